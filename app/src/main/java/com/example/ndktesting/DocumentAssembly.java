@@ -0,0 +1,73 @@
+package com.example.ndktesting;
+
+import android.os.ParcelFileDescriptor;
+
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Description of a merge or split for {@link PdfiumCore#assembleDocuments(DocumentAssembly, String, int)}:
+ * source files, output files and which pages of which source go into each output, in order.
+ * Sources are only read and may be shared by several outputs; outputs must be writable.
+ * Password protected sources are not supported.
+ */
+public class DocumentAssembly {
+    /*package*/ final List<ParcelFileDescriptor> mSources = new ArrayList<>();
+    /*package*/ final List<ParcelFileDescriptor> mOutputs = new ArrayList<>();
+    /*package*/ final List<int[]> mParts = new ArrayList<>();   //{output, source}
+    /*package*/ final List<String> mPartPages = new ArrayList<>();
+
+    /** @return index of the source for {@link #addPages(int, int, String)} */
+    public int addSource(ParcelFileDescriptor source) {
+        mSources.add(source);
+        return mSources.size() - 1;
+    }
+
+    /** @return index of the output for {@link #addPages(int, int, String)} */
+    public int addOutput(ParcelFileDescriptor output) {
+        mOutputs.add(output);
+        return mOutputs.size() - 1;
+    }
+
+    /**
+     * Append pages of a source to an output.
+     *
+     * @param pages 1-based page list like "1-3,7", null for all pages
+     */
+    public DocumentAssembly addPages(int output, int source, String pages) {
+        if (output < 0 || output >= mOutputs.size() || source < 0 || source >= mSources.size()) {
+            throw new IndexOutOfBoundsException("Unknown output or source");
+        }
+        mParts.add(new int[]{output, source});
+        mPartPages.add(pages);
+        return this;
+    }
+
+    public int getOutputCount() {
+        return mOutputs.size();
+    }
+
+    /** All pages of the sources, one after another, into out */
+    public static DocumentAssembly merge(ParcelFileDescriptor out, ParcelFileDescriptor... sources) {
+        DocumentAssembly assembly = new DocumentAssembly();
+        int output = assembly.addOutput(out);
+        for (ParcelFileDescriptor source : sources) {
+            assembly.addPages(output, assembly.addSource(source), null);
+        }
+        return assembly;
+    }
+
+    /** Page ranges of one source, ranges[i] into outs[i] */
+    public static DocumentAssembly split(ParcelFileDescriptor source, String[] ranges,
+                                         ParcelFileDescriptor[] outs) {
+        if (ranges.length != outs.length) {
+            throw new IllegalArgumentException("One output per range needed");
+        }
+        DocumentAssembly assembly = new DocumentAssembly();
+        int input = assembly.addSource(source);
+        for (int i = 0; i < outs.length; i++) {
+            assembly.addPages(assembly.addOutput(outs[i]), input, ranges[i]);
+        }
+        return assembly;
+    }
+}
@@ -0,0 +1,93 @@
+package com.example.ndktesting;
+
+import android.graphics.Bitmap;
+import android.os.ParcelFileDescriptor;
+
+import com.example.ndktesting.util.SizeF;
+
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * What a viewer shows before the first render: page count and sizes, metadata, outline
+ * and a first page thumbnail. Returned by {@link PdfiumCore#getCachedDocumentSummary(ParcelFileDescriptor)}
+ * straight from the disk cache, or by {@link PdfiumCore#getDocumentSummary(PdfDocument)}.
+ * Bookmarks of the outline have no native pointer.
+ */
+public class DocumentSummary {
+    private final int mPageCount;
+    private final float[] mPageSizes;
+    private final PdfDocument.Meta mMeta;
+    private final List<PdfDocument.Bookmark> mOutline;
+    private final int mThumbnailWidth;
+    private final int mThumbnailHeight;
+    private final int[] mThumbnail;
+
+    /*package*/ DocumentSummary(Object[] arrays) {
+        int[] header = (int[]) arrays[0];
+        mPageCount = header[0];
+        mThumbnailWidth = header[1];
+        mThumbnailHeight = header[2];
+        mPageSizes = (float[]) arrays[1];
+
+        String[] meta = (String[]) arrays[2];
+        mMeta = new PdfDocument.Meta();
+        mMeta.title = meta[0];
+        mMeta.author = meta[1];
+        mMeta.subject = meta[2];
+        mMeta.keywords = meta[3];
+        mMeta.creator = meta[4];
+        mMeta.producer = meta[5];
+        mMeta.creationDate = meta[6];
+        mMeta.modDate = meta[7];
+
+        mOutline = buildOutline((String[]) arrays[3], (int[]) arrays[4]);
+        mThumbnail = (int[]) arrays[5];
+    }
+
+    //Entries are in pre-order with their depth, the last entry of each depth is the parent
+    private static List<PdfDocument.Bookmark> buildOutline(String[] titles, int[] outline) {
+        List<PdfDocument.Bookmark> topLevel = new ArrayList<>();
+        List<List<PdfDocument.Bookmark>> levels = new ArrayList<>();
+        levels.add(topLevel);
+        for (int i = 0; i < titles.length; i++) {
+            int depth = Math.min(outline[i * 2], levels.size() - 1);
+            PdfDocument.Bookmark bookmark = new PdfDocument.Bookmark();
+            bookmark.title = titles[i];
+            bookmark.pageIdx = outline[i * 2 + 1];
+            levels.get(depth).add(bookmark);
+
+            while (levels.size() > depth + 1) {
+                levels.remove(levels.size() - 1);
+            }
+            levels.add(bookmark.getChildren());
+        }
+        return topLevel;
+    }
+
+    public int getPageCount() {
+        return mPageCount;
+    }
+
+    /** Page size in points */
+    public SizeF getPageSize(int pageIndex) {
+        return new SizeF(mPageSizes[pageIndex * 2], mPageSizes[pageIndex * 2 + 1]);
+    }
+
+    public PdfDocument.Meta getMeta() {
+        return mMeta;
+    }
+
+    public List<PdfDocument.Bookmark> getTableOfContents() {
+        return mOutline;
+    }
+
+    /** First page rendered small, null if the summary has none */
+    public Bitmap getThumbnail() {
+        if (mThumbnail.length == 0) {
+            return null;
+        }
+        return Bitmap.createBitmap(mThumbnail, mThumbnailWidth, mThumbnailHeight,
+                Bitmap.Config.ARGB_8888);
+    }
+}
@@ -0,0 +1,52 @@
+package com.example.ndktesting;
+
+/**
+ * Text of a whole document as one UTF-16 string, returned by
+ * {@link PdfiumCore#getDocumentText(PdfDocument)}. Pages follow each other without
+ * separators; the page offset table maps between characters and pages.
+ */
+public class DocumentText {
+    public final String text;
+    private final int[] mPageOffsets;
+
+    /*package*/ DocumentText(String text, int[] pageOffsets) {
+        this.text = text;
+        mPageOffsets = pageOffsets;
+    }
+
+    public int getPageCount() {
+        return mPageOffsets.length - 1;
+    }
+
+    /** Index of the first character of the page in {@link #text} */
+    public int getPageStart(int pageIndex) {
+        return mPageOffsets[pageIndex];
+    }
+
+    /** Index past the last character of the page in {@link #text} */
+    public int getPageEnd(int pageIndex) {
+        return mPageOffsets[pageIndex + 1];
+    }
+
+    public String getPageText(int pageIndex) {
+        return text.substring(getPageStart(pageIndex), getPageEnd(pageIndex));
+    }
+
+    /** Page containing the character at index of {@link #text}, -1 if out of range */
+    public int getPageAt(int index) {
+        if (index < 0 || index >= text.length()) {
+            return -1;
+        }
+        int low = 0;
+        int high = getPageCount() - 1;
+        while (low < high) {
+            int mid = (low + high + 1) >>> 1;
+            if (mPageOffsets[mid] <= index) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        return low;
+    }
+}
@@ -0,0 +1,26 @@
+package com.example.ndktesting;
+
+/**
+ * Spatial index of the links, web links and chars of one page, created by
+ * {@link PdfiumCore#newPageHitIndex(PdfDocument, int)}. The native index never changes
+ * once built and lookups never call into PDFium, so they do not wait for renders; a
+ * separate index lock keeps a close from freeing it under them. When the page content is
+ * rewritten (fit to sheet, flatten) the index is dropped and the next lookup rebuilds it
+ * under the PdfiumCore lock.
+ */
+public class PageHitIndex {
+    /*package*/ long mNativeHitIndexPtr;    //written under the index lock
+    /*package*/ volatile boolean mStale;    //page content rewritten, rebuild before the next lookup
+    /*package*/ final PdfDocument mDocument;
+    /*package*/ final int mPageIndex;
+
+    /*package*/ PageHitIndex(PdfDocument doc, int pageIndex, long nativeHitIndexPtr) {
+        mDocument = doc;
+        mPageIndex = pageIndex;
+        mNativeHitIndexPtr = nativeHitIndexPtr;
+    }
+
+    public int getPageIndex() {
+        return mPageIndex;
+    }
+}
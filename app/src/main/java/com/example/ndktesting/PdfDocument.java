@@ -5,10 +5,12 @@ import android.os.ParcelFileDescriptor;
 
 
 import androidx.collection.ArrayMap;
+import androidx.collection.ArraySet;
 
 import java.util.ArrayList;
 import java.util.List;
 import java.util.Map;
+import java.util.Set;
 
 public class PdfDocument {
 
@@ -106,11 +108,24 @@ public class PdfDocument {
     }
 
     /*package*/ long mNativeDocPtr;
+    /* own reference to the native web link cache, read under the PdfiumCore index lock */
+    /*package*/ long mNativeWebLinksPtr;
     /*package*/ ParcelFileDescriptor parcelFileDescriptor;
+    /*package*/ boolean mPasswordProtected;
 
     /*package*/ final Map<Integer, Long> mNativePagesPtr = new ArrayMap<>();
     /*package*/ final Map<Integer, Long> mNativeTextPagesPtr = new ArrayMap<>();
+    /* closed by a memory trim, reopened on next use */
+    /*package*/ final Set<Integer> mEvictedPages = new ArraySet<>();
+    /*package*/ final Set<Integer> mEvictedTextPages = new ArraySet<>();
+
+    /*package*/ final List<SearchSession> mSearchSessions = new ArrayList<>();
+    /*package*/ final List<PageHitIndex> mHitIndexes = new ArrayList<>();
+
+    /*package*/ RenderPool mRenderPool;
+    /*package*/ int mRenderPoolDocId = -1;
+
     public boolean hasPage(int index) {
-        return mNativePagesPtr.containsKey(index);
+        return mNativePagesPtr.containsKey(index) || mEvictedPages.contains(index);
     }
 }
@@ -1,22 +1,27 @@
 package com.example.ndktesting;
 
+import android.content.ComponentCallbacks2;
 import android.content.Context;
 import android.graphics.Bitmap;
 import android.graphics.Point;
+import android.graphics.PointF;
 import android.graphics.Rect;
 import android.graphics.RectF;
 import android.os.ParcelFileDescriptor;
 import android.util.Log;
+import android.view.KeyEvent;
 import android.view.Surface;
 
 import com.example.ndktesting.util.Size;
 
+import java.io.File;
 import java.io.FileDescriptor;
 import java.io.IOException;
 import java.io.UnsupportedEncodingException;
 import java.lang.reflect.Field;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
 import java.util.ArrayList;
 import java.util.List;
 
@@ -96,6 +101,8 @@ public class PdfiumCore {
 
     private native long[] nativeGetPageLinks(long pagePtr);
 
+    private native void nativeCloseLinks(long[] linkPtrs);
+
     private native Integer nativeGetDestPageIndex(long docPtr, long linkPtr);
 
     private native String nativeGetLinkURI(long docPtr, long linkPtr);
@@ -132,16 +139,214 @@ public class PdfiumCore {
 
     private native double[] nativeTextGetRect(long textPagePtr, int rect_index);
 
+    private native float[] nativeTextMapTextRange(long textPagePtr, int textStart, int textLength);
+
     private native int nativeTextGetBoundedText(long textPagePtr, double left, double top, double right, double bottom, short[] arr);
 
     private native long[] nativeLoadTextPages(long docPtr, int fromIndex, int toIndex);
 
     private native int nativeTextGetUnicode(long textPagePtr, int index);
 
+    private native float[] nativeTextGetCharGeometry(long textPagePtr);
+
+    private native long nativeNewTextSelection(long textPagePtr);
+
+    private native void nativeCloseTextSelection(long selectionPtr);
+
+    private native float[] nativeTextSelectionUpdate(long selectionPtr, float startX, float startY,
+                                                     float endX, float endY);
+
+    private native float[] nativeTextSelectionSelect(long selectionPtr, int start, int end);
+
+    private native String nativeTextSelectionGetText(long selectionPtr);
+
+    private native void nativeCloseSearchHandle(long handler);
+
+    private native long nativeNewSearchSession(long docPtr, int pageIndex, String query, int flags);
+
+    private native void nativeCloseSearchSession(long sessionPtr);
+
+    private native boolean nativeSearchSessionNext(long sessionPtr);
+
+    private native boolean nativeSearchSessionPrev(long sessionPtr);
+
+    private native boolean nativeSearchSessionJump(long sessionPtr, int n);
+
+    private native int nativeSearchSessionCount(long sessionPtr);
+
+    private native int[] nativeSearchSessionGetMatch(long sessionPtr);
+
+    private native long nativeNewTextSearchIndex(String text);
+
+    private native void nativeCloseTextSearchIndex(long indexPtr);
+
+    private native int[] nativeTextSearchIndexFind(long indexPtr, String query, int flags);
+
+    private native int nativeStartRegexSearch(long executorPtr, Object lock, long docPtr,
+                                              String pattern, int fromPage, int toPage,
+                                              RegexSearchCallback callback);
+
+    private native void nativeCancelRegexSearch(int searchId);
+
+    private native long nativeDetectWebLinks(long executorPtr, Object lock, long docPtr,
+                                             int pageIndex, long textPagePtr);
+
+    private native long nativeAcquireWebLinks(long docPtr);
+
+    private native void nativeReleaseWebLinks(long webLinksPtr);
+
+    private native Object[] nativeGetWebLinks(long webLinksPtr, int pageIndex);
+
+    private native String nativeGetWebLinkAt(long webLinksPtr, int pageIndex, float x, float y);
+
+    private native long nativeNewHitIndex(long docPtr, int pageIndex, long pagePtr, long textPagePtr);
+
+    private native void nativeCloseHitIndex(long indexPtr);
+
+    private native long nativeHitTest(long indexPtr, float x, float y, float tolerance);
+
+    private native PdfDocument.Link nativeHitIndexGetLink(long indexPtr, long hit);
+
+    private native int nativeBuildNamedDestIndex(long docPtr);
+
+    private native int nativeFindNamedDest(long docPtr, String name);
+
+    private native Object[] nativeReadDocumentSummary(int fd, String cacheDir);
+
+    private native boolean nativeIsDocumentModified(long docPtr);
+
+    private native void nativeInvalidatePageIndexes(long docPtr, int fromIndex, int toIndex);
+
+    private native Object[] nativeBuildDocumentSummary(long docPtr, int fd, String cacheDir,
+                                                       int thumbnailWidth);
+
+    private native long nativeCreateRenderPool(String workerPath, int workers) throws IOException;
+
+    private native void nativeDestroyRenderPool(long poolPtr);
+
+    private native int nativeGetRenderPoolWorkers(long poolPtr);
+
+    private native int nativeRenderPoolOpenDocument(long poolPtr, int fd, String password) throws IOException;
+
+    private native void nativeRenderPoolCloseDocument(long poolPtr, int docId);
+
+    private native boolean nativeRenderPoolRenderBitmap(long poolPtr, int docId, int pageIndex,
+                                                        Bitmap bitmap, int startX, int startY,
+                                                        int drawSizeHor, int drawSizeVer,
+                                                        boolean renderAnnot);
+
+    private native int nativeRenderPoolRenderBitmaps(long poolPtr, int docId, int[] pageIndexes,
+                                                     Bitmap[] bitmaps, boolean renderAnnot);
+
+    private native long nativeRenderPoolRenderShared(long poolPtr, int docId, int pageIndex,
+                                                     int width, int height, boolean renderAnnot);
+
+    private native ByteBuffer nativeRenderPoolMapPage(long poolPtr, long ticket);
+
+    private native void nativeRenderPoolReleasePage(long poolPtr, long ticket);
+
+    private native String nativeGetDocumentText(long docPtr, int[] pageOffsets);
+
+    private native String nativeRenderPoolGetDocumentText(long poolPtr, int docId, int pageCount,
+                                                          int[] pageOffsets);
+
+    private native long nativeCreateRenderExecutor(int threads);
+
+    private native long nativeSubmitRender(long executorPtr, Object lock, long docPtr, long pagePtr,
+                                           long poolPtr, int poolDocId, int pageIndex,
+                                           Bitmap bitmap, int startX, int startY,
+                                           int drawSizeHor, int drawSizeVer, boolean renderAnnot,
+                                           RenderCallback callback);
+
+    private native int nativeGetRenderStatus(long executorPtr, long ticket);
+
+    private native int nativeAwaitRender(long executorPtr, long ticket, int timeoutMs);
+
+    private native boolean nativeCancelRender(long executorPtr, long ticket);
+
+    private native void nativeCancelDocumentRenders(long executorPtr, long docPtr);
+
+    private native void nativeShutdownRenderExecutor(long executorPtr);
+
+    private native long nativeTrimMemory(int level);
+
+    private native long[] nativeGetMemoryUsage();
+
+    private native int nativeLoadFontIndex(String indexPath, String[] fontDirs);
+
+    private native void nativeInstallFontIndex();
+
+    private native void nativeWarmUpLibrary(int gracePeriodMs);
+
+    private native void nativeRenderPageGray(long pagePtr, ByteBuffer buffer, int output, int stride,
+                                             int width, int height, int startX, int startY,
+                                             int drawSizeHor, int drawSizeVer, boolean renderAnnot);
+
+    private native long nativeSaveDocument(long docPtr, int fd, boolean incremental, boolean append,
+                                           SaveCallback callback) throws IOException;
+
+    private native int[] nativeAssembleDocuments(String workerPath, int[] sourceFds, int[] outputFds,
+                                                 int[] partOutputs, int[] partSources,
+                                                 String[] partPages, int maxProcesses);
+
+    private native float[] nativeChooseSheetLayout(long docPtr, int pageIndex, int pagesPerSheet,
+                                                   float sheetWidth, float sheetHeight,
+                                                   float margin, float gap);
+
+    private native int nativeTransformPagesToSheet(long docPtr, int fromIndex, int toIndex,
+                                                   float sheetWidth, float sheetHeight, float margin);
+
+    private native void nativeRenderSheet(long docPtr, Bitmap bitmap, int firstPage, float[] layout,
+                                          boolean renderAnnot);
+
+    private native int[] nativeFlattenDocument(long docPtr, int fromIndex, int toIndex, int mode,
+                                               int fd, SaveCallback callback) throws IOException;
+
+    private native boolean nativeFormMouse(long docPtr, long pagePtr, int action, double pageX,
+                                           double pageY);
+
+    private native boolean nativeFormKey(long docPtr, long pagePtr, int keyCode, boolean down,
+                                         int modifier);
+
+    private native boolean nativeFormChar(long docPtr, long pagePtr, int unicode, int modifier);
+
+    private native void nativeFormKillFocus(long docPtr);
+
+    private native float[] nativeTakeFormDirtyRects(long docPtr, long pagePtr);
+
+    private native int[] nativeRenderPageRegions(long pagePtr, Bitmap bitmap, int startX, int startY,
+                                                 int drawSizeX, int drawSizeY, float[] pageRects,
+                                                 boolean renderAnnot);
+
+    private native PointF nativeDeviceCoordsToPage(long pagePtr, int startX, int startY, int sizeX,
+                                                   int sizeY, int rotate, int deviceX, int deviceY);
+
+    /** States of an async render ticket */
+    public static final int RENDER_UNKNOWN = -1;
+    public static final int RENDER_PENDING = 0;
+    public static final int RENDER_RUNNING = 1;
+    public static final int RENDER_DONE = 2;
+    public static final int RENDER_FAILED = 3;
+    public static final int RENDER_CANCELLED = 4;
+
     /* synchronize native methods */
     private static final Object lock = new Object();
+    /*
+     * Guards the lookup tables that taps read without waiting for renders: the web link
+     * caches and hit indexes of open documents. Taken alone or inside lock, never the
+     * other way round.
+     */
+    private static final Object indexLock = new Object();
     private static Field mFdField = null;
     private int mCurrentDpi;
+    private String mSummaryCacheDir;
+
+    /** Width in pixels of the first page thumbnail kept in a {@link DocumentSummary} */
+    private static final int SUMMARY_THUMBNAIL_WIDTH = 256;
+    /* native executor running async renders, shared by all instances */
+    private static long sRenderExecutorPtr = 0;
+    /* documents of all instances, visited by trimMemory */
+    private static final List<PdfDocument> sOpenDocuments = new ArrayList<>();
 
     public static int getNumFd(ParcelFileDescriptor fdObj) {
         try {
@@ -167,6 +372,10 @@ public class PdfiumCore {
     /** Context needed to get screen density */
     public PdfiumCore(Context ctx) {
         mCurrentDpi = ctx.getResources().getDisplayMetrics().densityDpi;
+        File summaryDir = new File(ctx.getCacheDir(), "pdfium-summaries");
+        if (summaryDir.isDirectory() || summaryDir.mkdirs()) {
+            mSummaryCacheDir = summaryDir.getPath();
+        }
         Log.d(TAG, "Starting PdfiumAndroid " + BuildConfig.VERSION_NAME);
     }
 
@@ -179,8 +388,11 @@ public class PdfiumCore {
     public PdfDocument newDocument(ParcelFileDescriptor fd, String password) throws IOException {
         PdfDocument document = new PdfDocument();
         document.parcelFileDescriptor = fd;
+        document.mPasswordProtected = password != null;
         synchronized (lock) {
             document.mNativeDocPtr = nativeOpenDocument(getNumFd(fd), password);
+            document.mNativeWebLinksPtr = nativeAcquireWebLinks(document.mNativeDocPtr);
+            sOpenDocuments.add(document);
         }
 
         return document;
@@ -196,6 +408,8 @@ public class PdfiumCore {
         PdfDocument document = new PdfDocument();
         synchronized (lock) {
             document.mNativeDocPtr = nativeOpenMemDocument(data, password);
+            document.mNativeWebLinksPtr = nativeAcquireWebLinks(document.mNativeDocPtr);
+            sOpenDocuments.add(document);
         }
         return document;
     }
@@ -207,7 +421,7 @@ public class PdfiumCore {
         }
     }
 
-    /** Open page and store native pointer in {@link PdfDocument} */
+    /** Open page and store its native handle in {@link PdfDocument} */
     public long openPage(PdfDocument doc, int pageIndex) {
         long pagePtr;
         synchronized (lock) {
@@ -218,7 +432,7 @@ public class PdfiumCore {
 
     }
 
-    /** Open range of pages and store native pointers in {@link PdfDocument} */
+    /** Open range of pages and store their native handles in {@link PdfDocument} */
     public long[] openPage(PdfDocument doc, int fromIndex, int toIndex) {
         long[] pagesPtr;
         synchronized (lock) {
@@ -234,6 +448,25 @@ public class PdfiumCore {
         }
     }
 
+    /* Opened page, reopened if a memory trim closed it; call holding the lock */
+    private Long getPagePtr(PdfDocument doc, int pageIndex) {
+        Long pagePtr = doc.mNativePagesPtr.get(pageIndex);
+        if (pagePtr == null && doc.mEvictedPages.remove(pageIndex)) {
+            pagePtr = nativeLoadPage(doc.mNativeDocPtr, pageIndex);
+            doc.mNativePagesPtr.put(pageIndex, pagePtr);
+        }
+        return pagePtr;
+    }
+
+    /* Loaded text page, reloaded if a memory trim closed it; call holding the lock */
+    private Long getTextPagePtr(PdfDocument doc, int pageIndex) {
+        Long textPtr = doc.mNativeTextPagesPtr.get(pageIndex);
+        if (textPtr == null && doc.mEvictedTextPages.contains(pageIndex)) {
+            textPtr = getPdfTextPageLoad(doc, pageIndex);
+        }
+        return textPtr;
+    }
+
     /**
      * Get page width in pixels. <br>
      * This method requires page to be opened.
@@ -241,7 +474,7 @@ public class PdfiumCore {
     public int getPageWidth(PdfDocument doc, int index) {
         synchronized (lock) {
             Long pagePtr;
-            if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
+            if ((pagePtr = getPagePtr(doc, index)) != null) {
                 return nativeGetPageWidthPixel(pagePtr, mCurrentDpi);
             }
             return 0;
@@ -255,7 +488,7 @@ public class PdfiumCore {
     public int getPageHeight(PdfDocument doc, int index) {
         synchronized (lock) {
             Long pagePtr;
-            if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
+            if ((pagePtr = getPagePtr(doc, index)) != null) {
                 return nativeGetPageHeightPixel(pagePtr, mCurrentDpi);
             }
             return 0;
@@ -272,7 +505,7 @@ public class PdfiumCore {
     public int getPageWidthPoint(PdfDocument doc, int index) {
         synchronized (lock) {
             Long pagePtr;
-            if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
+            if ((pagePtr = getPagePtr(doc, index)) != null) {
                 return nativeGetPageWidthPoint(pagePtr);
             }
             return 0;
@@ -286,7 +519,7 @@ public class PdfiumCore {
     public int getPageHeightPoint(PdfDocument doc, int index) {
         synchronized (lock) {
             Long pagePtr;
-            if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
+            if ((pagePtr = getPagePtr(doc, index)) != null) {
                 return nativeGetPageHeightPoint(pagePtr);
             }
             return 0;
@@ -322,7 +555,7 @@ public class PdfiumCore {
         synchronized (lock) {
             try {
                 //nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi);
-                nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi,
+                nativeRenderPage(getPagePtr(doc, pageIndex), surface, mCurrentDpi,
                         startX, startY, drawSizeX, drawSizeY, renderAnnot);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
@@ -358,9 +591,16 @@ public class PdfiumCore {
     public void renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
                                  int startX, int startY, int drawSizeX, int drawSizeY,
                                  boolean renderAnnot) {
+        RenderPool pool = doc.mRenderPool;
+        if (pool != null) {
+            //Workers have their own PDFium instances, no need for the global lock
+            nativeRenderPoolRenderBitmap(pool.mNativePoolPtr, doc.mRenderPoolDocId, pageIndex,
+                    bitmap, startX, startY, drawSizeX, drawSizeY, renderAnnot);
+            return;
+        }
         synchronized (lock) {
             try {
-                nativeRenderPageBitmap(doc.mNativePagesPtr.get(pageIndex), bitmap, mCurrentDpi,
+                nativeRenderPageBitmap(getPagePtr(doc, pageIndex), bitmap, mCurrentDpi,
                         startX, startY, drawSizeX, drawSizeY, renderAnnot);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
@@ -372,180 +612,1271 @@ public class PdfiumCore {
         }
     }
 
-    /** Release native resources and opened file */
-    public void closeDocument(PdfDocument doc) {
+    private long getRenderExecutor() {
         synchronized (lock) {
-            for (Integer index : doc.mNativePagesPtr.keySet()) {
-                nativeClosePage(doc.mNativePagesPtr.get(index));
+            if (sRenderExecutorPtr == 0) {
+                //In-process renders serialize on the lock anyway, more threads help pooled documents
+                int threads = Math.max(1, Math.min(4, Runtime.getRuntime().availableProcessors() - 1));
+                sRenderExecutorPtr = nativeCreateRenderExecutor(threads);
             }
-            doc.mNativePagesPtr.clear();
-
-            nativeCloseDocument(doc.mNativeDocPtr);
+            return sRenderExecutorPtr;
+        }
+    }
 
-            if (doc.parcelFileDescriptor != null) { //if document was loaded from file
-                try {
-                    doc.parcelFileDescriptor.close();
-                } catch (IOException e) {
-                /* ignore */
+    /**
+     * Queue rendering of a page fragment on {@link Bitmap} and return immediately.
+     * A native render thread owns the PDFium calls; the bitmap must not be drawn
+     * until the render completes.<br>
+     * Page must be opened before rendering unless the document has a render pool.
+     *
+     * @param callback notified on the render thread when done, may be null to poll instead
+     * @return ticket for {@link #getRenderStatus(long)}, {@link #awaitRender(long, int)}
+     * and {@link #cancelRender(long)}
+     */
+    public long renderPageBitmapAsync(PdfDocument doc, Bitmap bitmap, int pageIndex,
+                                      int startX, int startY, int drawSizeX, int drawSizeY,
+                                      boolean renderAnnot, RenderCallback callback) {
+        long executorPtr = getRenderExecutor();
+        long pagePtr = 0;
+        RenderPool pool = doc.mRenderPool;
+        //Submit under the lock so a trim cannot close the page in between
+        synchronized (lock) {
+            if (pool == null) {
+                Long ptr = getPagePtr(doc, pageIndex);
+                if (ptr == null) {
+                    throw new IllegalStateException("Page " + pageIndex + " is not opened");
                 }
-                doc.parcelFileDescriptor = null;
+                pagePtr = ptr;
             }
+            return nativeSubmitRender(executorPtr, lock, doc.mNativeDocPtr, pagePtr,
+                    pool != null ? pool.mNativePoolPtr : 0, doc.mRenderPoolDocId, pageIndex,
+                    bitmap, startX, startY, drawSizeX, drawSizeY, renderAnnot, callback);
         }
     }
 
-    /** Get metadata for given document */
-    public PdfDocument.Meta getDocumentMeta(PdfDocument doc) {
-        synchronized (lock) {
-            PdfDocument.Meta meta = new PdfDocument.Meta();
-            meta.title = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Title");
-            meta.author = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Author");
-            meta.subject = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Subject");
-            meta.keywords = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Keywords");
-            meta.creator = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Creator");
-            meta.producer = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Producer");
-            meta.creationDate = nativeGetDocumentMetaText(doc.mNativeDocPtr, "CreationDate");
-            meta.modDate = nativeGetDocumentMetaText(doc.mNativeDocPtr, "ModDate");
+    /**
+     * @return one of RENDER_* states, {@link #RENDER_UNKNOWN} once the ticket fell out
+     * of the recent history
+     */
+    public int getRenderStatus(long ticket) {
+        return nativeGetRenderStatus(getRenderExecutor(), ticket);
+    }
 
-            return meta;
+    /**
+     * Wait for an async render, never call it on the UI thread with a long timeout.
+     *
+     * @param timeoutMs negative to wait until done
+     * @return state of the render when the wait ended
+     */
+    public int awaitRender(long ticket, int timeoutMs) {
+        return nativeAwaitRender(getRenderExecutor(), ticket, timeoutMs);
+    }
+
+    /** Cancel an async render not started yet, the callback still gets {@link #RENDER_CANCELLED} */
+    public boolean cancelRender(long ticket) {
+        return nativeCancelRender(getRenderExecutor(), ticket);
+    }
+
+    /**
+     * Start a pool of render worker processes. Each worker loads its own PDFium,
+     * so documents attached with {@link #attachRenderPool(PdfDocument, RenderPool, String)}
+     * render pages in parallel.
+     *
+     * @param workerPath path of the pdfiumRenderWorker executable,
+     *                   see {@link RenderPool#getDefaultWorkerPath(Context)}
+     */
+    public RenderPool newRenderPool(String workerPath, int workers) throws IOException {
+        RenderPool.checkWorker(workerPath);
+        RenderPool pool = new RenderPool();
+        pool.mNativePoolPtr = nativeCreateRenderPool(workerPath, workers);
+        pool.mWorkers = nativeGetRenderPoolWorkers(pool.mNativePoolPtr);
+        return pool;
+    }
+
+    /**
+     * Open document in all workers of the pool. Afterwards
+     * {@link #renderPageBitmap(PdfDocument, Bitmap, int, int, int, int, int, boolean)}
+     * goes through the pool. Only documents opened from a file descriptor are supported.
+     */
+    public void attachRenderPool(PdfDocument doc, RenderPool pool, String password) throws IOException {
+        if (doc.parcelFileDescriptor == null) {
+            throw new IOException("Render pool needs a document opened from file");
         }
+        doc.mRenderPoolDocId = nativeRenderPoolOpenDocument(pool.mNativePoolPtr,
+                getNumFd(doc.parcelFileDescriptor), password);
+        doc.mRenderPool = pool;
     }
 
-    /** Get table of contents (bookmarks) for given document */
-    public List<PdfDocument.Bookmark> getTableOfContents(PdfDocument doc) {
-        synchronized (lock) {
-            List<PdfDocument.Bookmark> topLevel = new ArrayList<>();
-            Long first = nativeGetFirstChildBookmark(doc.mNativeDocPtr, null);
-            if (first != null) {
-                recursiveGetBookmark(topLevel, doc, first);
-            }
-            return topLevel;
+    /**
+     * Render whole pages scaled to given bitmaps, pages are spread over the pool workers.
+     *
+     * @return number of pages rendered
+     */
+    public int renderPagesBitmap(PdfDocument doc, int[] pageIndexes, Bitmap[] bitmaps,
+                                 boolean renderAnnot) {
+        RenderPool pool = doc.mRenderPool;
+        if (pool == null) {
+            throw new IllegalStateException("Document is not attached to a render pool");
         }
+        return nativeRenderPoolRenderBitmaps(pool.mNativePoolPtr, doc.mRenderPoolDocId,
+                pageIndexes, bitmaps, renderAnnot);
     }
 
-    private void recursiveGetBookmark(List<PdfDocument.Bookmark> tree, PdfDocument doc, long bookmarkPtr) {
-        PdfDocument.Bookmark bookmark = new PdfDocument.Bookmark();
-        bookmark.mNativePtr = bookmarkPtr;
-        bookmark.title = nativeGetBookmarkTitle(bookmarkPtr);
-        bookmark.pageIdx = nativeGetBookmarkDestIndex(doc.mNativeDocPtr, bookmarkPtr);
-        tree.add(bookmark);
+    /**
+     * Render whole page into the shared memory ring of the pool, the workers write pixels
+     * there directly so nothing is copied on the way. Release the page when done with it,
+     * a pool has only a few slots.
+     *
+     * @return rendered page or null if rendering failed or all slots are in use
+     */
+    public RenderedPage renderPageShared(PdfDocument doc, int pageIndex, int width, int height,
+                                         boolean renderAnnot) {
+        RenderPool pool = doc.mRenderPool;
+        if (pool == null) {
+            throw new IllegalStateException("Document is not attached to a render pool");
+        }
+        long ticket = nativeRenderPoolRenderShared(pool.mNativePoolPtr, doc.mRenderPoolDocId,
+                pageIndex, width, height, renderAnnot);
+        if (ticket == 0) {
+            return null;
+        }
+        //The ticket holds its slot from the render on, give it back if mapping fails
+        ByteBuffer pixels = nativeRenderPoolMapPage(pool.mNativePoolPtr, ticket);
+        if (pixels == null) {
+            nativeRenderPoolReleasePage(pool.mNativePoolPtr, ticket);
+            return null;
+        }
+        return new RenderedPage(ticket, pixels, pageIndex, width, height);
+    }
 
-        Long child = nativeGetFirstChildBookmark(doc.mNativeDocPtr, bookmarkPtr);
-        if (child != null) {
-            recursiveGetBookmark(bookmark.getChildren(), doc, child);
+    /** Give the ring slot of the page back to the pool, its pixels must not be used afterwards */
+    public void releaseRenderedPage(PdfDocument doc, RenderedPage page) {
+        RenderPool pool = doc.mRenderPool;
+        if (pool != null && page.mTicket != 0) {
+            nativeRenderPoolReleasePage(pool.mNativePoolPtr, page.mTicket);
+            page.mTicket = 0;
         }
+    }
 
-        Long sibling = nativeGetSiblingBookmark(doc.mNativeDocPtr, bookmarkPtr);
-        if (sibling != null) {
-            recursiveGetBookmark(tree, doc, sibling);
+    /** Stop pool workers, documents still attached must be closed first */
+    public void closeRenderPool(RenderPool pool) {
+        if (pool.mNativePoolPtr != 0) {
+            nativeDestroyRenderPool(pool.mNativePoolPtr);
+            pool.mNativePoolPtr = 0;
         }
     }
 
-    /** Get all links from given page */
-    public List<PdfDocument.Link> getPageLinks(PdfDocument doc, int pageIndex) {
+    /**
+     * Release native resources and opened file. Closing the last open document also
+     * stops the async render threads once their queue is drained.
+     */
+    public void closeDocument(PdfDocument doc) {
+        long executorPtr;
         synchronized (lock) {
-            List<PdfDocument.Link> links = new ArrayList<>();
-            Long nativePagePtr = doc.mNativePagesPtr.get(pageIndex);
-            if (nativePagePtr == null) {
-                return links;
+            executorPtr = sRenderExecutorPtr;
+        }
+        if (executorPtr != 0) {
+            //Outside the lock, running renders need it to finish
+            nativeCancelDocumentRenders(executorPtr, doc.mNativeDocPtr);
+        }
+        if (doc.mRenderPool != null) {
+            nativeRenderPoolCloseDocument(doc.mRenderPool.mNativePoolPtr, doc.mRenderPoolDocId);
+            doc.mRenderPool = null;
+            doc.mRenderPoolDocId = -1;
+        }
+        synchronized (lock) {
+            for (SearchSession session : doc.mSearchSessions) {
+                nativeCloseSearchSession(session.mNativeSessionPtr);
+                session.mNativeSessionPtr = 0;
             }
-            long[] linkPtrs = nativeGetPageLinks(nativePagePtr);
-            for (long linkPtr : linkPtrs) {
-                Integer index = nativeGetDestPageIndex(doc.mNativeDocPtr, linkPtr);
-                String uri = nativeGetLinkURI(doc.mNativeDocPtr, linkPtr);
-
-                RectF rect = nativeGetLinkRect(linkPtr);
-                if (rect != null && (index != null || uri != null)) {
-                    links.add(new PdfDocument.Link(rect, index, uri));
+            doc.mSearchSessions.clear();
+
+            synchronized (indexLock) {
+                for (PageHitIndex index : doc.mHitIndexes) {
+                    if (index.mNativeHitIndexPtr != 0) {
+                        nativeCloseHitIndex(index.mNativeHitIndexPtr);
+                    }
+                    index.mNativeHitIndexPtr = 0;
+                    index.mStale = false;
                 }
+            }
+            doc.mHitIndexes.clear();
 
+            long webLinksPtr;
+            synchronized (indexLock) {
+                webLinksPtr = doc.mNativeWebLinksPtr;
+                doc.mNativeWebLinksPtr = 0;
             }
-            return links;
+            nativeReleaseWebLinks(webLinksPtr);
+
+            //Closes every page, text page and search handle of the document natively
+            nativeCloseDocument(doc.mNativeDocPtr);
+            //Lookups racing the close find no document instead of a freed one
+            doc.mNativeDocPtr = 0;
+            doc.mNativeTextPagesPtr.clear();
+            doc.mNativePagesPtr.clear();
+            doc.mEvictedTextPages.clear();
+            doc.mEvictedPages.clear();
+            sOpenDocuments.remove(doc);
+
+            if (doc.parcelFileDescriptor != null) { //if document was loaded from file
+                try {
+                    doc.parcelFileDescriptor.close();
+                } catch (IOException e) {
+                /* ignore */
+                }
+                doc.parcelFileDescriptor = null;
+            }
+            if (!sOpenDocuments.isEmpty()) {
+                executorPtr = 0;
+            }
+        }
+        if (executorPtr != 0) {
+            //Last document gone, join the render threads; the next async call restarts them
+            nativeShutdownRenderExecutor(executorPtr);
         }
     }
 
+    /** Tracked native memory categories, indexes of {@link #getNativeMemoryUsage()} */
+    public static final int MEMORY_PAGES = 0;
+    public static final int MEMORY_TEXT_PAGES = 1;
+    public static final int MEMORY_TILE_CACHE = 2;
+    public static final int MEMORY_SCRATCH = 3;
+
     /**
-     * Map page coordinates to device screen coordinates
+     * Give native memory back, call from {@link android.content.ComponentCallbacks2#onTrimMemory(int)}.
+     * Levels are mapped one by one, the foreground RUNNING_* levels and the background ones
+     * are not one scale:
+     * <ul>
+     * <li>TRIM_MEMORY_RUNNING_MODERATE and TRIM_MEMORY_UI_HIDDEN drop scratch buffers
+     * and cached regexes.</li>
+     * <li>TRIM_MEMORY_RUNNING_LOW also closes the text pages of all documents;
+     * TRIM_MEMORY_RUNNING_CRITICAL also drops the render pool pixel ring and limits the
+     * PDFium image cache of renders until the pressure eases.</li>
+     * <li>TRIM_MEMORY_BACKGROUND closes text pages and pages, and releases a library kept by
+     * warmUpLibrary with no document open; TRIM_MEMORY_MODERATE and TRIM_MEMORY_COMPLETE
+     * also drop the pixel ring.</li>
+     * </ul>
+     * Closed pages reopen on next use through this class; page and text page handles returned
+     * earlier go stale and native calls with them throw IllegalStateException. Char geometry
+     * buffers must not be read afterwards.
      *
-     * @param doc       pdf document
-     * @param pageIndex index of page
-     * @param startX    left pixel position of the display area in device coordinates
-     * @param startY    top pixel position of the display area in device coordinates
-     * @param sizeX     horizontal size (in pixels) for displaying the page
-     * @param sizeY     vertical size (in pixels) for displaying the page
-     * @param rotate    page orientation: 0 (normal), 1 (rotated 90 degrees clockwise),
-     *                  2 (rotated 180 degrees), 3 (rotated 90 degrees counter-clockwise)
-     * @param pageX     X value in page coordinates
-     * @param pageY     Y value in page coordinate
-     * @return mapped coordinates
+     * @return bytes released by the native caches; closed pages are not counted
      */
-    public Point mapPageCoordsToDevice(PdfDocument doc, int pageIndex, int startX, int startY, int sizeX,
-                                       int sizeY, int rotate, double pageX, double pageY) {
-        long pagePtr = doc.mNativePagesPtr.get(pageIndex);
-        return nativePageCoordsToDevice(pagePtr, startX, startY, sizeX, sizeY, rotate, pageX, pageY);
+    public long trimMemory(int level) {
+        boolean closeTextPages;
+        boolean closePages;
+        switch (level) {
+            case ComponentCallbacks2.TRIM_MEMORY_RUNNING_MODERATE:
+            case ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN:
+                closeTextPages = false;
+                closePages = false;
+                break;
+            case ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW:
+            case ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL:
+                //Still visible, pages on screen stay open
+                closeTextPages = true;
+                closePages = false;
+                break;
+            case ComponentCallbacks2.TRIM_MEMORY_BACKGROUND:
+            case ComponentCallbacks2.TRIM_MEMORY_MODERATE:
+            case ComponentCallbacks2.TRIM_MEMORY_COMPLETE:
+                closeTextPages = true;
+                closePages = true;
+                break;
+            default:
+                //Levels added later than COMPLETE can only be worse
+                closeTextPages = level > ComponentCallbacks2.TRIM_MEMORY_COMPLETE;
+                closePages = closeTextPages;
+                break;
+        }
+        synchronized (lock) {
+            long released = nativeTrimMemory(level);
+            if (!closeTextPages) {
+                return released;
+            }
+            for (PdfDocument doc : sOpenDocuments) {
+                //Queued renders and web link scans find the handles stale and skip
+                for (Integer index : doc.mNativeTextPagesPtr.keySet()) {
+                    nativeCloseTextpage(doc.mNativeTextPagesPtr.get(index));
+                    doc.mEvictedTextPages.add(index);
+                }
+                doc.mNativeTextPagesPtr.clear();
+
+                if (closePages) {
+                    for (Integer index : doc.mNativePagesPtr.keySet()) {
+                        nativeClosePage(doc.mNativePagesPtr.get(index));
+                        doc.mEvictedPages.add(index);
+                    }
+                    doc.mNativePagesPtr.clear();
+                }
+            }
+            return released;
+        }
     }
 
-    /**
-     * @return mapped coordinates
-     * @see PdfiumCore#mapPageCoordsToDevice(PdfDocument, int, int, int, int, int, int, double, double)
-     */
-    public RectF mapRectToDevice(PdfDocument doc, int pageIndex, int startX, int startY, int sizeX,
-                                 int sizeY, int rotate, RectF coords) {
-
-        Point leftTop = mapPageCoordsToDevice(doc, pageIndex, startX, startY, sizeX, sizeY, rotate,
-                coords.left, coords.top);
-        Point rightBottom = mapPageCoordsToDevice(doc, pageIndex, startX, startY, sizeX, sizeY, rotate,
-                coords.right, coords.bottom);
-        return new RectF(leftTop.x, leftTop.y, rightBottom.x, rightBottom.y);
+    /** Estimated native bytes held per MEMORY_* category; PDFium does not report exact usage */
+    public long[] getNativeMemoryUsage() {
+        return nativeGetMemoryUsage();
     }
 
-
-    //updating the liibrary from here first try lets check it out
-
-    public long getPdfTextPageLoad(PdfDocument doc , int pageIndex){
-        long pagePtr;
-        long text;
+    /**
+     * Write the document, with any edits, to out. Writes are gathered into 1 MB chunks and
+     * the file is cut at the end of the output. A full rewrite cannot go into the file the
+     * document was opened from, PDFium still reads pages from it; use another file or
+     * {@link #saveDocumentIncremental(PdfDocument, SaveCallback)}.
+     *
+     * @param incremental keep the original bytes and append the changes as a new revision
+     * @param callback    progress, may be null
+     * @return size of the written file
+     * @throws IllegalArgumentException if out is the document's own file and not incremental
+     */
+    public long saveDocument(PdfDocument doc, ParcelFileDescriptor out, boolean incremental,
+                             SaveCallback callback) throws IOException {
         synchronized (lock) {
-            pagePtr = nativeLoadPage(doc.mNativeDocPtr, pageIndex);
-            doc.mNativePagesPtr.put(pageIndex, pagePtr);
-
-            text = nativeTextLoadPage(pagePtr);
-
-            return text;
+            return nativeSaveDocument(doc.mNativeDocPtr, getNumFd(out), incremental, false, callback);
         }
     }
 
-    public int getPageCharcters(long page){
+    /**
+     * Append the changes as a new revision to the file the document was opened from. Only the
+     * revision is written to disk, but PDFium still reads and serializes the whole original, so
+     * the save takes time in proportion to the file size; saving again replaces the previous
+     * revision. The file must have been opened read-write and not modified since.
+     *
+     * @param callback progress, may be null
+     * @return size of the file after the append
+     */
+    public long saveDocumentIncremental(PdfDocument doc, SaveCallback callback) throws IOException {
+        if (doc.parcelFileDescriptor == null) {
+            throw new IllegalStateException("Document was not opened from a file");
+        }
         synchronized (lock) {
-            return nativeGetTotalCharactersInPage(page);
+            return nativeSaveDocument(doc.mNativeDocPtr, getNumFd(doc.parcelFileDescriptor),
+                    true, true, callback);
         }
     }
 
+    /** Result of each output of {@link #assembleDocuments(DocumentAssembly, String, int)} */
+    public static final int ASSEMBLE_OK = 0;
+    public static final int ASSEMBLE_ERROR_SOURCE = 1;
+    public static final int ASSEMBLE_ERROR_PAGES = 2;
+    public static final int ASSEMBLE_ERROR_SAVE = 3;
+    public static final int ASSEMBLE_ERROR_PROCESS = 4;
 
-    public boolean searchWord(String word ,int flag, long page)  {
-        synchronized (lock){
-
-            return nativeIfMatchFound(nativeTextSearchHandler(page,flag,word));
-        }
+    /**
+     * Build the outputs of a merge or split. Each output is assembled by its own worker
+     * process with its own PDFium, so outputs are built in parallel and do not hold the
+     * PDFium lock of this process. Blocks until all outputs are done; call off the UI thread.
+     *
+     * @param workerPath   path of the pdfiumRenderWorker executable,
+     *                     see {@link RenderPool#getDefaultWorkerPath(Context)}
+     * @param maxProcesses workers running at once
+     * @return ASSEMBLE_* status per output
+     * @throws IOException if the worker executable is not there
+     */
+    public int[] assembleDocuments(DocumentAssembly assembly, String workerPath, int maxProcesses)
+            throws IOException {
+        RenderPool.checkWorker(workerPath);
+        int[] sourceFds = new int[assembly.mSources.size()];
+        for (int i = 0; i < sourceFds.length; i++) {
+            sourceFds[i] = getNumFd(assembly.mSources.get(i));
+        }
+        int[] outputFds = new int[assembly.mOutputs.size()];
+        for (int i = 0; i < outputFds.length; i++) {
+            outputFds[i] = getNumFd(assembly.mOutputs.get(i));
+        }
+        int parts = assembly.mParts.size();
+        int[] partOutputs = new int[parts];
+        int[] partSources = new int[parts];
+        for (int i = 0; i < parts; i++) {
+            partOutputs[i] = assembly.mParts.get(i)[0];
+            partSources[i] = assembly.mParts.get(i)[1];
+        }
+        String[] partPages = assembly.mPartPages.toArray(new String[parts]);
+        return nativeAssembleDocuments(workerPath, sourceFds, outputFds, partOutputs, partSources,
+                partPages, maxProcesses);
+    }
+
+    /**
+     * Sheet layout for pagesPerSheet pages of the document, sized after its first page. The grid
+     * and the sheet orientation giving the largest pages are chosen; pages are turned a quarter
+     * in their cell when that makes them larger.
+     *
+     * @param sheetWidth  sheet size in points, e.g. 595 x 842 for A4
+     * @param margin      around the cells, points
+     * @param gap         between cells, points
+     */
+    public SheetLayout getSheetLayout(PdfDocument doc, int pagesPerSheet, float sheetWidth,
+                                      float sheetHeight, float margin, float gap) {
+        synchronized (lock) {
+            return new SheetLayout(nativeChooseSheetLayout(doc.mNativeDocPtr, 0, pagesPerSheet,
+                    sheetWidth, sheetHeight, margin, gap));
+        }
+    }
+
+    /**
+     * Render a sheet of several pages for printing. Every page is drawn straight into its cell of
+     * bitmap, so no page bitmaps are allocated or copied; the bitmap should have the aspect ratio
+     * of the layout. Pages do not need to be opened.
+     *
+     * @param bitmap     ARGB_8888 only
+     * @param sheetIndex pages from sheetIndex * layout.getPagesPerSheet() on
+     */
+    public void renderSheet(PdfDocument doc, Bitmap bitmap, SheetLayout layout, int sheetIndex,
+                            boolean renderAnnot) {
+        synchronized (lock) {
+            nativeRenderSheet(doc.mNativeDocPtr, bitmap, sheetIndex * layout.getPagesPerSheet(),
+                    layout.mValues, renderAnnot);
+        }
+    }
+
+    /**
+     * Fit pages fromIndex..toIndex to a sheet size, e.g. A4 pages onto Letter paper. Each page is
+     * scaled, turned to the sheet orientation that fits it best and centered; its rotation is
+     * folded into the content. The content stays vector and is written by
+     * {@link #saveDocument(PdfDocument, ParcelFileDescriptor, boolean, SaveCallback)}. Opened
+     * pages in the range are reopened on next use, handles returned earlier go stale. Render pool
+     * workers keep showing the original pages.
+     *
+     * @return number of pages transformed
+     */
+    public int fitPagesToSheet(PdfDocument doc, int fromIndex, int toIndex, float sheetWidth,
+                               float sheetHeight, float margin) {
+        synchronized (lock) {
+            int transformed = nativeTransformPagesToSheet(doc.mNativeDocPtr, fromIndex, toIndex,
+                    sheetWidth, sheetHeight, margin);
+            reopenPages(doc, fromIndex, toIndex);
+            return transformed;
+        }
+    }
+
+    /*
+     * Close opened pages whose content was rewritten, they reload on next use, and drop what was
+     * derived from them: web links, named destinations and hit indexes, which rebuild on their
+     * next lookup; call holding the lock
+     */
+    private void reopenPages(PdfDocument doc, int fromIndex, int toIndex) {
+        nativeInvalidatePageIndexes(doc.mNativeDocPtr, fromIndex, toIndex);
+        synchronized (indexLock) {
+            for (PageHitIndex hitIndex : doc.mHitIndexes) {
+                if (hitIndex.mPageIndex < fromIndex || hitIndex.mPageIndex > toIndex) {
+                    continue;
+                }
+                if (hitIndex.mNativeHitIndexPtr != 0) {
+                    nativeCloseHitIndex(hitIndex.mNativeHitIndexPtr);
+                    hitIndex.mNativeHitIndexPtr = 0;
+                }
+                hitIndex.mStale = true;
+            }
+        }
+        for (int index = fromIndex; index <= toIndex; index++) {
+            Long textPtr = doc.mNativeTextPagesPtr.remove(index);
+            if (textPtr != null) {
+                nativeCloseTextpage(textPtr);
+                doc.mEvictedTextPages.add(index);
+            }
+            Long pagePtr = doc.mNativePagesPtr.remove(index);
+            if (pagePtr != null) {
+                nativeClosePage(pagePtr);
+                doc.mEvictedPages.add(index);
+            }
+        }
+    }
+
+    /** Flatten for display, annotations hidden on screen stay hidden */
+    public static final int FLATTEN_DISPLAY = 0;
+    /** Flatten for print, annotations marked for printing become content */
+    public static final int FLATTEN_PRINT = 1;
+
+    /** Index of {@link #flattenDocument(PdfDocument, int, int, int, ParcelFileDescriptor, SaveCallback)} results */
+    public static final int FLATTEN_RESULT_FLATTENED = 0;
+    public static final int FLATTEN_RESULT_UNCHANGED = 1;
+    public static final int FLATTEN_RESULT_FAILED = 2;
+
+    /**
+     * Merge annotations and form fields of pages fromIndex..toIndex into the page content, e.g.
+     * before archiving, and write the result to out. The whole range is done in one native call
+     * that keeps a single page loaded at a time. The save is a full rewrite, so the original
+     * annotations are not kept in an earlier revision. Opened pages in the range are reopened
+     * on next use, handles returned earlier go stale.
+     *
+     * @param mode     {@link #FLATTEN_DISPLAY} or {@link #FLATTEN_PRINT}
+     * @param out      where to save, null to only flatten the open document; not the file the
+     *                 document was opened from, which PDFium still reads
+     * @param callback save progress, may be null
+     * @return page counts indexed by FLATTEN_RESULT_*
+     * @throws IllegalArgumentException if out is the document's own file, nothing is flattened
+     */
+    public int[] flattenDocument(PdfDocument doc, int fromIndex, int toIndex, int mode,
+                                 ParcelFileDescriptor out, SaveCallback callback) throws IOException {
+        synchronized (lock) {
+            try {
+                return nativeFlattenDocument(doc.mNativeDocPtr, fromIndex, toIndex, mode,
+                        out != null ? getNumFd(out) : -1, callback);
+            } finally {
+                reopenPages(doc, fromIndex, toIndex);
+            }
+        }
+    }
+
+    /** Touch actions of {@link #onFormTouch(PdfDocument, int, int, double, double)} */
+    public static final int FORM_TOUCH_DOWN = 0;
+    public static final int FORM_TOUCH_UP = 1;
+    public static final int FORM_TOUCH_MOVE = 2;
+
+    /* PDFium key flags and virtual key codes, fpdf_fwlevent.h */
+    private static final int FORM_KEY_SHIFT = 1;
+    private static final int FORM_KEY_CONTROL = 1 << 1;
+    private static final int FORM_KEY_ALT = 1 << 2;
+
+    private static int toFormKeyCode(int keyCode) {
+        switch (keyCode) {
+            case KeyEvent.KEYCODE_DEL:
+                return 0x08;
+            case KeyEvent.KEYCODE_TAB:
+                return 0x09;
+            case KeyEvent.KEYCODE_ENTER:
+                return 0x0D;
+            case KeyEvent.KEYCODE_MOVE_END:
+                return 0x23;
+            case KeyEvent.KEYCODE_MOVE_HOME:
+                return 0x24;
+            case KeyEvent.KEYCODE_DPAD_LEFT:
+                return 0x25;
+            case KeyEvent.KEYCODE_DPAD_UP:
+                return 0x26;
+            case KeyEvent.KEYCODE_DPAD_RIGHT:
+                return 0x27;
+            case KeyEvent.KEYCODE_DPAD_DOWN:
+                return 0x28;
+            case KeyEvent.KEYCODE_FORWARD_DEL:
+                return 0x2E;
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * Pass a touch on an opened page to its form fields. Afterwards
+     * {@link #takeFormDirtyRects(PdfDocument, int)} tells what to repaint.
+     *
+     * @param action FORM_TOUCH_*
+     * @param pageX  page coordinates, see
+     *               {@link #mapDeviceCoordsToPage(PdfDocument, int, int, int, int, int, int, int, int)}
+     * @return true when a form field took the touch
+     */
+    public boolean onFormTouch(PdfDocument doc, int pageIndex, int action, double pageX,
+                               double pageY) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            return pagePtr != null && nativeFormMouse(doc.mNativeDocPtr, pagePtr, action, pageX, pageY);
+        }
+    }
+
+    /**
+     * Pass a key event to the focused form field of an opened page, typed characters included.
+     *
+     * @return true when the field took it
+     */
+    public boolean onFormKeyEvent(PdfDocument doc, int pageIndex, KeyEvent event) {
+        int modifier = (event.isShiftPressed() ? FORM_KEY_SHIFT : 0)
+                | (event.isCtrlPressed() ? FORM_KEY_CONTROL : 0)
+                | (event.isAltPressed() ? FORM_KEY_ALT : 0);
+        int keyCode = toFormKeyCode(event.getKeyCode());
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            if (pagePtr == null) {
+                return false;
+            }
+            boolean down = event.getAction() == KeyEvent.ACTION_DOWN;
+            boolean handled = keyCode != 0
+                    && nativeFormKey(doc.mNativeDocPtr, pagePtr, keyCode, down, modifier);
+            //Fields edit on chars: backspace and enter go as control chars besides their keys,
+            //other control characters only through the key codes above
+            int unicode = (keyCode == 0x08 || keyCode == 0x0D) ? keyCode : event.getUnicodeChar();
+            if (down && (unicode >= 0x20 || unicode == 0x08 || unicode == 0x0D)) {
+                handled |= nativeFormChar(doc.mNativeDocPtr, pagePtr, unicode, modifier);
+            }
+            return handled;
+        }
+    }
+
+    /** Commit the value of the focused form field and drop the focus */
+    public void clearFormFocus(PdfDocument doc) {
+        synchronized (lock) {
+            nativeFormKillFocus(doc.mNativeDocPtr);
+        }
+    }
+
+    /**
+     * Regions of an opened page that form fields repainted since the last call, 4 floats per
+     * rect: left, top, right, bottom in page coordinates. Pass them to
+     * {@link #renderPageRegions(PdfDocument, Bitmap, int, int, int, int, int, float[], boolean)}
+     * for every bitmap or tile showing the page.
+     */
+    public float[] takeFormDirtyRects(PdfDocument doc, int pageIndex) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            return pagePtr != null ? nativeTakeFormDirtyRects(doc.mNativeDocPtr, pagePtr) : new float[0];
+        }
+    }
+
+    /**
+     * Render page regions again into a bitmap already showing the page, e.g. after a form field
+     * changed; the rest of the bitmap is left alone. Arguments place the page like
+     * {@link #renderPageBitmap(PdfDocument, Bitmap, int, int, int, int, int, boolean)}.
+     * RGB_565 bitmaps are rendered whole.
+     *
+     * @param pageRects 4 floats per rect in page coordinates, as from takeFormDirtyRects
+     * @return device rects written, 4 ints per rect: left, top, right, bottom
+     */
+    public int[] renderPageRegions(PdfDocument doc, Bitmap bitmap, int pageIndex, int startX,
+                                   int startY, int drawSizeX, int drawSizeY, float[] pageRects,
+                                   boolean renderAnnot) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            if (pagePtr == null) {
+                throw new IllegalStateException("Page " + pageIndex + " is not opened");
+            }
+            return nativeRenderPageRegions(pagePtr, bitmap, startX, startY, drawSizeX, drawSizeY,
+                    pageRects, renderAnnot);
+        }
+    }
+
+    /** Outputs of {@link #renderPageGray}: one byte per pixel, 0 black to 255 white */
+    public static final int GRAY_OUTPUT_8BIT = 0;
+    /** 1 bit per pixel, Bayer ordered dither; stable between renders, for text and page turns */
+    public static final int GRAY_OUTPUT_MONO_ORDERED = 1;
+    /** 1 bit per pixel, Floyd-Steinberg error diffusion; better for photos */
+    public static final int GRAY_OUTPUT_MONO_DIFFUSION = 2;
+
+    /** Smallest row stride in bytes of a {@link #renderPageGray} output width pixels wide */
+    public static int getGrayRowBytes(int output, int width) {
+        return output == GRAY_OUTPUT_8BIT ? width : (width + 7) / 8;
+    }
+
+    /**
+     * Render a page for e-ink panels straight into a direct buffer of width x height pixels, in
+     * grayscale without a colour bitmap in between. 1 bit rows are packed as in PBM: the
+     * leftmost pixel in the most significant bit, set bits black. Placement arguments are as
+     * in {@link #renderPageBitmap(PdfDocument, Bitmap, int, int, int, int, int, boolean)}.
+     *
+     * @param output GRAY_OUTPUT_*
+     * @param stride bytes per row, at least {@link #getGrayRowBytes(int, int)}; the buffer may
+     *               end right after the bytes of the last row
+     * @throws OutOfMemoryError if the scratch canvas of a 1 bit output cannot be allocated
+     */
+    public void renderPageGray(PdfDocument doc, ByteBuffer buffer, int output, int stride,
+                               int width, int height, int pageIndex, int startX, int startY,
+                               int drawSizeX, int drawSizeY, boolean renderAnnot) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            if (pagePtr == null) {
+                throw new IllegalStateException("Page " + pageIndex + " is not opened");
+            }
+            nativeRenderPageGray(pagePtr, buffer, output, stride, width, height, startX, startY,
+                    drawSizeX, drawSizeY, renderAnnot);
+        }
+    }
+
+    /** Grace period of {@link #warmUpLibrary(int)} keeping PDFium for the rest of the process */
+    public static final int KEEP_LIBRARY_LOADED = -1;
+
+    /**
+     * Initialize PDFium on a native background thread, e.g. from Application.onCreate, so the
+     * first document open does not pay for it. Returns at once; an open racing the warm-up
+     * waits for it instead of initializing twice. From then on the library stays loaded
+     * gracePeriodMs after the last document closes, and from the warm-up while none is open,
+     * instead of being torn down and rebuilt between documents.
+     * {@link #trimMemory(int)} from TRIM_MEMORY_BACKGROUND releases it early when idle.
+     *
+     * @param gracePeriodMs 0 tears down with the last document as without warm-up,
+     *                      {@link #KEEP_LIBRARY_LOADED} never
+     */
+    public void warmUpLibrary(int gracePeriodMs) {
+        nativeWarmUpLibrary(gracePeriodMs);
+    }
+
+    /** Directories scanned by {@link #installFontIndex(Context)} */
+    public static final String[] SYSTEM_FONT_DIRS = {"/system/fonts", "/product/fonts"};
+
+    /**
+     * Serve fonts that documents do not embed from an index of the system fonts, kept in the
+     * app cache and rebuilt only when the fonts change. The first call in a process reads the
+     * index, or scans the fonts if there is none, so call it off the UI thread, ideally before
+     * opening documents; pages already rendered keep the fonts they got.
+     *
+     * @return number of font faces indexed
+     */
+    public int installFontIndex(Context ctx) {
+        File indexFile = new File(ctx.getCacheDir(), "pdfium-fonts.index");
+        return installFontIndex(indexFile, SYSTEM_FONT_DIRS);
+    }
+
+    /** As {@link #installFontIndex(Context)} with an own index file and font directories */
+    public int installFontIndex(File indexFile, String... fontDirs) {
+        int faces = nativeLoadFontIndex(indexFile != null ? indexFile.getPath() : null, fontDirs);
+        synchronized (lock) {
+            nativeInstallFontIndex();
+        }
+        return faces;
+    }
+
+    /** Get metadata for given document */
+    public PdfDocument.Meta getDocumentMeta(PdfDocument doc) {
+        synchronized (lock) {
+            PdfDocument.Meta meta = new PdfDocument.Meta();
+            meta.title = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Title");
+            meta.author = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Author");
+            meta.subject = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Subject");
+            meta.keywords = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Keywords");
+            meta.creator = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Creator");
+            meta.producer = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Producer");
+            meta.creationDate = nativeGetDocumentMetaText(doc.mNativeDocPtr, "CreationDate");
+            meta.modDate = nativeGetDocumentMetaText(doc.mNativeDocPtr, "ModDate");
+
+            return meta;
+        }
+    }
+
+    /**
+     * Summary of a file from the disk cache, read without opening the document, so the
+     * viewer can lay out pages and show the outline while it is still being parsed.
+     *
+     * @return null if the file was never summarized or changed since
+     */
+    public DocumentSummary getCachedDocumentSummary(ParcelFileDescriptor fd) {
+        if (mSummaryCacheDir == null) {
+            return null;
+        }
+        Object[] arrays = nativeReadDocumentSummary(getNumFd(fd), mSummaryCacheDir);
+        return arrays != null ? new DocumentSummary(arrays) : null;
+    }
+
+    /**
+     * Summary of an open document, from the disk cache or built under the lock and stored
+     * for the next open. Password protected and in-memory documents are never written to disk,
+     * nor are documents changed since they were opened (page transforms, flattening, form
+     * edits): their summary is built fresh and the file keeps its own. The cache directory is
+     * bounded, least recently used summaries go first.
+     */
+    public DocumentSummary getDocumentSummary(PdfDocument doc) {
+        int fd = doc.parcelFileDescriptor != null ? getNumFd(doc.parcelFileDescriptor) : -1;
+        String cacheDir = doc.mPasswordProtected ? null : mSummaryCacheDir;
+        if (cacheDir != null) {
+            synchronized (lock) {
+                if (nativeIsDocumentModified(doc.mNativeDocPtr)) {
+                    cacheDir = null;
+                }
+            }
+        }
+        if (fd >= 0 && cacheDir != null) {
+            Object[] cached = nativeReadDocumentSummary(fd, cacheDir);
+            if (cached != null) {
+                return new DocumentSummary(cached);
+            }
+        }
+        synchronized (lock) {
+            Object[] arrays = nativeBuildDocumentSummary(doc.mNativeDocPtr, fd, cacheDir,
+                    SUMMARY_THUMBNAIL_WIDTH);
+            return arrays != null ? new DocumentSummary(arrays) : null;
+        }
+    }
+
+    /** Get table of contents (bookmarks) for given document */
+    public List<PdfDocument.Bookmark> getTableOfContents(PdfDocument doc) {
+        synchronized (lock) {
+            List<PdfDocument.Bookmark> topLevel = new ArrayList<>();
+            Long first = nativeGetFirstChildBookmark(doc.mNativeDocPtr, null);
+            if (first != null) {
+                recursiveGetBookmark(topLevel, doc, first);
+            }
+            return topLevel;
+        }
+    }
+
+    private void recursiveGetBookmark(List<PdfDocument.Bookmark> tree, PdfDocument doc, long bookmarkPtr) {
+        PdfDocument.Bookmark bookmark = new PdfDocument.Bookmark();
+        bookmark.mNativePtr = bookmarkPtr;
+        bookmark.title = nativeGetBookmarkTitle(bookmarkPtr);
+        bookmark.pageIdx = nativeGetBookmarkDestIndex(doc.mNativeDocPtr, bookmarkPtr);
+        tree.add(bookmark);
+
+        Long child = nativeGetFirstChildBookmark(doc.mNativeDocPtr, bookmarkPtr);
+        if (child != null) {
+            recursiveGetBookmark(bookmark.getChildren(), doc, child);
+        }
+
+        Long sibling = nativeGetSiblingBookmark(doc.mNativeDocPtr, bookmarkPtr);
+        if (sibling != null) {
+            recursiveGetBookmark(tree, doc, sibling);
+        }
+    }
+
+    /** Get all links from given page */
+    public List<PdfDocument.Link> getPageLinks(PdfDocument doc, int pageIndex) {
+        synchronized (lock) {
+            List<PdfDocument.Link> links = new ArrayList<>();
+            Long nativePagePtr = getPagePtr(doc, pageIndex);
+            if (nativePagePtr == null) {
+                return links;
+            }
+            long[] linkPtrs = nativeGetPageLinks(nativePagePtr);
+            try {
+                for (long linkPtr : linkPtrs) {
+                    Integer index = nativeGetDestPageIndex(doc.mNativeDocPtr, linkPtr);
+                    String uri = nativeGetLinkURI(doc.mNativeDocPtr, linkPtr);
+
+                    RectF rect = nativeGetLinkRect(linkPtr);
+                    if (rect != null && (index != null || uri != null)) {
+                        links.add(new PdfDocument.Link(rect, index, uri));
+                    }
+
+                }
+            } finally {
+                nativeCloseLinks(linkPtrs);
+            }
+            return links;
+        }
+    }
+
+    /**
+     * Map page coordinates to device screen coordinates
+     *
+     * @param doc       pdf document
+     * @param pageIndex index of page
+     * @param startX    left pixel position of the display area in device coordinates
+     * @param startY    top pixel position of the display area in device coordinates
+     * @param sizeX     horizontal size (in pixels) for displaying the page
+     * @param sizeY     vertical size (in pixels) for displaying the page
+     * @param rotate    page orientation: 0 (normal), 1 (rotated 90 degrees clockwise),
+     *                  2 (rotated 180 degrees), 3 (rotated 90 degrees counter-clockwise)
+     * @param pageX     X value in page coordinates
+     * @param pageY     Y value in page coordinate
+     * @return mapped coordinates
+     */
+    public Point mapPageCoordsToDevice(PdfDocument doc, int pageIndex, int startX, int startY, int sizeX,
+                                       int sizeY, int rotate, double pageX, double pageY) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            if (pagePtr == null) {
+                throw new IllegalStateException("Page " + pageIndex + " is not opened");
+            }
+            //Inside the lock, a trim could close the page under the call
+            return nativePageCoordsToDevice(pagePtr, startX, startY, sizeX, sizeY, rotate, pageX, pageY);
+        }
+    }
+
+    /**
+     * Map device coordinates, e.g. of a touch, to page coordinates
+     *
+     * @see PdfiumCore#mapPageCoordsToDevice(PdfDocument, int, int, int, int, int, int, double, double)
+     */
+    public PointF mapDeviceCoordsToPage(PdfDocument doc, int pageIndex, int startX, int startY,
+                                        int sizeX, int sizeY, int rotate, int deviceX, int deviceY) {
+        synchronized (lock) {
+            Long pagePtr = getPagePtr(doc, pageIndex);
+            if (pagePtr == null) {
+                throw new IllegalStateException("Page " + pageIndex + " is not opened");
+            }
+            return nativeDeviceCoordsToPage(pagePtr, startX, startY, sizeX, sizeY, rotate,
+                    deviceX, deviceY);
+        }
+    }
+
+    /**
+     * @return mapped coordinates
+     * @see PdfiumCore#mapPageCoordsToDevice(PdfDocument, int, int, int, int, int, int, double, double)
+     */
+    public RectF mapRectToDevice(PdfDocument doc, int pageIndex, int startX, int startY, int sizeX,
+                                 int sizeY, int rotate, RectF coords) {
+
+        Point leftTop = mapPageCoordsToDevice(doc, pageIndex, startX, startY, sizeX, sizeY, rotate,
+                coords.left, coords.top);
+        Point rightBottom = mapPageCoordsToDevice(doc, pageIndex, startX, startY, sizeX, sizeY, rotate,
+                coords.right, coords.bottom);
+        return new RectF(leftTop.x, leftTop.y, rightBottom.x, rightBottom.y);
+    }
+
+
+    //updating the liibrary from here first try lets check it out
+
+    /** Text page of an opened page, loaded once and closed with the document */
+    public long getPdfTextPageLoad(PdfDocument doc , int pageIndex){
+        synchronized (lock) {
+            Long text = doc.mNativeTextPagesPtr.get(pageIndex);
+            if (text != null) {
+                return text;
+            }
+
+            Long pagePtr = doc.mNativePagesPtr.get(pageIndex);
+            if (pagePtr == null) {
+                pagePtr = nativeLoadPage(doc.mNativeDocPtr, pageIndex);
+                doc.mNativePagesPtr.put(pageIndex, pagePtr);
+                doc.mEvictedPages.remove(pageIndex);
+            }
+
+            long textPtr = nativeTextLoadPage(pagePtr);
+            doc.mEvictedTextPages.remove(pageIndex);
+            if (textPtr != 0) {
+                doc.mNativeTextPagesPtr.put(pageIndex, textPtr);
+                //Detected on a render thread once we release the lock
+                nativeDetectWebLinks(getRenderExecutor(), lock, doc.mNativeDocPtr, pageIndex, textPtr);
+            }
+            return textPtr;
+        }
+    }
+
+    /**
+     * URLs written as plain text on the page, one Link per highlight rect. Detection starts
+     * when the text page loads ({@link #getPdfTextPageLoad(PdfDocument, int)}); until it is
+     * done the list is empty. Never waits for renders.
+     */
+    public List<PdfDocument.Link> getPageWebLinks(PdfDocument doc, int pageIndex) {
+        List<PdfDocument.Link> links = new ArrayList<>();
+        Object[] result;
+        synchronized (indexLock) {
+            result = nativeGetWebLinks(doc.mNativeWebLinksPtr, pageIndex);
+        }
+        if (result == null) {
+            return links;
+        }
+        String[] urls = (String[]) result[0];
+        float[] rects = (float[]) result[1];
+        int pos = 0;
+        for (String url : urls) {
+            int rectCount = (int) rects[pos++];
+            for (int r = 0; r < rectCount; r++, pos += 4) {
+                RectF bounds = new RectF(rects[pos], rects[pos + 1], rects[pos + 2], rects[pos + 3]);
+                links.add(new PdfDocument.Link(bounds, null, url));
+            }
+        }
+        return links;
+    }
+
+    /**
+     * URL under a point in page coordinates, null if there is none or detection
+     * has not finished yet. A table scan that never waits for renders, safe to call on tap.
+     */
+    public String getWebLinkAt(PdfDocument doc, int pageIndex, float x, float y) {
+        //indexLock keeps closeDocument from releasing the links under the lookup
+        synchronized (indexLock) {
+            return nativeGetWebLinkAt(doc.mNativeWebLinksPtr, pageIndex, x, y);
+        }
+    }
+
+    /**
+     * Page a named destination points to, -1 if the document has no such name. The first
+     * call indexes all names of the document, later ones are a hash lookup.
+     */
+    public int getNamedDestPageIndex(PdfDocument doc, String name) {
+        synchronized (lock) {
+            int pageIndex = nativeFindNamedDest(doc.mNativeDocPtr, name);
+            if (pageIndex == -2) {
+                nativeBuildNamedDestIndex(doc.mNativeDocPtr);
+                pageIndex = nativeFindNamedDest(doc.mNativeDocPtr, name);
+            }
+            return pageIndex;
+        }
+    }
+
+    /** Kinds of a hit returned by {@link #hitTest(PageHitIndex, float, float, float)} */
+    public static final int HIT_NONE = 0;
+    public static final int HIT_LINK = 1;
+    public static final int HIT_WEB_LINK = 2;
+    public static final int HIT_CHAR = 3;
+
+    /**
+     * Index the link rects, web link rects and char boxes of a page for
+     * {@link #hitTest(PageHitIndex, float, float, float)}. Loads the page and text page
+     * if needed; build it once per page and keep it while the page is shown.
+     */
+    public PageHitIndex newPageHitIndex(PdfDocument doc, int pageIndex) {
+        synchronized (lock) {
+            PageHitIndex index = new PageHitIndex(doc, pageIndex, buildHitIndex(doc, pageIndex));
+            doc.mHitIndexes.add(index);
+            return index;
+        }
+    }
+
+    /* Native hit index of a page; call holding the lock */
+    private long buildHitIndex(PdfDocument doc, int pageIndex) {
+        long textPtr = getPdfTextPageLoad(doc, pageIndex);
+        long pagePtr = doc.mNativePagesPtr.get(pageIndex);    //loaded with the text page
+        return nativeNewHitIndex(doc.mNativeDocPtr, pageIndex, pagePtr, textPtr);
+    }
+
+    /*
+     * Rebuild index if its page content was rewritten. The only part of a lookup that calls
+     * into PDFium, so the only one that takes the lock
+     */
+    private void rebuildIfStale(PageHitIndex index) {
+        if (!index.mStale) {
+            return;
+        }
+        synchronized (lock) {
+            if (!index.mStale || index.mDocument.mNativeDocPtr == 0) {
+                return;
+            }
+            long indexPtr = buildHitIndex(index.mDocument, index.mPageIndex);
+            synchronized (indexLock) {
+                index.mNativeHitIndexPtr = indexPtr;
+                index.mStale = false;
+            }
+        }
+    }
+
+    /**
+     * Object under a point in page coordinates. Links win over web links over chars; without
+     * a direct hit the nearest one within tolerance points is returned. A grid lookup that
+     * never waits for renders, except for a rebuild once after the page content was rewritten.
+     *
+     * @return hit to decode with {@link #getHitKind(long)} and {@link #getHitId(long)},
+     * 0 if nothing is there or the index was closed
+     */
+    public long hitTest(PageHitIndex index, float x, float y, float tolerance) {
+        rebuildIfStale(index);
+        synchronized (indexLock) {
+            if (index.mNativeHitIndexPtr == 0) {
+                return 0;
+            }
+            return nativeHitTest(index.mNativeHitIndexPtr, x, y, tolerance);
+        }
+    }
+
+    /** One of HIT_* */
+    public static int getHitKind(long hit) {
+        return (int) (hit >>> 32);
+    }
+
+    /** Char index for {@link #HIT_CHAR}, link number for the link kinds */
+    public static int getHitId(long hit) {
+        return (int) hit;
+    }
+
+    /** Link of a {@link #HIT_LINK} or {@link #HIT_WEB_LINK} hit, null for other hits */
+    public PdfDocument.Link getHitLink(PageHitIndex index, long hit) {
+        rebuildIfStale(index);
+        synchronized (indexLock) {
+            if (index.mNativeHitIndexPtr == 0) {
+                return null;
+            }
+            return nativeHitIndexGetLink(index.mNativeHitIndexPtr, hit);
+        }
+    }
+
+    public void closePageHitIndex(PageHitIndex index) {
+        synchronized (lock) {
+            synchronized (indexLock) {
+                if (index.mNativeHitIndexPtr != 0) {
+                    nativeCloseHitIndex(index.mNativeHitIndexPtr);
+                    index.mNativeHitIndexPtr = 0;
+                }
+                index.mStale = false;
+            }
+            index.mDocument.mHitIndexes.remove(index);
+        }
+    }
+
+    /**
+     * Text of all pages in one pass, without loading every text page into the document.
+     * Documents with a render pool extract page ranges in the workers in parallel.
+     */
+    public DocumentText getDocumentText(PdfDocument doc) {
+        int pageCount = getPageCount(doc);
+        int[] offsets = new int[pageCount + 1];
+
+        RenderPool pool = doc.mRenderPool;
+        if (pool != null) {
+            String text = nativeRenderPoolGetDocumentText(pool.mNativePoolPtr, doc.mRenderPoolDocId,
+                    pageCount, offsets);
+            if (text != null) {
+                return new DocumentText(text, offsets);
+            }
+        }
+        synchronized (lock) {
+            String text = nativeGetDocumentText(doc.mNativeDocPtr, offsets);
+            return new DocumentText(text != null ? text : "", offsets);
+        }
+    }
+
+    public int getPageCharcters(long page){
+        synchronized (lock) {
+            return nativeGetTotalCharactersInPage(page);
+        }
+    }
+
+
+    public boolean searchWord(String word ,int flag, long page)  {
+        synchronized (lock){
+            long handle = nativeTextSearchHandler(page, flag, word);
+            try {
+                return nativeIfMatchFound(handle);
+            } finally {
+                nativeCloseSearchHandle(handle);
+            }
+        }
     }
 
     public boolean SearchPrevious(String word  ,int flag, long page){
         synchronized (lock){
-            return  nativePreviousMatch(nativeTextSearchHandler(page,flag,word));
+            long handle = nativeTextSearchHandler(page, flag, word);
+            try {
+                return nativePreviousMatch(handle);
+            } finally {
+                nativeCloseSearchHandle(handle);
+            }
         }
     }
 
     public int getTotalSearchResult(String word ,int flag, long page){
         synchronized (lock){
-            return nativeGetSearchCount(nativeTextSearchHandler(page, 1, word));
+            long handle = nativeTextSearchHandler(page, 1, word);
+            try {
+                return nativeGetSearchCount(handle);
+            } finally {
+                nativeCloseSearchHandle(handle);
+            }
         }
     }
 
     public int getSearchIndex(String word ,int flag, long page){
         synchronized (lock){
-            return nativeGetSearchIndex(nativeTextSearchHandler(page, flag, word));
+            long handle = nativeTextSearchHandler(page, flag, word);
+            try {
+                return nativeGetSearchIndex(handle);
+            } finally {
+                nativeCloseSearchHandle(handle);
+            }
+        }
+    }
+
+    /** Flags of {@link #newSearchSession(PdfDocument, int, String, int)} */
+    public static final int SEARCH_MATCH_CASE = 0x00000001;
+    public static final int SEARCH_MATCH_WHOLE_WORD = 0x00000002;
+
+    /**
+     * Start a find session on a page. The session owns its own page and search state
+     * until {@link #closeSearchSession(SearchSession)} or until the document is closed.
+     *
+     * @param flags {@link #SEARCH_MATCH_CASE} and/or {@link #SEARCH_MATCH_WHOLE_WORD}
+     */
+    public SearchSession newSearchSession(PdfDocument doc, int pageIndex, String query, int flags) {
+        synchronized (lock) {
+            SearchSession session = new SearchSession(doc, pageIndex,
+                    nativeNewSearchSession(doc.mNativeDocPtr, pageIndex, query, flags));
+            doc.mSearchSessions.add(session);
+            return session;
+        }
+    }
+
+    /** Move to the next match, false after the last one */
+    public boolean searchNext(SearchSession session) {
+        synchronized (lock) {
+            if (!nativeSearchSessionNext(session.mNativeSessionPtr)) {
+                return false;
+            }
+            session.set(nativeSearchSessionGetMatch(session.mNativeSessionPtr));
+            return true;
         }
     }
 
+    /** Move to the previous match, false on the first one */
+    public boolean searchPrevious(SearchSession session) {
+        synchronized (lock) {
+            if (!nativeSearchSessionPrev(session.mNativeSessionPtr)) {
+                return false;
+            }
+            session.set(nativeSearchSessionGetMatch(session.mNativeSessionPtr));
+            return true;
+        }
+    }
+
+    /** Move to match n (0 based), false if the page has fewer matches */
+    public boolean searchJump(SearchSession session, int n) {
+        synchronized (lock) {
+            if (!nativeSearchSessionJump(session.mNativeSessionPtr, n)) {
+                return false;
+            }
+            session.set(nativeSearchSessionGetMatch(session.mNativeSessionPtr));
+            return true;
+        }
+    }
+
+    /** Number of matches on the page */
+    public int getSearchCount(SearchSession session) {
+        synchronized (lock) {
+            return nativeSearchSessionCount(session.mNativeSessionPtr);
+        }
+    }
+
+    public void closeSearchSession(SearchSession session) {
+        synchronized (lock) {
+            if (session.mNativeSessionPtr != 0) {
+                nativeCloseSearchSession(session.mNativeSessionPtr);
+                session.mNativeSessionPtr = 0;
+            }
+            session.mDocument.mSearchSessions.remove(session);
+        }
+    }
+
+    /**
+     * Fold text (lower case, no diacritics, ligatures expanded, whitespace collapsed) once
+     * for repeated searches with {@link #findInTextIndex(TextSearchIndex, String, int)}.
+     * Does not use PDFium, so it does not take the lock.
+     */
+    public TextSearchIndex newTextSearchIndex(String text) {
+        return new TextSearchIndex(nativeNewTextSearchIndex(text));
+    }
+
+    /**
+     * Case and accent insensitive search, "Zurich" finds "Zürich" and "strasse" finds "Straße".
+     *
+     * @param flags 0 or {@link #SEARCH_MATCH_WHOLE_WORD}
+     * @return start, length pairs in UTF-16 offsets of the indexed string. On a
+     * {@link DocumentText} these are offsets into the extracted text, which holds spaces and
+     * line breaks PDFium generated, not PDFium char indexes; map them to a page with
+     * {@link DocumentText#getPageAt(int)} and to chars and rects with
+     * {@link #textPageMapTextRange(PdfDocument, int, int, int)}.
+     */
+    public int[] findInTextIndex(TextSearchIndex index, String query, int flags) {
+        int[] matches = nativeTextSearchIndexFind(index.mNativeIndexPtr, query, flags);
+        return matches != null ? matches : new int[0];
+    }
+
+    public void closeTextSearchIndex(TextSearchIndex index) {
+        if (index.mNativeIndexPtr != 0) {
+            nativeCloseTextSearchIndex(index.mNativeIndexPtr);
+            index.mNativeIndexPtr = 0;
+        }
+    }
+
+    /**
+     * Search pages [fromPage, toPage) for a regular expression: literals, ., [...] classes,
+     * \d \w \s, groups, |, * + ? {n,m} and \b at the start or end. Pages are matched in
+     * parallel on the render threads and reported as they finish; only loading the page
+     * text takes the lock.
+     *
+     * @return search id for {@link #cancelRegexSearch(int)}, 0 if nothing was searched
+     * @throws IllegalArgumentException if the pattern is not supported
+     */
+    public int searchRegex(PdfDocument doc, String pattern, int fromPage, int toPage,
+                           RegexSearchCallback callback) {
+        toPage = Math.min(toPage, getPageCount(doc));
+        fromPage = Math.max(fromPage, 0);
+        if (fromPage >= toPage) {
+            return 0;
+        }
+        return nativeStartRegexSearch(getRenderExecutor(), lock, doc.mNativeDocPtr, pattern,
+                fromPage, toPage, callback);
+    }
+
+    /** Skip pages not matched yet, the callback still gets onRegexSearchComplete */
+    public void cancelRegexSearch(int searchId) {
+        nativeCancelRegexSearch(searchId);
+    }
+
     public String getText(long page, int start , int count){
 
         synchronized (lock){
@@ -560,10 +1891,100 @@ public class PdfiumCore {
         public double top;
     }
 
+    /** Floats per character in {@link #textPageGetCharGeometry(PdfDocument, int)} */
+    public static final int CHAR_GEOMETRY_STRIDE = 5;
+
+    /**
+     * Boxes and unicode values of all characters of a loaded text page in one call.
+     * Character i occupies floats i * {@link #CHAR_GEOMETRY_STRIDE} onwards:
+     * left, top, right, bottom in page points, then the unicode value.<br>
+     * The buffer is a copy owned by the caller and stays valid after the text page closes;
+     * the native side keeps the geometry with the text page so later calls skip PDFium.
+     */
+    public FloatBuffer textPageGetCharGeometry(PdfDocument doc, int textPageIndex) {
+        synchronized (lock) {
+            Long textPagePtr = getTextPagePtr(doc, textPageIndex);
+            if (textPagePtr == null) {
+                return null;
+            }
+            float[] geometry = nativeTextGetCharGeometry(textPagePtr);
+            if (geometry == null) {
+                return null;
+            }
+            return FloatBuffer.wrap(geometry);
+        }
+    }
+
+    /** Selection on a loaded text page, close it with {@link #closeTextSelection(TextSelection)} */
+    public TextSelection newTextSelection(PdfDocument doc, int textPageIndex) {
+        synchronized (lock) {
+            Long textPagePtr = getTextPagePtr(doc, textPageIndex);
+            if (textPagePtr == null) {
+                throw new IllegalStateException("Text page " + textPageIndex + " is not loaded");
+            }
+            return new TextSelection(nativeNewTextSelection(textPagePtr));
+        }
+    }
+
+    /**
+     * Select chars between the chars nearest to start and end points, in page coordinates.
+     * Works on the copied page text only, so it holds the lock just for the update.
+     *
+     * @return false if the selection did not change or was closed
+     */
+    public boolean updateTextSelection(TextSelection selection, float startX, float startY,
+                                       float endX, float endY) {
+        synchronized (lock) {
+            if (selection.mNativeSelectionPtr == 0) {
+                return false;
+            }
+            float[] packed = nativeTextSelectionUpdate(selection.mNativeSelectionPtr,
+                    startX, startY, endX, endY);
+            if (packed == null) {
+                return false;
+            }
+            selection.set(packed);
+            return true;
+        }
+    }
+
+    /** Select char range, both ends inclusive */
+    public boolean selectText(TextSelection selection, int start, int end) {
+        synchronized (lock) {
+            if (selection.mNativeSelectionPtr == 0) {
+                return false;
+            }
+            float[] packed = nativeTextSelectionSelect(selection.mNativeSelectionPtr, start, end);
+            if (packed == null) {
+                return false;
+            }
+            selection.set(packed);
+            return true;
+        }
+    }
+
+    public String getSelectedText(TextSelection selection) {
+        synchronized (lock) {
+            if (selection.mNativeSelectionPtr == 0) {
+                return "";
+            }
+            return nativeTextSelectionGetText(selection.mNativeSelectionPtr);
+        }
+    }
+
+    public void closeTextSelection(TextSelection selection) {
+        synchronized (lock) {
+            if (selection.mNativeSelectionPtr != 0) {
+                nativeCloseTextSelection(selection.mNativeSelectionPtr);
+                selection.mNativeSelectionPtr = 0;
+            }
+        }
+    }
+
     public Rect textPageGetCharBox(PdfDocument doc, int textPageIndex, int index) {
         synchronized (lock) {
             try {
-                double[] o = nativeTextGetCharBox(doc.mNativeTextPagesPtr.get(textPageIndex), index);
+                double[] o = nativeTextGetCharBox(getTextPagePtr(doc, textPageIndex), index);
                 Rect r = new Rect();
                 r.left = o[0];
                 r.right = o[1];
@@ -585,7 +2006,7 @@ public class PdfiumCore {
     public int textPageGetCharIndexAtPos(PdfDocument doc, int textPageIndex, double x, double y, double xTolerance, double yTolerance) {
         synchronized (lock) {
             try {
-                return nativeTextGetCharIndexAtPos(doc.mNativeTextPagesPtr.get(textPageIndex), x, y, xTolerance, yTolerance);
+                return nativeTextGetCharIndexAtPos(getTextPagePtr(doc, textPageIndex), x, y, xTolerance, yTolerance);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
                 e.printStackTrace();
@@ -600,7 +2021,7 @@ public class PdfiumCore {
     public int textPageCountRects(PdfDocument doc, int textPageIndex, int start_index, int count) {
         synchronized (lock) {
             try {
-                return nativeTextCountRects(doc.mNativeTextPagesPtr.get(textPageIndex), start_index, count);
+                return nativeTextCountRects(getTextPagePtr(doc, textPageIndex), start_index, count);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
                 e.printStackTrace();
@@ -615,7 +2036,7 @@ public class PdfiumCore {
     public Rect textPageGetRect(PdfDocument doc, int textPageIndex, int rect_index) {
         synchronized (lock) {
             try {
-                double[] o = nativeTextGetRect(doc.mNativeTextPagesPtr.get(textPageIndex), rect_index);
+                double[] o = nativeTextGetRect(getTextPagePtr(doc, textPageIndex), rect_index);
                 Rect r = new Rect();
                 r.left = o[0];
                 r.top = o[1];
@@ -633,12 +2054,32 @@ public class PdfiumCore {
         return null;
     }
 
+    /**
+     * Chars and highlight rects of a range of the page text as extracted by
+     * {@link #getDocumentText(PdfDocument)}, e.g. a {@link #findInTextIndex} match minus
+     * {@link DocumentText#getPageStart(int)}. Generated spaces and line breaks at either end
+     * are dropped.
+     *
+     * @return first char index, char count, then left, top, right, bottom per rect in page
+     * coordinates; null if the range holds no char of the page
+     */
+    public float[] textPageMapTextRange(PdfDocument doc, int textPageIndex, int textStart,
+                                        int textLength) {
+        synchronized (lock) {
+            Long textPagePtr = getTextPagePtr(doc, textPageIndex);
+            if (textPagePtr == null) {
+                throw new IllegalStateException("Text page " + textPageIndex + " is not loaded");
+            }
+            return nativeTextMapTextRange(textPagePtr, textStart, textLength);
+        }
+    }
+
     public String textPageGetBoundedText(PdfDocument doc, int textPageIndex, Rect rect, int length) {
         synchronized (lock) {
             try {
                 short[] buf = new short[length+1];
 
-                int r = nativeTextGetBoundedText(doc.mNativeTextPagesPtr.get(textPageIndex), rect.left, rect.top, rect.right, rect.bottom, buf);
+                int r = nativeTextGetBoundedText(getTextPagePtr(doc, textPageIndex), rect.left, rect.top, rect.right, rect.bottom, buf);
 
                 byte[] bytes = new byte[(r-1)*2];
                 ByteBuffer bb = ByteBuffer.wrap(bytes);
@@ -663,7 +2104,7 @@ public class PdfiumCore {
     public char textPageGetUnicode(PdfDocument doc, int textPageIndex, int index) {
         synchronized (lock) {
             try {
-                return (char)nativeTextGetUnicode(doc.mNativeTextPagesPtr.get(textPageIndex), index);
+                return (char)nativeTextGetUnicode(getTextPagePtr(doc, textPageIndex), index);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
                 e.printStackTrace();
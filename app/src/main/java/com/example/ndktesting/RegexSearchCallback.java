@@ -0,0 +1,23 @@
+package com.example.ndktesting;
+
+/**
+ * Results of {@link PdfiumCore#searchRegex(PdfDocument, String, int, int, RegexSearchCallback)},
+ * streamed page by page in no particular page order. Called on a native render
+ * thread, post to a Handler before touching views.
+ */
+public interface RegexSearchCallback {
+    /**
+     * @param pageIndex page of the matches
+     * @param matches   start, length pairs in char indexes of the page text
+     * @param rects     per match the number of highlight rects, then left, top, right,
+     *                  bottom of each rect in page coordinates
+     */
+    void onRegexMatches(int pageIndex, int[] matches, float[] rects);
+
+    /**
+     * Called once after the last page, also when the search was cancelled.
+     *
+     * @param totalMatches matches reported through {@link #onRegexMatches(int, int[], float[])}
+     */
+    void onRegexSearchComplete(int totalMatches, boolean cancelled);
+}
@@ -0,0 +1,17 @@
+package com.example.ndktesting;
+
+import android.graphics.Bitmap;
+
+/**
+ * Completion of a render submitted with
+ * {@link PdfiumCore#renderPageBitmapAsync(PdfDocument, Bitmap, int, int, int, int, int, boolean, RenderCallback)}.
+ * Called on a native render thread, post to a Handler before touching views.
+ */
+public interface RenderCallback {
+    /**
+     * @param ticket ticket returned on submit
+     * @param status {@link PdfiumCore#RENDER_DONE}, {@link PdfiumCore#RENDER_FAILED}
+     *               or {@link PdfiumCore#RENDER_CANCELLED}
+     */
+    void onRenderComplete(long ticket, int status);
+}
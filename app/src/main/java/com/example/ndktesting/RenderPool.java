@@ -0,0 +1,45 @@
+package com.example.ndktesting;
+
+import android.content.Context;
+
+import java.io.File;
+import java.io.IOException;
+
+/**
+ * Pool of helper processes, each running its own PDFium instance, used to rasterize
+ * pages of one document in parallel. Created by {@link PdfiumCore#newRenderPool(String, int)}.
+ */
+public class RenderPool {
+    /** File name of the worker executable next to the app native libraries */
+    public static final String WORKER_NAME = "libpdfiumRenderWorker.so";
+
+    /*package*/ RenderPool() {
+    }
+
+    /*package*/ long mNativePoolPtr;
+    /*package*/ int mWorkers;
+
+    public int getWorkerCount() {
+        return mWorkers;
+    }
+
+    /** Path the installer extracts the packaged worker executable to */
+    public static String getDefaultWorkerPath(Context ctx) {
+        return ctx.getApplicationInfo().nativeLibraryDir + "/" + WORKER_NAME;
+    }
+
+    /**
+     * Fail early with a clear message on a missing worker. One that is present but cannot
+     * link or start fails the ready handshake and nativeCreateRenderPool throws.
+     */
+    /*package*/ static void checkWorker(String workerPath) throws IOException {
+        if (workerPath == null) {
+            throw new IOException("No render worker path");
+        }
+        File worker = new File(workerPath);
+        if (!worker.isFile() || !worker.canExecute()) {
+            throw new IOException("Render worker " + workerPath + " missing or not executable,"
+                    + " it must be packaged as " + WORKER_NAME);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+package com.example.ndktesting;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Page rendered by a {@link RenderPool} into its shared memory ring. Pixels are RGBA,
+ * laid out like an ARGB_8888 bitmap, and stay valid until
+ * {@link PdfiumCore#releaseRenderedPage(PdfDocument, RenderedPage)}.
+ */
+public class RenderedPage {
+    /*package*/ long mTicket;
+
+    /*package*/ RenderedPage(long ticket, ByteBuffer pixels, int pageIndex, int width, int height) {
+        mTicket = ticket;
+        this.pixels = pixels;
+        this.pageIndex = pageIndex;
+        this.width = width;
+        this.height = height;
+    }
+
+    /** Direct buffer mapping the ring slot, e.g. for {@link android.graphics.Bitmap#copyPixelsFromBuffer} */
+    public final ByteBuffer pixels;
+    public final int pageIndex;
+    public final int width;
+    public final int height;
+
+    public int getStride() {
+        return width * 4;
+    }
+}
@@ -0,0 +1,13 @@
+package com.example.ndktesting;
+
+/**
+ * Progress of {@link PdfiumCore#saveDocument(PdfDocument, android.os.ParcelFileDescriptor, boolean, SaveCallback)}.
+ * Called on the saving thread while it holds the PDFium lock; do not call back into
+ * {@link PdfiumCore} from here.
+ */
+public interface SaveCallback {
+    /**
+     * @param bytesWritten size of the output so far, including original bytes an append skipped
+     */
+    void onSaveProgress(long bytesWritten);
+}
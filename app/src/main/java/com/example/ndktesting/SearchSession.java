@@ -0,0 +1,46 @@
+package com.example.ndktesting;
+
+/**
+ * Find session on one page, created by
+ * {@link PdfiumCore#newSearchSession(PdfDocument, int, String, int)}. Keeps its search
+ * position natively, so stepping through matches does not restart the search.
+ */
+public class SearchSession {
+    /*package*/ long mNativeSessionPtr;
+    /*package*/ final PdfDocument mDocument;
+    /*package*/ final int mPageIndex;
+    /*package*/ int mMatch = -1;
+    /*package*/ int mCharIndex = -1;
+    /*package*/ int mCharCount;
+
+    /*package*/ SearchSession(PdfDocument doc, int pageIndex, long nativeSessionPtr) {
+        mDocument = doc;
+        mPageIndex = pageIndex;
+        mNativeSessionPtr = nativeSessionPtr;
+    }
+
+    public int getPageIndex() {
+        return mPageIndex;
+    }
+
+    /** Number of the current match, -1 before the first step */
+    public int getMatch() {
+        return mMatch;
+    }
+
+    /** Index of the first char of the current match in the text page */
+    public int getCharIndex() {
+        return mCharIndex;
+    }
+
+    /** Chars in the current match */
+    public int getCharCount() {
+        return mCharCount;
+    }
+
+    /*package*/ void set(int[] match) {
+        mMatch = match[0];
+        mCharIndex = match[1];
+        mCharCount = match[2];
+    }
+}
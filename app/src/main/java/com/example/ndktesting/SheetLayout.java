@@ -0,0 +1,36 @@
+package com.example.ndktesting;
+
+/**
+ * Print sheet holding rows x cols pages, returned by
+ * {@link PdfiumCore#getSheetLayout(PdfDocument, int, float, float, float, float)}. Sizes are in
+ * points; the orientation is already chosen, so width may exceed height.
+ */
+public class SheetLayout {
+    /*package*/ final float[] mValues;
+
+    /*package*/ SheetLayout(float[] values) {
+        mValues = values;
+        width = values[0];
+        height = values[1];
+        margin = values[2];
+        gap = values[3];
+        rows = (int) values[4];
+        cols = (int) values[5];
+    }
+
+    public final float width;
+    public final float height;
+    public final float margin;
+    public final float gap;
+    public final int rows;
+    public final int cols;
+
+    public int getPagesPerSheet() {
+        return rows * cols;
+    }
+
+    /** Sheets needed for pageCount pages */
+    public int getSheetCount(int pageCount) {
+        return (pageCount + getPagesPerSheet() - 1) / getPagesPerSheet();
+    }
+}
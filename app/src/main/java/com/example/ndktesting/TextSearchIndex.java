@@ -0,0 +1,16 @@
+package com.example.ndktesting;
+
+/**
+ * Folded copy of a text for case and accent insensitive search, created by
+ * {@link PdfiumCore#newTextSearchIndex(String)}. Matches are reported in UTF-16
+ * offsets of the original string, not folded positions. On a {@link DocumentText}
+ * they map to pages through {@link DocumentText#getPageAt(int)} and to PDFium chars
+ * through {@link PdfiumCore#textPageMapTextRange(PdfDocument, int, int, int)}.
+ */
+public class TextSearchIndex {
+    /*package*/ long mNativeIndexPtr;
+
+    /*package*/ TextSearchIndex(long nativeIndexPtr) {
+        mNativeIndexPtr = nativeIndexPtr;
+    }
+}
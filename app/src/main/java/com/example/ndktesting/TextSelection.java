@@ -0,0 +1,46 @@
+package com.example.ndktesting;
+
+import android.graphics.RectF;
+
+/**
+ * Text selection on one text page, created by
+ * {@link PdfiumCore#newTextSelection(PdfDocument, int)}. Updates run natively on a
+ * copy of the page text and boxes, so they are cheap enough for every drag event.
+ */
+public class TextSelection {
+    /*package*/ long mNativeSelectionPtr;
+    /*package*/ int mStart;
+    /*package*/ int mCount;
+    /*package*/ float[] mRects = new float[0];
+    /*package*/ int mRectOffset;
+
+    /*package*/ TextSelection(long nativeSelectionPtr) {
+        mNativeSelectionPtr = nativeSelectionPtr;
+    }
+
+    /** Index of the first selected char in the text page */
+    public int getStart() {
+        return mStart;
+    }
+
+    public int getCount() {
+        return mCount;
+    }
+
+    public int getRectCount() {
+        return (mRects.length - mRectOffset) / 4;
+    }
+
+    /** Merged highlight rect of one line in page coordinates */
+    public RectF getRect(int index) {
+        int i = mRectOffset + index * 4;
+        return new RectF(mRects[i], mRects[i + 1], mRects[i + 2], mRects[i + 3]);
+    }
+
+    /*package*/ void set(float[] packed) {
+        mStart = (int) packed[0];
+        mCount = (int) packed[1];
+        mRects = packed;
+        mRectOffset = 2;
+    }
+}
@@ -43,6 +43,66 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
 LOCAL_SHARED_LIBRARIES += aospPdfium
 LOCAL_LDLIBS += -llog -landroid -ljnigraphics
 
-LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp
+LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp \
+                    $(LOCAL_PATH)/src/pdfCore.cpp \
+                    $(LOCAL_PATH)/src/renderPool.cpp \
+                    $(LOCAL_PATH)/src/renderExecutor.cpp \
+                    $(LOCAL_PATH)/src/textSelection.cpp \
+                    $(LOCAL_PATH)/src/searchSession.cpp \
+                    $(LOCAL_PATH)/src/textSearch.cpp \
+                    $(LOCAL_PATH)/src/textRegex.cpp \
+                    $(LOCAL_PATH)/src/webLinks.cpp \
+                    $(LOCAL_PATH)/src/hitIndex.cpp \
+                    $(LOCAL_PATH)/src/namedDests.cpp \
+                    $(LOCAL_PATH)/src/docSummary.cpp \
+                    $(LOCAL_PATH)/src/memoryGovernor.cpp \
+                    $(LOCAL_PATH)/src/handleTable.cpp \
+                    $(LOCAL_PATH)/src/scratchArena.cpp \
+                    $(LOCAL_PATH)/src/documentSave.cpp \
+                    $(LOCAL_PATH)/src/pixelRing.cpp \
+                    $(LOCAL_PATH)/src/sharedMemory.cpp \
+                    $(LOCAL_PATH)/src/documentAssembler.cpp \
+                    $(LOCAL_PATH)/src/imposition.cpp \
+                    $(LOCAL_PATH)/src/formFill.cpp \
+                    $(LOCAL_PATH)/src/fontProvider.cpp \
+                    $(LOCAL_PATH)/src/pdfiumLibrary.cpp \
+                    $(LOCAL_PATH)/src/grayRender.cpp
 
 include $(BUILD_SHARED_LIBRARY)
+
+#Render pool helper process, one PDFium instance per worker. Named like a library so
+#it lands in libs/<abi> (jniLibs) and the installer extracts it to nativeLibraryDir
+include $(CLEAR_VARS)
+LOCAL_MODULE := pdfiumRenderWorker
+LOCAL_MODULE_FILENAME := libpdfiumRenderWorker.so
+
+LOCAL_CFLAGS += -DHAVE_PTHREADS
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
+LOCAL_SHARED_LIBRARIES += aospPdfium
+LOCAL_LDLIBS += -llog
+#Finds its libraries next to itself; the parent also sets LD_LIBRARY_PATH for linkers
+#older than API 24, which ignore $ORIGIN
+LOCAL_LDFLAGS += -Wl,-rpath,'$$ORIGIN'
+
+LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/renderWorker.cpp \
+                    $(LOCAL_PATH)/src/pdfCore.cpp \
+                    $(LOCAL_PATH)/src/pixelRing.cpp \
+                    $(LOCAL_PATH)/src/sharedMemory.cpp \
+                    $(LOCAL_PATH)/src/documentSave.cpp \
+                    $(LOCAL_PATH)/src/documentAssembler.cpp
+
+include $(BUILD_EXECUTABLE)
+
+#Headless batch render/extract tool, same render and text path as jniPdfium
+include $(CLEAR_VARS)
+LOCAL_MODULE := pdfiumBatch
+
+LOCAL_CFLAGS += -DHAVE_PTHREADS
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
+LOCAL_SHARED_LIBRARIES += aospPdfium
+LOCAL_LDLIBS += -llog
+
+LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/pdfiumBatch.cpp \
+                    $(LOCAL_PATH)/src/pdfCore.cpp
+
+include $(BUILD_EXECUTABLE)
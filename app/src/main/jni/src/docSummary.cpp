@@ -0,0 +1,325 @@
+#include "util.hpp"
+#include "docSummary.hpp"
+#include "pdfCore.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <errno.h>
+    #include <dirent.h>
+    #include <sys/stat.h>
+    #include <sys/time.h>
+}
+
+#include <algorithm>
+
+#include <fpdf_doc.h>
+
+#define DOC_SUMMARY_MAGIC 0x50445353 //PDSS
+#define DOC_SUMMARY_VERSION 1
+#define DOC_SUMMARY_HASH_BLOCK 65536
+#define DOC_SUMMARY_MAX_OUTLINE 10000
+#define DOC_SUMMARY_MAX_DEPTH 64
+
+const char* const kDocSummaryMetaTags[DOC_SUMMARY_META_COUNT] = {
+    "Title", "Author", "Subject", "Keywords", "Creator", "Producer", "CreationDate", "ModDate"
+};
+
+struct DocumentSummaryHeader {
+    uint32_t magic;
+    uint32_t version;
+    DocumentKey key;
+    uint32_t payloadSize;
+    uint32_t payloadHash;
+};
+
+static uint64_t fnv1a64(uint64_t h, const uint8_t *data, size_t size){
+    for(size_t i = 0; i < size; i++){
+        h = (h ^ data[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+bool getDocumentKey(int fd, DocumentKey *key){
+    struct stat state;
+    if(fstat(fd, &state) != 0) return false;
+
+    key->size = (uint64_t) state.st_size;
+    key->mtimeNs = (int64_t) state.st_mtim.tv_sec * 1000000000ll + state.st_mtim.tv_nsec;
+
+    //Head and tail: header, first page objects, trailer and last xref section
+    std::vector<uint8_t> block(DOC_SUMMARY_HASH_BLOCK);
+    uint64_t h = 14695981039346656037ull;
+    off_t offsets[2] = { 0, (off_t) (key->size > DOC_SUMMARY_HASH_BLOCK ? key->size - DOC_SUMMARY_HASH_BLOCK : 0) };
+    for(int i = 0; i < 2; i++){
+        ssize_t n = pread(fd, &block[0], block.size(), offsets[i]);
+        if(n < 0) return false;
+        h = fnv1a64(h, &block[0], (size_t) n);
+    }
+    key->contentHash = h;
+    return true;
+}
+
+static void getMetaText(FPDF_DOCUMENT doc, const char *tag, std::vector<unsigned short> *out){
+    out->clear();
+    unsigned long length = FPDF_GetMetaText(doc, tag, NULL, 0);
+    if(length <= 2) return;
+    out->resize(length / 2);
+    FPDF_GetMetaText(doc, tag, &(*out)[0], length);
+    out->resize(length / 2 - 1);
+}
+
+static void appendOutline(FPDF_DOCUMENT doc, FPDF_BOOKMARK parent, int depth, DocumentSummary *summary){
+    if(depth >= DOC_SUMMARY_MAX_DEPTH) return;
+
+    FPDF_BOOKMARK bookmark = FPDFBookmark_GetFirstChild(doc, parent);
+    //Broken outlines can loop, the entry cap ends them
+    while(bookmark != NULL && summary->outline.size() < DOC_SUMMARY_MAX_OUTLINE){
+        OutlineEntry entry;
+        entry.depth = depth;
+        entry.pageIndex = -1;
+        FPDF_DEST dest = FPDFBookmark_GetDest(doc, bookmark);
+        if(dest != NULL) entry.pageIndex = (int32_t) FPDFDest_GetPageIndex(doc, dest);
+
+        entry.titleStart = (int32_t) summary->outlineTitles.size();
+        unsigned long length = FPDFBookmark_GetTitle(bookmark, NULL, 0);
+        if(length > 2){
+            summary->outlineTitles.resize(entry.titleStart + length / 2);
+            FPDFBookmark_GetTitle(bookmark, &summary->outlineTitles[entry.titleStart], length);
+            summary->outlineTitles.resize(entry.titleStart + length / 2 - 1);
+        }
+        entry.titleLength = (int32_t) summary->outlineTitles.size() - entry.titleStart;
+        summary->outline.push_back(entry);
+
+        appendOutline(doc, bookmark, depth + 1, summary);
+        bookmark = FPDFBookmark_GetNextSibling(doc, bookmark);
+    }
+}
+
+void buildDocumentSummary(FPDF_DOCUMENT doc, int thumbnailWidth, DocumentSummary *summary){
+    summary->pageCount = FPDF_GetPageCount(doc);
+    summary->pageSizes.resize((size_t) summary->pageCount * 2);
+    for(int i = 0; i < summary->pageCount; i++){
+        double width = 0, height = 0;
+        if(!FPDF_GetPageSizeByIndex(doc, i, &width, &height)){
+            width = height = 0;
+        }
+        summary->pageSizes[i * 2] = (float) width;
+        summary->pageSizes[i * 2 + 1] = (float) height;
+    }
+
+    for(int i = 0; i < DOC_SUMMARY_META_COUNT; i++){
+        getMetaText(doc, kDocSummaryMetaTags[i], &summary->meta[i]);
+    }
+
+    summary->outline.clear();
+    summary->outlineTitles.clear();
+    appendOutline(doc, NULL, 0, summary);
+
+    summary->thumbnailWidth = summary->thumbnailHeight = 0;
+    summary->thumbnail.clear();
+    if(thumbnailWidth > 0 && summary->pageCount > 0 && summary->pageSizes[0] > 0){
+        int width = thumbnailWidth;
+        int height = (int) (thumbnailWidth * summary->pageSizes[1] / summary->pageSizes[0] + 0.5f);
+        FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+        if(page != NULL && height > 0 && height <= thumbnailWidth * 8){
+            //BGRA in memory is the ARGB int of an Android bitmap
+            summary->thumbnail.resize((size_t) width * height);
+            renderPageToBuffer(page, &summary->thumbnail[0], FPDFBitmap_BGRA, width * 4,
+                               width, height, 0, 0, width, height, 0, NULL);
+            summary->thumbnailWidth = width;
+            summary->thumbnailHeight = height;
+        }
+        if(page != NULL) FPDF_ClosePage(page);
+    }
+}
+
+std::string documentSummaryPath(const char *directory, const DocumentKey &key){
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-%llx.summary",
+             (unsigned long long) key.contentHash, (unsigned long long) key.size);
+    return std::string(directory) + name;
+}
+
+//Payload: little endian fields back to back, arrays prefixed by their element count
+class SummaryWriter {
+public:
+    std::vector<uint8_t> data;
+
+    void put(const void *value, size_t size){
+        const uint8_t *bytes = (const uint8_t*) value;
+        data.insert(data.end(), bytes, bytes + size);
+    }
+    void putInt(int32_t value){ put(&value, sizeof(value)); }
+    template <class T>
+    void putArray(const std::vector<T> &values){
+        putInt((int32_t) values.size());
+        if(!values.empty()) put(&values[0], values.size() * sizeof(T));
+    }
+};
+
+class SummaryReader {
+public:
+    SummaryReader(const uint8_t *data, size_t size) : mData(data), mSize(size), mPos(0), mFailed(false) {}
+
+    bool failed() const { return mFailed || mPos != mSize; }
+
+    bool get(void *value, size_t size){
+        if(mFailed || size > mSize - mPos){
+            mFailed = true;
+            return false;
+        }
+        memcpy(value, mData + mPos, size);
+        mPos += size;
+        return true;
+    }
+    int32_t getInt(){
+        int32_t value = 0;
+        get(&value, sizeof(value));
+        return value;
+    }
+    template <class T>
+    void getArray(std::vector<T> *values){
+        int32_t count = getInt();
+        if(count < 0 || (size_t) count > (mSize - mPos) / sizeof(T)){
+            mFailed = true;
+            return;
+        }
+        values->resize(count);
+        if(count > 0) get(&(*values)[0], (size_t) count * sizeof(T));
+    }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    size_t mPos;
+    bool mFailed;
+};
+
+bool writeDocumentSummary(const std::string &path, const DocumentKey &key,
+                          const DocumentSummary &summary){
+    SummaryWriter writer;
+    writer.putInt(summary.pageCount);
+    writer.putArray(summary.pageSizes);
+    for(int i = 0; i < DOC_SUMMARY_META_COUNT; i++) writer.putArray(summary.meta[i]);
+    writer.putArray(summary.outline);
+    writer.putArray(summary.outlineTitles);
+    writer.putInt(summary.thumbnailWidth);
+    writer.putInt(summary.thumbnailHeight);
+    writer.putArray(summary.thumbnail);
+
+    DocumentSummaryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DOC_SUMMARY_MAGIC;
+    header.version = DOC_SUMMARY_VERSION;
+    header.key = key;
+    header.payloadSize = (uint32_t) writer.data.size();
+    header.payloadHash = (uint32_t) fnv1a64(14695981039346656037ull, &writer.data[0], writer.data.size());
+
+    std::string temporary = path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        LOGE("Cannot write summary %s: %s", temporary.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)
+              && write(fd, &writer.data[0], writer.data.size()) == (ssize_t) writer.data.size();
+    ok = (close(fd) == 0) && ok;
+    if(!ok || rename(temporary.c_str(), path.c_str()) != 0){
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readDocumentSummary(const std::string &path, const DocumentKey &key, DocumentSummary *summary){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    DocumentSummaryHeader header;
+    std::vector<uint8_t> payload;
+    bool ok = read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)
+              && header.magic == DOC_SUMMARY_MAGIC && header.version == DOC_SUMMARY_VERSION
+              && header.key.size == key.size && header.key.mtimeNs == key.mtimeNs
+              && header.key.contentHash == key.contentHash;
+    //A corrupt header must not size the allocation, the payload is the rest of the file
+    struct stat state;
+    ok = ok && fstat(fd, &state) == 0
+         && (uint64_t) state.st_size == (uint64_t) sizeof(header) + header.payloadSize;
+    if(ok){
+        payload.resize(header.payloadSize);
+        ok = header.payloadSize > 0
+             && read(fd, &payload[0], payload.size()) == (ssize_t) payload.size()
+             && (uint32_t) fnv1a64(14695981039346656037ull, &payload[0], payload.size()) == header.payloadHash;
+    }
+    close(fd);
+    if(!ok) return false;
+
+    SummaryReader reader(&payload[0], payload.size());
+    summary->pageCount = reader.getInt();
+    reader.getArray(&summary->pageSizes);
+    for(int i = 0; i < DOC_SUMMARY_META_COUNT; i++) reader.getArray(&summary->meta[i]);
+    reader.getArray(&summary->outline);
+    reader.getArray(&summary->outlineTitles);
+    summary->thumbnailWidth = reader.getInt();
+    summary->thumbnailHeight = reader.getInt();
+    reader.getArray(&summary->thumbnail);
+    if(reader.failed()
+       || summary->pageSizes.size() != (size_t) summary->pageCount * 2
+       || summary->thumbnail.size() != (size_t) summary->thumbnailWidth * summary->thumbnailHeight){
+        return false;
+    }
+    for(size_t i = 0; i < summary->outline.size(); i++){
+        const OutlineEntry &entry = summary->outline[i];
+        if(entry.titleStart < 0 || entry.titleLength < 0
+           || (size_t) entry.titleStart + entry.titleLength > summary->outlineTitles.size()){
+            return false;
+        }
+    }
+    return true;
+}
+
+void touchDocumentSummary(const std::string &path){
+    utimes(path.c_str(), NULL);
+}
+
+struct SummaryFile {
+    std::string path;
+    int64_t usedNs;
+    uint64_t size;
+
+    bool operator<(const SummaryFile &other) const { return usedNs < other.usedNs; }
+};
+
+void trimDocumentSummaries(const char *directory, uint64_t maxBytes){
+    DIR *dir = opendir(directory);
+    if(dir == NULL) return;
+
+    std::vector<SummaryFile> files;
+    uint64_t total = 0;
+    static const char kSuffix[] = ".summary";
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        size_t length = strlen(entry->d_name);
+        if(length < sizeof(kSuffix) || strcmp(entry->d_name + length - (sizeof(kSuffix) - 1), kSuffix) != 0){
+            continue;
+        }
+        SummaryFile file;
+        file.path = std::string(directory) + "/" + entry->d_name;
+        struct stat state;
+        if(stat(file.path.c_str(), &state) != 0 || !S_ISREG(state.st_mode)) continue;
+        file.usedNs = (int64_t) state.st_mtim.tv_sec * 1000000000ll + state.st_mtim.tv_nsec;
+        file.size = (uint64_t) state.st_size;
+        total += file.size;
+        files.push_back(file);
+    }
+    closedir(dir);
+    if(total <= maxBytes) return;
+
+    std::sort(files.begin(), files.end());
+    for(size_t i = 0; i < files.size() && total > maxBytes; i++){
+        if(unlink(files[i].path.c_str()) == 0) total -= files[i].size;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef _DOC_SUMMARY_HPP_
+#define _DOC_SUMMARY_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * What a viewer needs before the first page renders: page count, page sizes,
+ * metadata, outline and a first page thumbnail. It is built once from the
+ * open document and persisted as one file per document in a cache directory.
+ * Files are named after a key of file size, mtime and a hash of the head and
+ * tail of the file, so a reopen finds its summary from the fd alone, without
+ * PDFium parsing anything.
+ */
+
+#define DOC_SUMMARY_META_COUNT 8
+
+//Bound of a summary cache directory, a thumbnail alone is about 350 KB
+#define DOC_SUMMARY_CACHE_MAX_BYTES (16 << 20)
+
+//Tags of DocumentSummary::meta, in order
+extern const char* const kDocSummaryMetaTags[DOC_SUMMARY_META_COUNT];
+
+struct DocumentKey {
+    uint64_t size;
+    int64_t mtimeNs;
+    uint64_t contentHash;       //FNV-1a of the first and last 64 KB
+};
+
+struct OutlineEntry {
+    int32_t depth;              //0 for top level entries, children follow their parent
+    int32_t pageIndex;          //-1 when the entry has no destination
+    int32_t titleStart;         //in DocumentSummary::outlineTitles
+    int32_t titleLength;
+};
+
+struct DocumentSummary {
+    int32_t pageCount;
+    std::vector<float> pageSizes;                   //width, height in points per page
+    std::vector<unsigned short> meta[DOC_SUMMARY_META_COUNT];
+    std::vector<OutlineEntry> outline;              //pre-order
+    std::vector<unsigned short> outlineTitles;
+    int32_t thumbnailWidth;
+    int32_t thumbnailHeight;
+    std::vector<uint32_t> thumbnail;                //ARGB as Android ints, 0 sized if none
+};
+
+//Key of an open file; false if it cannot be read
+bool getDocumentKey(int fd, DocumentKey *key);
+
+//Collect the summary, caller holds the PDFium lock; thumbnailWidth 0 skips the thumbnail
+void buildDocumentSummary(FPDF_DOCUMENT doc, int thumbnailWidth, DocumentSummary *summary);
+
+//Cache file of key in directory
+std::string documentSummaryPath(const char *directory, const DocumentKey &key);
+
+//Write through a temporary file and rename, readers never see a partial file
+bool writeDocumentSummary(const std::string &path, const DocumentKey &key,
+                          const DocumentSummary &summary);
+//False if missing, stale or corrupt
+bool readDocumentSummary(const std::string &path, const DocumentKey &key, DocumentSummary *summary);
+
+//Mark a cached summary as just used, trimming drops the least recently used first
+void touchDocumentSummary(const std::string &path);
+//Delete least recently used summaries of directory until it holds at most maxBytes
+void trimDocumentSummaries(const char *directory, uint64_t maxBytes);
+
+#endif
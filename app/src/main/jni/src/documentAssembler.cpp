@@ -0,0 +1,241 @@
+#include "util.hpp"
+#include "pdfCore.hpp"
+#include "documentAssembler.hpp"
+#include "documentSave.hpp"
+#include "sharedMemory.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <poll.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <signal.h>
+    #include <sys/wait.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_edit.h>
+#include <fpdf_ppo.h>
+
+#include <map>
+
+//Descriptors of an assemble worker: status pipe, output, then the sources it uses.
+//The worker writes one byte to the pipe once PDFium is up, the pipe hangs up at exit
+#define ASSEMBLE_STATUS_FD 3
+#define ASSEMBLE_OUTPUT_FD 4
+#define ASSEMBLE_SOURCE_FD 5
+
+struct AssembleChild {
+    pid_t pid;
+    int pipe;               //read end, hangs up when the worker exits
+    size_t output;
+    bool started;           //ready byte received
+};
+
+static bool spawnAssembler(const char *workerPath, const std::vector<int> &sourceFds,
+                           const AssembleOutput &output, AssembleChild *child){
+    //Argument per part as "slot:pages", slot numbering only the sources this output uses
+    std::vector<int> slots(sourceFds.size(), -1);
+    std::vector<int> fds;
+    fds.push_back(-1);
+    fds.push_back(output.fd);
+    std::vector<std::string> args;
+    args.push_back(workerPath);
+    args.push_back("assemble");
+    for(size_t i = 0; i < output.parts.size(); i++){
+        int source = output.parts[i].source;
+        if(source < 0 || source >= (int) sourceFds.size()) return false;
+        if(slots[source] < 0){
+            slots[source] = (int) fds.size() - (ASSEMBLE_SOURCE_FD - ASSEMBLE_STATUS_FD);
+            fds.push_back(sourceFds[source]);
+        }
+        char slot[16];
+        snprintf(slot, sizeof(slot), "%d:", slots[source]);
+        args.push_back(slot + output.parts[i].pages);
+    }
+
+    int pipeFds[2];
+    if(pipe(pipeFds) != 0){
+        LOGE("Assemble pipe failed: %s", strerror(errno));
+        return false;
+    }
+    fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    fds[0] = pipeFds[1];
+
+    //Everything the child needs is allocated before fork
+    std::vector<char*> argv;
+    for(size_t i = 0; i < args.size(); i++) argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(NULL);
+    //The worker links against libmodpdfium and libc++_shared next to it in nativeLibraryDir
+    std::vector<std::string> environment;
+    std::vector<char*> envp;
+    helperEnvironment(workerPath, &environment, &envp);
+    int count = (int) fds.size();
+    std::vector<int> moved(count);
+
+    pid_t pid = fork();
+    if(pid == 0){
+        //Child of a JVM process: only async-signal-safe calls until exec.
+        //Move every fd above the target range first so none is clobbered
+        for(int i = 0; i < count; i++){
+            moved[i] = fcntl(fds[i], F_DUPFD, ASSEMBLE_STATUS_FD + count);
+            if(moved[i] < 0) _exit(ASSEMBLE_ERROR_PROCESS);
+        }
+        for(int i = 0; i < count; i++) dup2(moved[i], ASSEMBLE_STATUS_FD + i);
+        long maxFd = sysconf(_SC_OPEN_MAX);
+        for(int fd = ASSEMBLE_STATUS_FD + count; fd < maxFd; fd++) close(fd);
+
+        execve(workerPath, &argv[0], &envp[0]);
+        _exit(ASSEMBLE_ERROR_PROCESS);
+    }
+    close(pipeFds[1]);
+
+    if(pid < 0){
+        LOGE("Assemble fork failed: %s", strerror(errno));
+        close(pipeFds[0]);
+        return false;
+    }
+    child->pid = pid;
+    child->pipe = pipeFds[0];
+    child->started = false;
+    return true;
+}
+
+static int reapAssembler(const AssembleChild &child){
+    close(child.pipe);
+    int state;
+    while(waitpid(child.pid, &state, 0) < 0){
+        if(errno != EINTR) return ASSEMBLE_ERROR_PROCESS;
+    }
+    if(!WIFEXITED(state)){
+        LOGE("Assemble worker of output %d crashed", (int) child.output);
+        return ASSEMBLE_ERROR_PROCESS;
+    }
+    int status = WEXITSTATUS(state);
+    if(!child.started){
+        //Failed exec, link or init; its exit status is not an AssembleStatus
+        LOGE("Assemble worker of output %d did not start, exit status %d", (int) child.output, status);
+        return ASSEMBLE_ERROR_PROCESS;
+    }
+    return (status <= ASSEMBLE_ERROR_PROCESS)? status : ASSEMBLE_ERROR_PROCESS;
+}
+
+void assembleDocuments(const char *workerPath, const std::vector<int> &sourceFds,
+                       const std::vector<AssembleOutput> &outputs, int maxProcesses,
+                       std::vector<int> *statuses){
+    statuses->assign(outputs.size(), ASSEMBLE_ERROR_PROCESS);
+    if(maxProcesses < 1) maxProcesses = 1;
+
+    std::vector<AssembleChild> running;
+    size_t next = 0;
+    while(next < outputs.size() || !running.empty()){
+        while(next < outputs.size() && (int) running.size() < maxProcesses){
+            AssembleChild child;
+            child.output = next;
+            if(spawnAssembler(workerPath, sourceFds, outputs[next], &child)){
+                running.push_back(child);
+            }
+            next++;
+        }
+        if(running.empty()) continue;
+
+        //Wait on the pipes, waitpid(-1) would also reap render pool workers
+        std::vector<struct pollfd> polls(running.size());
+        for(size_t i = 0; i < running.size(); i++){
+            polls[i].fd = running[i].pipe;
+            polls[i].events = POLLIN;
+            polls[i].revents = 0;
+        }
+        if(poll(&polls[0], polls.size(), -1) < 0){
+            if(errno == EINTR) continue;
+            LOGE("Assemble poll failed: %s", strerror(errno));
+            break;
+        }
+        for(size_t i = running.size(); i-- > 0;){
+            if(polls[i].revents == 0) continue;
+            if(!running[i].started){
+                char ready;
+                ssize_t got = read(running[i].pipe, &ready, 1);
+                if(got < 0 && errno == EINTR) continue;
+                if(got == 1){
+                    running[i].started = true;
+                    continue;
+                }
+            }
+            (*statuses)[running[i].output] = reapAssembler(running[i]);
+            running.erase(running.begin() + i);
+        }
+    }
+
+    for(size_t i = 0; i < running.size(); i++){
+        kill(running[i].pid, SIGKILL);
+        reapAssembler(running[i]);
+    }
+}
+
+int assembleMain(int argc, char **argv){
+    FPDF_InitLibrary();
+    char ready = 1;
+    if(write(ASSEMBLE_STATUS_FD, &ready, 1) != 1){
+        FPDF_DestroyLibrary();
+        return ASSEMBLE_ERROR_PROCESS;
+    }
+
+    FPDF_DOCUMENT dest = FPDF_CreateNewDocument();
+    std::map<int, FPDF_DOCUMENT> sources;
+    int status = (dest != NULL)? ASSEMBLE_OK : ASSEMBLE_ERROR_SAVE;
+
+    for(int i = 2; i < argc && status == ASSEMBLE_OK; i++){
+        const char *colon = strchr(argv[i], ':');
+        if(colon == NULL){
+            status = ASSEMBLE_ERROR_PAGES;
+            break;
+        }
+        int slot = atoi(argv[i]);
+        const char *pages = (colon[1] != 0)? colon + 1 : NULL;
+
+        FPDF_DOCUMENT source;
+        std::map<int, FPDF_DOCUMENT>::iterator it = sources.find(slot);
+        if(it != sources.end()){
+            source = it->second;
+        }else{
+            int fd = ASSEMBLE_SOURCE_FD + slot;
+            long size = getFileSize(fd);
+            source = (size > 0)? loadDocumentFromFd(fd, (size_t) size, NULL) : NULL;
+            if(source == NULL){
+                status = ASSEMBLE_ERROR_SOURCE;
+                break;
+            }
+            //Page layout and viewer settings follow the first source
+            if(sources.empty()) FPDF_CopyViewerPreferences(dest, source);
+            sources[slot] = source;
+        }
+
+        if(!FPDF_ImportPages(dest, source, pages, FPDF_GetPageCount(dest))){
+            status = ASSEMBLE_ERROR_PAGES;
+        }
+    }
+
+    if(status == ASSEMBLE_OK){
+        SaveOptions options;
+        options.flags = FPDF_NO_INCREMENTAL;
+        options.skipBytes = 0;
+        options.progress = NULL;
+        options.progressArg = NULL;
+        int64_t written;
+        if(saveDocumentToFd(dest, ASSEMBLE_OUTPUT_FD, options, &written) != 0){
+            status = ASSEMBLE_ERROR_SAVE;
+        }
+    }
+
+    //Imported pages are deep copies, sources can go in any order
+    if(dest != NULL) FPDF_CloseDocument(dest);
+    for(std::map<int, FPDF_DOCUMENT>::iterator it = sources.begin(); it != sources.end(); ++it){
+        FPDF_CloseDocument(it->second);
+    }
+    FPDF_DestroyLibrary();
+    return status;
+}
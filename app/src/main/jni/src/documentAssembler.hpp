@@ -0,0 +1,49 @@
+#ifndef _DOCUMENT_ASSEMBLER_HPP_
+#define _DOCUMENT_ASSEMBLER_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <string>
+#include <vector>
+
+/*
+ * Merge and split: every output document is built from page ranges of the
+ * sources with FPDF_ImportPages into FPDF_CreateNewDocument and written with
+ * a streamed save. Each output is assembled in its own pdfiumRenderWorker
+ * process (PDFium is single threaded), up to a given number at once. Sources
+ * are shared by fd between the processes, they only pread them.
+ */
+
+enum AssembleStatus {
+    ASSEMBLE_OK = 0,
+    ASSEMBLE_ERROR_SOURCE,      //a source could not be opened, encrypted ones included
+    ASSEMBLE_ERROR_PAGES,       //page range rejected by FPDF_ImportPages
+    ASSEMBLE_ERROR_SAVE,
+    ASSEMBLE_ERROR_PROCESS      //worker could not start or crashed
+};
+
+struct AssemblePart {
+    int source;                 //index into the source fds
+    std::string pages;          //1-based list like "1-3,7", empty for all pages
+};
+
+struct AssembleOutput {
+    int fd;
+    std::vector<AssemblePart> parts;
+};
+
+/*
+ * Build outputs with at most maxProcesses workers running, blocks until all
+ * are done. statuses gets an AssembleStatus per output.
+ */
+void assembleDocuments(const char *workerPath, const std::vector<int> &sourceFds,
+                       const std::vector<AssembleOutput> &outputs, int maxProcesses,
+                       std::vector<int> *statuses);
+
+//Worker side: "assemble" command line of one output, returns the AssembleStatus to exit with
+int assembleMain(int argc, char **argv);
+
+#endif
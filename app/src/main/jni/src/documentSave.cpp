@@ -0,0 +1,124 @@
+#include "util.hpp"
+#include "documentSave.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <string.h>
+    #include <sys/stat.h>
+}
+
+#define SAVE_CHUNK_SIZE (1024 * 1024)
+#define SAVE_VERIFY_SIZE 1024     //skipped bytes compared with the file before trusting it
+
+//PDFium calls WriteBlock with the struct itself, the writer state follows it
+struct FdWriter {
+    FPDF_FILEWRITE base;
+    int fd;
+    const SaveOptions *options;
+    char *buffer;
+    size_t used;
+    int64_t offset;         //output offset of buffer[0]
+    int error;
+
+    bool flush(){
+        size_t done = 0;
+        while(done < used){
+            ssize_t n = pwrite(fd, buffer + done, used - done, (off_t) (offset + done));
+            if(n < 0){
+                if(errno == EINTR) continue;
+                error = errno;
+                return false;
+            }
+            done += (size_t) n;
+        }
+        offset += (int64_t) used;
+        used = 0;
+        if(options->progress != NULL) options->progress(offset, options->progressArg);
+        return true;
+    }
+
+    //Original file bytes the incremental output starts with, only the first kilobyte is compared.
+    //PDFium produced them anyway, skipping saves the writes only
+    bool skip(const char *data, size_t size){
+        if(offset < SAVE_VERIFY_SIZE){
+            size_t verify = (size_t) (SAVE_VERIFY_SIZE - offset);
+            if(verify > size) verify = size;
+            char existing[SAVE_VERIFY_SIZE];
+            ssize_t n = pread(fd, existing, verify, (off_t) offset);
+            if(n != (ssize_t) verify || memcmp(existing, data, verify) != 0){
+                LOGE("Save target does not hold the original document");
+                error = EINVAL;
+                return false;
+            }
+        }
+        offset += (int64_t) size;
+        return true;
+    }
+
+    int write(const void *data, unsigned long size){
+        if(error != 0) return 0;
+        const char *bytes = static_cast<const char*>(data);
+
+        int64_t skipBytes = options->skipBytes;
+        if(used == 0 && offset < skipBytes){
+            size_t skipped = (size_t) (skipBytes - offset);
+            if(skipped > size) skipped = size;
+            if(!skip(bytes, skipped)) return 0;
+            bytes += skipped;
+            size -= skipped;
+        }
+
+        while(size > 0){
+            size_t copy = SAVE_CHUNK_SIZE - used;
+            if(copy > size) copy = size;
+            memcpy(buffer + used, bytes, copy);
+            used += copy;
+            bytes += copy;
+            size -= copy;
+            if(used == SAVE_CHUNK_SIZE && !flush()) return 0;
+        }
+        return 1;
+    }
+
+    static int writeBlock(FPDF_FILEWRITE *self, const void *data, unsigned long size){
+        return reinterpret_cast<FdWriter*>(self)->write(data, size);
+    }
+};
+
+int saveDocumentToFd(FPDF_DOCUMENT doc, int fd, const SaveOptions &options, int64_t *written){
+    *written = 0;
+    if(options.skipBytes > 0){
+        struct stat state;
+        if(fstat(fd, &state) != 0) return errno;
+        //A previous append may follow, the new revision replaces it
+        if(state.st_size < options.skipBytes) return EINVAL;
+    }
+
+    FdWriter writer;
+    writer.base.version = 1;
+    writer.base.WriteBlock = &FdWriter::writeBlock;
+    writer.fd = fd;
+    writer.options = &options;
+    writer.buffer = static_cast<char*>(malloc(SAVE_CHUNK_SIZE));
+    writer.used = 0;
+    writer.offset = 0;
+    writer.error = 0;
+    if(writer.buffer == NULL) return ENOMEM;
+
+    bool saved = FPDF_SaveAsCopy(doc, &writer.base, (FPDF_DWORD) options.flags);
+    if(writer.error == 0 && !saved) writer.error = EIO;
+    if(writer.error == 0 && options.skipBytes > writer.offset + (int64_t) writer.used){
+        //Not an incremental copy of the file, nothing was written to it
+        writer.error = EINVAL;
+    }
+    if(writer.error == 0) writer.flush();
+    free(writer.buffer);
+    if(writer.error != 0) return writer.error;
+
+    //Old content past the end belongs to an earlier, longer save
+    if(ftruncate(fd, (off_t) writer.offset) != 0) return errno;
+    if(fdatasync(fd) != 0 && errno != EINVAL) return errno;
+    *written = writer.offset;
+    return 0;
+}
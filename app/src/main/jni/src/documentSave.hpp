@@ -0,0 +1,43 @@
+#ifndef _DOCUMENT_SAVE_HPP_
+#define _DOCUMENT_SAVE_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_save.h>
+
+/*
+ * FPDF_SaveAsCopy into a file descriptor. PDFium hands the writer many small
+ * blocks; they are gathered into large chunks and written with pwrite at
+ * their offset in the output. An incremental save starts with a verbatim
+ * copy of the file the document was loaded from, so saving back into that
+ * file can skip writing those bytes and write only the new revision after
+ * them. PDFium still reads and streams the whole original through the
+ * writer, so the save costs a read of the file; only the disk writes shrink.
+ *
+ * A non-incremental save must not go into the file the document was loaded
+ * from: PDFium reads pages from it lazily while the output overwrites it.
+ */
+
+//Called after every chunk written with the output size so far
+typedef void (*SaveProgress)(int64_t written, void *arg);
+
+struct SaveOptions {
+    int flags;              //FPDF_INCREMENTAL, FPDF_NO_INCREMENTAL or FPDF_REMOVE_SECURITY
+    int64_t skipBytes;      //output already in the file, 0 writes everything
+    SaveProgress progress;  //may be NULL
+    void *progressArg;
+};
+
+/*
+ * Save doc into fd and cut the file at the end of the output. Returns 0 on
+ * success, errno of the failed write, EINVAL when the file is shorter than
+ * skipBytes or does not start like the output, EIO when PDFium failed.
+ * written gets the size of the output, skipped bytes included.
+ */
+int saveDocumentToFd(FPDF_DOCUMENT doc, int fd, const SaveOptions &options, int64_t *written);
+
+#endif
@@ -0,0 +1,668 @@
+#include "util.hpp"
+#include "fontProvider.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <dirent.h>
+    #include <string.h>
+    #include <strings.h>
+    #include <errno.h>
+    #include <sys/stat.h>
+}
+
+#include <algorithm>
+
+using namespace android;
+
+#define FONT_INDEX_MAGIC 0x50464958 //PFIX
+#define FONT_INDEX_VERSION 1
+#define FONT_MAX_TABLES 256
+#define FONT_MAX_COLLECTION 64
+#define FONT_MAX_NAME_TABLE (1 << 20)
+
+#define FONT_TAG(a, b, c, d) (((uint32_t) (a) << 24) | ((uint32_t) (b) << 16) | ((uint32_t) (c) << 8) | (uint32_t) (d))
+#define TAG_TTCF FONT_TAG('t', 't', 'c', 'f')
+#define TAG_NAME FONT_TAG('n', 'a', 'm', 'e')
+#define TAG_OS2 FONT_TAG('O', 'S', '/', '2')
+#define TAG_POST FONT_TAG('p', 'o', 's', 't')
+
+//OS/2 ulCodePageRange1 bits
+#define CODEPAGE_LATIN1 (1u << 0)
+#define CODEPAGE_JIS (1u << 17)
+#define CODEPAGE_GB2312 (1u << 18)
+#define CODEPAGE_WANSUNG (1u << 19)
+#define CODEPAGE_BIG5 (1u << 20)
+#define CODEPAGE_JOHAB (1u << 21)
+#define CODEPAGE_SYMBOL (1u << 31)
+
+static const int kTrackedCharsets[] = {
+    FXFONT_ANSI_CHARSET, FXFONT_SYMBOL_CHARSET, FXFONT_SHIFTJIS_CHARSET,
+    FXFONT_HANGEUL_CHARSET, FXFONT_GB2312_CHARSET, FXFONT_CHINESEBIG5_CHARSET
+};
+#define TRACKED_CHARSET_COUNT (int) (sizeof(kTrackedCharsets) / sizeof(kTrackedCharsets[0]))
+
+struct FontIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t stamp;
+    uint32_t payloadSize;
+    uint32_t payloadHash;
+};
+
+static uint64_t fnv1a64(uint64_t h, const void *data, size_t size){
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++){
+        h = (h ^ bytes[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint16_t be16(const uint8_t *p){
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static uint32_t be32(const uint8_t *p){
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+std::string foldFontName(const char *name, size_t length){
+    std::string key;
+    key.reserve(length);
+    for(size_t i = 0; i < length; i++){
+        char c = name[i];
+        if(c >= 'A' && c <= 'Z') key += (char) (c - 'A' + 'a');
+        else if((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) key += c;
+    }
+    return key;
+}
+
+uint32_t fontCharsetBit(int charset){
+    for(int i = 0; i < TRACKED_CHARSET_COUNT; i++){
+        if(kTrackedCharsets[i] == charset) return 1u << i;
+    }
+    return 0;
+}
+
+static bool isCjkCharset(int charset){
+    return charset == FXFONT_SHIFTJIS_CHARSET || charset == FXFONT_HANGEUL_CHARSET
+           || charset == FXFONT_GB2312_CHARSET || charset == FXFONT_CHINESEBIG5_CHARSET;
+}
+
+static bool isFontFile(const char *name){
+    const char *dot = strrchr(name, '.');
+    return dot != NULL && (strcasecmp(dot, ".ttf") == 0 || strcasecmp(dot, ".otf") == 0
+                           || strcasecmp(dot, ".ttc") == 0 || strcasecmp(dot, ".otc") == 0);
+}
+
+//Font files of directory, sorted so the stamp does not depend on readdir order
+static void listFontFiles(const std::string &directory, std::vector<std::string> *paths){
+    DIR *dir = opendir(directory.c_str());
+    if(dir == NULL) return;
+    size_t first = paths->size();
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        if(isFontFile(entry->d_name)) paths->push_back(directory + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(paths->begin() + first, paths->end());
+}
+
+uint64_t fontDirectoriesStamp(const std::vector<std::string> &directories){
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < directories.size(); i++) listFontFiles(directories[i], &paths);
+
+    uint64_t h = 14695981039346656037ull;
+    for(size_t i = 0; i < paths.size(); i++){
+        struct stat state;
+        if(stat(paths[i].c_str(), &state) != 0) continue;
+        int64_t size = (int64_t) state.st_size;
+        int64_t mtimeNs = (int64_t) state.st_mtim.tv_sec * 1000000000ll + state.st_mtim.tv_nsec;
+        h = fnv1a64(h, paths[i].c_str(), paths[i].size() + 1);
+        h = fnv1a64(h, &size, sizeof(size));
+        h = fnv1a64(h, &mtimeNs, sizeof(mtimeNs));
+    }
+    return h;
+}
+
+static bool readAt(int fd, uint32_t offset, void *buffer, size_t size){
+    return pread(fd, buffer, size, (off_t) offset) == (ssize_t) size;
+}
+
+//Offset and length of tag among count table records, false if absent or past the file end
+static bool findTable(const uint8_t *records, int count, uint32_t tag, size_t fileSize,
+                      uint32_t *offset, uint32_t *length){
+    for(int i = 0; i < count; i++){
+        const uint8_t *record = records + i * 16;
+        if(be32(record) != tag) continue;
+        *offset = be32(record + 8);
+        *length = be32(record + 12);
+        return *offset <= fileSize && *length <= fileSize - *offset;
+    }
+    return false;
+}
+
+//UTF-16BE of Windows and Unicode platform names to UTF-8
+static std::string decodeUtf16(const uint8_t *data, size_t length){
+    std::string text;
+    for(size_t i = 0; i + 1 < length; i += 2){
+        uint32_t c = be16(data + i);
+        if(c >= 0xD800 && c <= 0xDBFF && i + 3 < length){
+            uint32_t low = be16(data + i + 2);
+            if(low >= 0xDC00 && low <= 0xDFFF){
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        if(c < 0x80){
+            text += (char) c;
+        }else if(c < 0x800){
+            text += (char) (0xC0 | (c >> 6));
+            text += (char) (0x80 | (c & 0x3F));
+        }else if(c < 0x10000){
+            text += (char) (0xE0 | (c >> 12));
+            text += (char) (0x80 | ((c >> 6) & 0x3F));
+            text += (char) (0x80 | (c & 0x3F));
+        }else{
+            text += (char) (0xF0 | (c >> 18));
+            text += (char) (0x80 | ((c >> 12) & 0x3F));
+            text += (char) (0x80 | ((c >> 6) & 0x3F));
+            text += (char) (0x80 | (c & 0x3F));
+        }
+    }
+    return text;
+}
+
+//Name nameId of the name table, English Windows names first, then any Windows, then Mac Roman
+static std::string findName(const std::vector<uint8_t> &table, int nameId){
+    if(table.size() < 6) return std::string();
+    int count = be16(&table[2]);
+    size_t storage = be16(&table[4]);
+    if(6 + (size_t) count * 12 > table.size()) return std::string();
+
+    int bestRank = 0;
+    const uint8_t *best = NULL;
+    for(int i = 0; i < count; i++){
+        const uint8_t *record = &table[6 + i * 12];
+        if(be16(record + 6) != nameId) continue;
+        int platform = be16(record);
+        int encoding = be16(record + 2);
+        int language = be16(record + 4);
+        int rank = 0;
+        if(platform == 3 && (encoding == 1 || encoding == 10)) rank = (language == 0x409)? 4 : 3;
+        else if(platform == 0) rank = 2;
+        else if(platform == 1 && encoding == 0) rank = 1;
+        if(rank > bestRank){
+            bestRank = rank;
+            best = record;
+        }
+    }
+    if(best == NULL) return std::string();
+
+    size_t length = be16(best + 8);
+    size_t offset = storage + be16(best + 10);
+    if(offset > table.size() || length > table.size() - offset) return std::string();
+    if(be16(best) == 1) return std::string((const char*) &table[offset], length);
+    return decodeUtf16(&table[offset], length);
+}
+
+//Face with its table directory at dirOffset, false if it is not a TrueType or CFF font
+static bool readFace(int fd, const std::string &path, uint32_t dirOffset, size_t fileSize, FontFace *face){
+    uint8_t header[12];
+    if(!readAt(fd, dirOffset, header, sizeof(header))) return false;
+    uint32_t version = be32(header);
+    if(version != 0x00010000 && version != FONT_TAG('O', 'T', 'T', 'O')
+       && version != FONT_TAG('t', 'r', 'u', 'e')){
+        return false;
+    }
+    int count = be16(header + 4);
+    if(count == 0 || count > FONT_MAX_TABLES) return false;
+    std::vector<uint8_t> records((size_t) count * 16);
+    if(!readAt(fd, dirOffset + 12, &records[0], records.size())) return false;
+
+    uint32_t offset, length;
+    if(!findTable(&records[0], count, TAG_NAME, fileSize, &offset, &length)
+       || length > FONT_MAX_NAME_TABLE){
+        return false;
+    }
+    std::vector<uint8_t> names(length);
+    if(length == 0 || !readAt(fd, offset, &names[0], length)) return false;
+
+    //Typographic family groups weights that older family names split, "Roboto" over "Roboto Light"
+    face->family = findName(names, 16);
+    if(face->family.empty()) face->family = findName(names, 1);
+    if(face->family.empty()) return false;
+    face->familyKey = foldFontName(face->family.c_str(), face->family.size());
+    std::string postScript = findName(names, 6);
+    face->postScriptKey = foldFontName(postScript.c_str(), postScript.size());
+    face->path = path;
+    face->faceOffset = dirOffset;
+    face->weight = FXFONT_FW_NORMAL;
+    face->flags = 0;
+    face->charsets = fontCharsetBit(FXFONT_ANSI_CHARSET);
+
+    int familyClass = 0;
+    uint8_t os2[86];
+    if(findTable(&records[0], count, TAG_OS2, fileSize, &offset, &length) && length >= 64
+       && readAt(fd, offset, os2, (length < sizeof(os2))? length : sizeof(os2))){
+        uint16_t weight = be16(os2 + 4);
+        if(weight >= 100 && weight <= 1000) face->weight = weight;
+        familyClass = os2[30];
+        if(familyClass >= 1 && familyClass <= 7) face->flags |= FONT_FACE_SERIF;
+        if(familyClass == 10) face->flags |= FONT_FACE_SCRIPT;
+        if(be16(os2 + 62) & 1) face->flags |= FONT_FACE_ITALIC;
+
+        //Code page ranges came with table version 1, version 0 fonts are taken as Latin
+        if(be16(os2) >= 1 && length >= 86){
+            uint32_t codePages = be32(os2 + 78);
+            uint32_t charsets = 0;
+            if(codePages & CODEPAGE_LATIN1) charsets |= fontCharsetBit(FXFONT_ANSI_CHARSET);
+            if(codePages & CODEPAGE_SYMBOL) charsets |= fontCharsetBit(FXFONT_SYMBOL_CHARSET);
+            if(codePages & CODEPAGE_JIS) charsets |= fontCharsetBit(FXFONT_SHIFTJIS_CHARSET);
+            if(codePages & (CODEPAGE_WANSUNG | CODEPAGE_JOHAB)) charsets |= fontCharsetBit(FXFONT_HANGEUL_CHARSET);
+            if(codePages & CODEPAGE_GB2312) charsets |= fontCharsetBit(FXFONT_GB2312_CHARSET);
+            if(codePages & CODEPAGE_BIG5) charsets |= fontCharsetBit(FXFONT_CHINESEBIG5_CHARSET);
+            if(charsets != 0) face->charsets = charsets;
+        }
+    }
+    if(familyClass == 0 && strstr(face->familyKey.c_str(), "serif") != NULL
+       && strstr(face->familyKey.c_str(), "sans") == NULL){
+        face->flags |= FONT_FACE_SERIF;
+    }
+
+    uint8_t post[16];
+    if(findTable(&records[0], count, TAG_POST, fileSize, &offset, &length) && length >= sizeof(post)
+       && readAt(fd, offset, post, sizeof(post)) && be32(post + 12) != 0){
+        face->flags |= FONT_FACE_FIXED;
+    }
+    return true;
+}
+
+static void scanFontFile(const std::string &path, std::vector<FontFace> *faces){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return;
+    struct stat state;
+    uint8_t header[12];
+    if(fstat(fd, &state) != 0 || !readAt(fd, 0, header, sizeof(header))){
+        close(fd);
+        return;
+    }
+
+    size_t fileSize = (size_t) state.st_size;
+    FontFace face;
+    if(be32(header) == TAG_TTCF){
+        uint32_t count = be32(header + 8);
+        if(count > FONT_MAX_COLLECTION) count = FONT_MAX_COLLECTION;
+        std::vector<uint8_t> offsets(count * 4);
+        if(count > 0 && readAt(fd, 12, &offsets[0], offsets.size())){
+            for(uint32_t i = 0; i < count; i++){
+                if(readFace(fd, path, be32(&offsets[i * 4]), fileSize, &face)) faces->push_back(face);
+            }
+        }
+    }else if(readFace(fd, path, 0, fileSize, &face)){
+        faces->push_back(face);
+    }
+    close(fd);
+}
+
+void scanFontDirectories(const std::vector<std::string> &directories, std::vector<FontFace> *faces){
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < directories.size(); i++) listFontFiles(directories[i], &paths);
+    faces->clear();
+    for(size_t i = 0; i < paths.size(); i++) scanFontFile(paths[i], faces);
+}
+
+//Payload: little endian fields back to back, strings prefixed by their length
+class FontIndexWriter {
+public:
+    std::vector<uint8_t> data;
+
+    void put(const void *value, size_t size){
+        const uint8_t *bytes = (const uint8_t*) value;
+        data.insert(data.end(), bytes, bytes + size);
+    }
+    void putInt(int32_t value){ put(&value, sizeof(value)); }
+    void putString(const std::string &value){
+        putInt((int32_t) value.size());
+        put(value.data(), value.size());
+    }
+};
+
+class FontIndexReader {
+public:
+    FontIndexReader(const uint8_t *data, size_t size) : mData(data), mSize(size), mPos(0), mFailed(false) {}
+
+    bool failed() const { return mFailed || mPos != mSize; }
+
+    bool get(void *value, size_t size){
+        if(mFailed || size > mSize - mPos){
+            mFailed = true;
+            return false;
+        }
+        memcpy(value, mData + mPos, size);
+        mPos += size;
+        return true;
+    }
+    int32_t getInt(){
+        int32_t value = 0;
+        get(&value, sizeof(value));
+        return value;
+    }
+    std::string getString(){
+        int32_t length = getInt();
+        if(length < 0 || (size_t) length > mSize - mPos){
+            mFailed = true;
+            return std::string();
+        }
+        std::string value((const char*) mData + mPos, (size_t) length);
+        mPos += length;
+        return value;
+    }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    size_t mPos;
+    bool mFailed;
+};
+
+bool writeFontIndex(const std::string &path, uint64_t stamp, const std::vector<FontFace> &faces){
+    FontIndexWriter writer;
+    writer.putInt((int32_t) faces.size());
+    for(size_t i = 0; i < faces.size(); i++){
+        const FontFace &face = faces[i];
+        writer.putString(face.family);
+        writer.putString(face.familyKey);
+        writer.putString(face.postScriptKey);
+        writer.putString(face.path);
+        writer.putInt((int32_t) face.faceOffset);
+        writer.putInt(face.weight);
+        writer.putInt((int32_t) face.flags);
+        writer.putInt((int32_t) face.charsets);
+    }
+
+    FontIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FONT_INDEX_MAGIC;
+    header.version = FONT_INDEX_VERSION;
+    header.stamp = stamp;
+    header.payloadSize = (uint32_t) writer.data.size();
+    header.payloadHash = (uint32_t) fnv1a64(14695981039346656037ull, &writer.data[0], writer.data.size());
+
+    std::string temporary = path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        LOGE("Cannot write font index %s: %s", temporary.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)
+              && write(fd, &writer.data[0], writer.data.size()) == (ssize_t) writer.data.size();
+    ok = (close(fd) == 0) && ok;
+    if(!ok || rename(temporary.c_str(), path.c_str()) != 0){
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readFontIndex(const std::string &path, uint64_t stamp, std::vector<FontFace> *faces){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    FontIndexHeader header;
+    std::vector<uint8_t> payload;
+    bool ok = read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)
+              && header.magic == FONT_INDEX_MAGIC && header.version == FONT_INDEX_VERSION
+              && header.stamp == stamp;
+    //A corrupt header must not size the allocation, the payload is the rest of the file
+    struct stat state;
+    ok = ok && fstat(fd, &state) == 0
+         && (uint64_t) state.st_size == (uint64_t) sizeof(header) + header.payloadSize;
+    if(ok){
+        payload.resize(header.payloadSize);
+        ok = header.payloadSize > 0
+             && read(fd, &payload[0], payload.size()) == (ssize_t) payload.size()
+             && (uint32_t) fnv1a64(14695981039346656037ull, &payload[0], payload.size()) == header.payloadHash;
+    }
+    close(fd);
+    if(!ok) return false;
+
+    FontIndexReader reader(&payload[0], payload.size());
+    int32_t count = reader.getInt();
+    if(count < 0 || (size_t) count > payload.size()) return false;
+    faces->resize(count);
+    for(int32_t i = 0; i < count; i++){
+        FontFace &face = (*faces)[i];
+        face.family = reader.getString();
+        face.familyKey = reader.getString();
+        face.postScriptKey = reader.getString();
+        face.path = reader.getString();
+        face.faceOffset = (uint32_t) reader.getInt();
+        face.weight = reader.getInt();
+        face.flags = (uint32_t) reader.getInt();
+        face.charsets = (uint32_t) reader.getInt();
+    }
+    if(reader.failed()){
+        faces->clear();
+        return false;
+    }
+    return true;
+}
+
+FontProvider& FontProvider::instance(){
+    static FontProvider provider;
+    return provider;
+}
+
+FontProvider* FontProvider::of(FPDF_SYSFONTINFO *info){
+    return reinterpret_cast<Info*>(info)->self;
+}
+
+FontProvider::FontProvider() : mLoaded(false) {
+    memset(&mInfo, 0, sizeof(mInfo));
+    mInfo.self = this;
+    FPDF_SYSFONTINFO &info = mInfo.base;
+    info.version = 1;
+    info.Release = release;
+    info.EnumFonts = enumFonts;
+    info.MapFont = mapFont;
+    info.GetFont = getFont;
+    info.GetFontData = getFontData;
+    info.GetFaceName = getFaceName;
+    info.GetFontCharset = getFontCharset;
+    info.DeleteFont = deleteFont;
+}
+
+int FontProvider::load(const std::string &indexPath, const std::vector<std::string> &directories){
+    Mutex::Autolock lock(mLock);
+    if(mLoaded) return (int) mFaces.size();
+
+    uint64_t stamp = fontDirectoriesStamp(directories);
+    if(indexPath.empty() || !readFontIndex(indexPath, stamp, &mFaces)){
+        scanFontDirectories(directories, &mFaces);
+        if(!indexPath.empty()) writeFontIndex(indexPath, stamp, mFaces);
+        LOGD("Font index built, %d faces", (int) mFaces.size());
+    }
+    mLoaded = true;
+    return (int) mFaces.size();
+}
+
+void FontProvider::install(){
+    {
+        Mutex::Autolock lock(mLock);
+        if(!mLoaded || mFaces.empty()) return;
+    }
+    //PDFium wraps the struct and calls Release when the library goes, the provider stays
+    FPDF_SetSystemFontInfo(&mInfo.base);
+}
+
+const FontFace* FontProvider::match(int weight, bool italic, int charset, int pitchFamily,
+                                    const char *name, bool *exact) const {
+    //Subset tag of an embedded font name, "ABCDEF+Arial,Bold"
+    size_t length = (name != NULL)? strlen(name) : 0;
+    if(length > 7 && name[6] == '+'){
+        bool tagged = true;
+        for(int i = 0; i < 6; i++) tagged = tagged && name[i] >= 'A' && name[i] <= 'Z';
+        if(tagged){
+            name += 7;
+            length -= 7;
+        }
+    }
+    //Full name against PostScript names, the part before a style suffix against families
+    std::string fullKey = foldFontName(name, length);
+    size_t familyLength = 0;
+    while(familyLength < length && name[familyLength] != ',' && name[familyLength] != '-') familyLength++;
+    std::string familyKey = foldFontName(name, familyLength);
+    if(familyKey.size() > 4 && familyKey.compare(familyKey.size() - 2, 2, "mt") == 0){
+        familyKey.erase(familyKey.size() - 2);
+        if(familyKey.size() > 4 && familyKey.compare(familyKey.size() - 2, 2, "ps") == 0){
+            familyKey.erase(familyKey.size() - 2);
+        }
+    }
+
+    bool cjk = isCjkCharset(charset);
+    uint32_t charsetBit = fontCharsetBit(charset);
+    const FontFace *best = NULL;
+    int bestScore = 0;
+    *exact = false;
+    for(size_t i = 0; i < mFaces.size(); i++){
+        const FontFace &face = mFaces[i];
+        int score = 0;
+        if(!fullKey.empty() && face.postScriptKey == fullKey) score += 2000;
+        else if(!familyKey.empty() && face.familyKey == familyKey) score += 1000;
+        else if(familyKey.size() >= 4 && face.familyKey.compare(0, familyKey.size(), familyKey) == 0) score += 400;
+        else if(!cjk) continue;
+
+        if(charsetBit != 0){
+            if(face.charsets & charsetBit) score += 200;
+            else if(cjk || charset == FXFONT_SYMBOL_CHARSET) continue;
+        }
+        bool fixed = (face.flags & FONT_FACE_FIXED) != 0;
+        if(pitchFamily & FXFONT_FF_FIXEDPITCH) score += fixed ? 100 : 0;
+        else if(fixed) score -= 100;
+        if(((pitchFamily & FXFONT_FF_ROMAN) != 0) == ((face.flags & FONT_FACE_SERIF) != 0)) score += 50;
+        if(((pitchFamily & FXFONT_FF_SCRIPT) != 0) == ((face.flags & FONT_FACE_SCRIPT) != 0)) score += 50;
+        if(italic == ((face.flags & FONT_FACE_ITALIC) != 0)) score += 30;
+        int weightDistance = face.weight - weight;
+        score -= ((weightDistance < 0)? -weightDistance : weightDistance) / 10;
+
+        if(best == NULL || score > bestScore){
+            best = &face;
+            bestScore = score;
+        }
+    }
+    *exact = best != NULL && bestScore >= 1000;
+    return best;
+}
+
+FontProvider::Handle* FontProvider::openFace(const FontFace *face, int charset){
+    int fd = open(face->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        LOGE("Cannot open font %s: %s", face->path.c_str(), strerror(errno));
+        return NULL;
+    }
+    struct stat state;
+    //A font replaced since the index was read
+    if(fstat(fd, &state) != 0 || (uint64_t) state.st_size < (uint64_t) face->faceOffset + 12){
+        close(fd);
+        return NULL;
+    }
+
+    Handle *handle = new Handle;
+    handle->face = face;
+    handle->fd = fd;
+    handle->size = (size_t) state.st_size;
+    handle->charset = charset;
+    return handle;
+}
+
+void FontProvider::release(FPDF_SYSFONTINFO * /*info*/){
+}
+
+void FontProvider::enumFonts(FPDF_SYSFONTINFO *info, void *mapper){
+    const std::vector<FontFace> &faces = of(info)->mFaces;
+    for(size_t i = 0; i < faces.size(); i++){
+        for(int c = 0; c < TRACKED_CHARSET_COUNT; c++){
+            if(faces[i].charsets & (1u << c)){
+                FPDF_AddInstalledFont(mapper, faces[i].family.c_str(), kTrackedCharsets[c]);
+            }
+        }
+    }
+}
+
+void* FontProvider::mapFont(FPDF_SYSFONTINFO *info, int weight, FPDF_BOOL italic, int charset,
+                            int pitchFamily, const char *face, FPDF_BOOL *exact){
+    FontProvider *self = of(info);
+    bool matchedExactly;
+    const FontFace *found = self->match(weight, italic != 0, charset, pitchFamily, face, &matchedExactly);
+    if(exact != NULL) *exact = matchedExactly;
+    return (found != NULL)? self->openFace(found, charset) : NULL;
+}
+
+void* FontProvider::getFont(FPDF_SYSFONTINFO *info, const char *face){
+    FontProvider *self = of(info);
+    bool matchedExactly;
+    const FontFace *found = self->match(FXFONT_FW_NORMAL, false, FXFONT_DEFAULT_CHARSET, 0,
+                                        face, &matchedExactly);
+    return (found != NULL && matchedExactly)? self->openFace(found, FXFONT_DEFAULT_CHARSET) : NULL;
+}
+
+unsigned long FontProvider::getFontData(FPDF_SYSFONTINFO * /*info*/, void *font, unsigned int table,
+                                        unsigned char *buffer, unsigned long bufferSize){
+    Handle *handle = static_cast<Handle*>(font);
+    size_t size = handle->size;
+    uint32_t faceOffset = handle->face->faceOffset;
+
+    uint32_t start;
+    size_t length;
+    if(table == 0){
+        //PDFium loads a collection through 'ttcf' and takes the face as the one at
+        //the 'ttcf' size minus this size, which is the collection from the face on
+        start = faceOffset;
+        length = size - faceOffset;
+    }else if(table == TAG_TTCF){
+        if(faceOffset == 0) return 0;
+        start = 0;
+        length = size;
+    }else{
+        //PDFium asks for the size first, then again with the buffer; the directory is small
+        uint8_t header[12];
+        if(!readAt(handle->fd, faceOffset, header, sizeof(header))) return 0;
+        int count = be16(header + 4);
+        if(count > FONT_MAX_TABLES || (size - faceOffset - 12) / 16 < (size_t) count) return 0;
+        uint8_t records[FONT_MAX_TABLES * 16];
+        if(count == 0 || !readAt(handle->fd, faceOffset + 12, records, (size_t) count * 16)) return 0;
+        uint32_t tableLength;
+        if(!findTable(records, count, table, size, &start, &tableLength)) return 0;
+        length = tableLength;
+    }
+
+    if(buffer == NULL || bufferSize < length) return (unsigned long) length;
+    if(length > 0 && !readAt(handle->fd, start, buffer, length)) return 0;
+    return (unsigned long) length;
+}
+
+unsigned long FontProvider::getFaceName(FPDF_SYSFONTINFO * /*info*/, void *font,
+                                        char *buffer, unsigned long bufferSize){
+    const std::string &family = static_cast<Handle*>(font)->face->family;
+    if(buffer == NULL || bufferSize < family.size()) return (unsigned long) family.size();
+    memcpy(buffer, family.data(), family.size());
+    if(bufferSize > family.size()) buffer[family.size()] = '\0';
+    return (unsigned long) family.size();
+}
+
+int FontProvider::getFontCharset(FPDF_SYSFONTINFO * /*info*/, void *font){
+    Handle *handle = static_cast<Handle*>(font);
+    uint32_t charsets = handle->face->charsets;
+    if(charsets & fontCharsetBit(handle->charset)) return handle->charset;
+    for(int c = 0; c < TRACKED_CHARSET_COUNT; c++){
+        if(charsets & (1u << c)) return kTrackedCharsets[c];
+    }
+    return FXFONT_ANSI_CHARSET;
+}
+
+void FontProvider::deleteFont(FPDF_SYSFONTINFO * /*info*/, void *font){
+    Handle *handle = static_cast<Handle*>(font);
+    close(handle->fd);
+    delete handle;
+}
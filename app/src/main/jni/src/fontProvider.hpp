@@ -0,0 +1,125 @@
+#ifndef _FONT_PROVIDER_HPP_
+#define _FONT_PROVIDER_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_sysfontinfo.h>
+#include <utils/Mutex.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * System fonts for unembedded PDF fonts, in place of the PDFium default that
+ * opens and parses every file under the font directories the first time a
+ * document needs a substitute. Faces are read once into an index of family,
+ * PostScript name, weight, style and supported charsets, persisted in the
+ * cache directory and rebuilt only when a font directory changes (an OTA).
+ * MapFont picks a face from the index alone and opens only that file.
+ * PDFium copies the font data it asks for and deletes the handle right
+ * after, so GetFontData reads the tables with pread and nothing of the
+ * file is kept between faces.
+ *
+ * Matching follows the PDFium Linux font info: Latin and symbol requests
+ * need a name match and otherwise fall back to the PDFium built-in fonts,
+ * CJK requests take the closest face covering their charset.
+ */
+
+//FontFace::flags
+#define FONT_FACE_ITALIC 1
+#define FONT_FACE_FIXED 2
+#define FONT_FACE_SERIF 4
+#define FONT_FACE_SCRIPT 8
+
+struct FontFace {
+    std::string family;         //as in the name table
+    std::string familyKey;      //folded for matching, see foldFontName
+    std::string postScriptKey;
+    std::string path;
+    uint32_t faceOffset;        //table directory, non zero inside a collection
+    int32_t weight;             //OS/2 usWeightClass
+    uint32_t flags;             //FONT_FACE_*
+    uint32_t charsets;          //one bit per FXFONT_*_CHARSET, see fontCharsetBit
+};
+
+//Lower case letters and digits only: "Noto Sans CJK JP" and "NotoSansCJKjp" meet
+std::string foldFontName(const char *name, size_t length);
+
+//Bit of a FXFONT_*_CHARSET in FontFace::charsets, 0 if not tracked
+uint32_t fontCharsetBit(int charset);
+
+//Faces of the font files in directories, unreadable files are skipped
+void scanFontDirectories(const std::vector<std::string> &directories, std::vector<FontFace> *faces);
+
+//Changes when a font file in directories is added, removed or replaced
+uint64_t fontDirectoriesStamp(const std::vector<std::string> &directories);
+
+bool writeFontIndex(const std::string &path, uint64_t stamp, const std::vector<FontFace> &faces);
+//False if missing, built for another stamp or corrupt
+bool readFontIndex(const std::string &path, uint64_t stamp, std::vector<FontFace> *faces);
+
+class FontProvider {
+public:
+    static FontProvider& instance();
+
+    /*
+     * Read the index at indexPath, scanning directories and rewriting it when
+     * missing or stale. Once per process, later calls return the faces loaded
+     * by the first; safe without the PDFium lock. Returns the face count.
+     */
+    int load(const std::string &indexPath, const std::vector<std::string> &directories);
+
+    /*
+     * FPDF_SetSystemFontInfo with this provider once faces are loaded. Needed
+     * after every FPDF_InitLibrary, the caller holds the PDFium lock.
+     */
+    void install();
+
+private:
+    FontProvider();
+
+    //PDFium passes the struct itself to callbacks, the owner follows it
+    struct Info {
+        FPDF_SYSFONTINFO base;
+        FontProvider *self;
+    };
+
+    //Open from MapFont or GetFont until DeleteFont
+    struct Handle {
+        const FontFace *face;
+        int fd;
+        size_t size;            //of the whole file
+        int charset;
+    };
+
+    static FontProvider* of(FPDF_SYSFONTINFO *info);
+    static void release(FPDF_SYSFONTINFO *info);
+    static void enumFonts(FPDF_SYSFONTINFO *info, void *mapper);
+    static void* mapFont(FPDF_SYSFONTINFO *info, int weight, FPDF_BOOL italic, int charset,
+                         int pitchFamily, const char *face, FPDF_BOOL *exact);
+    static void* getFont(FPDF_SYSFONTINFO *info, const char *face);
+    static unsigned long getFontData(FPDF_SYSFONTINFO *info, void *font, unsigned int table,
+                                     unsigned char *buffer, unsigned long bufferSize);
+    static unsigned long getFaceName(FPDF_SYSFONTINFO *info, void *font,
+                                     char *buffer, unsigned long bufferSize);
+    static int getFontCharset(FPDF_SYSFONTINFO *info, void *font);
+    static void deleteFont(FPDF_SYSFONTINFO *info, void *font);
+
+    const FontFace* match(int weight, bool italic, int charset, int pitchFamily,
+                          const char *name, bool *exact) const;
+    static Handle* openFace(const FontFace *face, int charset);
+
+    android::Mutex mLock;
+    Info mInfo;
+    bool mLoaded;
+    std::vector<FontFace> mFaces;
+
+    FontProvider(const FontProvider&);
+    FontProvider& operator=(const FontProvider&);
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "util.hpp"
+#include "formFill.hpp"
+
+extern "C" {
+    #include <string.h>
+    #include <time.h>
+    #include <sys/time.h>
+}
+
+//Past this many separate regions a page repaints their bounding box
+#define MAX_DIRTY_RECTS 16
+
+FormFill* FormFill::of(FPDF_FORMFILLINFO *info){
+    return reinterpret_cast<Info*>(info)->self;
+}
+
+FormFill::FormFill(FPDF_DOCUMENT doc) : mHandle(NULL), mCurrentPage(NULL), mChanged(false) {
+    memset(&mInfo, 0, sizeof(mInfo));
+    mInfo.self = this;
+    FPDF_FORMFILLINFO &info = mInfo.base;
+    info.version = 1;
+    info.FFI_Invalidate = invalidate;
+    info.FFI_OutputSelectedRect = outputSelectedRect;
+    info.FFI_SetCursor = setCursor;
+    info.FFI_SetTimer = setTimer;
+    info.FFI_KillTimer = killTimer;
+    info.FFI_GetLocalTime = getLocalTime;
+    info.FFI_OnChange = onChange;
+    info.FFI_GetPage = getPage;
+    info.FFI_GetCurrentPage = getCurrentPage;
+    info.FFI_GetRotation = getRotation;
+    info.FFI_ExecuteNamedAction = executeNamedAction;
+    info.FFI_SetTextFieldFocus = setTextFieldFocus;
+    info.FFI_DoURIAction = doURIAction;
+    info.FFI_DoGoToAction = doGoToAction;
+    info.m_pJsPlatform = NULL;
+
+    mHandle = FPDFDOC_InitFormFillEnvironment(doc, &info);
+    if(mHandle == NULL){
+        LOGE("Form fill environment not created");
+    }
+}
+
+FormFill::~FormFill(){
+    if(mHandle != NULL){
+        FPDFDOC_ExitFormFillEnvironment(mHandle);
+    }
+}
+
+void FormFill::attachPage(FPDF_PAGE page, int pageIndex){
+    if(mHandle == NULL) return;
+    mPages[pageIndex] = page;
+    mPageIndexes[page] = pageIndex;
+    FORM_OnAfterLoadPage(page, mHandle);
+}
+
+void FormFill::detachPage(FPDF_PAGE page){
+    if(mHandle == NULL) return;
+    std::map<FPDF_PAGE, int>::iterator index = mPageIndexes.find(page);
+    if(index == mPageIndexes.end()) return;
+
+    FORM_OnBeforeClosePage(page, mHandle);
+    //A reload of the same page index may already have replaced the entry
+    std::map<int, FPDF_PAGE>::iterator current = mPages.find(index->second);
+    if(current != mPages.end() && current->second == page) mPages.erase(current);
+    mPageIndexes.erase(index);
+    mDirty.erase(page);
+    if(mCurrentPage == page) mCurrentPage = NULL;
+}
+
+void FormFill::takeDirtyRects(FPDF_PAGE page, std::vector<FS_RECTF> *out){
+    out->clear();
+    std::map<FPDF_PAGE, std::vector<FS_RECTF> >::iterator dirty = mDirty.find(page);
+    if(dirty == mDirty.end()) return;
+    out->swap(dirty->second);
+    mDirty.erase(dirty);
+}
+
+static bool rectsTouch(const FS_RECTF &a, const FS_RECTF &b){
+    return a.left <= b.right && b.left <= a.right && a.bottom <= b.top && b.bottom <= a.top;
+}
+
+static void unite(FS_RECTF *into, const FS_RECTF &rect){
+    if(rect.left < into->left) into->left = rect.left;
+    if(rect.right > into->right) into->right = rect.right;
+    if(rect.bottom < into->bottom) into->bottom = rect.bottom;
+    if(rect.top > into->top) into->top = rect.top;
+}
+
+void FormFill::addDirty(FPDF_PAGE page, const FS_RECTF &rect){
+    if(mPageIndexes.find(page) == mPageIndexes.end()) return;
+    mCurrentPage = page;
+
+    //Page coordinates grow upwards, a caret invalidates the same spot over and over
+    FS_RECTF merged = rect;
+    if(merged.left > merged.right){ float swap = merged.left; merged.left = merged.right; merged.right = swap; }
+    if(merged.bottom > merged.top){ float swap = merged.bottom; merged.bottom = merged.top; merged.top = swap; }
+
+    std::vector<FS_RECTF> &rects = mDirty[page];
+    for(size_t i = rects.size(); i-- > 0;){
+        if(rectsTouch(rects[i], merged)){
+            unite(&merged, rects[i]);
+            rects.erase(rects.begin() + i);
+        }
+    }
+    if(rects.size() >= MAX_DIRTY_RECTS){
+        for(size_t i = 0; i < rects.size(); i++) unite(&merged, rects[i]);
+        rects.clear();
+    }
+    rects.push_back(merged);
+}
+
+void FormFill::invalidate(FPDF_FORMFILLINFO *info, FPDF_PAGE page,
+                          double left, double top, double right, double bottom){
+    FS_RECTF rect;
+    rect.left = (float) left;
+    rect.top = (float) top;
+    rect.right = (float) right;
+    rect.bottom = (float) bottom;
+    of(info)->addDirty(page, rect);
+}
+
+void FormFill::outputSelectedRect(FPDF_FORMFILLINFO *info, FPDF_PAGE page,
+                                  double left, double top, double right, double bottom){
+    //Text selection is painted by FPDF_FFLDraw too
+    invalidate(info, page, left, top, right, bottom);
+}
+
+void FormFill::setCursor(FPDF_FORMFILLINFO *info, int cursorType){
+}
+
+int FormFill::setTimer(FPDF_FORMFILLINFO *info, int elapse, TimerCallback callback){
+    //No timers, the caret stays solid
+    return 0;
+}
+
+void FormFill::killTimer(FPDF_FORMFILLINFO *info, int timerId){
+}
+
+FPDF_SYSTEMTIME FormFill::getLocalTime(FPDF_FORMFILLINFO *info){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct tm local;
+    time_t seconds = now.tv_sec;
+    localtime_r(&seconds, &local);
+
+    //Fields as fpdf_formfill.h documents them, struct tm style
+    FPDF_SYSTEMTIME time;
+    time.wYear = (unsigned short) local.tm_year;
+    time.wMonth = (unsigned short) local.tm_mon;
+    time.wDayOfWeek = (unsigned short) local.tm_wday;
+    time.wDay = (unsigned short) local.tm_mday;
+    time.wHour = (unsigned short) local.tm_hour;
+    time.wMinute = (unsigned short) local.tm_min;
+    time.wSecond = (unsigned short) local.tm_sec;
+    time.wMilliseconds = (unsigned short) (now.tv_usec / 1000);
+    return time;
+}
+
+void FormFill::onChange(FPDF_FORMFILLINFO *info){
+    of(info)->mChanged = true;
+}
+
+FPDF_PAGE FormFill::getPage(FPDF_FORMFILLINFO *info, FPDF_DOCUMENT doc, int pageIndex){
+    //Only attached pages, loading one here would leave it unowned
+    std::map<int, FPDF_PAGE> &pages = of(info)->mPages;
+    std::map<int, FPDF_PAGE>::iterator page = pages.find(pageIndex);
+    return (page != pages.end())? page->second : NULL;
+}
+
+FPDF_PAGE FormFill::getCurrentPage(FPDF_FORMFILLINFO *info, FPDF_DOCUMENT doc){
+    return of(info)->mCurrentPage;
+}
+
+int FormFill::getRotation(FPDF_FORMFILLINFO *info, FPDF_PAGE page){
+    return 0;
+}
+
+void FormFill::executeNamedAction(FPDF_FORMFILLINFO *info, FPDF_BYTESTRING action){
+}
+
+void FormFill::setTextFieldFocus(FPDF_FORMFILLINFO *info, FPDF_WIDESTRING value,
+                                 FPDF_DWORD valueLength, FPDF_BOOL isFocus){
+}
+
+void FormFill::doURIAction(FPDF_FORMFILLINFO *info, FPDF_BYTESTRING uri){
+}
+
+void FormFill::doGoToAction(FPDF_FORMFILLINFO *info, int pageIndex, int zoomMode,
+                            float *pos, int posCount){
+}
+
+bool renderPageRegion(FPDF_PAGE page, FPDF_FORMHANDLE form, void *buffer, int stride,
+                      int canvasHorSize, int canvasVerSize,
+                      int startX, int startY, int drawSizeHor, int drawSizeVer,
+                      const FS_RECTF &pageRect, int flags, int deviceRect[4]){
+    int x1, y1, x2, y2;
+    FPDF_PageToDevice(page, startX, startY, drawSizeHor, drawSizeVer, 0,
+                      pageRect.left, pageRect.top, &x1, &y1);
+    FPDF_PageToDevice(page, startX, startY, drawSizeHor, drawSizeVer, 0,
+                      pageRect.right, pageRect.bottom, &x2, &y2);
+
+    //A pixel around for antialiased edges, then clip to the page on the canvas
+    int left = ((x1 < x2)? x1 : x2) - 1;
+    int top = ((y1 < y2)? y1 : y2) - 1;
+    int right = ((x1 < x2)? x2 : x1) + 2;
+    int bottom = ((y1 < y2)? y2 : y1) + 2;
+    if(left < startX) left = startX;
+    if(top < startY) top = startY;
+    if(right > startX + drawSizeHor) right = startX + drawSizeHor;
+    if(bottom > startY + drawSizeVer) bottom = startY + drawSizeVer;
+    if(left < 0) left = 0;
+    if(top < 0) top = 0;
+    if(right > canvasHorSize) right = canvasHorSize;
+    if(bottom > canvasVerSize) bottom = canvasVerSize;
+    if(left >= right || top >= bottom) return false;
+
+    //Bitmap over the region only, PDFium clips to it and leaves the rest untouched
+    char *origin = static_cast<char*>(buffer) + (size_t) top * stride + (size_t) left * 4;
+    FPDF_BITMAP region = FPDFBitmap_CreateEx(right - left, bottom - top, FPDFBitmap_BGRA,
+                                             origin, stride);
+    FPDFBitmap_FillRect(region, 0, 0, right - left, bottom - top, 0xFFFFFFFF); //White
+    FPDF_RenderPageBitmap(region, page, startX - left, startY - top,
+                          drawSizeHor, drawSizeVer, 0, flags);
+    if(form != NULL){
+        FPDF_FFLDraw(form, region, page, startX - left, startY - top,
+                     drawSizeHor, drawSizeVer, 0, flags);
+    }
+    FPDFBitmap_Destroy(region);
+
+    deviceRect[0] = left;
+    deviceRect[1] = top;
+    deviceRect[2] = right;
+    deviceRect[3] = bottom;
+    return true;
+}
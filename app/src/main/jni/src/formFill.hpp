@@ -0,0 +1,90 @@
+#ifndef _FORM_FILL_HPP_
+#define _FORM_FILL_HPP_
+
+#include <fpdfview.h>
+#include <fpdf_formfill.h>
+
+#include <map>
+#include <vector>
+
+/*
+ * Form-fill environment of one document. Form fields are drawn over the page
+ * with FPDF_FFLDraw and take touch and key input. Whatever PDFium repaints,
+ * a caret move or a typed character, arrives through FFI_Invalidate and is
+ * kept as dirty rects of the page, so only those regions are rendered again
+ * into the bitmap already showing the page.
+ *
+ * Every call, PDFium callbacks included, happens under the PDFium lock. No
+ * JavaScript platform is given, scripts and timers (caret blinking) are off.
+ */
+class FormFill {
+public:
+    explicit FormFill(FPDF_DOCUMENT doc);
+    ~FormFill();
+
+    FPDF_FORMHANDLE handle() const { return mHandle; }
+
+    //Pages must be attached after FPDF_LoadPage and detached before FPDF_ClosePage
+    void attachPage(FPDF_PAGE page, int pageIndex);
+    void detachPage(FPDF_PAGE page);
+
+    //Regions of page repainted by PDFium since the last call, in page coordinates
+    void takeDirtyRects(FPDF_PAGE page, std::vector<FS_RECTF> *out);
+
+    //A field value changed since the environment was created
+    bool changed() const { return mChanged; }
+
+private:
+    //PDFium passes the struct itself to callbacks, the owner follows it
+    struct Info {
+        FPDF_FORMFILLINFO base;
+        FormFill *self;
+    };
+
+    static FormFill* of(FPDF_FORMFILLINFO *info);
+    static void invalidate(FPDF_FORMFILLINFO *info, FPDF_PAGE page,
+                           double left, double top, double right, double bottom);
+    static void outputSelectedRect(FPDF_FORMFILLINFO *info, FPDF_PAGE page,
+                                   double left, double top, double right, double bottom);
+    static void setCursor(FPDF_FORMFILLINFO *info, int cursorType);
+    static int setTimer(FPDF_FORMFILLINFO *info, int elapse, TimerCallback callback);
+    static void killTimer(FPDF_FORMFILLINFO *info, int timerId);
+    static FPDF_SYSTEMTIME getLocalTime(FPDF_FORMFILLINFO *info);
+    static void onChange(FPDF_FORMFILLINFO *info);
+    static FPDF_PAGE getPage(FPDF_FORMFILLINFO *info, FPDF_DOCUMENT doc, int pageIndex);
+    static FPDF_PAGE getCurrentPage(FPDF_FORMFILLINFO *info, FPDF_DOCUMENT doc);
+    static int getRotation(FPDF_FORMFILLINFO *info, FPDF_PAGE page);
+    static void executeNamedAction(FPDF_FORMFILLINFO *info, FPDF_BYTESTRING action);
+    static void setTextFieldFocus(FPDF_FORMFILLINFO *info, FPDF_WIDESTRING value,
+                                  FPDF_DWORD valueLength, FPDF_BOOL isFocus);
+    static void doURIAction(FPDF_FORMFILLINFO *info, FPDF_BYTESTRING uri);
+    static void doGoToAction(FPDF_FORMFILLINFO *info, int pageIndex, int zoomMode,
+                             float *pos, int posCount);
+
+    void addDirty(FPDF_PAGE page, const FS_RECTF &rect);
+
+    Info mInfo;
+    FPDF_FORMHANDLE mHandle;
+    std::map<int, FPDF_PAGE> mPages;
+    std::map<FPDF_PAGE, int> mPageIndexes;
+    std::map<FPDF_PAGE, std::vector<FS_RECTF> > mDirty;
+    FPDF_PAGE mCurrentPage;     //last page that had input or an invalidate
+    bool mChanged;
+
+    FormFill(const FormFill&);
+    FormFill& operator=(const FormFill&);
+};
+
+/*
+ * Render the part of a page inside pageRect again into a buffer that already
+ * holds the page drawn at startX, startY with drawSizeHor x drawSizeVer, as
+ * renderPageToBuffer does. Fields are drawn on top when form is set. Only
+ * BGRA buffers, 4 bytes per pixel. deviceRect gets left, top, right, bottom
+ * of the pixels written; returns false when the rect is off the canvas.
+ */
+bool renderPageRegion(FPDF_PAGE page, FPDF_FORMHANDLE form, void *buffer, int stride,
+                      int canvasHorSize, int canvasVerSize,
+                      int startX, int startY, int drawSizeHor, int drawSizeVer,
+                      const FS_RECTF &pageRect, int flags, int deviceRect[4]);
+
+#endif
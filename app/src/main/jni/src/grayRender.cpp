@@ -0,0 +1,149 @@
+#include "util.hpp"
+#include "grayRender.hpp"
+#include "pdfCore.hpp"
+#include "scratchArena.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define GRAY_RENDER_NEON 1
+#endif
+
+//Bayer 8x8 index matrix; a pixel is black below index * 4 + 2, spread evenly over 0..255
+static const uint8_t kBayer8[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+size_t grayOutputRowBytes(int output, int width){
+    return (output == GRAY_OUTPUT_8BIT)? (size_t) width : ((size_t) width + 7) / 8;
+}
+
+void ditherOrdered(const uint8_t *gray, int grayStride, int width, int height,
+                   uint8_t *out, int outStride){
+    size_t rowBytes = ((size_t) width + 7) / 8;
+    for(int y = 0; y < height; y++){
+        const uint8_t *row = gray + (size_t) y * grayStride;
+        uint8_t *outRow = out + (size_t) y * outStride;
+        //Output bytes start on multiples of 8 pixels, so pixel i of a byte meets column i
+        uint8_t thresholds[16];
+        for(int i = 0; i < 16; i++) thresholds[i] = (uint8_t) (kBayer8[y & 7][i & 7] * 4 + 2);
+
+        int x = 0;
+#ifdef GRAY_RENDER_NEON
+        static const uint8_t kBitWeights[16] = { 128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1 };
+        uint8x16_t threshold = vld1q_u8(thresholds);
+        uint8x16_t weights = vld1q_u8(kBitWeights);
+        for(; x + 16 <= width; x += 16){
+            //Black lanes keep their bit weight, three pairwise adds fold each half into a byte
+            uint8x16_t bits = vandq_u8(vcltq_u8(vld1q_u8(row + x), threshold), weights);
+            uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+            sum = vpadd_u8(sum, sum);
+            sum = vpadd_u8(sum, sum);
+            outRow[x / 8] = vget_lane_u8(sum, 0);
+            outRow[x / 8 + 1] = vget_lane_u8(sum, 1);
+        }
+#endif
+        for(; x < width; x += 8){
+            uint8_t bits = 0;
+            int count = (width - x < 8)? width - x : 8;
+            for(int i = 0; i < count; i++){
+                if(row[x + i] < thresholds[i]) bits |= (uint8_t) (0x80 >> i);
+            }
+            outRow[x / 8] = bits;
+        }
+        //The buffer may end with the last row
+        if(y < height - 1 && rowBytes < (size_t) outStride) memset(outRow + rowBytes, 0, outStride - rowBytes);
+    }
+}
+
+bool ditherDiffusion(const uint8_t *gray, int grayStride, int width, int height,
+                     uint8_t *out, int outStride){
+    ScratchScope scope;
+    //Errors in sixteenths for this row and the next, a guard cell on each side
+    size_t cells = (size_t) width + 2;
+    int *errors = ScratchArena::current().alloc<int>(cells * 2);
+    if(errors == NULL) return false;
+    memset(errors, 0, cells * 2 * sizeof(int));
+    int *current = errors + 1;
+    int *next = errors + cells + 1;
+
+    size_t rowBytes = ((size_t) width + 7) / 8;
+    for(int y = 0; y < height; y++){
+        const uint8_t *row = gray + (size_t) y * grayStride;
+        uint8_t *outRow = out + (size_t) y * outStride;
+        //The buffer may end with the last row
+        memset(outRow, 0, (y < height - 1)? (size_t) outStride : rowBytes);
+
+        //Serpentine, so errors do not drift to one side in worms
+        int step = (y & 1)? -1 : 1;
+        int x = (y & 1)? width - 1 : 0;
+        for(int n = 0; n < width; n++, x += step){
+            int value = row[x] + current[x] / 16;
+            int error;
+            if(value < 128){
+                outRow[x >> 3] |= (uint8_t) (0x80 >> (x & 7));
+                error = value;
+            }else{
+                error = value - 255;
+            }
+            current[x + step] += error * 7;
+            next[x - step] += error * 3;
+            next[x] += error * 5;
+            next[x + step] += error;
+        }
+
+        int *swap = current;
+        current = next;
+        next = swap;
+        memset(next - 1, 0, cells * sizeof(int));
+    }
+    return true;
+}
+
+bool renderPageGray(FPDF_PAGE page, FPDF_FORMHANDLE form, int output, void *buffer, int stride,
+                    int canvasHorSize, int canvasVerSize,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer, int flags){
+    if(output < 0 || output >= GRAY_OUTPUT_COUNT || canvasHorSize <= 0 || canvasVerSize <= 0
+       || stride < 0 || (size_t) stride < grayOutputRowBytes(output, canvasHorSize)){
+        return false;
+    }
+    flags |= FPDF_GRAYSCALE;
+
+    if(output == GRAY_OUTPUT_8BIT){
+        renderPageToBuffer(page, buffer, FPDFBitmap_Gray, stride, canvasHorSize, canvasVerSize,
+                           startX, startY, drawSizeHor, drawSizeVer, flags, form);
+        return true;
+    }
+
+    //Gray rows padded to whole vectors for the ditherer
+    ScratchScope scope;
+    int grayStride = (canvasHorSize + 15) & ~15;
+    uint8_t *gray = static_cast<uint8_t*>(ScratchArena::current().alloc((size_t) grayStride * canvasVerSize, 16));
+    if(gray == NULL){
+        LOGE("No memory for a %dx%d gray canvas", canvasHorSize, canvasVerSize);
+        return false;
+    }
+    renderPageToBuffer(page, gray, FPDFBitmap_Gray, grayStride, canvasHorSize, canvasVerSize,
+                       startX, startY, drawSizeHor, drawSizeVer, flags, form);
+
+    uint8_t *out = static_cast<uint8_t*>(buffer);
+    if(output == GRAY_OUTPUT_MONO_ORDERED){
+        ditherOrdered(gray, grayStride, canvasHorSize, canvasVerSize, out, stride);
+        return true;
+    }
+    if(!ditherDiffusion(gray, grayStride, canvasHorSize, canvasVerSize, out, stride)){
+        LOGE("No memory for diffusion errors");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef _GRAY_RENDER_HPP_
+#define _GRAY_RENDER_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_formfill.h>
+
+/*
+ * Output for e-ink panels, which show gray levels or black and white only.
+ * PDFium renders with FPDF_GRAYSCALE straight into an 8 bit gray bitmap, a
+ * quarter of the BGRA pixels and no colour conversion afterwards. 1 bit
+ * output dithers that gray into the caller buffer: ordered (Bayer 8x8),
+ * which is stable between page turns and vectorized with NEON, or
+ * Floyd-Steinberg error diffusion, better for photos.
+ *
+ * 1 bit rows are packed as in PBM: leftmost pixel in the most significant
+ * bit, set bits black, padding bits of the last byte clear. Bytes between
+ * rows are cleared, the last row is written only up to its own bytes.
+ */
+
+enum GrayOutput {
+    GRAY_OUTPUT_8BIT = 0,
+    GRAY_OUTPUT_MONO_ORDERED,
+    GRAY_OUTPUT_MONO_DIFFUSION,
+    GRAY_OUTPUT_COUNT
+};
+
+//Bytes per row of width pixels in output
+size_t grayOutputRowBytes(int output, int width);
+
+/*
+ * Render like renderPageToBuffer into buffer of canvasHorSize x canvasVerSize
+ * pixels in output format; 1 bit outputs take a scratch gray copy of the
+ * canvas. False if stride is too small for the output or the scratch copy
+ * cannot be allocated.
+ */
+bool renderPageGray(FPDF_PAGE page, FPDF_FORMHANDLE form, int output, void *buffer, int stride,
+                    int canvasHorSize, int canvasVerSize,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer, int flags);
+
+void ditherOrdered(const uint8_t *gray, int grayStride, int width, int height,
+                   uint8_t *out, int outStride);
+//False if the error rows cannot be allocated
+bool ditherDiffusion(const uint8_t *gray, int grayStride, int width, int height,
+                     uint8_t *out, int outStride);
+
+#endif
@@ -0,0 +1,117 @@
+#include "util.hpp"
+#include "handleTable.hpp"
+
+using namespace android;
+
+//Low half is slot + 1 so no handle is 0, high half the slot generation
+static int64_t makeHandle(int32_t index, uint32_t generation){
+    return (int64_t) (((uint64_t) generation << 32) | (uint32_t) (index + 1));
+}
+
+HandleTable& HandleTable::instance(){
+    static HandleTable table;
+    return table;
+}
+
+HandleTable::HandleTable() : mFreeHead(-1) {
+}
+
+int64_t HandleTable::add(int kind, void *object, const void *owner){
+    Mutex::Autolock lock(mLock);
+    int32_t index;
+    if(mFreeHead >= 0){
+        index = mFreeHead;
+        mFreeHead = mSlots[index].nextFree;
+    }else{
+        index = (int32_t) mSlots.size();
+        Slot slot;
+        slot.generation = 1;
+        mSlots.push_back(slot);
+    }
+
+    Slot &slot = mSlots[index];
+    slot.object = object;
+    slot.owner = owner;
+    slot.kind = kind;
+    slot.nextFree = -1;
+    slot.prevOwned = -1;
+
+    std::map<const void*, int32_t>::iterator head = mOwned.find(owner);
+    if(head != mOwned.end()){
+        slot.nextOwned = head->second;
+        mSlots[head->second].prevOwned = index;
+        head->second = index;
+    }else{
+        slot.nextOwned = -1;
+        mOwned[owner] = index;
+    }
+    return makeHandle(index, slot.generation);
+}
+
+int32_t HandleTable::slotOf(int64_t handle, int kind) const {
+    int32_t index = (int32_t) (uint32_t) (handle & 0xFFFFFFFF) - 1;
+    if(index < 0 || index >= (int32_t) mSlots.size()) return -1;
+    const Slot &slot = mSlots[index];
+    if(slot.kind != kind || slot.generation != (uint32_t) ((uint64_t) handle >> 32)) return -1;
+    return index;
+}
+
+void* HandleTable::get(int64_t handle, int kind){
+    Mutex::Autolock lock(mLock);
+    int32_t index = slotOf(handle, kind);
+    return (index >= 0)? mSlots[index].object : NULL;
+}
+
+void HandleTable::releaseLocked(int32_t index){
+    Slot &slot = mSlots[index];
+    if(slot.prevOwned >= 0){
+        mSlots[slot.prevOwned].nextOwned = slot.nextOwned;
+    }else if(slot.nextOwned >= 0){
+        mOwned[slot.owner] = slot.nextOwned;
+    }else{
+        mOwned.erase(slot.owner);
+    }
+    if(slot.nextOwned >= 0) mSlots[slot.nextOwned].prevOwned = slot.prevOwned;
+
+    //New generation makes every copy of the old handle stale
+    slot.generation++;
+    if(slot.generation == 0) slot.generation = 1;
+    slot.kind = 0;
+    slot.object = NULL;
+    slot.owner = NULL;
+    slot.nextFree = mFreeHead;
+    mFreeHead = index;
+}
+
+bool HandleTable::close(int64_t handle, int kind, HandleCloser closer){
+    void *object;
+    {
+        Mutex::Autolock lock(mLock);
+        int32_t index = slotOf(handle, kind);
+        if(index < 0) return false;
+        object = mSlots[index].object;
+        releaseLocked(index);
+    }
+    //Closers call back into the table, run them without the lock
+    closeOwned(object, closer);
+    closer(kind, object);
+    return true;
+}
+
+void HandleTable::closeOwned(const void *owner, HandleCloser closer){
+    for(;;){
+        void *object;
+        int kind;
+        {
+            Mutex::Autolock lock(mLock);
+            std::map<const void*, int32_t>::iterator head = mOwned.find(owner);
+            if(head == mOwned.end()) return;
+            int32_t index = head->second;
+            object = mSlots[index].object;
+            kind = mSlots[index].kind;
+            releaseLocked(index);
+        }
+        closeOwned(object, closer);
+        closer(kind, object);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef _HANDLE_TABLE_HPP_
+#define _HANDLE_TABLE_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <utils/Mutex.h>
+
+#include <map>
+#include <vector>
+
+/*
+ * Handles given to Java in place of raw PDFium pointers. A handle is a slot
+ * index plus the generation of the slot, so a handle used after its object
+ * was closed resolves to NULL instead of a freed pointer. Every handle has an
+ * owner, the document or the parent object (a text page owns its searches, a
+ * page its text pages and links); closing an owner closes everything it owns
+ * first, so closing a document releases all its children in one pass.
+ */
+
+enum HandleKind {
+    HANDLE_PAGE = 1,
+    HANDLE_TEXT_PAGE,
+    HANDLE_SEARCH,
+    HANDLE_LINK
+};
+
+//Frees the PDFium object behind a handle of kind
+typedef void (*HandleCloser)(int kind, void *object);
+
+class HandleTable {
+public:
+    static HandleTable& instance();
+
+    //New handle for object, never 0 or -1
+    int64_t add(int kind, void *object, const void *owner);
+
+    //Object of a live handle of that kind, NULL if the handle is stale or of another kind
+    void* get(int64_t handle, int kind);
+
+    //Close what object owns, then object itself; false if the handle was stale
+    bool close(int64_t handle, int kind, HandleCloser closer);
+
+    //Close every handle owned by owner, children first
+    void closeOwned(const void *owner, HandleCloser closer);
+
+private:
+    HandleTable();
+
+    struct Slot {
+        void *object;
+        const void *owner;
+        uint32_t generation;
+        int kind;               //0 while free
+        int32_t prevOwned;      //siblings with the same owner, -1 ends
+        int32_t nextOwned;
+        int32_t nextFree;
+    };
+
+    android::Mutex mLock;
+    std::vector<Slot> mSlots;
+    int32_t mFreeHead;
+    std::map<const void*, int32_t> mOwned;      //first slot of each owner
+
+    int32_t slotOf(int64_t handle, int kind) const;
+    void releaseLocked(int32_t index);
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "util.hpp"
+#include "hitIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define HIT_INDEX_ITEMS_PER_CELL 4
+#define HIT_INDEX_MAX_CELLS_PER_SIDE 128
+
+HitIndex::HitIndex(float pageWidth, float pageHeight,
+                   const std::vector<PageLink> &links,
+                   const std::vector<unsigned short> &webUrls, const std::vector<int32_t> &webUrlStarts,
+                   const std::vector<float> &webRects, const std::vector<int32_t> &webRectStarts,
+                   const std::vector<float> &charGeometry)
+        : mLinks(links), mWebUrls(webUrls), mWebUrlStarts(webUrlStarts) {
+    if(mWebUrlStarts.empty()) mWebUrlStarts.push_back(0);
+
+    for(size_t i = 0; i < links.size(); i++){
+        addItem((float) links[i].left, (float) links[i].top, (float) links[i].right,
+                (float) links[i].bottom, HIT_LINK, (int) i);
+    }
+
+    int webCount = (int) mWebUrlStarts.size() - 1;
+    mWebBounds.resize((size_t) webCount * 4);
+    for(int i = 0; i < webCount; i++){
+        float *bounds = &mWebBounds[(size_t) i * 4];
+        bounds[0] = bounds[3] = 1e30f;
+        bounds[1] = bounds[2] = -1e30f;
+        for(int r = webRectStarts[i]; r < webRectStarts[i + 1]; r += 4){
+            const float *rect = &webRects[r];
+            addItem(rect[0], rect[1], rect[2], rect[3], HIT_WEB_LINK, i);
+            bounds[0] = std::min(bounds[0], rect[0]);
+            bounds[1] = std::max(bounds[1], rect[1]);
+            bounds[2] = std::max(bounds[2], rect[2]);
+            bounds[3] = std::min(bounds[3], rect[3]);
+        }
+    }
+
+    int charCount = (int) (charGeometry.size() / CHAR_GEOMETRY_STRIDE);
+    for(int i = 0; i < charCount; i++){
+        const float *box = &charGeometry[(size_t) i * CHAR_GEOMETRY_STRIDE];
+        //Line breaks and generated spaces have no box
+        if(box[2] <= box[0] || box[1] <= box[3]) continue;
+        addItem(box[0], box[1], box[2], box[3], HIT_CHAR, i);
+    }
+
+    buildGrid(pageWidth, pageHeight);
+}
+
+void HitIndex::addItem(float left, float top, float right, float bottom, int kind, int id){
+    Item item;
+    item.left = std::min(left, right);
+    item.right = std::max(left, right);
+    item.top = std::max(top, bottom);
+    item.bottom = std::min(top, bottom);
+    item.kind = kind;
+    item.id = id;
+    mItems.push_back(item);
+}
+
+void HitIndex::buildGrid(float pageWidth, float pageHeight){
+    //Grid covers the page and anything drawn outside of it
+    float left = 0, bottom = 0, right = std::max(pageWidth, 1.0f), top = std::max(pageHeight, 1.0f);
+    for(size_t i = 0; i < mItems.size(); i++){
+        left = std::min(left, mItems[i].left);
+        bottom = std::min(bottom, mItems[i].bottom);
+        right = std::max(right, mItems[i].right);
+        top = std::max(top, mItems[i].top);
+    }
+    float width = right - left, height = top - bottom;
+
+    //Square-ish cells with a few items each
+    float cells = std::max(1.0f, (float) mItems.size() / HIT_INDEX_ITEMS_PER_CELL);
+    mColumns = (int) std::ceil(std::sqrt(cells * width / height));
+    mRows = (int) std::ceil(cells / mColumns);
+    mColumns = std::max(1, std::min(mColumns, HIT_INDEX_MAX_CELLS_PER_SIDE));
+    mRows = std::max(1, std::min(mRows, HIT_INDEX_MAX_CELLS_PER_SIDE));
+    mOriginX = left;
+    mOriginY = bottom;
+    mCellWidth = width / mColumns;
+    mCellHeight = height / mRows;
+
+    //Count, prefix sum, fill
+    mCellStarts.assign((size_t) mColumns * mRows + 1, 0);
+    for(int pass = 0; pass < 2; pass++){
+        std::vector<int32_t> fill;
+        if(pass == 1){
+            for(size_t c = 1; c < mCellStarts.size(); c++) mCellStarts[c] += mCellStarts[c - 1];
+            mCellItems.resize(mCellStarts.back());
+            fill.assign(mCellStarts.begin(), mCellStarts.end() - 1);
+        }
+        for(size_t i = 0; i < mItems.size(); i++){
+            const Item &item = mItems[i];
+            for(int r = row(item.bottom); r <= row(item.top); r++){
+                for(int c = column(item.left); c <= column(item.right); c++){
+                    int cell = r * mColumns + c;
+                    if(pass == 0) mCellStarts[cell + 1]++;
+                    else mCellItems[fill[cell]++] = (int32_t) i;
+                }
+            }
+        }
+    }
+}
+
+int HitIndex::column(float x) const {
+    int c = (int) ((x - mOriginX) / mCellWidth);
+    return std::max(0, std::min(c, mColumns - 1));
+}
+
+int HitIndex::row(float y) const {
+    int r = (int) ((y - mOriginY) / mCellHeight);
+    return std::max(0, std::min(r, mRows - 1));
+}
+
+int HitIndex::hitTest(float x, float y, float tolerance, int *id) const {
+    int bestKind = HIT_NONE;
+    float bestDistance = tolerance;
+
+    int firstRow = row(y - tolerance), lastRow = row(y + tolerance);
+    int firstColumn = column(x - tolerance), lastColumn = column(x + tolerance);
+    for(int r = firstRow; r <= lastRow; r++){
+        for(int c = firstColumn; c <= lastColumn; c++){
+            int cell = r * mColumns + c;
+            for(int i = mCellStarts[cell]; i < mCellStarts[cell + 1]; i++){
+                const Item &item = mItems[mCellItems[i]];
+                float dx = std::max(0.0f, std::max(item.left - x, x - item.right));
+                float dy = std::max(0.0f, std::max(item.bottom - y, y - item.top));
+                float distance = std::max(dx, dy);
+                if(distance > tolerance) continue;
+
+                //A direct hit beats a near one, then lower kinds win
+                bool better = (bestKind == HIT_NONE)
+                              || (distance == 0 && bestDistance > 0)
+                              || (distance == 0 && bestDistance == 0 && item.kind < bestKind)
+                              || (distance > 0 && bestDistance > 0 && distance < bestDistance);
+                if(better){
+                    bestKind = item.kind;
+                    bestDistance = distance;
+                    *id = item.id;
+                }
+            }
+        }
+    }
+    return bestKind;
+}
+
+void HitIndex::webLinkUrl(int id, std::vector<unsigned short> *url) const {
+    url->assign(mWebUrls.begin() + mWebUrlStarts[id], mWebUrls.begin() + mWebUrlStarts[id + 1]);
+}
@@ -0,0 +1,78 @@
+#ifndef _HIT_INDEX_HPP_
+#define _HIT_INDEX_HPP_
+
+extern "C" {
+    #include <stdint.h>
+}
+
+#include "pdfCore.hpp"
+
+#include <vector>
+
+/*
+ * Uniform grid over one page holding annotation link rects, web link rects
+ * and char boxes. Items are stored once and referenced from every cell they
+ * overlap (cells in CSR form: start offsets plus one flat item list), cells
+ * are sized for a few items each, so a tap only tests the handful of items of
+ * its cell. Everything a hit resolves to is copied in, queries never call
+ * into PDFium.
+ */
+
+enum HitKind {
+    HIT_NONE = 0,
+    HIT_LINK,           //annotation link, id indexes links()
+    HIT_WEB_LINK,       //URL in the page text, id indexes webLinkUrl()
+    HIT_CHAR            //id is the char index of the text page
+};
+
+class HitIndex {
+public:
+    /*
+     * charGeometry as getCharGeometry, web links as WebLinkCache::getPage.
+     * Any of them may be empty.
+     */
+    HitIndex(float pageWidth, float pageHeight,
+             const std::vector<PageLink> &links,
+             const std::vector<unsigned short> &webUrls, const std::vector<int32_t> &webUrlStarts,
+             const std::vector<float> &webRects, const std::vector<int32_t> &webRectStarts,
+             const std::vector<float> &charGeometry);
+
+    /*
+     * Object under the point (page coordinates): links win over web links
+     * over chars. Without a direct hit the nearest item within tolerance
+     * points is taken. Returns the HitKind, id gets the item id.
+     */
+    int hitTest(float x, float y, float tolerance, int *id) const;
+
+    const std::vector<PageLink>& links() const { return mLinks; }
+    int webLinkCount() const { return (int) mWebUrlStarts.size() - 1; }
+    void webLinkUrl(int id, std::vector<unsigned short> *url) const;
+    //Union of the rects of a web link: left, top, right, bottom
+    const float* webLinkBounds(int id) const { return &mWebBounds[(size_t) id * 4]; }
+
+private:
+    struct Item {
+        float left, top, right, bottom;     //PDF space, top > bottom
+        int32_t kind;
+        int32_t id;
+    };
+
+    std::vector<Item> mItems;
+    std::vector<int32_t> mCellStarts;       //cell c holds mCellItems[mCellStarts[c]..mCellStarts[c + 1])
+    std::vector<int32_t> mCellItems;
+    float mOriginX, mOriginY;
+    float mCellWidth, mCellHeight;
+    int mColumns, mRows;
+
+    std::vector<PageLink> mLinks;
+    std::vector<unsigned short> mWebUrls;
+    std::vector<int32_t> mWebUrlStarts;
+    std::vector<float> mWebBounds;
+
+    void addItem(float left, float top, float right, float bottom, int kind, int id);
+    void buildGrid(float pageWidth, float pageHeight);
+    int column(float x) const;
+    int row(float y) const;
+};
+
+#endif
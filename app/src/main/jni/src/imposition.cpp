@@ -0,0 +1,187 @@
+#include "util.hpp"
+#include "imposition.hpp"
+
+#include <fpdf_edit.h>
+#include <fpdf_transformpage.h>
+
+//Turning a page only pays when it grows noticeably, level layouts win ties
+#define ROTATE_PREFERENCE 1.001f
+
+static void cellSize(const SheetLayout &layout, float *width, float *height){
+    *width = (layout.width - 2 * layout.margin - (layout.cols - 1) * layout.gap) / layout.cols;
+    *height = (layout.height - 2 * layout.margin - (layout.rows - 1) * layout.gap) / layout.rows;
+}
+
+static float fitScale(float cellWidth, float cellHeight, float pageWidth, float pageHeight){
+    float scaleX = cellWidth / pageWidth;
+    float scaleY = cellHeight / pageHeight;
+    return (scaleX < scaleY)? scaleX : scaleY;
+}
+
+SheetLayout chooseSheetLayout(float sheetWidth, float sheetHeight, int pagesPerSheet,
+                              float pageWidth, float pageHeight, float margin, float gap){
+    if(pagesPerSheet < 1) pagesPerSheet = 1;
+
+    SheetLayout best;
+    float bestScore = -1;
+    for(int orientation = 0; orientation < 2; orientation++){
+        for(int rows = 1; rows <= pagesPerSheet; rows++){
+            if(pagesPerSheet % rows != 0) continue;
+
+            SheetLayout layout;
+            layout.width = (orientation == 0)? sheetWidth : sheetHeight;
+            layout.height = (orientation == 0)? sheetHeight : sheetWidth;
+            layout.margin = margin;
+            layout.gap = gap;
+            layout.rows = rows;
+            layout.cols = pagesPerSheet / rows;
+
+            float cellWidth, cellHeight;
+            cellSize(layout, &cellWidth, &cellHeight);
+            if(cellWidth <= 0 || cellHeight <= 0) continue;
+            float level = fitScale(cellWidth, cellHeight, pageWidth, pageHeight);
+            float turned = fitScale(cellWidth, cellHeight, pageHeight, pageWidth) / ROTATE_PREFERENCE;
+            float score = (level > turned)? level : turned;
+            if(score > bestScore){
+                best = layout;
+                bestScore = score;
+            }
+        }
+    }
+
+    if(bestScore < 0){
+        //Margins eat the sheet, fall back to a plain grid without them
+        best.width = sheetWidth;
+        best.height = sheetHeight;
+        best.margin = 0;
+        best.gap = 0;
+        best.rows = 1;
+        best.cols = pagesPerSheet;
+    }
+    return best;
+}
+
+CellPlacement placePage(const SheetLayout &layout, int cell, float pageWidth, float pageHeight){
+    float cellWidth, cellHeight;
+    cellSize(layout, &cellWidth, &cellHeight);
+    int row = cell / layout.cols;
+    int col = cell % layout.cols;
+    float cellLeft = layout.margin + col * (cellWidth + layout.gap);
+    float cellTop = layout.height - layout.margin - row * (cellHeight + layout.gap);
+
+    float level = fitScale(cellWidth, cellHeight, pageWidth, pageHeight);
+    float turned = fitScale(cellWidth, cellHeight, pageHeight, pageWidth);
+
+    CellPlacement placement;
+    placement.rotate = (turned > level * ROTATE_PREFERENCE)? 1 : 0;
+    if(placement.rotate){
+        placement.width = pageHeight * turned;
+        placement.height = pageWidth * turned;
+    }else{
+        placement.width = pageWidth * level;
+        placement.height = pageHeight * level;
+    }
+    placement.left = cellLeft + (cellWidth - placement.width) / 2;
+    placement.bottom = cellTop - cellHeight + (cellHeight - placement.height) / 2;
+    return placement;
+}
+
+bool transformPageToSheet(FPDF_PAGE page, const SheetLayout &layout, int cell){
+    int rotation = FPDFPage_GetRotation(page);
+
+    //Content coordinates are those of the visible box, before the page rotation
+    float left, bottom, right, top;
+    if(!FPDFPage_GetCropBox(page, &left, &bottom, &right, &top)
+       && !FPDFPage_GetMediaBox(page, &left, &bottom, &right, &top)){
+        //Inherited from the page tree, assumed at the origin
+        bool turned = (rotation % 2) != 0;
+        left = 0;
+        bottom = 0;
+        right = (float) (turned ? FPDF_GetPageHeight(page) : FPDF_GetPageWidth(page));
+        top = (float) (turned ? FPDF_GetPageWidth(page) : FPDF_GetPageHeight(page));
+    }
+    if(left > right){ float swap = left; left = right; right = swap; }
+    if(bottom > top){ float swap = bottom; bottom = top; top = swap; }
+    float boxWidth = right - left;
+    float boxHeight = top - bottom;
+    if(boxWidth <= 0 || boxHeight <= 0) return false;
+
+    bool shown = (rotation % 2) != 0;
+    CellPlacement placement = placePage(layout, cell, shown ? boxHeight : boxWidth,
+                                        shown ? boxWidth : boxHeight);
+
+    //Quarter turns clockwise of the box onto the origin, then scale and move into the cell
+    FS_MATRIX matrix;
+    int turns = (rotation + placement.rotate) % 4;
+    switch(turns){
+        case 1:
+            matrix.a = 0; matrix.b = -1; matrix.c = 1; matrix.d = 0;
+            matrix.e = -bottom; matrix.f = right;
+            break;
+        case 2:
+            matrix.a = -1; matrix.b = 0; matrix.c = 0; matrix.d = -1;
+            matrix.e = right; matrix.f = top;
+            break;
+        case 3:
+            matrix.a = 0; matrix.b = 1; matrix.c = -1; matrix.d = 0;
+            matrix.e = top; matrix.f = -left;
+            break;
+        default:
+            matrix.a = 1; matrix.b = 0; matrix.c = 0; matrix.d = 1;
+            matrix.e = -left; matrix.f = -bottom;
+            break;
+    }
+    float scale = placement.width / ((turns % 2 != 0)? boxHeight : boxWidth);
+    matrix.a *= scale;
+    matrix.b *= scale;
+    matrix.c *= scale;
+    matrix.d *= scale;
+    matrix.e = matrix.e * scale + placement.left;
+    matrix.f = matrix.f * scale + placement.bottom;
+
+    FS_RECTF clip;
+    clip.left = placement.left;
+    clip.top = placement.bottom + placement.height;
+    clip.right = placement.left + placement.width;
+    clip.bottom = placement.bottom;
+
+    if(!FPDFPage_TransFormWithClip(page, &matrix, &clip)){
+        LOGE("Page transform failed");
+        return false;
+    }
+    FPDFPage_TransformAnnots(page, matrix.a, matrix.b, matrix.c, matrix.d, matrix.e, matrix.f);
+    FPDFPage_SetRotation(page, 0);
+    FPDFPage_SetMediaBox(page, 0, 0, layout.width, layout.height);
+    FPDFPage_SetCropBox(page, 0, 0, layout.width, layout.height);
+    return true;
+}
+
+void renderSheet(FPDF_DOCUMENT doc, int firstPage, const SheetLayout &layout,
+                 void *buffer, int format, int stride, int width, int height, int flags){
+    FPDF_BITMAP sheet = FPDFBitmap_CreateEx(width, height, format, buffer, stride);
+    FPDFBitmap_FillRect(sheet, 0, 0, width, height, 0xFFFFFFFF); //White
+
+    float scaleX = width / layout.width;
+    float scaleY = height / layout.height;
+    int pageCount = FPDF_GetPageCount(doc);
+    int cells = layout.rows * layout.cols;
+    for(int cell = 0; cell < cells && firstPage + cell < pageCount; cell++){
+        FPDF_PAGE page = FPDF_LoadPage(doc, firstPage + cell);
+        if(page == NULL){
+            LOGE("Sheet page %d not loaded", firstPage + cell);
+            continue;
+        }
+        //PDFium applies the page rotation itself, sizes here are as displayed
+        CellPlacement placement = placePage(layout, cell, (float) FPDF_GetPageWidth(page),
+                                            (float) FPDF_GetPageHeight(page));
+        int x = (int) (placement.left * scaleX + 0.5f);
+        int y = (int) ((layout.height - placement.bottom - placement.height) * scaleY + 0.5f);
+        int sizeX = (int) (placement.width * scaleX + 0.5f);
+        int sizeY = (int) (placement.height * scaleY + 0.5f);
+        FPDF_RenderPageBitmap(sheet, page, x, y, sizeX, sizeY, placement.rotate, flags);
+        FPDF_ClosePage(page);
+    }
+
+    //Buffer is external, destroy only releases the bitmap wrapper
+    FPDFBitmap_Destroy(sheet);
+}
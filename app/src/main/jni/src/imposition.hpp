@@ -0,0 +1,59 @@
+#ifndef _IMPOSITION_HPP_
+#define _IMPOSITION_HPP_
+
+#include <fpdfview.h>
+
+/*
+ * Pages on print sheets. A sheet holds rows x cols equal cells in reading
+ * order; every page is scaled to fit its cell, turned a quarter when that
+ * makes it larger, and centered. transformPageToSheet rewrites one page in
+ * place as a sheet with FPDFPage_TransFormWithClip, so the content stays
+ * vector. This PDFium cannot move content between pages (no form XObjects,
+ * content generation writes images only), so sheets of several pages are
+ * rendered with renderSheet, each page drawn straight into its cell of the
+ * sheet buffer.
+ */
+
+struct SheetLayout {
+    float width;            //points, orientation already chosen
+    float height;
+    float margin;           //around the cells
+    float gap;              //between cells
+    int rows;
+    int cols;
+};
+
+struct CellPlacement {
+    int rotate;             //extra quarter turns clockwise, 0 or 1
+    float left;             //placed page on the sheet, PDF coordinates
+    float bottom;
+    float width;
+    float height;
+};
+
+/*
+ * Grid and sheet orientation giving pages of the given size the largest
+ * scale. sheetWidth and sheetHeight may be swapped in the result.
+ */
+SheetLayout chooseSheetLayout(float sheetWidth, float sheetHeight, int pagesPerSheet,
+                              float pageWidth, float pageHeight, float margin, float gap);
+
+//Where a page of the given displayed size goes in a cell, cells count from the top left
+CellPlacement placePage(const SheetLayout &layout, int cell, float pageWidth, float pageHeight);
+
+/*
+ * Rewrite page as a sheet of the layout with its content in cell. Page
+ * rotation is folded into the content, annotations move along. Pages loaded
+ * before show the old content until reloaded.
+ */
+bool transformPageToSheet(FPDF_PAGE page, const SheetLayout &layout, int cell);
+
+/*
+ * Render pages firstPage.. into the cells of a white sheet in buffer, laid
+ * out as FPDFBitmap_* format and scaled to width x height pixels. Cells past
+ * the last page stay empty.
+ */
+void renderSheet(FPDF_DOCUMENT doc, int firstPage, const SheetLayout &layout,
+                 void *buffer, int format, int stride, int width, int height, int flags);
+
+#endif
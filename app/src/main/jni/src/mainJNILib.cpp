@@ -16,37 +16,79 @@ using namespace android;
 
 #include <fpdfview.h>
 #include <fpdf_doc.h>
+#include <fpdf_edit.h>
 
 //inclue the header file in library
 #include <fpdf_text.h>
 
+#include "pdfCore.hpp"
+#include "renderPool.hpp"
+#include "renderExecutor.hpp"
+#include "textSelection.hpp"
+#include "searchSession.hpp"
+#include "textSearch.hpp"
+#include "textRegex.hpp"
+#include "webLinks.hpp"
+#include "hitIndex.hpp"
+#include "namedDests.hpp"
+#include "docSummary.hpp"
+#include "memoryGovernor.hpp"
+#include "handleTable.hpp"
+#include "scratchArena.hpp"
+#include "documentSave.hpp"
+#include "documentAssembler.hpp"
+#include "imposition.hpp"
+#include "formFill.hpp"
+#include "fontProvider.hpp"
+#include "pdfiumLibrary.hpp"
+#include "grayRender.hpp"
 
 #include <string>
 #include <vector>
+#include <map>
 #include <cstddef>
 
 static Mutex sLibraryLock;
 
-static int sLibraryReferenceCount = 0;
+//Text scratch reused across calls, callers hold the PdfiumCore lock
+static std::vector<unsigned short> sTextScratch;
 
+//Char geometry per text page, handed out as direct buffers until the text page closes
+static std::map<FPDF_TEXTPAGE, std::vector<float>*> sCharGeometry;
+
+//Form environment of the document of every loaded page, for drawing and input
+static std::map<FPDF_PAGE, FormFill*> sPageForms;
+
+//Pages loaded only to build a text page on, closed together with it
+static std::map<FPDF_TEXTPAGE, FPDF_PAGE> sTextPageOwnPages;
+
+
+static size_t trimScratch(int level, void *arg){
+    //Callers of trim hold the PdfiumCore lock, like every user of the scratch
+    size_t released = sTextScratch.capacity() * sizeof(unsigned short);
+    std::vector<unsigned short>().swap(sTextScratch);
+    MemoryGovernor::instance().untrack(&sTextScratch);
+    return released + TextRegex::trimCache();
+}
+
+static void trackTextScratch(){
+    MemoryGovernor::instance().track(&sTextScratch, MEMORY_SCRATCH,
+                                     sTextScratch.capacity() * sizeof(unsigned short));
+}
 
 static void initLibraryIfNeed(){
+    PdfiumLibrary::instance().acquire();
+
     Mutex::Autolock lock(sLibraryLock);
-    if(sLibraryReferenceCount == 0){
-        LOGD("Init FPDF library");
-        FPDF_InitLibrary();
+    static bool trimRegistered = false;
+    if(!trimRegistered){
+        MemoryGovernor::instance().addTrimHandler(0, TRIM_RUNNING_MODERATE, trimScratch, NULL);
+        trimRegistered = true;
     }
-    sLibraryReferenceCount++;
 }
 
 static void destroyLibraryIfNeed(){
-    Mutex::Autolock lock(sLibraryLock);
-
-    sLibraryReferenceCount--;
-    if(sLibraryReferenceCount == 0){
-        LOGD("Destroy FPDF library");
-        FPDF_DestroyLibrary();
-    }
+    PdfiumLibrary::instance().release();
 }
 
 struct rgb {
@@ -61,35 +103,41 @@ private:
 
 public:
     FPDF_DOCUMENT pdfDocument = NULL;
-    size_t fileSize;
+    size_t fileSize = 0;    //0 for documents opened from memory
+    dev_t fileDevice = 0;   //file PDFium reads pages from lazily
+    ino_t fileInode = 0;
+    FormFill *formFill = NULL;
+    WebLinkCache *webLinks = new WebLinkCache();
+    NamedDestIndex namedDests;
+    std::map<int, FPDF_PAGE> openPages;    //pages Java holds a handle to, by index
+    bool modified = false;  //page content changed in memory, see isModified
 
     DocumentFile() { initLibraryIfNeed(); }
     ~DocumentFile();
+
+    //In-memory edits the file does not have, form edits included
+    bool isModified() const { return modified || (formFill != NULL && formFill->changed()); }
+
+    //fd refers to the file the document reads from
+    bool isSourceFile(int fd) const {
+        struct stat state;
+        return fileSize != 0 && fstat(fd, &state) == 0
+               && state.st_dev == fileDevice && state.st_ino == fileInode;
+    }
 };
 DocumentFile::~DocumentFile(){
+    //Pages are closed by now, the environment goes before its document
+    delete formFill;
     if(pdfDocument != NULL){
         FPDF_CloseDocument(pdfDocument);
     }
+    webLinks->release();
 
     destroyLibraryIfNeed();
 }
 
-template <class string_type>
-inline typename string_type::value_type* WriteInto(string_type* str, size_t length_with_null) {
-    str->reserve(length_with_null);
-    str->resize(length_with_null - 1);
-    return &((*str)[0]);
-}
-
-inline long getFileSize(int fd){
-    struct stat file_state;
-    if(fstat(fd, &file_state) >= 0){
-        return (long)(file_state.st_size);
-    }else{
-        LOGE("Error getting file size");
-        return 0;
-    }
-}
+//Document of every page Java holds a handle to, to forget it in the document's openPages
+static std::map<FPDF_PAGE, DocumentFile*> sPageDocuments;
 
 static char* getErrorDescription(const long error) {
     char* description = NULL;
@@ -176,18 +224,104 @@ void rgbBitmapTo565(void *source, int sourceStride, void *dest, AndroidBitmapInf
 
 extern "C" { //For JNI support
 
-static int getBlock(void* param, unsigned long position, unsigned char* outBuffer,
-                    unsigned long size) {
-    const int fd = reinterpret_cast<intptr_t>(param);
-    const int readCount = pread(fd, outBuffer, size, position);
-    if (readCount < 0) {
-        LOGE("Cannot read from file descriptor. Error:%d", errno);
-        return 0;
+
+
+//PDFium does not report its memory, estimates scale with the parsed content
+static void trackPage(FPDF_PAGE page){
+    MemoryGovernor::instance().track(page, MEMORY_PAGES,
+                                     16384 + (size_t) FPDFPage_CountObject(page) * 512);
+}
+
+static void trackTextPage(FPDF_TEXTPAGE textPage){
+    MemoryGovernor::instance().track(textPage, MEMORY_TEXT_PAGES,
+                                     8192 + (size_t) FPDFText_CountChars(textPage) * 96);
+}
+
+static void closeTextPageInternal(FPDF_TEXTPAGE page){
+    MemoryGovernor::instance().untrack(page);
+
+    std::map<FPDF_TEXTPAGE, std::vector<float>*>::iterator geometry = sCharGeometry.find(page);
+    if(geometry != sCharGeometry.end()){
+        delete geometry->second;
+        sCharGeometry.erase(geometry);
+    }
+
+    FPDFText_ClosePage(page);
+
+    std::map<FPDF_TEXTPAGE, FPDF_PAGE>::iterator own = sTextPageOwnPages.find(page);
+    if(own != sTextPageOwnPages.end()){
+        MemoryGovernor::instance().untrack(own->second);
+        FPDF_ClosePage(own->second);
+        sTextPageOwnPages.erase(own);
     }
-    return 1;
 }
 
+static void closeHandleObject(int kind, void *object){
+    switch(kind){
+        case HANDLE_PAGE: {
+            FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(object);
+            std::map<FPDF_PAGE, FormFill*>::iterator form = sPageForms.find(page);
+            if(form != sPageForms.end()){
+                form->second->detachPage(page);
+                sPageForms.erase(form);
+            }
+            std::map<FPDF_PAGE, DocumentFile*>::iterator owner = sPageDocuments.find(page);
+            if(owner != sPageDocuments.end()){
+                std::map<int, FPDF_PAGE> &open = owner->second->openPages;
+                for(std::map<int, FPDF_PAGE>::iterator it = open.begin(); it != open.end(); ++it){
+                    if(it->second == page){
+                        open.erase(it);
+                        break;
+                    }
+                }
+                sPageDocuments.erase(owner);
+            }
+            MemoryGovernor::instance().untrack(object);
+            FPDF_ClosePage(page);
+            break;
+        }
+        case HANDLE_TEXT_PAGE:
+            closeTextPageInternal(reinterpret_cast<FPDF_TEXTPAGE>(object));
+            break;
+        case HANDLE_SEARCH:
+            FPDFText_FindClose(reinterpret_cast<FPDF_SCHHANDLE>(object));
+            break;
+        default:
+            //Links belong to their page
+            break;
+    }
+}
+
+//Java holds handles, a stale one throws instead of touching freed PDFium memory
+static void* resolveHandle(JNIEnv *env, jlong handle, int kind){
+    void *object = HandleTable::instance().get((int64_t) handle, kind);
+    if(object == NULL){
+        LOGE("Stale or invalid handle %llx of kind %d", (unsigned long long) handle, kind);
+        jniThrowException(env, "java/lang/IllegalStateException", "stale or invalid handle");
+    }
+    return object;
+}
+
+static FPDF_PAGE pageOf(JNIEnv *env, jlong handle){
+    return reinterpret_cast<FPDF_PAGE>(resolveHandle(env, handle, HANDLE_PAGE));
+}
+
+static FPDF_TEXTPAGE textPageOf(JNIEnv *env, jlong handle){
+    return reinterpret_cast<FPDF_TEXTPAGE>(resolveHandle(env, handle, HANDLE_TEXT_PAGE));
+}
+
+static FPDF_SCHHANDLE searchOf(JNIEnv *env, jlong handle){
+    return reinterpret_cast<FPDF_SCHHANDLE>(resolveHandle(env, handle, HANDLE_SEARCH));
+}
+
+static FPDF_LINK linkOf(JNIEnv *env, jlong handle){
+    return reinterpret_cast<FPDF_LINK>(resolveHandle(env, handle, HANDLE_LINK));
+}
 
+static FPDF_FORMHANDLE formOf(FPDF_PAGE page){
+    std::map<FPDF_PAGE, FormFill*>::iterator form = sPageForms.find(page);
+    return (form != sPageForms.end())? form->second->handle() : NULL;
+}
 
 static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
     try{
@@ -199,7 +333,14 @@ static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
             if (page == NULL) {
                 throw "Loaded page is null";
             }
-            return reinterpret_cast<jlong>(page);
+            trackPage(page);
+            if(doc->formFill != NULL){
+                doc->formFill->attachPage(page, pageIndex);
+                sPageForms[page] = doc->formFill;
+            }
+            doc->openPages[pageIndex] = page;
+            sPageDocuments[page] = doc;
+            return (jlong) HandleTable::instance().add(HANDLE_PAGE, page, doc);
         }else{
             throw "Get page pdf document null";
         }
@@ -215,21 +356,36 @@ static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
 }
 
 static jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, int textPageIndex){
+    FPDF_PAGE ownPage = NULL;
     try{
-        if(doc == NULL) throw "Get page document null";
+        if(doc == NULL || doc->pdfDocument == NULL) throw "Get page document null";
 
-        FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(loadPageInternal(env, doc, textPageIndex));
-        if(page != NULL){
-            FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
-            if (textPage == NULL) {
-                throw "Loaded text page is null";
-            }
-            return reinterpret_cast<jlong>(textPage);
+        //Build on the page Java has open, else on a page of its own without form
+        FPDF_PAGE page;
+        std::map<int, FPDF_PAGE>::iterator open = doc->openPages.find(textPageIndex);
+        if(open != doc->openPages.end()){
+            page = open->second;
         }else{
-            throw "Load page null";
+            page = ownPage = FPDF_LoadPage(doc->pdfDocument, textPageIndex);
+            if (page == NULL) {
+                throw "Loaded page is null";
+            }
+        }
+        FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+        if (textPage == NULL) {
+            throw "Loaded text page is null";
+        }
+        trackTextPage(textPage);
+        if(ownPage != NULL){
+            trackPage(ownPage);
+            sTextPageOwnPages[textPage] = ownPage;
+            //Nothing else holds the own page, the document closes the text page
+            return (jlong) HandleTable::instance().add(HANDLE_TEXT_PAGE, textPage, doc);
         }
+        return (jlong) HandleTable::instance().add(HANDLE_TEXT_PAGE, textPage, page);
     }catch(const char *msg){
         LOGE("%s", msg);
+        if(ownPage != NULL) FPDF_ClosePage(ownPage);
 
         jniThrowException(env, "java/lang/IllegalStateException",
                           "cannot load text page");
@@ -238,7 +394,9 @@ static jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, int textPageIn
     }
 }
 
-static void closePageInternal(jlong pagePtr) { FPDF_ClosePage(reinterpret_cast<FPDF_PAGE>(pagePtr)); }
+static void closePageInternal(jlong pageHandle) {
+    HandleTable::instance().close((int64_t) pageHandle, HANDLE_PAGE, closeHandleObject);
+}
 
 
 
@@ -250,39 +408,16 @@ static void renderPageInternal( FPDF_PAGE page,
                                 int drawSizeHor, int drawSizeVer,
                                 bool renderAnnot){
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
-                                                 FPDFBitmap_BGRA,
-                                                 windowBuffer->bits, (int)(windowBuffer->stride) * 4);
-
-    /*LOGD("Start X: %d", startX);
-    LOGD("Start Y: %d", startY);
-    LOGD("Canvas Hor: %d", canvasHorSize);
-    LOGD("Canvas Ver: %d", canvasVerSize);
-    LOGD("Draw Hor: %d", drawSizeHor);
-    LOGD("Draw Ver: %d", drawSizeVer);*/
-
-    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
-        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
-                             0x848484FF); //Gray
-    }
-
-    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : drawSizeVer;
-    int baseX = (startX < 0)? 0 : startX;
-    int baseY = (startY < 0)? 0 : startY;
-    int flags = FPDF_REVERSE_BYTE_ORDER;
+    int flags = FPDF_REVERSE_BYTE_ORDER | MemoryGovernor::instance().renderFlags();
 
     if(renderAnnot) {
         flags |= FPDF_ANNOT;
     }
 
-    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
-                         0xFFFFFFFF); //White
-
-    FPDF_RenderPageBitmap( pdfBitmap, page,
-                           startX, startY,
-                           drawSizeHor, drawSizeVer,
-                           0, flags );
+    renderPageToBuffer(page, windowBuffer->bits, FPDFBitmap_BGRA,
+                       (int)(windowBuffer->stride) * 4,
+                       canvasHorSize, canvasVerSize,
+                       startX, startY, drawSizeHor, drawSizeVer, flags, formOf(page));
 }
 
 }//extern C
@@ -294,7 +429,8 @@ Java_com_example_ndktesting_PdfiumCore_nativePageCoordsToDevice(JNIEnv *env, job
                                                              jint rotate, jdouble page_x,
                                                              jdouble page_y) {
     // TODO: implement nativePageCoordsToDevice()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(page_ptr);
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return NULL;
     int deviceX, deviceY;
 
     FPDF_PageToDevice(page, start_x, start_y, size_x, size_y, rotate, page_x, page_y, &deviceX, &deviceY);
@@ -306,7 +442,8 @@ Java_com_example_ndktesting_PdfiumCore_nativePageCoordsToDevice(JNIEnv *env, job
 JNIEXPORT jobject JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetLinkRect(JNIEnv *env, jobject thiz, jlong linkPtr) {
     // TODO: implement nativeGetLinkRect()
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
+    FPDF_LINK link = linkOf(env, linkPtr);
+    if(link == NULL) return NULL;
     FS_RECTF fsRectF;
     FPDF_BOOL result = FPDFLink_GetAnnotRect(link, &fsRectF);
 
@@ -323,7 +460,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetLinkURI(JNIEnv *env, jobject thi
                                                      jlong linkPtr) {
     // TODO: implement nativeGetLinkURI()
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
+    FPDF_LINK link = linkOf(env, linkPtr);
+    if(link == NULL) return NULL;
     FPDF_ACTION action = FPDFLink_GetAction(link);
     if (action == NULL) {
         return NULL;
@@ -332,16 +470,20 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetLinkURI(JNIEnv *env, jobject thi
     if (bufferLen <= 0) {
         return env->NewStringUTF("");
     }
-    std::string uri;
-    FPDFAction_GetURIPath(doc->pdfDocument, action, WriteInto(&uri, bufferLen), bufferLen);
-    return env->NewStringUTF(uri.c_str());
+    ScratchScope scratch;
+    char *uri = scratch.arena().alloc<char>(bufferLen + 1);
+    if(uri == NULL) return NULL;
+    FPDFAction_GetURIPath(doc->pdfDocument, action, uri, bufferLen);
+    uri[bufferLen] = 0;
+    return env->NewStringUTF(uri);
 }extern "C"
 JNIEXPORT jobject JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetDestPageIndex(JNIEnv *env, jobject thiz, jlong docPtr,
                                                            jlong linkPtr) {
     // TODO: implement nativeGetDestPageIndex()
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
+    FPDF_LINK link = linkOf(env, linkPtr);
+    if(link == NULL) return NULL;
     FPDF_DEST dest = FPDFLink_GetDest(doc->pdfDocument, link);
     if (dest == NULL) {
         return NULL;
@@ -352,17 +494,40 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetDestPageIndex(JNIEnv *env, jobje
 JNIEXPORT jlongArray JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetPageLinks(JNIEnv *env, jobject thiz, jlong pagePtr) {
     // TODO: implement nativeGetPageLinks()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGE page = pageOf(env, pagePtr);
+    if(page == NULL) return NULL;
     int pos = 0;
-    std::vector<jlong> links;
+    int count = 0;
     FPDF_LINK link;
-    while (FPDFLink_Enumerate(page, &pos, &link)) {
-        links.push_back(reinterpret_cast<jlong>(link));
+    while (FPDFLink_Enumerate(page, &pos, &link)) count++;
+
+    jlongArray result = env->NewLongArray(count);
+    if(result == NULL || count == 0) return result;
+
+    ScratchScope scratch;
+    jlong *links = scratch.arena().alloc<jlong>(count);
+    if(links == NULL) return NULL;
+    pos = 0;
+    int i = 0;
+    while (i < count && FPDFLink_Enumerate(page, &pos, &link)) {
+        links[i++] = (jlong) HandleTable::instance().add(HANDLE_LINK, link, page);
     }
-
-    jlongArray result = env->NewLongArray(links.size());
-    env->SetLongArrayRegion(result, 0, links.size(), &links[0]);
+    env->SetLongArrayRegion(result, 0, i, links);
     return result;
+}
+
+//Link handles die with their page anyway, this frees the slots of a one-off enumeration
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseLinks(JNIEnv *env, jobject thiz,
+                                                        jlongArray link_ptrs) {
+    if(link_ptrs == NULL) return;
+    int length = (int) env->GetArrayLength(link_ptrs);
+    jlong *links = env->GetLongArrayElements(link_ptrs, NULL);
+    for(int i = 0; i < length; i++){
+        HandleTable::instance().close((int64_t) links[i], HANDLE_LINK, closeHandleObject);
+    }
+    env->ReleaseLongArrayElements(link_ptrs, links, JNI_ABORT);
 }extern "C"
 JNIEXPORT jobject JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetPageSizeByIndex(JNIEnv *env, jobject thiz,
@@ -415,9 +580,12 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetBookmarkTitle(JNIEnv *env, jobje
     if (bufferLen <= 2) {
         return env->NewStringUTF("");
     }
-    std::wstring title;
-    FPDFBookmark_GetTitle(bookmark, WriteInto(&title, bufferLen + 1), bufferLen);
-    return env->NewString((jchar*) title.c_str(), bufferLen / 2 - 1);
+    //bufferLen is in bytes of UTF-16 with the terminator
+    ScratchScope scratch;
+    jchar *title = scratch.arena().alloc<jchar>(bufferLen / 2 + 1);
+    if(title == NULL) return NULL;
+    FPDFBookmark_GetTitle(bookmark, title, bufferLen);
+    return env->NewString(title, bufferLen / 2 - 1);
 }extern "C"
 JNIEXPORT jobject JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetSiblingBookmark(JNIEnv *env, jobject thiz,
@@ -466,32 +634,29 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetDocumentMetaText(JNIEnv *env, jo
 
     size_t bufferLen = FPDF_GetMetaText(doc->pdfDocument, ctag, NULL, 0);
     if (bufferLen <= 2) {
+        env->ReleaseStringUTFChars(tag, ctag);
         return env->NewStringUTF("");
     }
-    std::wstring text;
-    FPDF_GetMetaText(doc->pdfDocument, ctag, WriteInto(&text, bufferLen + 1), bufferLen);
+    ScratchScope scratch;
+    jchar *text = scratch.arena().alloc<jchar>(bufferLen / 2 + 1);
+    if(text != NULL) FPDF_GetMetaText(doc->pdfDocument, ctag, text, bufferLen);
     env->ReleaseStringUTFChars(tag, ctag);
-    return env->NewString((jchar*) text.c_str(), bufferLen / 2 - 1);
-}extern "C"
-JNIEXPORT void JNICALL
-Java_com_example_ndktesting_PdfiumCore_nativeRenderPageBitmap(JNIEnv *env, jobject thiz,
-                                                           jlong page_ptr, jobject bitmap, jint dpi,
-                                                           jint start_x, jint start_y,
-                                                           jint drawSizeHor, jint drawSizeVer,
-                                                           jboolean render_annot) {
-    // TODO: implement nativeRenderPageBitmap()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(page_ptr);
-
+    if(text == NULL) return NULL;
+    return env->NewString(text, bufferLen / 2 - 1);
+}
+static bool renderPageOnBitmap(JNIEnv *env, FPDF_PAGE page, jobject bitmap,
+                               int startX, int startY, int drawSizeHor, int drawSizeVer,
+                               bool renderAnnot){
     if(page == NULL || bitmap == NULL){
         LOGE("Render page pointers invalid");
-        return;
+        return false;
     }
 
     AndroidBitmapInfo info;
     int ret;
     if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
         LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
-        return;
+        return false;
     }
 
     int canvasHorSize = info.width;
@@ -499,13 +664,13 @@ Java_com_example_ndktesting_PdfiumCore_nativeRenderPageBitmap(JNIEnv *env, jobje
 
     if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info.format != ANDROID_BITMAP_FORMAT_RGB_565){
         LOGE("Bitmap format must be RGBA_8888 or RGB_565");
-        return;
+        return false;
     }
 
     void *addr;
     if( (ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0 ){
         LOGE("Locking bitmap failed: %s", strerror(ret * -1));
-        return;
+        return false;
     }
 
     void *tmp;
@@ -513,6 +678,7 @@ Java_com_example_ndktesting_PdfiumCore_nativeRenderPageBitmap(JNIEnv *env, jobje
     int sourceStride;
     if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
         tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
+        MemoryGovernor::instance().track(tmp, MEMORY_SCRATCH, canvasVerSize * canvasHorSize * sizeof(rgb));
         sourceStride = canvasHorSize * sizeof(rgb);
         format = FPDFBitmap_BGR;
     } else {
@@ -521,47 +687,40 @@ Java_com_example_ndktesting_PdfiumCore_nativeRenderPageBitmap(JNIEnv *env, jobje
         format = FPDFBitmap_BGRA;
     }
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
-                                                 format, tmp, sourceStride);
-
-/*LOGD("Start X: %d", startX);
-LOGD("Start Y: %d", startY);
-LOGD("Canvas Hor: %d", canvasHorSize);
-LOGD("Canvas Ver: %d", canvasVerSize);
-LOGD("Draw Hor: %d", drawSizeHor);
-LOGD("Draw Ver: %d", drawSizeVer);*/
-
-    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
-        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
-                             0x848484FF); //Gray
-    }
-
-    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : (int)drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : (int)drawSizeVer;
-    int baseX = (start_x < 0)? 0 : (int)start_x;
-    int baseY = (start_y < 0)? 0 : (int)start_y;
-    int flags = FPDF_REVERSE_BYTE_ORDER;
+    int flags = FPDF_REVERSE_BYTE_ORDER | MemoryGovernor::instance().renderFlags();
 
-    if(render_annot) {
+    if(renderAnnot) {
         flags |= FPDF_ANNOT;
     }
 
-    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
-                         0xFFFFFFFF); //White
-
-    FPDF_RenderPageBitmap( pdfBitmap, page,
-                           start_x, start_y,
-                           (int)drawSizeHor, (int)drawSizeVer,
-                           0, flags );
+    renderPageToBuffer(page, tmp, format, sourceStride,
+                       canvasHorSize, canvasVerSize,
+                       startX, startY,
+                       drawSizeHor, drawSizeVer, flags, formOf(page));
 
     if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
         rgbBitmapTo565(tmp, sourceStride, addr, &info);
+        MemoryGovernor::instance().untrack(tmp);
         free(tmp);
     }
 
     AndroidBitmap_unlockPixels(env, bitmap);
+    return true;
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPageBitmap(JNIEnv *env, jobject thiz,
+                                                           jlong page_ptr, jobject bitmap, jint dpi,
+                                                           jint start_x, jint start_y,
+                                                           jint drawSizeHor, jint drawSizeVer,
+                                                           jboolean render_annot) {
+    // TODO: implement nativeRenderPageBitmap()
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return;
+    renderPageOnBitmap(env, page, bitmap, (int)start_x, (int)start_y,
+                       (int)drawSizeHor, (int)drawSizeVer, (bool)render_annot);
+}
 
 extern "C"
 JNIEXPORT void JNICALL
@@ -575,10 +734,11 @@ Java_com_example_ndktesting_PdfiumCore_nativeRenderPage(JNIEnv *env, jobject thi
         LOGE("native window pointer null");
         return;
     }
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(page_ptr);
+    FPDF_PAGE page = pageOf(env, page_ptr);
 
     if(page == NULL || nativeWindow == NULL){
         LOGE("Render page pointers invalid");
+        ANativeWindow_release(nativeWindow);
         return;
     }
 
@@ -612,7 +772,8 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetPageHeightPoint(JNIEnv *env, jobject thiz,
                                                              jlong page_ptr) {
     // TODO: implement nativeGetPageHeightPoint()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(page_ptr);
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return 0;
     return (jint)FPDF_GetPageHeight(page);
 }
 
@@ -621,7 +782,8 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetPageWidthPoint(JNIEnv *env, jobject thiz,
                                                             jlong pagePtr) {
     // TODO: implement nativeGetPageWidthPoint()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGE page = pageOf(env, pagePtr);
+    if(page == NULL) return 0;
     return (jint)FPDF_GetPageWidth(page);
 }
 
@@ -631,7 +793,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetPageHeightPixel(JNIEnv *env, job
                                                              jlong pagePtr, jint dpi) {
     // TODO: implement nativeGetPageHeightPixel()
 
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGE page = pageOf(env, pagePtr);
+    if(page == NULL) return 0;
     return (jint)(FPDF_GetPageHeight(page) * dpi / 72);
 }
 
@@ -640,7 +803,8 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetPageWidthPixel(JNIEnv *env, jobject thiz,
                                                             jlong pagePtr, jint dpi) {
     // TODO: implement nativeGetPageWidthPixel()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGE page = pageOf(env, pagePtr);
+    if(page == NULL) return 0;
     return (jint)(FPDF_GetPageWidth(page) * dpi / 72);
 }
 
@@ -654,6 +818,7 @@ Java_com_example_ndktesting_PdfiumCore_nativeClosePages(JNIEnv *env, jobject thi
 
     int i;
     for(i = 0; i < length; i++){ closePageInternal(pages[i]); }
+    env -> ReleaseLongArrayElements(pages_ptr, pages, JNI_ABORT);
 }
 
 extern "C"
@@ -671,7 +836,9 @@ Java_com_example_ndktesting_PdfiumCore_nativeLoadPages(JNIEnv *env, jobject thiz
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
 
     if(to_index < from_index) return NULL;
-    jlong pages[ to_index - from_index + 1 ];
+    ScratchScope scratch;
+    jlong *pages = scratch.arena().alloc<jlong>(to_index - from_index + 1);
+    if(pages == NULL) return NULL;
 
     int i;
     for(i = 0; i <= (to_index - from_index); i++){
@@ -714,7 +881,10 @@ JNIEXPORT void JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeCloseDocument(JNIEnv *env, jobject thiz, jlong doc_ptr) {
     // TODO: implement nativeCloseDocument()
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL) return;
 
+    //Pages, their text pages, searches and links in one pass
+    HandleTable::instance().closeOwned(doc, closeHandleObject);
     delete doc;
 }
 
@@ -761,6 +931,7 @@ Java_com_example_ndktesting_PdfiumCore_nativeOpenMemDocument(JNIEnv *env, jobjec
     }
 
     docFile->pdfDocument = document;
+    docFile->formFill = new FormFill(document);
 
     return reinterpret_cast<jlong>(docFile);
 
@@ -781,17 +952,18 @@ Java_com_example_ndktesting_PdfiumCore_nativeOpenDocument(JNIEnv *env, jobject t
 
     DocumentFile *docFile = new DocumentFile();
 
-    FPDF_FILEACCESS loader;
-    loader.m_FileLen = fileLength;
-    loader.m_Param = reinterpret_cast<void *>(intptr_t(fd));
-    loader.m_GetBlock = &getBlock;
-
     const char *cpassword = NULL;
     if (password != NULL) {
         cpassword = env->GetStringUTFChars(password, NULL);
     }
 
-    FPDF_DOCUMENT document = FPDF_LoadCustomDocument(&loader, cpassword);
+    FPDF_DOCUMENT document = loadDocumentFromFd(fd, fileLength, cpassword);
+    docFile->fileSize = fileLength;
+    struct stat source;
+    if(fstat(fd, &source) == 0){
+        docFile->fileDevice = source.st_dev;
+        docFile->fileInode = source.st_ino;
+    }
 
     if (cpassword != NULL) {
         env->ReleaseStringUTFChars(password, cpassword);
@@ -816,6 +988,7 @@ Java_com_example_ndktesting_PdfiumCore_nativeOpenDocument(JNIEnv *env, jobject t
     }
 
     docFile->pdfDocument = document;
+    docFile->formFill = new FormFill(document);
 
     return reinterpret_cast<jlong>(docFile);
 }
@@ -844,9 +1017,13 @@ JNIEXPORT jlong JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeTextLoadPage(JNIEnv *env, jobject thiz,
                                                           jlong page_ptr) {
     // TODO: implement nativeTextLoadPage()
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(page_ptr);
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return 0;
 
-    return reinterpret_cast<jlong>(FPDFText_LoadPage(page));
+    FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+    if(textPage == NULL) return 0;
+    trackTextPage(textPage);
+    return (jlong) HandleTable::instance().add(HANDLE_TEXT_PAGE, textPage, page);
 }
 
 extern "C"
@@ -855,8 +1032,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeGetTotalCharactersInPage(JNIEnv *en
                                                                       jlong page_ptr) {
     // TODO: implement nativeGetTotalCharactersInPage()
 
-    FPDF_TEXTPAGE page = reinterpret_cast<FPDF_TEXTPAGE>(page_ptr);
-
+    FPDF_TEXTPAGE page = textPageOf(env, page_ptr);
+    if(page == NULL) return 0;
 
     return (jint)FPDFText_CountChars(page);
 
@@ -866,10 +1043,15 @@ JNIEXPORT void JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeCloseTextpage(JNIEnv *env, jobject thiz,
                                                            jlong page_ptr) {
     // TODO: implement nativeCloseTextpage()
-    FPDF_TEXTPAGE page = reinterpret_cast<FPDF_TEXTPAGE>(page_ptr);
+    HandleTable::instance().close((int64_t) page_ptr, HANDLE_TEXT_PAGE, closeHandleObject);
 
-    FPDFText_ClosePage(page);
+}
 
+//FPDFText_FindStart wants a terminated UTF-16 query
+static void getSearchQuery(JNIEnv *env, jstring word, std::vector<unsigned short> *out){
+    int length = (word != NULL)? env->GetStringLength(word) : 0;
+    out->assign(length + 1, 0);
+    if(length > 0) env->GetStringRegion(word, 0, length, &(*out)[0]);
 }
 
 extern "C"
@@ -878,18 +1060,22 @@ Java_com_example_ndktesting_PdfiumCore_nativeTextSearchHandler(JNIEnv *env, jobj
                                                                jlong page_ptr, jint start_index,
                                                                jstring word) {
     // TODO: implement nativeTextSearchHandler()
-    FPDF_TEXTPAGE page = reinterpret_cast<FPDF_TEXTPAGE>(page_ptr);
-
-    const char *ctag = env->GetStringUTFChars(word, NULL);
-
-    int length = env->GetStringLength(word);
-    const FPDF_WCHAR* wcFind = env->GetStringChars(word, 0);
-
+    FPDF_TEXTPAGE page = textPageOf(env, page_ptr);
+    if(page == NULL) return 0;
 
+    std::vector<unsigned short> query;
+    getSearchQuery(env, word, &query);
 
+    FPDF_SCHHANDLE search = FPDFText_FindStart(page, &query[0], FPDF_MATCHWHOLEWORD, start_index);
+    if(search == NULL) return 0;
+    return (jlong) HandleTable::instance().add(HANDLE_SEARCH, search, page);
+}
 
-    return reinterpret_cast<jlong>(FPDFText_FindStart(page, (FPDF_WCHAR*)wcFind,
-                                                      FPDF_MATCHWHOLEWORD, start_index));
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseSearchHandle(JNIEnv *env, jobject thiz,
+                                                               jlong handler) {
+    HandleTable::instance().close((int64_t) handler, HANDLE_SEARCH, closeHandleObject);
 }
 
 extern "C"
@@ -900,7 +1086,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeIfMatchFound(JNIEnv *env, jobject t
     // TODO: implement nativeIfMatchFound()
 
    // return (jint*)searchHandle;
-    FPDF_SCHHANDLE pSearchHandle = reinterpret_cast<FPDF_SCHHANDLE>(handler);
+    FPDF_SCHHANDLE pSearchHandle = searchOf(env, handler);
+    if(pSearchHandle == NULL) return JNI_FALSE;
     FPDF_BOOL isMatch = FPDFText_FindNext(pSearchHandle);
     LOGD("FPDFText_FindNext Match is %x",isMatch);
     return isMatch;
@@ -914,23 +1101,23 @@ JNIEXPORT jstring JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetText(JNIEnv *env, jobject thiz, jlong pageptr,
                                                      jint start, jint count) {
     // TODO: implement nativeGetText()
-    FPDF_DWORD bufflen = 0;
-
-    FPDF_TEXTPAGE pTextPage = reinterpret_cast<FPDF_TEXTPAGE>(pageptr);
-
-    FPDF_WCHAR* pBuff = new FPDF_WCHAR[count+1];
-
+    FPDF_TEXTPAGE pTextPage = textPageOf(env, pageptr);
+    if(pTextPage == NULL) return NULL;
+    if(count <= 0){
+        return env->NewStringUTF("");
+    }
 
-    int ret = FPDFText_GetText(pTextPage, start, count, pBuff);
+    ScratchScope scratch;
+    unsigned short *text = scratch.arena().alloc<unsigned short>(count + 1);
+    if(text == NULL) return NULL;
+    int ret = FPDFText_GetText(pTextPage, start, count, text);
 
-    if(ret == 0){
+    if(ret <= 0){
         LOGE("FPDFTextGetText: FPDFTextGetText did not return success");
+        return env->NewStringUTF("");
     }
-    //LOGE("FPDFTextGetText: %x" , ret);
-    jstring Text = env->NewString(pBuff, ret-1);
-    //delete pBuff;
-
-    return Text;
+    //ret counts the terminator
+    return env->NewString(text, ret - 1);
 }
 
 extern "C"
@@ -938,7 +1125,8 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetSearchCount(JNIEnv *env, jobject thiz,
                                                             jlong handler) {
     // TODO: implement nativeGetSearchCount()
-    FPDF_SCHHANDLE pSearchHandle = reinterpret_cast<FPDF_SCHHANDLE>(handler);
+    FPDF_SCHHANDLE pSearchHandle = searchOf(env, handler);
+    if(pSearchHandle == NULL) return 0;
     jint result = FPDFText_GetSchCount(pSearchHandle);
 
     LOGE("FPDFTextcount: %x" , FPDFText_GetSchCount(pSearchHandle));
@@ -950,7 +1138,8 @@ JNIEXPORT jboolean JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativePreviousMatch(JNIEnv *env, jobject thiz,
                                                            jlong handler) {
     // TODO: implement nativePreviousMatch()
-    FPDF_SCHHANDLE pSearchHandle = reinterpret_cast<FPDF_SCHHANDLE>(handler);
+    FPDF_SCHHANDLE pSearchHandle = searchOf(env, handler);
+    if(pSearchHandle == NULL) return JNI_FALSE;
 
     return FPDFText_FindPrev(pSearchHandle);
 }
@@ -960,7 +1149,8 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeGetSearchIndex(JNIEnv *env, jobject thiz,
                                                             jlong handler) {
     // TODO: implement nativeGetSearchIndex()
-    FPDF_SCHHANDLE pSearchHandle = reinterpret_cast<FPDF_SCHHANDLE>(handler);
+    FPDF_SCHHANDLE pSearchHandle = searchOf(env, handler);
+    if(pSearchHandle == NULL) return -1;
 
     return FPDFText_GetSchResultIndex(pSearchHandle);
 }
@@ -971,7 +1161,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeTextGetCharBox(JNIEnv *env, jobject
                                                             jlong text_page_ptr, jint index) {
     // TODO: implement nativeTextGetCharBox()
 
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return NULL;
     jdoubleArray result = env->NewDoubleArray(4);
     if (result == NULL) {
         return NULL;
@@ -988,7 +1179,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeTextGetCharIndexAtPos(JNIEnv *env,
                                                                    jdouble y_tolerance) {
     // TODO: implement nativeTextGetCharIndexAtPos()
 
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return -1;
     return (jint)FPDFText_GetCharIndexAtPos(textPage, (double)x, (double)y, (double)x_tolerance, (double)y_tolerance);
 }extern "C"
 JNIEXPORT jint JNICALL
@@ -996,14 +1188,49 @@ Java_com_example_ndktesting_PdfiumCore_nativeTextCountRects(JNIEnv *env, jobject
                                                             jlong text_page_ptr, jint start_index,
                                                             jint count) {
     // TODO: implement nativeTextCountRects()
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return 0;
     return (jint)FPDFText_CountRects(textPage, (int)start_index, (int) count);
-}extern "C"
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextMapTextRange(JNIEnv *env, jobject thiz,
+                                                              jlong text_page_ptr, jint text_start,
+                                                              jint text_length) {
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return NULL;
+    int charStart, charCount;
+    if(!textRangeToChars(textPage, (int) text_start, (int) text_length, &charStart, &charCount)){
+        return NULL;
+    }
+
+    //char start, char count, then 4 floats per rect like a packed selection
+    std::vector<float> packed;
+    packed.push_back((float) charStart);
+    packed.push_back((float) charCount);
+    int rects = FPDFText_CountRects(textPage, charStart, charCount);
+    for(int i = 0; i < rects; i++){
+        double left, top, right, bottom;
+        FPDFText_GetRect(textPage, i, &left, &top, &right, &bottom);
+        packed.push_back((float) left);
+        packed.push_back((float) top);
+        packed.push_back((float) right);
+        packed.push_back((float) bottom);
+    }
+    jfloatArray result = env->NewFloatArray((jsize) packed.size());
+    if(result == NULL) return NULL;
+    env->SetFloatArrayRegion(result, 0, (jsize) packed.size(), &packed[0]);
+    return result;
+}
+
+extern "C"
 JNIEXPORT jdoubleArray JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeTextGetRect(JNIEnv *env, jobject thiz,
                                                          jlong text_page_ptr, jint rect_index) {
     // TODO: implement nativeTextGetRect()
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return NULL;
     jdoubleArray result = env->NewDoubleArray(4);
     if (result == NULL) {
         return NULL;
@@ -1019,7 +1246,8 @@ Java_com_example_ndktesting_PdfiumCore_nativeTextGetBoundedText(JNIEnv *env, job
                                                                 jdouble top, jdouble right,
                                                                 jdouble bottom, jshortArray arr) {
     // TODO: implement nativeTextGetBoundedText()
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return 0;
     jboolean isCopy = 0;
     unsigned short *buffer = NULL;
     int bufLen = 0;
@@ -1041,11 +1269,20 @@ Java_com_example_ndktesting_PdfiumCore_nativeLoadTextPages(JNIEnv *env, jobject
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
 
     if(toIndex < fromIndex) return NULL;
-    jlong pages[ toIndex - fromIndex + 1 ];
+    ScratchScope scratch;
+    jlong *pages = scratch.arena().alloc<jlong>(toIndex - fromIndex + 1);
+    if(pages == NULL) return NULL;
 
     int i;
     for(i = 0; i <= (toIndex - fromIndex); i++){
         pages[i] = loadTextPageInternal(env, doc, (int)(i + fromIndex));
+        if(pages[i] == -1){
+            //Exception pending, drop the text pages loaded so far
+            while(--i >= 0){
+                HandleTable::instance().close((int64_t) pages[i], HANDLE_TEXT_PAGE, closeHandleObject);
+            }
+            return NULL;
+        }
     }
 
     jlongArray javaPages = env -> NewLongArray( (jsize)(toIndex - fromIndex + 1) );
@@ -1057,6 +1294,1810 @@ JNIEXPORT jint JNICALL
 Java_com_example_ndktesting_PdfiumCore_nativeTextGetUnicode(JNIEnv *env, jobject thiz,
                                                             jlong text_page_ptr, jint index) {
     // TODO: implement nativeTextGetUnicode()
-    FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(text_page_ptr);
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return 0;
     return (jint)FPDFText_GetUnicode(textPage, (int)index);
-}
\ No newline at end of file
+}
+
+static bool lockPoolTarget(JNIEnv *env, jobject bitmap, int pageIndex,
+                           int startX, int startY, int drawSizeHor, int drawSizeVer,
+                           bool renderAnnot, RenderPool::Target *target, void **addr,
+                           AndroidBitmapInfo *info){
+    int ret;
+    if((ret = AndroidBitmap_getInfo(env, bitmap, info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return false;
+    }
+    if(info->format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info->format != ANDROID_BITMAP_FORMAT_RGB_565){
+        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
+        return false;
+    }
+    if( (ret = AndroidBitmap_lockPixels(env, bitmap, addr)) != 0 ){
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return false;
+    }
+
+    target->pageIndex = pageIndex;
+    target->canvasHorSize = info->width;
+    target->canvasVerSize = info->height;
+    if (info->format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        target->pixels = malloc(info->height * info->width * sizeof(rgb));
+        MemoryGovernor::instance().track(target->pixels, MEMORY_SCRATCH,
+                                         info->height * info->width * sizeof(rgb));
+        target->stride = info->width * sizeof(rgb);
+        target->format = FPDFBitmap_BGR;
+    } else {
+        target->pixels = *addr;
+        target->stride = info->stride;
+        target->format = FPDFBitmap_BGRA;
+    }
+    target->startX = startX;
+    target->startY = startY;
+    target->drawSizeHor = drawSizeHor;
+    target->drawSizeVer = drawSizeVer;
+    target->flags = FPDF_REVERSE_BYTE_ORDER | MemoryGovernor::instance().renderFlags();
+    if(renderAnnot) {
+        target->flags |= FPDF_ANNOT;
+    }
+    return true;
+}
+
+static void unlockPoolTarget(JNIEnv *env, jobject bitmap, RenderPool::Target *target, void *addr,
+                             AndroidBitmapInfo *info){
+    if (info->format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        rgbBitmapTo565(target->pixels, target->stride, addr, info);
+        MemoryGovernor::instance().untrack(target->pixels);
+        free(target->pixels);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCreateRenderPool(JNIEnv *env, jobject thiz,
+                                                              jstring worker_path, jint workers) {
+    const char *cpath = env->GetStringUTFChars(worker_path, NULL);
+    RenderPool *pool = new RenderPool(cpath, (int) workers);
+    env->ReleaseStringUTFChars(worker_path, cpath);
+
+    if(pool->workerCount() == 0){
+        delete pool;
+        jniThrowException(env, "java/io/IOException",
+                          "render pool workers did not start, see the log for their exit status");
+        return -1;
+    }
+    return reinterpret_cast<jlong>(pool);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeDestroyRenderPool(JNIEnv *env, jobject thiz,
+                                                               jlong pool_ptr) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    delete pool;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetRenderPoolWorkers(JNIEnv *env, jobject thiz,
+                                                                  jlong pool_ptr) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    return (jint) pool->workerCount();
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolOpenDocument(JNIEnv *env, jobject thiz,
+                                                                    jlong pool_ptr, jint fd,
+                                                                    jstring password) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+
+    const char *cpassword = NULL;
+    if (password != NULL) {
+        cpassword = env->GetStringUTFChars(password, NULL);
+    }
+
+    int documentId = pool->openDocument((int) fd, cpassword);
+
+    if (cpassword != NULL) {
+        env->ReleaseStringUTFChars(password, cpassword);
+    }
+
+    if (documentId < 0) {
+        jniThrowException(env, "java/io/IOException",
+                          "cannot open document in render pool");
+    }
+    return (jint) documentId;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolCloseDocument(JNIEnv *env, jobject thiz,
+                                                                     jlong pool_ptr, jint doc_id) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    pool->closeDocument((int) doc_id);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolRenderBitmap(JNIEnv *env, jobject thiz,
+                                                                    jlong pool_ptr, jint doc_id,
+                                                                    jint page_index, jobject bitmap,
+                                                                    jint start_x, jint start_y,
+                                                                    jint draw_size_hor,
+                                                                    jint draw_size_ver,
+                                                                    jboolean render_annot) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    if(pool == NULL || bitmap == NULL){
+        LOGE("Render pool pointers invalid");
+        return JNI_FALSE;
+    }
+
+    RenderPool::Target target;
+    AndroidBitmapInfo info;
+    void *addr;
+    if(!lockPoolTarget(env, bitmap, (int) page_index, (int) start_x, (int) start_y,
+                       (int) draw_size_hor, (int) draw_size_ver, (bool) render_annot,
+                       &target, &addr, &info)){
+        return JNI_FALSE;
+    }
+
+    int rendered = pool->render((int) doc_id, &target, 1);
+
+    unlockPoolTarget(env, bitmap, &target, addr, &info);
+    return (jboolean) (rendered == 1);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolRenderBitmaps(JNIEnv *env, jobject thiz,
+                                                                     jlong pool_ptr, jint doc_id,
+                                                                     jintArray page_indexes,
+                                                                     jobjectArray bitmaps,
+                                                                     jboolean render_annot) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    int count = (int) env->GetArrayLength(page_indexes);
+    if(pool == NULL || count != (int) env->GetArrayLength(bitmaps)){
+        LOGE("Render pool arguments invalid");
+        return 0;
+    }
+
+    std::vector<jint> pages(count);
+    env->GetIntArrayRegion(page_indexes, 0, count, count > 0 ? &pages[0] : NULL);
+
+    std::vector<RenderPool::Target> targets;
+    std::vector<jobject> locked;
+    std::vector<void*> addrs;
+    std::vector<AndroidBitmapInfo> infos;
+    targets.reserve(count);
+    for(int i = 0; i < count; i++){
+        jobject bitmap = env->GetObjectArrayElement(bitmaps, i);
+        if(bitmap == NULL) continue;
+
+        RenderPool::Target target;
+        AndroidBitmapInfo info;
+        void *addr;
+        if(!lockPoolTarget(env, bitmap, (int) pages[i], 0, 0, 0, 0, (bool) render_annot,
+                           &target, &addr, &info)){
+            env->DeleteLocalRef(bitmap);
+            continue;
+        }
+        //Whole page scaled to the bitmap
+        target.drawSizeHor = target.canvasHorSize;
+        target.drawSizeVer = target.canvasVerSize;
+
+        targets.push_back(target);
+        locked.push_back(bitmap);
+        addrs.push_back(addr);
+        infos.push_back(info);
+    }
+
+    int rendered = targets.empty() ? 0 : pool->render((int) doc_id, &targets[0], (int) targets.size());
+
+    for(size_t i = 0; i < targets.size(); i++){
+        unlockPoolTarget(env, locked[i], &targets[i], addrs[i], &infos[i]);
+        env->DeleteLocalRef(locked[i]);
+    }
+    return (jint) rendered;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolRenderShared(JNIEnv *env, jobject thiz,
+                                                                    jlong pool_ptr, jint doc_id,
+                                                                    jint page_index, jint width,
+                                                                    jint height,
+                                                                    jboolean render_annot) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    if(pool == NULL || width <= 0 || height <= 0){
+        LOGE("Render pool arguments invalid");
+        return 0;
+    }
+
+    //Page stays in the ring, RGBA byte order like an ARGB_8888 bitmap
+    RenderPool::Target target;
+    target.pageIndex = (int) page_index;
+    target.pixels = NULL;
+    target.format = FPDFBitmap_BGRA;
+    target.canvasHorSize = (int) width;
+    target.canvasVerSize = (int) height;
+    target.stride = (int) width * 4;
+    target.startX = 0;
+    target.startY = 0;
+    target.drawSizeHor = (int) width;
+    target.drawSizeVer = (int) height;
+    target.flags = FPDF_REVERSE_BYTE_ORDER | MemoryGovernor::instance().renderFlags();
+    if(render_annot) {
+        target.flags |= FPDF_ANNOT;
+    }
+
+    if(pool->render((int) doc_id, &target, 1) != 1) return 0;
+    return (jlong) target.ticket;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolMapPage(JNIEnv *env, jobject thiz,
+                                                               jlong pool_ptr, jlong ticket) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    if(pool == NULL || ticket == 0) return NULL;
+
+    void *pixels;
+    const PixelSlot *slot = pool->acquirePage((uint64_t) ticket, &pixels);
+    if(slot == NULL) return NULL;
+
+    //On failure the caller still releases the ticket
+    return env->NewDirectByteBuffer(pixels, (jlong) slot->stride * slot->height);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolReleasePage(JNIEnv *env, jobject thiz,
+                                                                   jlong pool_ptr, jlong ticket) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    if(pool == NULL || ticket == 0) return;
+    pool->releasePage((uint64_t) ticket);
+}
+
+//Async render of one page on a bitmap, through the pool when the document has one
+class BitmapRenderTask : public RenderTask {
+public:
+    jobject lock;           //PdfiumCore lock, held around in-process PDFium calls
+    jobject bitmap;
+    jobject callback;
+    jlong pageHandle;       //resolved under the lock, the page may close while queued
+    RenderPool *pool;
+    int poolDocumentId;
+    int pageIndex;
+    int startX;
+    int startY;
+    int drawSizeHor;
+    int drawSizeVer;
+    bool renderAnnot;
+
+    bool run(JNIEnv *env) {
+        if(pool != NULL){
+            RenderPool::Target target;
+            AndroidBitmapInfo info;
+            void *addr;
+            if(!lockPoolTarget(env, bitmap, pageIndex, startX, startY, drawSizeHor, drawSizeVer,
+                               renderAnnot, &target, &addr, &info)){
+                return false;
+            }
+            int rendered = pool->render(poolDocumentId, &target, 1);
+            unlockPoolTarget(env, bitmap, &target, addr, &info);
+            return rendered == 1;
+        }
+
+        //Same lock as the synchronized Java wrappers, PDFium is not thread safe
+        if(env->MonitorEnter(lock) != JNI_OK) return false;
+        FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(
+                HandleTable::instance().get((int64_t) pageHandle, HANDLE_PAGE));
+        bool ok = page != NULL
+                  && renderPageOnBitmap(env, page, bitmap, startX, startY,
+                                        drawSizeHor, drawSizeVer, renderAnnot);
+        env->MonitorExit(lock);
+        return ok;
+    }
+
+    void complete(JNIEnv *env, int64_t ticket, int state) {
+        if(callback != NULL){
+            jclass clazz = env->GetObjectClass(callback);
+            jmethodID onComplete = env->GetMethodID(clazz, "onRenderComplete", "(JI)V");
+            if(onComplete != NULL){
+                env->CallVoidMethod(callback, onComplete, (jlong) ticket, (jint) state);
+            }
+            env->DeleteLocalRef(clazz);
+            env->DeleteGlobalRef(callback);
+        }
+        env->DeleteGlobalRef(bitmap);
+        env->DeleteGlobalRef(lock);
+    }
+};
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCreateRenderExecutor(JNIEnv *env, jobject thiz,
+                                                                  jint threads) {
+    JavaVM *vm;
+    if(env->GetJavaVM(&vm) != JNI_OK){
+        jniThrowException(env, "java/lang/IllegalStateException", "cannot get VM");
+        return 0;
+    }
+    RenderExecutor *executor = new RenderExecutor(vm, (int) threads);
+    if(executor->threadCount() == 0){
+        delete executor;
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "cannot start render threads");
+        return 0;
+    }
+    return reinterpret_cast<jlong>(executor);
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSubmitRender(JNIEnv *env, jobject thiz,
+                                                          jlong executor_ptr, jobject lock,
+                                                          jlong doc_ptr, jlong page_ptr,
+                                                          jlong pool_ptr, jint pool_doc_id,
+                                                          jint page_index, jobject bitmap,
+                                                          jint start_x, jint start_y,
+                                                          jint draw_size_hor, jint draw_size_ver,
+                                                          jboolean render_annot,
+                                                          jobject callback) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    if(executor == NULL || bitmap == NULL || (page_ptr == 0 && pool_ptr == 0)){
+        LOGE("Render task pointers invalid");
+        return 0;
+    }
+
+    BitmapRenderTask *task = new BitmapRenderTask();
+    task->lock = env->NewGlobalRef(lock);
+    task->bitmap = env->NewGlobalRef(bitmap);
+    task->callback = (callback != NULL)? env->NewGlobalRef(callback) : NULL;
+    task->pageHandle = page_ptr;
+    task->pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    task->poolDocumentId = (int) pool_doc_id;
+    task->pageIndex = (int) page_index;
+    task->startX = (int) start_x;
+    task->startY = (int) start_y;
+    task->drawSizeHor = (int) draw_size_hor;
+    task->drawSizeVer = (int) draw_size_ver;
+    task->renderAnnot = (bool) render_annot;
+
+    return (jlong) executor->submit(task, (intptr_t) doc_ptr);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetRenderStatus(JNIEnv *env, jobject thiz,
+                                                             jlong executor_ptr, jlong ticket) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    return (jint) executor->status((int64_t) ticket);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeAwaitRender(JNIEnv *env, jobject thiz,
+                                                         jlong executor_ptr, jlong ticket,
+                                                         jint timeout_ms) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    return (jint) executor->await((int64_t) ticket, (int) timeout_ms);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCancelRender(JNIEnv *env, jobject thiz,
+                                                          jlong executor_ptr, jlong ticket) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    return (jboolean) executor->cancel(env, (int64_t) ticket);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCancelDocumentRenders(JNIEnv *env, jobject thiz,
+                                                                   jlong executor_ptr,
+                                                                   jlong doc_ptr) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    executor->cancelOwner(env, (intptr_t) doc_ptr);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeShutdownRenderExecutor(JNIEnv *env, jobject thiz,
+                                                                    jlong executor_ptr) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    executor->shutdown();
+}
+
+static jstring newDocumentTextString(JNIEnv *env, const std::vector<unsigned short> &text,
+                                     const std::vector<int32_t> &offsets, jintArray page_offsets){
+    int count = (int) env->GetArrayLength(page_offsets);
+    if(count > (int) offsets.size()) count = (int) offsets.size();
+    env->SetIntArrayRegion(page_offsets, 0, count, (const jint*) &offsets[0]);
+    return env->NewString(text.empty() ? NULL : &text[0], (jsize) text.size());
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetDocumentText(JNIEnv *env, jobject thiz,
+                                                             jlong doc_ptr,
+                                                             jintArray page_offsets) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL){
+        LOGE("Document text pointers invalid");
+        return NULL;
+    }
+
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    std::vector<unsigned short> text;
+    std::vector<int32_t> offsets;
+    appendDocumentText(doc->pdfDocument, 0, pageCount, &sTextScratch, &text, &offsets);
+    trackTextScratch();
+    return newDocumentTextString(env, text, offsets, page_offsets);
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPoolGetDocumentText(JNIEnv *env, jobject thiz,
+                                                                       jlong pool_ptr, jint doc_id,
+                                                                       jint page_count,
+                                                                       jintArray page_offsets) {
+    RenderPool *pool = reinterpret_cast<RenderPool*>(pool_ptr);
+    if(pool == NULL) return NULL;
+
+    std::vector<unsigned short> text;
+    std::vector<int32_t> offsets;
+    if(!pool->extractText((int) doc_id, (int) page_count, &text, &offsets)){
+        LOGE("Render pool text extraction failed");
+        return NULL;
+    }
+    return newDocumentTextString(env, text, offsets, page_offsets);
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextGetCharGeometry(JNIEnv *env, jobject thiz,
+                                                                 jlong text_page_ptr) {
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return NULL;
+
+    std::vector<float> *geometry;
+    std::map<FPDF_TEXTPAGE, std::vector<float>*>::iterator it = sCharGeometry.find(textPage);
+    if(it != sCharGeometry.end()){
+        geometry = it->second;
+    }else{
+        geometry = new std::vector<float>();
+        getCharGeometry(textPage, geometry);
+        sCharGeometry[textPage] = geometry;
+    }
+
+    //Copied out, the cache goes with the text page on close, reload or trim
+    jfloatArray result = env->NewFloatArray((jsize) geometry->size());
+    if(result == NULL) return NULL;
+    if(!geometry->empty()){
+        env->SetFloatArrayRegion(result, 0, (jsize) geometry->size(), &(*geometry)[0]);
+    }
+    return result;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeNewTextSelection(JNIEnv *env, jobject thiz,
+                                                              jlong text_page_ptr) {
+    FPDF_TEXTPAGE textPage = textPageOf(env, text_page_ptr);
+    if(textPage == NULL) return 0;
+    return reinterpret_cast<jlong>(new TextSelection(textPage));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseTextSelection(JNIEnv *env, jobject thiz,
+                                                                jlong selection_ptr) {
+    TextSelection *selection = reinterpret_cast<TextSelection*>(selection_ptr);
+    delete selection;
+}
+
+//Packed selection: start, count, then 4 floats per highlight rect
+static jfloatArray packTextSelection(JNIEnv *env, TextSelection *selection){
+    const std::vector<float> &rects = selection->rects();
+    jfloatArray result = env->NewFloatArray((jsize) (rects.size() + 2));
+    if(result == NULL) return NULL;
+
+    float header[2] = { (float) selection->start(), (float) selection->count() };
+    env->SetFloatArrayRegion(result, 0, 2, header);
+    if(!rects.empty()){
+        env->SetFloatArrayRegion(result, 2, (jsize) rects.size(), &rects[0]);
+    }
+    return result;
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextSelectionUpdate(JNIEnv *env, jobject thiz,
+                                                                 jlong selection_ptr,
+                                                                 jfloat start_x, jfloat start_y,
+                                                                 jfloat end_x, jfloat end_y) {
+    TextSelection *selection = reinterpret_cast<TextSelection*>(selection_ptr);
+    if(selection == NULL) return NULL;
+    if(!selection->update((float) start_x, (float) start_y, (float) end_x, (float) end_y)){
+        return NULL;
+    }
+    return packTextSelection(env, selection);
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextSelectionSelect(JNIEnv *env, jobject thiz,
+                                                                 jlong selection_ptr,
+                                                                 jint start, jint end) {
+    TextSelection *selection = reinterpret_cast<TextSelection*>(selection_ptr);
+    if(selection == NULL) return NULL;
+    if(!selection->select((int) start, (int) end)){
+        return NULL;
+    }
+    return packTextSelection(env, selection);
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextSelectionGetText(JNIEnv *env, jobject thiz,
+                                                                  jlong selection_ptr) {
+    TextSelection *selection = reinterpret_cast<TextSelection*>(selection_ptr);
+    if(selection == NULL || selection->count() == 0){
+        return env->NewStringUTF("");
+    }
+    std::vector<unsigned short> text;
+    selection->selectedText(&text);
+    return env->NewString(&text[0], (jsize) text.size());
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeNewSearchSession(JNIEnv *env, jobject thiz,
+                                                              jlong doc_ptr, jint page_index,
+                                                              jstring query, jint flags) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL){
+        LOGE("Search document pointer invalid");
+        return 0;
+    }
+
+    std::vector<unsigned short> cquery;
+    getSearchQuery(env, query, &cquery);
+
+    SearchSession *session = new SearchSession(doc->pdfDocument, (int) page_index,
+                                               &cquery[0], (unsigned long) flags);
+    if(!session->valid()){
+        delete session;
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "cannot start search");
+        return 0;
+    }
+    return reinterpret_cast<jlong>(session);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseSearchSession(JNIEnv *env, jobject thiz,
+                                                                jlong session_ptr) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    delete session;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSearchSessionNext(JNIEnv *env, jobject thiz,
+                                                               jlong session_ptr) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    if(session == NULL) return JNI_FALSE;
+    return (jboolean) session->next();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSearchSessionPrev(JNIEnv *env, jobject thiz,
+                                                               jlong session_ptr) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    if(session == NULL) return JNI_FALSE;
+    return (jboolean) session->prev();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSearchSessionJump(JNIEnv *env, jobject thiz,
+                                                               jlong session_ptr, jint n) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    if(session == NULL) return JNI_FALSE;
+    return (jboolean) session->jump((int) n);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSearchSessionCount(JNIEnv *env, jobject thiz,
+                                                                jlong session_ptr) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    if(session == NULL) return 0;
+    return (jint) session->count();
+}
+
+//Current match as {match number, char index, char count}
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSearchSessionGetMatch(JNIEnv *env, jobject thiz,
+                                                                   jlong session_ptr) {
+    SearchSession *session = reinterpret_cast<SearchSession*>(session_ptr);
+    if(session == NULL) return NULL;
+    jintArray result = env->NewIntArray(3);
+    if(result == NULL) return NULL;
+
+    jint match[3] = { session->current(), session->charIndex(), session->charCount() };
+    env->SetIntArrayRegion(result, 0, 3, match);
+    return result;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeNewTextSearchIndex(JNIEnv *env, jobject thiz,
+                                                                jstring text) {
+    int length = env->GetStringLength(text);
+    std::vector<unsigned short> ctext(length);
+    if(length > 0) env->GetStringRegion(text, 0, length, &ctext[0]);
+
+    FoldedText *folded = new FoldedText();
+    foldText(length > 0 ? &ctext[0] : NULL, (size_t) length, folded);
+    return reinterpret_cast<jlong>(folded);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseTextSearchIndex(JNIEnv *env, jobject thiz,
+                                                                  jlong index_ptr) {
+    FoldedText *folded = reinterpret_cast<FoldedText*>(index_ptr);
+    delete folded;
+}
+
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTextSearchIndexFind(JNIEnv *env, jobject thiz,
+                                                                 jlong index_ptr, jstring query,
+                                                                 jint flags) {
+    FoldedText *folded = reinterpret_cast<FoldedText*>(index_ptr);
+    if(folded == NULL) return NULL;
+
+    int length = env->GetStringLength(query);
+    std::vector<unsigned short> cquery(length);
+    if(length > 0) env->GetStringRegion(query, 0, length, &cquery[0]);
+
+    std::vector<int32_t> matches;
+    if(length > 0) searchFoldedText(*folded, &cquery[0], (size_t) length, (int) flags, &matches);
+
+    jintArray result = env->NewIntArray((jsize) matches.size());
+    if(result != NULL && !matches.empty()){
+        env->SetIntArrayRegion(result, 0, (jsize) matches.size(), (const jint*) &matches[0]);
+    }
+    return result;
+}
+
+/*
+ * Regex search over a page range. Every page is one executor task: text and
+ * boxes are copied out under the PdfiumCore lock, the DFA match and rects run
+ * outside it, so pages match in parallel and results stream back per page.
+ */
+struct RegexSearch {
+    int id;
+    jobject callback;
+    TextRegex *regex;
+    int remaining;          //page tasks not completed yet
+    int total;              //matches reported so far
+    int cancelled;
+};
+
+static Mutex sRegexSearchesLock;
+static std::map<int, RegexSearch*> sRegexSearches;
+static int sNextRegexSearchId = 1;
+
+class RegexPageTask : public RenderTask {
+public:
+    jobject lock;
+    RegexSearch *search;
+    DocumentFile *doc;
+    int pageIndex;
+    std::vector<int32_t> matches;
+    std::vector<float> rects;       //per match: rect count, then 4 floats per rect
+
+    bool run(JNIEnv *env) {
+        if(__atomic_load_n(&search->cancelled, __ATOMIC_ACQUIRE)) return false;
+
+        if(env->MonitorEnter(lock) != JNI_OK) return false;
+        TextSelection *selection = NULL;
+        FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+        if(page != NULL){
+            FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+            if(textPage != NULL){
+                selection = new TextSelection(textPage);
+                FPDFText_ClosePage(textPage);
+            }
+            FPDF_ClosePage(page);
+        }
+        env->MonitorExit(lock);
+        if(selection == NULL) return false;
+
+        const std::vector<unsigned short> &text = selection->pageText();
+        if(!text.empty()){
+            search->regex->findAll(&text[0], (int) text.size(), &matches);
+        }
+        for(size_t i = 0; i < matches.size(); i += 2){
+            selection->select(matches[i], matches[i] + matches[i + 1] - 1);
+            const std::vector<float> &matchRects = selection->rects();
+            rects.push_back((float) (matchRects.size() / 4));
+            rects.insert(rects.end(), matchRects.begin(), matchRects.end());
+        }
+        delete selection;
+        return true;
+    }
+
+    void complete(JNIEnv *env, int64_t ticket, int state) {
+        jclass clazz = env->GetObjectClass(search->callback);
+        if(state == RENDER_TASK_DONE && !matches.empty()
+           && !__atomic_load_n(&search->cancelled, __ATOMIC_ACQUIRE)){
+            jmethodID onMatches = env->GetMethodID(clazz, "onRegexMatches", "(I[I[F)V");
+            jintArray jmatches = env->NewIntArray((jsize) matches.size());
+            jfloatArray jrects = env->NewFloatArray((jsize) rects.size());
+            if(onMatches != NULL && jmatches != NULL && jrects != NULL){
+                env->SetIntArrayRegion(jmatches, 0, (jsize) matches.size(), (const jint*) &matches[0]);
+                env->SetFloatArrayRegion(jrects, 0, (jsize) rects.size(), &rects[0]);
+                env->CallVoidMethod(search->callback, onMatches, (jint) pageIndex, jmatches, jrects);
+                __atomic_add_fetch(&search->total, (int) (matches.size() / 2), __ATOMIC_RELAXED);
+            }
+            if(jmatches != NULL) env->DeleteLocalRef(jmatches);
+            if(jrects != NULL) env->DeleteLocalRef(jrects);
+        }
+        if(state == RENDER_TASK_CANCELLED){
+            __atomic_store_n(&search->cancelled, 1, __ATOMIC_RELEASE);
+        }
+
+        if(__atomic_sub_fetch(&search->remaining, 1, __ATOMIC_ACQ_REL) == 0){
+            {
+                Mutex::Autolock autolock(sRegexSearchesLock);
+                sRegexSearches.erase(search->id);
+            }
+            jmethodID onComplete = env->GetMethodID(clazz, "onRegexSearchComplete", "(IZ)V");
+            if(onComplete != NULL){
+                env->CallVoidMethod(search->callback, onComplete,
+                                    (jint) __atomic_load_n(&search->total, __ATOMIC_RELAXED),
+                                    (jboolean) (__atomic_load_n(&search->cancelled, __ATOMIC_ACQUIRE) != 0));
+            }
+            search->regex->release();
+            env->DeleteGlobalRef(search->callback);
+            delete search;
+        }
+        env->DeleteLocalRef(clazz);
+        env->DeleteGlobalRef(lock);
+    }
+};
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeStartRegexSearch(JNIEnv *env, jobject thiz,
+                                                              jlong executor_ptr, jobject lock,
+                                                              jlong doc_ptr, jstring pattern,
+                                                              jint from_page, jint to_page,
+                                                              jobject callback) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(executor == NULL || doc == NULL || callback == NULL || from_page >= to_page){
+        LOGE("Regex search arguments invalid");
+        return 0;
+    }
+
+    int length = env->GetStringLength(pattern);
+    std::vector<unsigned short> cpattern(length);
+    if(length > 0) env->GetStringRegion(pattern, 0, length, &cpattern[0]);
+
+    std::string error;
+    TextRegex *regex = TextRegex::acquire(length > 0 ? &cpattern[0] : NULL, (size_t) length, &error);
+    if(regex == NULL){
+        jniThrowException(env, "java/lang/IllegalArgumentException", error.c_str());
+        return 0;
+    }
+
+    RegexSearch *search = new RegexSearch();
+    search->callback = env->NewGlobalRef(callback);
+    search->regex = regex;
+    search->remaining = (int) (to_page - from_page);
+    search->total = 0;
+    search->cancelled = 0;
+    {
+        Mutex::Autolock autolock(sRegexSearchesLock);
+        search->id = sNextRegexSearchId++;
+        sRegexSearches[search->id] = search;
+    }
+    //Search may complete and be freed as soon as its last page is submitted
+    int id = search->id;
+
+    for(int i = (int) from_page; i < (int) to_page; i++){
+        RegexPageTask *task = new RegexPageTask();
+        task->lock = env->NewGlobalRef(lock);
+        task->search = search;
+        task->doc = doc;
+        task->pageIndex = i;
+        executor->submit(task, (intptr_t) doc_ptr);
+    }
+    return (jint) id;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCancelRegexSearch(JNIEnv *env, jobject thiz,
+                                                               jint search_id) {
+    Mutex::Autolock lock(sRegexSearchesLock);
+    std::map<int, RegexSearch*>::iterator it = sRegexSearches.find((int) search_id);
+    if(it != sRegexSearches.end()){
+        __atomic_store_n(&it->second->cancelled, 1, __ATOMIC_RELEASE);
+    }
+}
+
+//Web link detection of a loaded text page, queued so loading text never waits for it
+class WebLinkTask : public RenderTask {
+public:
+    jobject lock;
+    WebLinkCache *webLinks;     //own reference
+    jlong textPageHandle;
+    int pageIndex;
+
+    bool run(JNIEnv *env) {
+        if(webLinks->hasPage(pageIndex)) return true;
+        //The lock covers the FPDFLink calls only, storing the page does not need it
+        if(env->MonitorEnter(lock) != JNI_OK) return false;
+        //Text page closed since, detection runs again when it is reloaded
+        FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(
+                HandleTable::instance().get((int64_t) textPageHandle, HANDLE_TEXT_PAGE));
+        WebLinkCache::Page *page = (textPage != NULL)? WebLinkCache::load(textPage) : NULL;
+        env->MonitorExit(lock);
+        if(page == NULL) return false;
+        webLinks->store(pageIndex, page);
+        return true;
+    }
+
+    void complete(JNIEnv *env, int64_t ticket, int state) {
+        env->DeleteGlobalRef(lock);
+        webLinks->release();
+    }
+};
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeDetectWebLinks(JNIEnv *env, jobject thiz,
+                                                            jlong executor_ptr, jobject lock,
+                                                            jlong doc_ptr, jint page_index,
+                                                            jlong text_page_ptr) {
+    RenderExecutor *executor = reinterpret_cast<RenderExecutor*>(executor_ptr);
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(executor == NULL || doc == NULL || text_page_ptr == 0){
+        LOGE("Web link arguments invalid");
+        return 0;
+    }
+    if(doc->webLinks->hasPage((int) page_index)) return 0;
+
+    WebLinkTask *task = new WebLinkTask();
+    task->lock = env->NewGlobalRef(lock);
+    task->webLinks = doc->webLinks;
+    task->webLinks->acquire();
+    task->textPageHandle = text_page_ptr;
+    task->pageIndex = (int) page_index;
+    return (jlong) executor->submit(task, (intptr_t) doc_ptr);
+}
+
+//Reference to the web link cache of a document, for lookups that run without the PDFium lock
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeAcquireWebLinks(JNIEnv *env, jobject thiz,
+                                                             jlong doc_ptr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL) return 0;
+    doc->webLinks->acquire();
+    return reinterpret_cast<jlong>(doc->webLinks);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeReleaseWebLinks(JNIEnv *env, jobject thiz,
+                                                             jlong web_links_ptr) {
+    WebLinkCache *webLinks = reinterpret_cast<WebLinkCache*>(web_links_ptr);
+    if(webLinks != NULL) webLinks->release();
+}
+
+//Detected links as {String[] urls, float[] rects}, rects packed per link as rect count then 4 floats each
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetWebLinks(JNIEnv *env, jobject thiz,
+                                                         jlong web_links_ptr, jint page_index) {
+    WebLinkCache *webLinks = reinterpret_cast<WebLinkCache*>(web_links_ptr);
+    if(webLinks == NULL) return NULL;
+
+    std::vector<unsigned short> urls;
+    std::vector<int32_t> urlStarts;
+    std::vector<float> rects;
+    std::vector<int32_t> rectStarts;
+    if(!webLinks->getPage((int) page_index, &urls, &urlStarts, &rects, &rectStarts)){
+        return NULL;
+    }
+
+    int count = (int) urlStarts.size() - 1;
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray jurls = env->NewObjectArray((jsize) count, stringClass, NULL);
+    jfloatArray jrects = env->NewFloatArray((jsize) (rects.size() + count));
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jobjectArray result = env->NewObjectArray(2, objectClass, NULL);
+    if(jurls == NULL || jrects == NULL || result == NULL) return NULL;
+
+    std::vector<float> packed;
+    packed.reserve(rects.size() + count);
+    for(int i = 0; i < count; i++){
+        jstring url = env->NewString(urls.empty() ? NULL : &urls[urlStarts[i]],
+                                     (jsize) (urlStarts[i + 1] - urlStarts[i]));
+        env->SetObjectArrayElement(jurls, i, url);
+        env->DeleteLocalRef(url);
+
+        packed.push_back((float) ((rectStarts[i + 1] - rectStarts[i]) / 4));
+        packed.insert(packed.end(), rects.begin() + rectStarts[i], rects.begin() + rectStarts[i + 1]);
+    }
+    if(!packed.empty()) env->SetFloatArrayRegion(jrects, 0, (jsize) packed.size(), &packed[0]);
+
+    env->SetObjectArrayElement(result, 0, jurls);
+    env->SetObjectArrayElement(result, 1, jrects);
+    return result;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetWebLinkAt(JNIEnv *env, jobject thiz,
+                                                          jlong web_links_ptr, jint page_index,
+                                                          jfloat x, jfloat y) {
+    WebLinkCache *webLinks = reinterpret_cast<WebLinkCache*>(web_links_ptr);
+    if(webLinks == NULL) return NULL;
+
+    std::vector<unsigned short> url;
+    if(webLinks->linkAt((int) page_index, (float) x, (float) y, &url) != 1) return NULL;
+    return env->NewString(url.empty() ? NULL : &url[0], (jsize) url.size());
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeNewHitIndex(JNIEnv *env, jobject thiz,
+                                                         jlong doc_ptr, jint page_index,
+                                                         jlong page_ptr, jlong text_page_ptr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(
+            HandleTable::instance().get((int64_t) text_page_ptr, HANDLE_TEXT_PAGE));
+    if(doc == NULL || page == NULL){
+        LOGE("Hit index pointers invalid");
+        return 0;
+    }
+
+    std::vector<PageLink> links;
+    getPageLinks(doc->pdfDocument, page, &links);
+
+    //Detect web links now if the background pass has not got to the page yet
+    std::vector<unsigned short> webUrls;
+    std::vector<int32_t> webUrlStarts;
+    std::vector<float> webRects;
+    std::vector<int32_t> webRectStarts;
+    std::vector<float> charGeometry;
+    if(textPage != NULL){
+        doc->webLinks->detect((int) page_index, textPage);
+        doc->webLinks->getPage((int) page_index, &webUrls, &webUrlStarts, &webRects, &webRectStarts);
+        getCharGeometry(textPage, &charGeometry);
+    }
+
+    HitIndex *index = new HitIndex((float) FPDF_GetPageWidth(page), (float) FPDF_GetPageHeight(page),
+                                   links, webUrls, webUrlStarts, webRects, webRectStarts,
+                                   charGeometry);
+    return reinterpret_cast<jlong>(index);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeCloseHitIndex(JNIEnv *env, jobject thiz,
+                                                           jlong index_ptr) {
+    HitIndex *index = reinterpret_cast<HitIndex*>(index_ptr);
+    delete index;
+}
+
+//Hit packed as kind << 32 | id, 0 when nothing is under the point
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeHitTest(JNIEnv *env, jobject thiz,
+                                                     jlong index_ptr, jfloat x, jfloat y,
+                                                     jfloat tolerance) {
+    HitIndex *index = reinterpret_cast<HitIndex*>(index_ptr);
+    if(index == NULL) return 0;
+
+    int id = 0;
+    int kind = index->hitTest((float) x, (float) y, (float) tolerance, &id);
+    if(kind == HIT_NONE) return 0;
+    return ((jlong) kind << 32) | (uint32_t) id;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeHitIndexGetLink(JNIEnv *env, jobject thiz,
+                                                             jlong index_ptr, jlong hit) {
+    HitIndex *index = reinterpret_cast<HitIndex*>(index_ptr);
+    if(index == NULL) return NULL;
+    int kind = (int) (hit >> 32);
+    int id = (int) (uint32_t) hit;
+
+    float bounds[4];
+    jobject destPageIndex = NULL;
+    jstring uri = NULL;
+    if(kind == HIT_LINK && id >= 0 && id < (int) index->links().size()){
+        const PageLink &link = index->links()[id];
+        bounds[0] = (float) link.left;
+        bounds[1] = (float) link.top;
+        bounds[2] = (float) link.right;
+        bounds[3] = (float) link.bottom;
+        if(link.destPageIndex >= 0) destPageIndex = NewInteger(env, (jint) link.destPageIndex);
+        if(!link.uri.empty()) uri = env->NewStringUTF(link.uri.c_str());
+    }else if(kind == HIT_WEB_LINK && id >= 0 && id < index->webLinkCount()){
+        const float *linkBounds = index->webLinkBounds(id);
+        for(int i = 0; i < 4; i++) bounds[i] = linkBounds[i];
+        std::vector<unsigned short> url;
+        index->webLinkUrl(id, &url);
+        uri = env->NewString(url.empty() ? NULL : &url[0], (jsize) url.size());
+    }else{
+        return NULL;
+    }
+
+    jclass rectClass = env->FindClass("android/graphics/RectF");
+    jmethodID rectConstructor = env->GetMethodID(rectClass, "<init>", "(FFFF)V");
+    jobject rect = env->NewObject(rectClass, rectConstructor, bounds[0], bounds[1], bounds[2], bounds[3]);
+
+    jclass linkClass = env->FindClass("com/example/ndktesting/PdfDocument$Link");
+    jmethodID linkConstructor = env->GetMethodID(linkClass, "<init>",
+            "(Landroid/graphics/RectF;Ljava/lang/Integer;Ljava/lang/String;)V");
+    return env->NewObject(linkClass, linkConstructor, rect, destPageIndex, uri);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeBuildNamedDestIndex(JNIEnv *env, jobject thiz,
+                                                                 jlong doc_ptr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL) return 0;
+    doc->namedDests.build(doc->pdfDocument);
+    return (jint) doc->namedDests.count();
+}
+
+//Page of a named destination, -1 if unknown, -2 while the index is not built
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFindNamedDest(JNIEnv *env, jobject thiz,
+                                                           jlong doc_ptr, jstring name) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL) return -1;
+    if(!doc->namedDests.built()) return -2;
+
+    int length = env->GetStringLength(name);
+    std::vector<unsigned short> cname(length);
+    if(length > 0) env->GetStringRegion(name, 0, length, &cname[0]);
+    return (jint) doc->namedDests.find(length > 0 ? &cname[0] : NULL, (size_t) length);
+}
+
+static jstring newUtf16String(JNIEnv *env, const unsigned short *text, size_t length){
+    return env->NewString(length > 0 ? text : NULL, (jsize) length);
+}
+
+/*
+ * Summary as {int[] {pageCount, thumbnailWidth, thumbnailHeight}, float[] pageSizes,
+ * String[] meta, String[] outlineTitles, int[] outline (depth, pageIndex pairs), int[] thumbnail}
+ */
+static jobjectArray newDocumentSummaryArrays(JNIEnv *env, const DocumentSummary &summary){
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray result = env->NewObjectArray(6, objectClass, NULL);
+    if(result == NULL) return NULL;
+
+    jint header[3] = { summary.pageCount, summary.thumbnailWidth, summary.thumbnailHeight };
+    jintArray jheader = env->NewIntArray(3);
+    env->SetIntArrayRegion(jheader, 0, 3, header);
+    env->SetObjectArrayElement(result, 0, jheader);
+
+    jfloatArray sizes = env->NewFloatArray((jsize) summary.pageSizes.size());
+    if(!summary.pageSizes.empty()){
+        env->SetFloatArrayRegion(sizes, 0, (jsize) summary.pageSizes.size(), &summary.pageSizes[0]);
+    }
+    env->SetObjectArrayElement(result, 1, sizes);
+
+    jobjectArray meta = env->NewObjectArray(DOC_SUMMARY_META_COUNT, stringClass, NULL);
+    for(int i = 0; i < DOC_SUMMARY_META_COUNT; i++){
+        jstring text = newUtf16String(env, summary.meta[i].empty() ? NULL : &summary.meta[i][0],
+                                      summary.meta[i].size());
+        env->SetObjectArrayElement(meta, i, text);
+        env->DeleteLocalRef(text);
+    }
+    env->SetObjectArrayElement(result, 2, meta);
+
+    jsize outlineCount = (jsize) summary.outline.size();
+    jobjectArray titles = env->NewObjectArray(outlineCount, stringClass, NULL);
+    std::vector<jint> outline((size_t) outlineCount * 2);
+    for(jsize i = 0; i < outlineCount; i++){
+        const OutlineEntry &entry = summary.outline[i];
+        jstring title = newUtf16String(env, entry.titleLength > 0 ? &summary.outlineTitles[entry.titleStart] : NULL,
+                                       (size_t) entry.titleLength);
+        env->SetObjectArrayElement(titles, i, title);
+        env->DeleteLocalRef(title);
+        outline[i * 2] = entry.depth;
+        outline[i * 2 + 1] = entry.pageIndex;
+    }
+    env->SetObjectArrayElement(result, 3, titles);
+
+    jintArray joutline = env->NewIntArray((jsize) outline.size());
+    if(!outline.empty()) env->SetIntArrayRegion(joutline, 0, (jsize) outline.size(), &outline[0]);
+    env->SetObjectArrayElement(result, 4, joutline);
+
+    jintArray thumbnail = env->NewIntArray((jsize) summary.thumbnail.size());
+    if(!summary.thumbnail.empty()){
+        env->SetIntArrayRegion(thumbnail, 0, (jsize) summary.thumbnail.size(),
+                               (const jint*) &summary.thumbnail[0]);
+    }
+    env->SetObjectArrayElement(result, 5, thumbnail);
+    return result;
+}
+
+//Cached summary of the file, NULL on a miss; does not touch PDFium
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeReadDocumentSummary(JNIEnv *env, jobject thiz,
+                                                                 jint fd, jstring cache_dir) {
+    DocumentKey key;
+    if(cache_dir == NULL || !getDocumentKey((int) fd, &key)) return NULL;
+
+    const char *cdir = env->GetStringUTFChars(cache_dir, NULL);
+    std::string path = documentSummaryPath(cdir, key);
+    env->ReleaseStringUTFChars(cache_dir, cdir);
+
+    DocumentSummary summary;
+    if(!readDocumentSummary(path, key, &summary)) return NULL;
+    touchDocumentSummary(path);
+    return newDocumentSummaryArrays(env, summary);
+}
+
+//Build the summary of an open document, stored in cache_dir when fd and cache_dir are given
+//and the document has no in-memory edits
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeBuildDocumentSummary(JNIEnv *env, jobject thiz,
+                                                                  jlong doc_ptr, jint fd,
+                                                                  jstring cache_dir,
+                                                                  jint thumbnail_width) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL){
+        LOGE("Summary document pointer invalid");
+        return NULL;
+    }
+
+    DocumentSummary summary;
+    buildDocumentSummary(doc->pdfDocument, (int) thumbnail_width, &summary);
+
+    DocumentKey key;
+    if(fd >= 0 && cache_dir != NULL && !doc->isModified() && getDocumentKey((int) fd, &key)){
+        const char *cdir = env->GetStringUTFChars(cache_dir, NULL);
+        if(writeDocumentSummary(documentSummaryPath(cdir, key), key, summary)){
+            trimDocumentSummaries(cdir, DOC_SUMMARY_CACHE_MAX_BYTES);
+        }
+        env->ReleaseStringUTFChars(cache_dir, cdir);
+    }
+    return newDocumentSummaryArrays(env, summary);
+}
+
+//Drop what the document derived from pages from_index..to_index, after their content changed
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeInvalidatePageIndexes(JNIEnv *env, jobject thiz,
+                                                                   jlong doc_ptr, jint from_index,
+                                                                   jint to_index) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL) return;
+    doc->webLinks->invalidate((int) from_index, (int) to_index);
+    //Destinations keep their page but flattening can drop link targets, rebuild to be sure
+    doc->namedDests.invalidate();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeIsDocumentModified(JNIEnv *env, jobject thiz,
+                                                                jlong doc_ptr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    return (jboolean) (doc != NULL && doc->isModified());
+}
+
+//Load the font index, building it from font_dirs when stale; slow the first time, no lock needed
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeLoadFontIndex(JNIEnv *env, jobject thiz,
+                                                           jstring index_path, jobjectArray font_dirs) {
+    std::string indexPath;
+    if(index_path != NULL){
+        const char *cpath = env->GetStringUTFChars(index_path, NULL);
+        indexPath = cpath;
+        env->ReleaseStringUTFChars(index_path, cpath);
+    }
+    std::vector<std::string> directories;
+    jsize count = (font_dirs != NULL)? env->GetArrayLength(font_dirs) : 0;
+    for(jsize i = 0; i < count; i++){
+        jstring dir = (jstring) env->GetObjectArrayElement(font_dirs, i);
+        if(dir == NULL) continue;
+        const char *cdir = env->GetStringUTFChars(dir, NULL);
+        directories.push_back(cdir);
+        env->ReleaseStringUTFChars(dir, cdir);
+        env->DeleteLocalRef(dir);
+    }
+    return (jint) FontProvider::instance().load(indexPath, directories);
+}
+
+//Hand the loaded index to PDFium now if the library is up, otherwise at its next init
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeInstallFontIndex(JNIEnv *env, jobject thiz) {
+    PdfiumLibrary::instance().installFontProvider();
+}
+
+//Initialize PDFium on a background thread and keep it grace_ms past the last document, <0 for good
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeWarmUpLibrary(JNIEnv *env, jobject thiz, jint grace_ms) {
+    PdfiumLibrary::instance().warmUp((int) grace_ms);
+}
+
+//ComponentCallbacks2 trim level, returns bytes the native trim handlers released
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTrimMemory(JNIEnv *env, jobject thiz, jint level) {
+    return (jlong) MemoryGovernor::instance().trim((int) level);
+}
+
+//Tracked native bytes indexed by MemoryCategory
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeGetMemoryUsage(JNIEnv *env, jobject thiz) {
+    int64_t usage[MEMORY_CATEGORY_COUNT];
+    MemoryGovernor::instance().usage(usage);
+
+    jlongArray result = env->NewLongArray(MEMORY_CATEGORY_COUNT);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, MEMORY_CATEGORY_COUNT, (const jlong*) usage);
+    return result;
+}
+
+
+struct SaveCallback {
+    JNIEnv *env;
+    jobject callback;
+    jmethodID onProgress;
+};
+
+static void reportSaveProgress(int64_t written, void *arg){
+    SaveCallback *save = static_cast<SaveCallback*>(arg);
+    //A throwing callback is rethrown in Java once the save returns
+    if(save->env->ExceptionCheck()) return;
+    save->env->CallVoidMethod(save->callback, save->onProgress, (jlong) written);
+}
+
+//Only an incremental save may go into the file the document reads from, throws otherwise
+static bool checkSaveTarget(JNIEnv *env, DocumentFile *doc, int fd, int flags){
+    if(flags == FPDF_INCREMENTAL || !doc->isSourceFile(fd)) return true;
+    jniThrowException(env, "java/lang/IllegalArgumentException",
+                      "cannot rewrite the file the document reads from, save to another file");
+    return false;
+}
+
+//Streamed save reporting to a SaveCallback, throws IOException on failure; returns the file size
+static jlong saveWithCallback(JNIEnv *env, FPDF_DOCUMENT document, int fd, int flags,
+                              int64_t skipBytes, jobject callback){
+    SaveCallback save;
+    SaveOptions options;
+    options.flags = flags;
+    options.skipBytes = skipBytes;
+    options.progress = NULL;
+    options.progressArg = NULL;
+    if(callback != NULL){
+        jclass clazz = env->GetObjectClass(callback);
+        save.env = env;
+        save.callback = callback;
+        save.onProgress = env->GetMethodID(clazz, "onSaveProgress", "(J)V");
+        env->DeleteLocalRef(clazz);
+        if(save.onProgress == NULL) return -1;
+        options.progress = reportSaveProgress;
+        options.progressArg = &save;
+    }
+
+    int64_t written;
+    int error = saveDocumentToFd(document, fd, options, &written);
+    if(error != 0){
+        if(!env->ExceptionCheck()){
+            jniThrowExceptionFmt(env, "java/io/IOException", "cannot save document: %s",
+                                 strerror(error));
+        }
+        return -1;
+    }
+    return (jlong) written;
+}
+
+/*
+ * Save into fd, incremental when asked. With append the fd must be the file the document was
+ * opened from: only the new revision is written after its original bytes. Returns the file size.
+ */
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeSaveDocument(JNIEnv *env, jobject thiz,
+                                                          jlong doc_ptr, jint fd,
+                                                          jboolean incremental, jboolean append,
+                                                          jobject callback) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL || fd < 0){
+        jniThrowException(env, "java/lang/IllegalArgumentException", "invalid document or fd");
+        return -1;
+    }
+    if(append && doc->fileSize == 0){
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "document was not loaded from a file");
+        return -1;
+    }
+
+    int flags = (incremental || append)? FPDF_INCREMENTAL : FPDF_NO_INCREMENTAL;
+    if(!checkSaveTarget(env, doc, (int) fd, flags)) return -1;
+    return saveWithCallback(env, doc->pdfDocument, (int) fd, flags,
+                            append ? (int64_t) doc->fileSize : 0, callback);
+}
+
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeAssembleDocuments(JNIEnv *env, jobject thiz,
+                                                               jstring worker_path,
+                                                               jintArray source_fds,
+                                                               jintArray output_fds,
+                                                               jintArray part_outputs,
+                                                               jintArray part_sources,
+                                                               jobjectArray part_pages,
+                                                               jint max_processes) {
+    int sourceCount = (int) env->GetArrayLength(source_fds);
+    int outputCount = (int) env->GetArrayLength(output_fds);
+    int partCount = (int) env->GetArrayLength(part_outputs);
+    if(partCount != (int) env->GetArrayLength(part_sources)
+       || partCount != (int) env->GetArrayLength(part_pages)){
+        jniThrowException(env, "java/lang/IllegalArgumentException", "part arrays differ in length");
+        return NULL;
+    }
+
+    std::vector<jint> sourceFds(sourceCount);
+    std::vector<jint> outputFds(outputCount);
+    std::vector<jint> partOutputs(partCount);
+    std::vector<jint> partSources(partCount);
+    if(sourceCount > 0) env->GetIntArrayRegion(source_fds, 0, sourceCount, &sourceFds[0]);
+    if(outputCount > 0) env->GetIntArrayRegion(output_fds, 0, outputCount, &outputFds[0]);
+    if(partCount > 0){
+        env->GetIntArrayRegion(part_outputs, 0, partCount, &partOutputs[0]);
+        env->GetIntArrayRegion(part_sources, 0, partCount, &partSources[0]);
+    }
+
+    std::vector<int> sources(sourceFds.begin(), sourceFds.end());
+    std::vector<AssembleOutput> outputs(outputCount);
+    for(int i = 0; i < outputCount; i++) outputs[i].fd = (int) outputFds[i];
+    for(int i = 0; i < partCount; i++){
+        if(partOutputs[i] < 0 || partOutputs[i] >= outputCount
+           || partSources[i] < 0 || partSources[i] >= sourceCount){
+            jniThrowException(env, "java/lang/IllegalArgumentException", "part index out of range");
+            return NULL;
+        }
+        AssemblePart part;
+        part.source = (int) partSources[i];
+        jstring pages = (jstring) env->GetObjectArrayElement(part_pages, i);
+        if(pages != NULL){
+            const char *cpages = env->GetStringUTFChars(pages, NULL);
+            part.pages = cpages;
+            env->ReleaseStringUTFChars(pages, cpages);
+            env->DeleteLocalRef(pages);
+        }
+        outputs[partOutputs[i]].parts.push_back(part);
+    }
+
+    //Workers own their PDFium instance, no need for the library lock here
+    const char *cpath = env->GetStringUTFChars(worker_path, NULL);
+    std::vector<int> statuses;
+    assembleDocuments(cpath, sources, outputs, (int) max_processes, &statuses);
+    env->ReleaseStringUTFChars(worker_path, cpath);
+
+    jintArray result = env->NewIntArray((jsize) outputCount);
+    if(result == NULL) return NULL;
+    for(int i = 0; i < outputCount; i++){
+        jint status = (jint) statuses[i];
+        env->SetIntArrayRegion(result, i, 1, &status);
+    }
+    return result;
+}
+
+static jfloatArray packSheetLayout(JNIEnv *env, const SheetLayout &layout){
+    jfloat values[6] = {layout.width, layout.height, layout.margin, layout.gap,
+                        (jfloat) layout.rows, (jfloat) layout.cols};
+    jfloatArray result = env->NewFloatArray(6);
+    if(result != NULL) env->SetFloatArrayRegion(result, 0, 6, values);
+    return result;
+}
+
+static bool unpackSheetLayout(JNIEnv *env, jfloatArray values, SheetLayout *layout){
+    if(values == NULL || env->GetArrayLength(values) != 6){
+        jniThrowException(env, "java/lang/IllegalArgumentException", "invalid sheet layout");
+        return false;
+    }
+    jfloat packed[6];
+    env->GetFloatArrayRegion(values, 0, 6, packed);
+    layout->width = packed[0];
+    layout->height = packed[1];
+    layout->margin = packed[2];
+    layout->gap = packed[3];
+    layout->rows = (int) packed[4];
+    layout->cols = (int) packed[5];
+    if(layout->rows < 1 || layout->cols < 1 || layout->width <= 0 || layout->height <= 0){
+        jniThrowException(env, "java/lang/IllegalArgumentException", "invalid sheet layout");
+        return false;
+    }
+    return true;
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeChooseSheetLayout(JNIEnv *env, jobject thiz,
+                                                               jlong doc_ptr, jint page_index,
+                                                               jint pages_per_sheet,
+                                                               jfloat sheet_width,
+                                                               jfloat sheet_height,
+                                                               jfloat margin, jfloat gap) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL) return NULL;
+
+    double width, height;
+    if(!FPDF_GetPageSizeByIndex(doc->pdfDocument, (int) page_index, &width, &height)){
+        jniThrowException(env, "java/lang/IndexOutOfBoundsException", "no such page");
+        return NULL;
+    }
+    SheetLayout layout = chooseSheetLayout((float) sheet_width, (float) sheet_height,
+                                           (int) pages_per_sheet, (float) width, (float) height,
+                                           (float) margin, (float) gap);
+    return packSheetLayout(env, layout);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTransformPagesToSheet(JNIEnv *env, jobject thiz,
+                                                                   jlong doc_ptr, jint from_index,
+                                                                   jint to_index,
+                                                                   jfloat sheet_width,
+                                                                   jfloat sheet_height,
+                                                                   jfloat margin) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL) return 0;
+
+    int transformed = 0;
+    for(int i = (int) from_index; i <= (int) to_index; i++){
+        //Own page object, cached ones are reloaded by the caller to see the new content
+        FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, i);
+        if(page == NULL){
+            LOGE("Page %d not loaded for transform", i);
+            continue;
+        }
+        //One page per sheet, the sheet turns with the page
+        SheetLayout layout = chooseSheetLayout((float) sheet_width, (float) sheet_height, 1,
+                                               (float) FPDF_GetPageWidth(page),
+                                               (float) FPDF_GetPageHeight(page),
+                                               (float) margin, 0);
+        if(transformPageToSheet(page, layout, 0)) transformed++;
+        FPDF_ClosePage(page);
+    }
+    if(transformed > 0) doc->modified = true;
+    return transformed;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderSheet(JNIEnv *env, jobject thiz,
+                                                         jlong doc_ptr, jobject bitmap,
+                                                         jint first_page, jfloatArray layout_values,
+                                                         jboolean render_annot) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    SheetLayout layout;
+    if(doc == NULL || doc->pdfDocument == NULL || bitmap == NULL) return;
+    if(!unpackSheetLayout(env, layout_values, &layout)) return;
+
+    AndroidBitmapInfo info;
+    int ret;
+    if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return;
+    }
+    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888){
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                          "sheet bitmap must be ARGB_8888");
+        return;
+    }
+
+    void *addr;
+    if((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0){
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return;
+    }
+
+    int flags = FPDF_REVERSE_BYTE_ORDER | FPDF_PRINTING | MemoryGovernor::instance().renderFlags();
+    if(render_annot) flags |= FPDF_ANNOT;
+    renderSheet(doc->pdfDocument, (int) first_page, layout, addr, FPDFBitmap_BGRA,
+                (int) info.stride, (int) info.width, (int) info.height, flags);
+
+    AndroidBitmap_unlockPixels(env, bitmap);
+}
+
+/*
+ * Flatten pages fromIndex..toIndex, then save into fd unless it is negative. The save is a full
+ * rewrite so the annotations do not survive in an earlier revision. Returns flattened, unchanged
+ * and failed page counts.
+ */
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFlattenDocument(JNIEnv *env, jobject thiz,
+                                                             jlong doc_ptr, jint from_index,
+                                                             jint to_index, jint mode, jint fd,
+                                                             jobject callback) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->pdfDocument == NULL){
+        jniThrowException(env, "java/lang/IllegalArgumentException", "invalid document");
+        return NULL;
+    }
+
+    //Before flattening, a refused save must leave the document as it was
+    if(fd >= 0 && !checkSaveTarget(env, doc, (int) fd, FPDF_NO_INCREMENTAL)) return NULL;
+
+    FlattenCounts counts;
+    flattenPages(doc->pdfDocument, (int) from_index, (int) to_index, (int) mode, &counts);
+    if(counts.flattened > 0) doc->modified = true;
+
+    if(fd >= 0 && saveWithCallback(env, doc->pdfDocument, (int) fd, FPDF_NO_INCREMENTAL, 0,
+                                   callback) < 0){
+        return NULL;
+    }
+
+    jint values[3] = {counts.flattened, counts.unchanged, counts.failed};
+    jintArray result = env->NewIntArray(3);
+    if(result != NULL) env->SetIntArrayRegion(result, 0, 3, values);
+    return result;
+}
+
+static FormFill* formFillOf(JNIEnv *env, jlong doc_ptr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(doc_ptr);
+    if(doc == NULL || doc->formFill == NULL || doc->formFill->handle() == NULL){
+        jniThrowException(env, "java/lang/IllegalStateException", "document has no form environment");
+        return NULL;
+    }
+    return doc->formFill;
+}
+
+//Actions of nativeFormMouse, match PdfiumCore.FORM_TOUCH_*
+#define FORM_TOUCH_DOWN 0
+#define FORM_TOUCH_UP 1
+#define FORM_TOUCH_MOVE 2
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFormMouse(JNIEnv *env, jobject thiz,
+                                                       jlong doc_ptr, jlong page_ptr,
+                                                       jint action, jdouble page_x,
+                                                       jdouble page_y) {
+    FormFill *form = formFillOf(env, doc_ptr);
+    FPDF_PAGE page = (form != NULL)? pageOf(env, page_ptr) : NULL;
+    if(page == NULL) return JNI_FALSE;
+
+    FPDF_BOOL handled;
+    switch(action){
+        case FORM_TOUCH_DOWN:
+            handled = FORM_OnLButtonDown(form->handle(), page, 0, page_x, page_y);
+            break;
+        case FORM_TOUCH_UP:
+            handled = FORM_OnLButtonUp(form->handle(), page, 0, page_x, page_y);
+            break;
+        default:
+            handled = FORM_OnMouseMove(form->handle(), page, 0, page_x, page_y);
+            break;
+    }
+    return handled ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFormKey(JNIEnv *env, jobject thiz,
+                                                     jlong doc_ptr, jlong page_ptr,
+                                                     jint key_code, jboolean down,
+                                                     jint modifier) {
+    FormFill *form = formFillOf(env, doc_ptr);
+    FPDF_PAGE page = (form != NULL)? pageOf(env, page_ptr) : NULL;
+    if(page == NULL) return JNI_FALSE;
+
+    FPDF_BOOL handled = down ? FORM_OnKeyDown(form->handle(), page, (int) key_code, (int) modifier)
+                             : FORM_OnKeyUp(form->handle(), page, (int) key_code, (int) modifier);
+    return handled ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFormChar(JNIEnv *env, jobject thiz,
+                                                      jlong doc_ptr, jlong page_ptr,
+                                                      jint unicode, jint modifier) {
+    FormFill *form = formFillOf(env, doc_ptr);
+    FPDF_PAGE page = (form != NULL)? pageOf(env, page_ptr) : NULL;
+    if(page == NULL) return JNI_FALSE;
+
+    //PDFium takes UTF-16 units, characters past the BMP go in as their surrogates
+    FPDF_BOOL handled;
+    if(unicode > 0xFFFF){
+        int value = (int) unicode - 0x10000;
+        handled = FORM_OnChar(form->handle(), page, 0xD800 + (value >> 10), (int) modifier);
+        handled = FORM_OnChar(form->handle(), page, 0xDC00 + (value & 0x3FF), (int) modifier)
+                  || handled;
+    }else{
+        handled = FORM_OnChar(form->handle(), page, (int) unicode, (int) modifier);
+    }
+    return handled ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeFormKillFocus(JNIEnv *env, jobject thiz,
+                                                           jlong doc_ptr) {
+    FormFill *form = formFillOf(env, doc_ptr);
+    if(form != NULL) FORM_ForceToKillFocus(form->handle());
+}
+
+/*
+ * Regions of the page PDFium repainted since the last call, 4 floats per rect: left, top,
+ * right, bottom in page coordinates. Empty when nothing changed.
+ */
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeTakeFormDirtyRects(JNIEnv *env, jobject thiz,
+                                                                jlong doc_ptr, jlong page_ptr) {
+    FormFill *form = formFillOf(env, doc_ptr);
+    FPDF_PAGE page = (form != NULL)? pageOf(env, page_ptr) : NULL;
+    if(page == NULL) return NULL;
+
+    std::vector<FS_RECTF> rects;
+    form->takeDirtyRects(page, &rects);
+    jfloatArray result = env->NewFloatArray((jsize) rects.size() * 4);
+    if(result == NULL) return NULL;
+    for(size_t i = 0; i < rects.size(); i++){
+        jfloat values[4] = {rects[i].left, rects[i].top, rects[i].right, rects[i].bottom};
+        env->SetFloatArrayRegion(result, (jsize) i * 4, 4, values);
+    }
+    return result;
+}
+
+/*
+ * Render the given page rects again into a bitmap already showing the page at start, drawSize.
+ * Returns the device rects written, 4 ints per rect: left, top, right, bottom. An RGB_565 bitmap
+ * is rendered whole, the single rect returned then covers the page.
+ */
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPageRegions(JNIEnv *env, jobject thiz,
+                                                               jlong page_ptr, jobject bitmap,
+                                                               jint start_x, jint start_y,
+                                                               jint draw_size_hor,
+                                                               jint draw_size_ver,
+                                                               jfloatArray page_rects,
+                                                               jboolean render_annot) {
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL || bitmap == NULL || page_rects == NULL) return NULL;
+
+    AndroidBitmapInfo info;
+    int ret;
+    if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return NULL;
+    }
+
+    std::vector<jint> written;
+    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888){
+        if(!renderPageOnBitmap(env, page, bitmap, (int) start_x, (int) start_y,
+                               (int) draw_size_hor, (int) draw_size_ver, (bool) render_annot)){
+            return NULL;
+        }
+        written.push_back(0);
+        written.push_back(0);
+        written.push_back((jint) info.width);
+        written.push_back((jint) info.height);
+    }else{
+        int count = (int) env->GetArrayLength(page_rects) / 4;
+        std::vector<jfloat> rects(count * 4);
+        if(count > 0) env->GetFloatArrayRegion(page_rects, 0, count * 4, &rects[0]);
+
+        void *addr;
+        if((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0){
+            LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+            return NULL;
+        }
+
+        int flags = FPDF_REVERSE_BYTE_ORDER | MemoryGovernor::instance().renderFlags();
+        if(render_annot) flags |= FPDF_ANNOT;
+        FPDF_FORMHANDLE form = formOf(page);
+        for(int i = 0; i < count; i++){
+            FS_RECTF rect;
+            rect.left = rects[i * 4];
+            rect.top = rects[i * 4 + 1];
+            rect.right = rects[i * 4 + 2];
+            rect.bottom = rects[i * 4 + 3];
+            int device[4];
+            if(renderPageRegion(page, form, addr, (int) info.stride,
+                                (int) info.width, (int) info.height,
+                                (int) start_x, (int) start_y,
+                                (int) draw_size_hor, (int) draw_size_ver, rect, flags, device)){
+                written.insert(written.end(), device, device + 4);
+            }
+        }
+        AndroidBitmap_unlockPixels(env, bitmap);
+    }
+
+    jintArray result = env->NewIntArray((jsize) written.size());
+    if(result != NULL && !written.empty()){
+        env->SetIntArrayRegion(result, 0, (jsize) written.size(), &written[0]);
+    }
+    return result;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeDeviceCoordsToPage(JNIEnv *env, jobject thiz,
+                                                                jlong page_ptr, jint start_x,
+                                                                jint start_y, jint size_x,
+                                                                jint size_y, jint rotate,
+                                                                jint device_x, jint device_y) {
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return NULL;
+    double pageX, pageY;
+
+    FPDF_DeviceToPage(page, start_x, start_y, size_x, size_y, rotate, device_x, device_y,
+                      &pageX, &pageY);
+
+    jclass clazz = env->FindClass("android/graphics/PointF");
+    jmethodID constructorID = env->GetMethodID(clazz, "<init>", "(FF)V");
+    return env->NewObject(clazz, constructorID, (jfloat) pageX, (jfloat) pageY);
+}
+
+//Render into a direct buffer as 8 bit gray or dithered 1 bit, see GrayOutput
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ndktesting_PdfiumCore_nativeRenderPageGray(JNIEnv *env, jobject thiz,
+                                                            jlong page_ptr, jobject buffer,
+                                                            jint output, jint stride,
+                                                            jint width, jint height,
+                                                            jint start_x, jint start_y,
+                                                            jint draw_size_hor, jint draw_size_ver,
+                                                            jboolean render_annot) {
+    FPDF_PAGE page = pageOf(env, page_ptr);
+    if(page == NULL) return;
+
+    void *pixels = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(pixels == NULL || output < 0 || output >= GRAY_OUTPUT_COUNT || width <= 0 || height <= 0
+       || stride < 0 || (size_t) stride < grayOutputRowBytes(output, width)
+       || capacity < (jlong) stride * (height - 1) + (jlong) grayOutputRowBytes(output, width)){
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                          "buffer not direct or too small for the output");
+        return;
+    }
+
+    int flags = MemoryGovernor::instance().renderFlags();
+    if(render_annot) flags |= FPDF_ANNOT;
+    //Arguments are checked above, a failure is the scratch canvas
+    if(!renderPageGray(page, formOf(page), (int) output, pixels, (int) stride, (int) width, (int) height,
+                       (int) start_x, (int) start_y, (int) draw_size_hor, (int) draw_size_ver, flags)){
+        jniThrowException(env, "java/lang/OutOfMemoryError", "no memory to dither the page");
+    }
+}
@@ -0,0 +1,139 @@
+#include "util.hpp"
+#include "memoryGovernor.hpp"
+
+#include <fpdfview.h>
+
+extern "C" {
+    #include <time.h>
+}
+
+using namespace android;
+
+static int64_t monotonicMs(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool isBackgroundLevel(int level){
+    return level >= TRIM_UI_HIDDEN;
+}
+
+//Foreground level a trim level amounts to, TRIM_NONE if it asks for no memory
+static int foregroundPressure(int level){
+    switch(level){
+        case TRIM_RUNNING_MODERATE:
+        case TRIM_RUNNING_LOW:
+        case TRIM_RUNNING_CRITICAL:
+            return level;
+        case TRIM_UI_HIDDEN:
+            return TRIM_RUNNING_MODERATE;
+        case TRIM_BACKGROUND:
+            return TRIM_RUNNING_LOW;
+        case TRIM_MODERATE:
+        case TRIM_COMPLETE:
+            return TRIM_RUNNING_CRITICAL;
+        default:
+            //Levels added after COMPLETE can only be worse
+            return level > TRIM_COMPLETE ? TRIM_RUNNING_CRITICAL : TRIM_NONE;
+    }
+}
+
+MemoryGovernor& MemoryGovernor::instance(){
+    static MemoryGovernor governor;
+    return governor;
+}
+
+MemoryGovernor::MemoryGovernor() : mLimitedUntilMs(0) {
+    for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++) mUsage[i] = 0;
+}
+
+void MemoryGovernor::track(const void *object, int category, size_t bytes){
+    Mutex::Autolock lock(mLock);
+    std::map<const void*, Tracked>::iterator it = mTracked.find(object);
+    if(it != mTracked.end()){
+        mUsage[it->second.category] -= (int64_t) it->second.bytes;
+        it->second.category = category;
+        it->second.bytes = bytes;
+    }else{
+        Tracked tracked;
+        tracked.category = category;
+        tracked.bytes = bytes;
+        mTracked[object] = tracked;
+    }
+    mUsage[category] += (int64_t) bytes;
+}
+
+void MemoryGovernor::untrack(const void *object){
+    Mutex::Autolock lock(mLock);
+    std::map<const void*, Tracked>::iterator it = mTracked.find(object);
+    if(it == mTracked.end()) return;
+    mUsage[it->second.category] -= (int64_t) it->second.bytes;
+    mTracked.erase(it);
+}
+
+void MemoryGovernor::usage(int64_t out[MEMORY_CATEGORY_COUNT]){
+    Mutex::Autolock lock(mLock);
+    for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++) out[i] = mUsage[i];
+}
+
+void MemoryGovernor::addTrimHandler(int priority, int minLevel, TrimHandler handler, void *arg){
+    Handler entry;
+    entry.priority = priority;
+    entry.minLevel = minLevel;
+    entry.handler = handler;
+    entry.arg = arg;
+
+    Mutex::Autolock lock(mLock);
+    std::vector<Handler>::iterator it = mHandlers.begin();
+    while(it != mHandlers.end() && it->priority <= priority) ++it;
+    mHandlers.insert(it, entry);
+}
+
+void MemoryGovernor::removeTrimHandler(TrimHandler handler, void *arg){
+    Mutex::Autolock trimLock(mTrimLock);
+    Mutex::Autolock lock(mLock);
+    for(std::vector<Handler>::iterator it = mHandlers.begin(); it != mHandlers.end(); ++it){
+        if(it->handler == handler && it->arg == arg){
+            mHandlers.erase(it);
+            return;
+        }
+    }
+}
+
+bool MemoryGovernor::reaches(int level, int minLevel){
+    if(isBackgroundLevel(minLevel)) return isBackgroundLevel(level) && level >= minLevel;
+    int pressure = foregroundPressure(level);
+    return pressure != TRIM_NONE && pressure >= minLevel;
+}
+
+int MemoryGovernor::renderFlags() const {
+    int64_t until = __atomic_load_n(&mLimitedUntilMs, __ATOMIC_RELAXED);
+    return (until != 0 && monotonicMs() < until) ? FPDF_RENDER_LIMITEDIMAGECACHE : 0;
+}
+
+size_t MemoryGovernor::trim(int level){
+    Mutex::Autolock trimLock(mTrimLock);
+    //Only foreground reports say anything about renders happening now
+    if(level == TRIM_RUNNING_CRITICAL){
+        __atomic_store_n(&mLimitedUntilMs, monotonicMs() + TRIM_RENDER_FLAGS_MS, __ATOMIC_RELAXED);
+    }else if(level == TRIM_RUNNING_MODERATE || level == TRIM_RUNNING_LOW){
+        __atomic_store_n(&mLimitedUntilMs, (int64_t) 0, __ATOMIC_RELAXED);
+    }
+
+    //Handlers track and untrack while they run, call them without the lock
+    std::vector<Handler> handlers;
+    {
+        Mutex::Autolock lock(mLock);
+        handlers = mHandlers;
+    }
+
+    size_t released = 0;
+    for(size_t i = 0; i < handlers.size(); i++){
+        if(reaches(level, handlers[i].minLevel)){
+            released += handlers[i].handler(level, handlers[i].arg);
+        }
+    }
+    LOGD("Trim level %d released %zu bytes", level, released);
+    return released;
+}
@@ -0,0 +1,106 @@
+#ifndef _MEMORY_GOVERNOR_HPP_
+#define _MEMORY_GOVERNOR_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <utils/Mutex.h>
+
+#include <map>
+#include <vector>
+
+/*
+ * Process wide account of native memory held for the app, per category, and
+ * the trim entry point behind ComponentCallbacks2.onTrimMemory. Owners track
+ * each allocation under its address and untrack it when freed. Subsystems
+ * that can give memory back register a trim handler with a priority and the
+ * lowest trim level it runs at; trim runs them cheapest-to-rebuild first.
+ *
+ * Trim levels are not one scale: RUNNING_* come while the app is in the
+ * foreground, UI_HIDDEN and above while it is hidden or in the background.
+ * A handler registered at a foreground level also runs at the background
+ * levels that mean as much pressure (UI_HIDDEN none beyond RUNNING_MODERATE,
+ * BACKGROUND that of RUNNING_LOW, MODERATE and COMPLETE that of
+ * RUNNING_CRITICAL); one registered at a background level runs only in the
+ * background.
+ * PDFium does not report its own usage, page and text page sizes are estimates.
+ */
+
+enum MemoryCategory {
+    MEMORY_PAGES = 0,
+    MEMORY_TEXT_PAGES,
+    MEMORY_TILE_CACHE,      //render pool pixel ring
+    MEMORY_SCRATCH,         //reusable buffers and render temporaries
+    MEMORY_CATEGORY_COUNT
+};
+
+//ComponentCallbacks2 TRIM_MEMORY_* levels
+enum TrimLevel {
+    TRIM_NONE = 0,
+    TRIM_RUNNING_MODERATE = 5,
+    TRIM_RUNNING_LOW = 10,
+    TRIM_RUNNING_CRITICAL = 15,
+    TRIM_UI_HIDDEN = 20,
+    TRIM_BACKGROUND = 40,
+    TRIM_MODERATE = 60,
+    TRIM_COMPLETE = 80
+};
+
+//How long renders stay limited after a RUNNING_CRITICAL trim
+#define TRIM_RENDER_FLAGS_MS 30000
+
+//Free what can be rebuilt later, returns bytes released
+typedef size_t (*TrimHandler)(int level, void *arg);
+
+class MemoryGovernor {
+public:
+    static MemoryGovernor& instance();
+
+    //Account bytes for object, replacing what it had before
+    void track(const void *object, int category, size_t bytes);
+    void untrack(const void *object);
+    void usage(int64_t out[MEMORY_CATEGORY_COUNT]);
+
+    void addTrimHandler(int priority, int minLevel, TrimHandler handler, void *arg);
+    void removeTrimHandler(TrimHandler handler, void *arg);
+
+    /*
+     * Run the handlers level reaches, lower priority first. RUNNING_CRITICAL
+     * also makes renders use FPDF_RENDER_LIMITEDIMAGECACHE until a milder
+     * foreground level arrives or TRIM_RENDER_FLAGS_MS pass without another
+     * critical one. Returns bytes released by the handlers.
+     */
+    size_t trim(int level);
+
+    //Whether handlers registered at minLevel run at level
+    static bool reaches(int level, int minLevel);
+
+    //Extra FPDF_RenderPageBitmap flags the trim state asks for
+    int renderFlags() const;
+
+private:
+    MemoryGovernor();
+
+    struct Tracked {
+        int category;
+        size_t bytes;
+    };
+
+    struct Handler {
+        int priority;
+        int minLevel;
+        TrimHandler handler;
+        void *arg;
+    };
+
+    android::Mutex mLock;
+    android::Mutex mTrimLock;           //held while handlers run, removal waits for it
+    std::map<const void*, Tracked> mTracked;
+    int64_t mUsage[MEMORY_CATEGORY_COUNT];
+    std::vector<Handler> mHandlers;     //sorted by priority
+    int64_t mLimitedUntilMs;            //monotonic, 0 when renders are not limited
+};
+
+#endif
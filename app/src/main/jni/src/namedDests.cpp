@@ -0,0 +1,81 @@
+#include "util.hpp"
+#include "namedDests.hpp"
+
+#include <fpdf_doc.h>
+
+NamedDestIndex::NamedDestIndex() : mMask(0), mBuilt(0) {
+}
+
+//FNV-1a over the UTF-16 code units
+uint32_t NamedDestIndex::hash(const unsigned short *name, size_t length){
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < length; i++){
+        h = (h ^ name[i]) * 16777619u;
+    }
+    return h;
+}
+
+void NamedDestIndex::build(FPDF_DOCUMENT doc){
+    if(built()) return;
+
+    int count = (int) FPDF_CountNamedDests(doc);
+    mEntries.reserve(count > 0 ? count : 0);
+    std::vector<unsigned short> buffer;
+    for(int i = 0; i < count; i++){
+        //Byte lengths, including a two byte terminator
+        long length = 0;
+        FPDF_GetNamedDest(doc, i, NULL, &length);
+        if(length <= 2) continue;
+        buffer.resize((size_t) length / 2);
+        FPDF_DEST dest = FPDF_GetNamedDest(doc, i, &buffer[0], &length);
+        if(dest == NULL || length <= 2) continue;
+
+        Entry entry;
+        entry.nameStart = (int32_t) mNames.size();
+        entry.nameLength = (int32_t) (length / 2 - 1);
+        entry.pageIndex = (int32_t) FPDFDest_GetPageIndex(doc, dest);
+        entry.hash = hash(&buffer[0], (size_t) entry.nameLength);
+        mNames.insert(mNames.end(), buffer.begin(), buffer.begin() + entry.nameLength);
+        mEntries.push_back(entry);
+    }
+
+    //Power of two, at most half full
+    size_t capacity = 16;
+    while(capacity < mEntries.size() * 2) capacity *= 2;
+    mTable.assign(capacity, 0);
+    mMask = (uint32_t) (capacity - 1);
+    for(size_t e = 0; e < mEntries.size(); e++){
+        uint32_t slot = mEntries[e].hash & mMask;
+        while(mTable[slot] != 0) slot = (slot + 1) & mMask;
+        mTable[slot] = (int32_t) (e + 1);
+    }
+
+    LOGD("Indexed %d named destinations", (int) mEntries.size());
+    __atomic_store_n(&mBuilt, 1, __ATOMIC_RELEASE);
+}
+
+void NamedDestIndex::invalidate(){
+    __atomic_store_n(&mBuilt, 0, __ATOMIC_RELEASE);
+    mNames.clear();
+    mEntries.clear();
+    mTable.clear();
+    mMask = 0;
+}
+
+int NamedDestIndex::find(const unsigned short *name, size_t length) const {
+    if(!built() || mTable.empty()) return -1;
+
+    uint32_t h = hash(name, length);
+    for(uint32_t slot = h & mMask; mTable[slot] != 0; slot = (slot + 1) & mMask){
+        const Entry &entry = mEntries[mTable[slot] - 1];
+        if(entry.hash != h || entry.nameLength != (int32_t) length) continue;
+
+        bool same = true;
+        for(size_t i = 0; i < length && same; i++){
+            same = mNames[entry.nameStart + i] == name[i];
+        }
+        //Duplicate names: the first one wins, as in the name tree lookup
+        if(same) return entry.pageIndex;
+    }
+    return -1;
+}
@@ -0,0 +1,52 @@
+#ifndef _NAMED_DESTS_HPP_
+#define _NAMED_DESTS_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+
+#include <vector>
+
+/*
+ * Named destinations of a document resolved to page indexes once, so a
+ * lookup is a hash probe instead of a walk of the name tree. Names are kept
+ * back to back in one UTF-16 buffer; the table is open addressed with linear
+ * probing and holds entry numbers. Built once under the PDFium lock; reads
+ * never call into PDFium but still hold the lock while the document may close.
+ */
+
+class NamedDestIndex {
+public:
+    NamedDestIndex();
+
+    bool built() const { return __atomic_load_n(&mBuilt, __ATOMIC_ACQUIRE) != 0; }
+    //Caller holds the PDFium lock; does nothing when already built
+    void build(FPDF_DOCUMENT doc);
+    //Drop the index after the document changed, the next lookup builds it again; holds the lock too
+    void invalidate();
+
+    //Page index of the destination name, -1 if the document has no such name
+    int find(const unsigned short *name, size_t length) const;
+    int count() const { return (int) mEntries.size(); }
+
+private:
+    struct Entry {
+        uint32_t hash;
+        int32_t nameStart;
+        int32_t nameLength;
+        int32_t pageIndex;
+    };
+
+    std::vector<unsigned short> mNames;
+    std::vector<Entry> mEntries;
+    std::vector<int32_t> mTable;    //entry + 1, 0 is empty
+    uint32_t mMask;
+    int mBuilt;
+
+    static uint32_t hash(const unsigned short *name, size_t length);
+};
+
+#endif
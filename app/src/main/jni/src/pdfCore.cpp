@@ -0,0 +1,243 @@
+#include "util.hpp"
+#include "pdfCore.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <sys/stat.h>
+    #include <errno.h>
+}
+
+#include <fpdf_flatten.h>
+#include <fpdf_searchex.h>
+
+int getBlock(void* param, unsigned long position, unsigned char* outBuffer,
+             unsigned long size) {
+    const int fd = reinterpret_cast<intptr_t>(param);
+    const int readCount = pread(fd, outBuffer, size, position);
+    if (readCount < 0) {
+        LOGE("Cannot read from file descriptor. Error:%d", errno);
+        return 0;
+    }
+    return 1;
+}
+
+long getFileSize(int fd){
+    struct stat file_state;
+    if(fstat(fd, &file_state) >= 0){
+        return (long)(file_state.st_size);
+    }else{
+        LOGE("Error getting file size");
+        return 0;
+    }
+}
+
+FPDF_DOCUMENT loadDocumentFromFd(int fd, size_t fileLength, const char *password){
+    FPDF_FILEACCESS loader;
+    loader.m_FileLen = fileLength;
+    loader.m_Param = reinterpret_cast<void *>(intptr_t(fd));
+    loader.m_GetBlock = &getBlock;
+
+    return FPDF_LoadCustomDocument(&loader, password);
+}
+
+void renderPageToBuffer(FPDF_PAGE page, void *buffer, int format, int stride,
+                        int canvasHorSize, int canvasVerSize,
+                        int startX, int startY,
+                        int drawSizeHor, int drawSizeVer,
+                        int flags, FPDF_FORMHANDLE form){
+
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
+                                                 format, buffer, stride);
+
+    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
+        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
+                             0x848484FF); //Gray
+    }
+
+    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : drawSizeHor;
+    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : drawSizeVer;
+    int baseX = (startX < 0)? 0 : startX;
+    int baseY = (startY < 0)? 0 : startY;
+
+    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
+                         0xFFFFFFFF); //White
+
+    FPDF_RenderPageBitmap( pdfBitmap, page,
+                           startX, startY,
+                           drawSizeHor, drawSizeVer,
+                           0, flags );
+    if(form != NULL){
+        FPDF_FFLDraw(form, pdfBitmap, page, startX, startY, drawSizeHor, drawSizeVer, 0, flags);
+    }
+
+    //Buffer is external, destroy only releases the bitmap wrapper
+    FPDFBitmap_Destroy(pdfBitmap);
+}
+
+int getPageText(FPDF_TEXTPAGE textPage, std::vector<unsigned short> *out){
+    int count = FPDFText_CountChars(textPage);
+    if(count <= 0){
+        out->clear();
+        return 0;
+    }
+
+    out->resize(count + 1);
+    int written = FPDFText_GetText(textPage, 0, count, &(*out)[0]);
+    if(written <= 0){
+        out->clear();
+        return 0;
+    }
+    out->resize(written - 1); //drop terminator
+    return written - 1;
+}
+
+bool textRangeToChars(FPDF_TEXTPAGE textPage, int textStart, int textLength,
+                      int *charStart, int *charCount){
+    if(textStart < 0 || textLength <= 0) return false;
+    int first = -1, last = -1;
+    for(int i = textStart; i < textStart + textLength && first < 0; i++){
+        first = FPDFText_GetCharIndexFromTextIndex(textPage, i);
+    }
+    for(int i = textStart + textLength - 1; i >= textStart && last < 0; i--){
+        last = FPDFText_GetCharIndexFromTextIndex(textPage, i);
+    }
+    if(first < 0 || last < first) return false;
+    *charStart = first;
+    *charCount = last - first + 1;
+    return true;
+}
+
+void getCharGeometry(FPDF_TEXTPAGE textPage, std::vector<float> *out){
+    int count = FPDFText_CountChars(textPage);
+    out->resize(count > 0 ? (size_t) count * CHAR_GEOMETRY_STRIDE : 0);
+
+    for(int i = 0; i < count; i++){
+        double left = 0, right = 0, bottom = 0, top = 0;
+        FPDFText_GetCharBox(textPage, i, &left, &right, &bottom, &top);
+
+        float *entry = &(*out)[(size_t) i * CHAR_GEOMETRY_STRIDE];
+        entry[0] = (float) left;
+        entry[1] = (float) top;
+        entry[2] = (float) right;
+        entry[3] = (float) bottom;
+        //Code points stay exact in a float, they are below 2^24
+        entry[4] = (float) FPDFText_GetUnicode(textPage, i);
+    }
+}
+
+void appendDocumentText(FPDF_DOCUMENT doc, int fromIndex, int toIndex,
+                        std::vector<unsigned short> *scratch,
+                        std::vector<unsigned short> *text, std::vector<int32_t> *offsets){
+    if(offsets->empty()) offsets->push_back((int32_t) text->size());
+
+    for(int i = fromIndex; i < toIndex; i++){
+        FPDF_PAGE page = FPDF_LoadPage(doc, i);
+        if(page != NULL){
+            FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+            if(textPage != NULL){
+                int length = getPageText(textPage, scratch);
+                if(length > 0) text->insert(text->end(), scratch->begin(), scratch->begin() + length);
+                FPDFText_ClosePage(textPage);
+            }
+            FPDF_ClosePage(page);
+        }else{
+            LOGE("Cannot load page %d for text", i);
+        }
+        offsets->push_back((int32_t) text->size());
+    }
+}
+
+void getPageLinks(FPDF_DOCUMENT doc, FPDF_PAGE page, std::vector<PageLink> *out){
+    int pos = 0;
+    FPDF_LINK link;
+    while (FPDFLink_Enumerate(page, &pos, &link)) {
+        FS_RECTF rect;
+        if (!FPDFLink_GetAnnotRect(link, &rect)) continue;
+
+        PageLink pageLink;
+        pageLink.left = rect.left;
+        pageLink.top = rect.top;
+        pageLink.right = rect.right;
+        pageLink.bottom = rect.bottom;
+        pageLink.destPageIndex = -1;
+
+        FPDF_DEST dest = FPDFLink_GetDest(doc, link);
+        if (dest != NULL) {
+            pageLink.destPageIndex = (int) FPDFDest_GetPageIndex(doc, dest);
+        }
+
+        FPDF_ACTION action = FPDFLink_GetAction(link);
+        if (action != NULL) {
+            unsigned long bufferLen = FPDFAction_GetURIPath(doc, action, NULL, 0);
+            if (bufferLen > 1) {
+                pageLink.uri.resize(bufferLen);
+                FPDFAction_GetURIPath(doc, action, &pageLink.uri[0], bufferLen);
+                pageLink.uri.resize(bufferLen - 1);
+            }
+        }
+
+        if (pageLink.destPageIndex >= 0 || !pageLink.uri.empty()) {
+            out->push_back(pageLink);
+        }
+    }
+}
+
+void flattenPages(FPDF_DOCUMENT doc, int fromIndex, int toIndex, int flag, FlattenCounts *counts){
+    counts->flattened = 0;
+    counts->unchanged = 0;
+    counts->failed = 0;
+
+    int pageCount = FPDF_GetPageCount(doc);
+    if(fromIndex < 0) fromIndex = 0;
+    if(toIndex >= pageCount) toIndex = pageCount - 1;
+    for(int i = fromIndex; i <= toIndex; i++){
+        FPDF_PAGE page = FPDF_LoadPage(doc, i);
+        if(page == NULL){
+            LOGE("Page %d not loaded for flatten", i);
+            counts->failed++;
+            continue;
+        }
+        //Flatten writes the page dictionary itself, FPDFPage_GenerateContent here
+        //would replace the content with its image objects only
+        switch(FPDFPage_Flatten(page, flag)){
+            case FLATTEN_SUCCESS:
+                counts->flattened++;
+                break;
+            case FLATTEN_NOTHINGTODO:
+                counts->unchanged++;
+                break;
+            default:
+                counts->failed++;
+                break;
+        }
+        FPDF_ClosePage(page);
+    }
+}
+
+void utf16ToUtf8(const unsigned short *text, size_t length, std::string *out){
+    out->clear();
+    out->reserve(length);
+    for(size_t i = 0; i < length; i++){
+        uint32_t c = text[i];
+        if(c >= 0xD800 && c <= 0xDBFF && i + 1 < length
+           && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF){
+            c = 0x10000 + ((c - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+            i++;
+        }
+        if(c < 0x80){
+            out->push_back((char) c);
+        }else if(c < 0x800){
+            out->push_back((char) (0xC0 | (c >> 6)));
+            out->push_back((char) (0x80 | (c & 0x3F)));
+        }else if(c < 0x10000){
+            out->push_back((char) (0xE0 | (c >> 12)));
+            out->push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+            out->push_back((char) (0x80 | (c & 0x3F)));
+        }else{
+            out->push_back((char) (0xF0 | (c >> 18)));
+            out->push_back((char) (0x80 | ((c >> 12) & 0x3F)));
+            out->push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+            out->push_back((char) (0x80 | (c & 0x3F)));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef _PDF_CORE_HPP_
+#define _PDF_CORE_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_doc.h>
+#include <fpdf_text.h>
+#include <fpdf_formfill.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * PDFium helpers that do not depend on JNI or the Android window/bitmap APIs.
+ * The JNI bindings and the standalone tools (pdfiumBatch) both go through
+ * these, so a page rendered or extracted on a server looks exactly like the
+ * one the app shows.
+ */
+
+//Reader callback for FPDF_FILEACCESS, m_Param holds the file descriptor
+int getBlock(void* param, unsigned long position, unsigned char* outBuffer,
+             unsigned long size);
+
+long getFileSize(int fd);
+
+//Open document through FPDF_LoadCustomDocument reading from fd with pread
+FPDF_DOCUMENT loadDocumentFromFd(int fd, size_t fileLength, const char *password);
+
+/*
+ * Render page fragment into a caller owned buffer laid out as FPDFBitmap_*
+ * format. Form fields are drawn on top when form is not NULL.
+ */
+void renderPageToBuffer(FPDF_PAGE page, void *buffer, int format, int stride,
+                        int canvasHorSize, int canvasVerSize,
+                        int startX, int startY,
+                        int drawSizeHor, int drawSizeVer,
+                        int flags, FPDF_FORMHANDLE form);
+
+//Whole text of a page in UTF-16, without the trailing terminator
+int getPageText(FPDF_TEXTPAGE textPage, std::vector<unsigned short> *out);
+
+/*
+ * Char range of [textStart, textStart + textLength) in the getPageText string.
+ * That string also holds spaces and line breaks PDFium generated between
+ * chars, so its offsets are not char indexes; generated chars at either end
+ * are dropped. False if no real char is in the range.
+ */
+bool textRangeToChars(FPDF_TEXTPAGE textPage, int textStart, int textLength,
+                      int *charStart, int *charCount);
+
+//Floats per character of getCharGeometry: left, top, right, bottom in page points, unicode
+#define CHAR_GEOMETRY_STRIDE 5
+
+//Boxes and unicode values of every character of a text page, in one pass
+void getCharGeometry(FPDF_TEXTPAGE textPage, std::vector<float> *out);
+
+/*
+ * Append text of pages [fromIndex, toIndex) to text, one UTF-16 run per page
+ * without separators. offsets gets the end of every page appended, starting
+ * with a 0 when empty, so page i spans offsets[i]..offsets[i + 1]. scratch is
+ * reused between pages to avoid an allocation per page.
+ */
+void appendDocumentText(FPDF_DOCUMENT doc, int fromIndex, int toIndex,
+                        std::vector<unsigned short> *scratch,
+                        std::vector<unsigned short> *text, std::vector<int32_t> *offsets);
+
+struct PageLink {
+    double left, top, right, bottom;
+    int destPageIndex;      //-1 when link has no internal destination
+    std::string uri;        //empty when link has no URI action
+};
+
+//Annotation links of a page with resolved destination and URI
+void getPageLinks(FPDF_DOCUMENT doc, FPDF_PAGE page, std::vector<PageLink> *out);
+
+struct FlattenCounts {
+    int flattened;
+    int unchanged;          //nothing to flatten
+    int failed;
+};
+
+/*
+ * Merge annotations and form fields of pages [fromIndex, toIndex] into their
+ * content with FPDFPage_Flatten, flag FLAT_NORMALDISPLAY or FLAT_PRINT. Pages
+ * are loaded one at a time and closed right after, so any range keeps a
+ * single page resident. Pages loaded before show the old content.
+ */
+void flattenPages(FPDF_DOCUMENT doc, int fromIndex, int toIndex, int flag, FlattenCounts *counts);
+
+void utf16ToUtf8(const unsigned short *text, size_t length, std::string *out);
+
+#endif
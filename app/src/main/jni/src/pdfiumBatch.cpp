@@ -0,0 +1,458 @@
+#include "util.hpp"
+#include "pdfCore.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <getopt.h>
+    #include <string.h>
+    #include <stdio.h>
+    #include <sys/mman.h>
+    #include <sys/wait.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_text.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * pdfiumBatch - headless render/extract tool built from the same sources as
+ * libjniPdfium. Every worker is a separate process with its own PDFium
+ * instance (PDFium keeps global state and is not thread safe). Pages are
+ * split into one contiguous range per worker; a worker that runs dry steals
+ * pages from the back of the other ranges.
+ *
+ *   pdfiumBatch [-j workers] [-r dpi[,dpi...]] [-p pages] [-t] [-l]
+ *               [-o outdir] [-P password] file.pdf...
+ */
+
+struct BatchJob {
+    int fileIndex;
+    int pageIndex;
+};
+
+//head in the upper 32 bits, tail in the lower; updated with a single CAS
+struct WorkerRange {
+    uint64_t range;
+    char pad[56];
+};
+
+struct BatchOptions {
+    std::vector<std::string> files;
+    std::vector<int> dpis;
+    std::string pages;
+    std::string outDir;
+    const char *password;
+    bool extractText;
+    bool extractLinks;
+    int workers;
+};
+
+static void usage(const char *name){
+    fprintf(stderr,
+            "usage: %s [-j workers] [-r dpi[,dpi...]] [-p pages] [-t] [-l]\n"
+            "          [-o outdir] [-P password] file.pdf...\n"
+            "  -j  number of worker processes (default: online cpus)\n"
+            "  -r  render resolutions, 0 disables rendering (default: 72)\n"
+            "  -p  1-based page list like 1-3,7 (default: all pages)\n"
+            "  -t  extract page text as UTF-8\n"
+            "  -l  extract annotation and web links\n"
+            "  -o  output directory (default: .)\n"
+            "  -P  password of the documents\n", name);
+}
+
+//URIs come from the document, escape what would break the TSV row
+static void appendTsvField(const std::string &field, std::string *out){
+    for(size_t i = 0; i < field.size(); i++){
+        switch(field[i]){
+            case '\t': *out += "\\t"; break;
+            case '\n': *out += "\\n"; break;
+            case '\r': *out += "\\r"; break;
+            case '\\': *out += "\\\\"; break;
+            default: *out += field[i]; break;
+        }
+    }
+}
+
+static bool parseDpis(const char *arg, std::vector<int> *out){
+    out->clear();
+    const char *p = arg;
+    while(*p){
+        char *end;
+        long dpi = strtol(p, &end, 10);
+        if(end == p || dpi < 0 || dpi > 2400) return false;
+        if(dpi > 0) out->push_back((int) dpi);
+        p = (*end == ',')? end + 1 : end;
+        if(*end != ',' && *end != '\0') return false;
+    }
+    return true;
+}
+
+//Expand page list for a document with pageCount pages, out of range entries are dropped
+static bool parsePages(const std::string &spec, int pageCount, std::vector<int> *out){
+    out->clear();
+    if(spec.empty()){
+        for(int i = 0; i < pageCount; i++) out->push_back(i);
+        return true;
+    }
+
+    const char *p = spec.c_str();
+    while(*p){
+        char *end;
+        long from = strtol(p, &end, 10);
+        if(end == p) return false;
+        long to = from;
+        if(*end == '-'){
+            p = end + 1;
+            to = strtol(p, &end, 10);
+            if(end == p) to = pageCount;
+        }
+        for(long i = from; i <= to && i <= pageCount; i++){
+            if(i >= 1) out->push_back((int) i - 1);
+        }
+        if(*end != ',' && *end != '\0') return false;
+        p = (*end == ',')? end + 1 : end;
+    }
+    return true;
+}
+
+static std::string baseName(const std::string &path){
+    size_t slash = path.find_last_of('/');
+    std::string name = (slash == std::string::npos)? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if(dot != std::string::npos && dot > 0) name = name.substr(0, dot);
+    return name;
+}
+
+static bool writeFile(const std::string &path, const void *data, size_t size){
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == NULL){
+        fprintf(stderr, "cannot write %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+//RGBA buffer to binary PPM, alpha is dropped
+static bool writePpm(const std::string &path, const uint8_t *rgba, int width, int height){
+    std::vector<uint8_t> out;
+    char header[64];
+    int headerLen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    out.reserve(headerLen + (size_t) width * height * 3);
+    out.insert(out.end(), header, header + headerLen);
+    for(size_t i = 0; i < (size_t) width * height; i++){
+        out.push_back(rgba[i * 4]);
+        out.push_back(rgba[i * 4 + 1]);
+        out.push_back(rgba[i * 4 + 2]);
+    }
+    return writeFile(path, &out[0], out.size());
+}
+
+static bool popOwn(WorkerRange *queue, uint32_t *job){
+    uint64_t current = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+    for(;;){
+        uint32_t head = (uint32_t) (current >> 32);
+        uint32_t tail = (uint32_t) current;
+        if(head >= tail) return false;
+        uint64_t next = ((uint64_t) (head + 1) << 32) | tail;
+        if(__atomic_compare_exchange_n(&queue->range, &current, next, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            *job = head;
+            return true;
+        }
+    }
+}
+
+static bool stealTail(WorkerRange *queue, uint32_t *job){
+    uint64_t current = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+    for(;;){
+        uint32_t head = (uint32_t) (current >> 32);
+        uint32_t tail = (uint32_t) current;
+        if(head >= tail) return false;
+        uint64_t next = ((uint64_t) head << 32) | (tail - 1);
+        if(__atomic_compare_exchange_n(&queue->range, &current, next, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            *job = tail - 1;
+            return true;
+        }
+    }
+}
+
+class WorkerDocument {
+public:
+    int fileIndex = -1;
+    int fd = -1;
+    FPDF_DOCUMENT document = NULL;
+
+    bool open(const BatchOptions &options, int index){
+        if(index == fileIndex) return document != NULL;
+        close();
+        fileIndex = index;
+        fd = ::open(options.files[index].c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        document = loadDocumentFromFd(fd, (size_t) getFileSize(fd), options.password);
+        return document != NULL;
+    }
+
+    void close(){
+        if(document != NULL) FPDF_CloseDocument(document);
+        if(fd >= 0) ::close(fd);
+        document = NULL;
+        fd = -1;
+        fileIndex = -1;
+    }
+
+    ~WorkerDocument(){ close(); }
+};
+
+static bool processPage(const BatchOptions &options, FPDF_DOCUMENT document,
+                        const std::string &prefix, int pageIndex){
+    FPDF_PAGE page = FPDF_LoadPage(document, pageIndex);
+    if(page == NULL){
+        fprintf(stderr, "%s: cannot load page %d\n", prefix.c_str(), pageIndex + 1);
+        return false;
+    }
+
+    bool ok = true;
+    char suffix[64];
+    std::vector<uint8_t> pixels;
+
+    for(size_t i = 0; i < options.dpis.size(); i++){
+        int dpi = options.dpis[i];
+        int width = (int) (FPDF_GetPageWidth(page) * dpi / 72);
+        int height = (int) (FPDF_GetPageHeight(page) * dpi / 72);
+        if(width <= 0 || height <= 0) continue;
+
+        pixels.resize((size_t) width * height * 4);
+        renderPageToBuffer(page, &pixels[0], FPDFBitmap_BGRA, width * 4,
+                           width, height, 0, 0, width, height,
+                           FPDF_REVERSE_BYTE_ORDER | FPDF_ANNOT, NULL);
+
+        snprintf(suffix, sizeof(suffix), ".p%d.%ddpi.ppm", pageIndex + 1, dpi);
+        ok = writePpm(prefix + suffix, &pixels[0], width, height) && ok;
+    }
+
+    FPDF_TEXTPAGE textPage = NULL;
+    if(options.extractText || options.extractLinks){
+        textPage = FPDFText_LoadPage(page);
+    }
+
+    if(options.extractText && textPage != NULL){
+        std::vector<unsigned short> text;
+        std::string utf8;
+        int length = getPageText(textPage, &text);
+        utf16ToUtf8(length > 0 ? &text[0] : NULL, length, &utf8);
+
+        snprintf(suffix, sizeof(suffix), ".p%d.txt", pageIndex + 1);
+        ok = writeFile(prefix + suffix, utf8.data(), utf8.size()) && ok;
+    }
+
+    if(options.extractLinks){
+        std::string out;
+        char line[256];
+
+        std::vector<PageLink> links;
+        getPageLinks(document, page, &links);
+        for(size_t i = 0; i < links.size(); i++){
+            const PageLink &link = links[i];
+            snprintf(line, sizeof(line), "annot\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t",
+                     link.destPageIndex, link.left, link.top, link.right, link.bottom);
+            out += line;
+            appendTsvField(link.uri, &out);
+            out += '\n';
+        }
+
+        FPDF_PAGELINK webLinks = (textPage != NULL)? FPDFLink_LoadWebLinks(textPage) : NULL;
+        if(webLinks != NULL){
+            std::vector<unsigned short> url;
+            std::string utf8;
+            int count = FPDFLink_CountWebLinks(webLinks);
+            for(int i = 0; i < count; i++){
+                int urlLen = FPDFLink_GetURL(webLinks, i, NULL, 0);
+                if(urlLen <= 1) continue;
+                url.resize(urlLen);
+                FPDFLink_GetURL(webLinks, i, &url[0], urlLen);
+                utf16ToUtf8(&url[0], urlLen - 1, &utf8);
+
+                int rects = FPDFLink_CountRects(webLinks, i);
+                for(int r = 0; r < rects; r++){
+                    double left, top, right, bottom;
+                    FPDFLink_GetRect(webLinks, i, r, &left, &top, &right, &bottom);
+                    snprintf(line, sizeof(line), "web\t-1\t%.2f\t%.2f\t%.2f\t%.2f\t",
+                             left, top, right, bottom);
+                    out += line;
+                    appendTsvField(utf8, &out);
+                    out += '\n';
+                }
+            }
+            FPDFLink_CloseWebLinks(webLinks);
+        }
+
+        snprintf(suffix, sizeof(suffix), ".p%d.links.tsv", pageIndex + 1);
+        ok = writeFile(prefix + suffix, out.data(), out.size()) && ok;
+    }
+
+    if(textPage != NULL) FPDFText_ClosePage(textPage);
+    FPDF_ClosePage(page);
+    return ok;
+}
+
+static int runWorker(const BatchOptions &options, const std::vector<BatchJob> &jobs,
+                     WorkerRange *queues, int workerIndex){
+    FPDF_InitLibrary();
+
+    int failures = 0;
+    WorkerDocument doc;
+    std::vector<std::string> prefixes(options.files.size());
+    for(size_t i = 0; i < options.files.size(); i++){
+        prefixes[i] = options.outDir + "/" + baseName(options.files[i]);
+    }
+
+    for(;;){
+        uint32_t jobIndex;
+        bool found = popOwn(&queues[workerIndex], &jobIndex);
+        for(int i = 1; !found && i < options.workers; i++){
+            found = stealTail(&queues[(workerIndex + i) % options.workers], &jobIndex);
+        }
+        if(!found) break;
+
+        const BatchJob &job = jobs[jobIndex];
+        if(!doc.open(options, job.fileIndex)){
+            fprintf(stderr, "%s: cannot open document\n", options.files[job.fileIndex].c_str());
+            failures++;
+            continue;
+        }
+        if(!processPage(options, doc.document, prefixes[job.fileIndex], job.pageIndex)){
+            failures++;
+        }
+    }
+
+    doc.close();
+    FPDF_DestroyLibrary();
+    return failures;
+}
+
+static bool collectJobs(const BatchOptions &options, std::vector<BatchJob> *jobs){
+    bool ok = true;
+
+    //Only the page count is needed here; workers reopen documents themselves
+    FPDF_InitLibrary();
+    for(size_t i = 0; i < options.files.size(); i++){
+        WorkerDocument doc;
+        if(!doc.open(options, (int) i)){
+            fprintf(stderr, "%s: cannot open document (error %lu)\n",
+                    options.files[i].c_str(), FPDF_GetLastError());
+            ok = false;
+            continue;
+        }
+
+        std::vector<int> pages;
+        if(!parsePages(options.pages, FPDF_GetPageCount(doc.document), &pages)){
+            fprintf(stderr, "invalid page list: %s\n", options.pages.c_str());
+            ok = false;
+            break;
+        }
+        for(size_t p = 0; p < pages.size(); p++){
+            BatchJob job;
+            job.fileIndex = (int) i;
+            job.pageIndex = pages[p];
+            jobs->push_back(job);
+        }
+    }
+    FPDF_DestroyLibrary();
+
+    return ok;
+}
+
+int main(int argc, char **argv){
+    BatchOptions options;
+    options.dpis.push_back(72);
+    options.outDir = ".";
+    options.password = NULL;
+    options.extractText = false;
+    options.extractLinks = false;
+    options.workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while((opt = getopt(argc, argv, "j:r:p:tlo:P:h")) != -1){
+        switch(opt){
+            case 'j': options.workers = atoi(optarg); break;
+            case 'r':
+                if(!parseDpis(optarg, &options.dpis)){
+                    fprintf(stderr, "invalid dpi list: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'p': options.pages = optarg; break;
+            case 't': options.extractText = true; break;
+            case 'l': options.extractLinks = true; break;
+            case 'o': options.outDir = optarg; break;
+            case 'P': options.password = optarg; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    for(int i = optind; i < argc; i++) options.files.push_back(argv[i]);
+
+    if(options.files.empty()){
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<BatchJob> jobs;
+    bool ok = collectJobs(options, &jobs);
+    if(jobs.empty()) return ok ? 0 : 1;
+
+    if(options.workers < 1) options.workers = 1;
+    if((size_t) options.workers > jobs.size()) options.workers = (int) jobs.size();
+
+    size_t queuesSize = sizeof(WorkerRange) * options.workers;
+    WorkerRange *queues = (WorkerRange*) mmap(NULL, queuesSize, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(queues == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+
+    //Contiguous ranges keep a worker on the same document as long as possible
+    size_t chunk = jobs.size() / options.workers;
+    size_t extra = jobs.size() % options.workers;
+    uint32_t head = 0;
+    for(int i = 0; i < options.workers; i++){
+        uint32_t tail = head + (uint32_t) (chunk + ((size_t) i < extra ? 1 : 0));
+        queues[i].range = ((uint64_t) head << 32) | tail;
+        head = tail;
+    }
+
+    std::vector<pid_t> children;
+    for(int i = 0; i < options.workers; i++){
+        pid_t pid = fork();
+        if(pid == 0){
+            int failures = runWorker(options, jobs, queues, i);
+            _exit(failures == 0 ? 0 : 1);
+        }
+        if(pid < 0){
+            perror("fork");
+            ok = false;
+            break;
+        }
+        children.push_back(pid);
+    }
+
+    //Pages of workers that failed to start are stolen by the others
+    for(size_t i = 0; i < children.size(); i++){
+        int status;
+        if(waitpid(children[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            ok = false;
+        }
+    }
+
+    munmap(queues, queuesSize);
+    return ok ? 0 : 1;
+}
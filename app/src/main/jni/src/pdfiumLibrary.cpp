@@ -0,0 +1,150 @@
+#include "util.hpp"
+#include "pdfiumLibrary.hpp"
+#include "fontProvider.hpp"
+#include "memoryGovernor.hpp"
+
+extern "C" {
+    #include <string.h>
+    #include <sys/time.h>
+}
+
+#include <fpdfview.h>
+
+static int64_t nowMs(){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static size_t trimIdleLibrary(int level, void *arg){
+    //PDFium does not report what its caches held
+    static_cast<PdfiumLibrary*>(arg)->releaseIdle();
+    return 0;
+}
+
+PdfiumLibrary& PdfiumLibrary::instance(){
+    static PdfiumLibrary library;
+    return library;
+}
+
+PdfiumLibrary::PdfiumLibrary() : mInitialized(false), mWarmUpPending(false), mKeeperStarted(false),
+                                 mTrimRegistered(false), mReferences(0), mGraceMs(0), mIdleSinceMs(-1) {
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mWake, NULL);
+}
+
+void PdfiumLibrary::acquire(){
+    pthread_mutex_lock(&mLock);
+    if(!mInitialized) initLocked();
+    mReferences++;
+    mIdleSinceMs = -1;
+    pthread_mutex_unlock(&mLock);
+}
+
+void PdfiumLibrary::release(){
+    pthread_mutex_lock(&mLock);
+    mReferences--;
+    if(mReferences == 0){
+        if(mGraceMs == 0){
+            destroyLocked();
+        }else{
+            mIdleSinceMs = nowMs();
+            pthread_cond_signal(&mWake);
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void PdfiumLibrary::warmUp(int graceMs){
+    pthread_mutex_lock(&mLock);
+    mGraceMs = graceMs;
+    if(!mInitialized) mWarmUpPending = true;
+    //Without documents the grace period runs from the warm-up
+    if(mReferences == 0 && mIdleSinceMs < 0) mIdleSinceMs = nowMs();
+    startKeeperLocked();
+    pthread_cond_signal(&mWake);
+    pthread_mutex_unlock(&mLock);
+}
+
+void PdfiumLibrary::installFontProvider(){
+    pthread_mutex_lock(&mLock);
+    if(mInitialized) FontProvider::instance().install();
+    pthread_mutex_unlock(&mLock);
+}
+
+bool PdfiumLibrary::releaseIdle(){
+    pthread_mutex_lock(&mLock);
+    bool idle = mInitialized && mReferences == 0;
+    if(idle) destroyLocked();
+    pthread_mutex_unlock(&mLock);
+    return idle;
+}
+
+void PdfiumLibrary::startKeeperLocked(){
+    if(mKeeperStarted) return;
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, keeperMain, this) != 0){
+        LOGE("Library keeper thread not started");
+        return;
+    }
+    pthread_detach(thread);
+    mKeeperStarted = true;
+}
+
+void* PdfiumLibrary::keeperMain(void *arg){
+    static_cast<PdfiumLibrary*>(arg)->keep();
+    return NULL;
+}
+
+void PdfiumLibrary::keep(){
+    pthread_mutex_lock(&mLock);
+    for(;;){
+        if(mWarmUpPending){
+            //Documents opened meanwhile wait on the lock instead of initializing twice
+            mWarmUpPending = false;
+            if(!mInitialized) initLocked();
+            continue;
+        }
+        if(!mInitialized || mReferences > 0 || mGraceMs < 0 || mIdleSinceMs < 0){
+            pthread_cond_wait(&mWake, &mLock);
+            continue;
+        }
+
+        int64_t due = mIdleSinceMs + mGraceMs;
+        if(nowMs() >= due){
+            destroyLocked();
+            continue;
+        }
+        struct timespec deadline;
+        deadline.tv_sec = (time_t) (due / 1000);
+        deadline.tv_nsec = (long) (due % 1000) * 1000000;
+        pthread_cond_timedwait(&mWake, &mLock, &deadline);
+    }
+}
+
+void PdfiumLibrary::initLocked(){
+    LOGD("Init FPDF library");
+    FPDF_LIBRARY_CONFIG config;
+    memset(&config, 0, sizeof(config));
+    config.version = 2;
+    config.m_pUserFontPaths = NULL;     //default paths, FontProvider replaces the lookup when loaded
+    config.m_pIsolate = NULL;
+    config.m_v8EmbedderSlot = 0;
+    FPDF_InitLibraryWithConfig(&config);
+    mInitialized = true;
+    //No-op until a font index is loaded
+    FontProvider::instance().install();
+    //Also for a warm-up with no document yet; rebuilt only on the next open, so last
+    if(!mTrimRegistered){
+        MemoryGovernor::instance().addTrimHandler(100, TRIM_BACKGROUND, trimIdleLibrary, this);
+        mTrimRegistered = true;
+    }
+}
+
+void PdfiumLibrary::destroyLocked(){
+    if(!mInitialized) return;
+    LOGD("Destroy FPDF library");
+    FPDF_DestroyLibrary();
+    mInitialized = false;
+    mIdleSinceMs = -1;
+}
@@ -0,0 +1,62 @@
+#ifndef _PDFIUM_LIBRARY_HPP_
+#define _PDFIUM_LIBRARY_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <pthread.h>
+}
+
+/*
+ * Lifetime of the in-process PDFium library. Open documents hold a reference;
+ * the first one initializes the library with FPDF_InitLibraryWithConfig. With
+ * no grace period the last release tears it down at once, as before. After a
+ * warm-up the library is initialized ahead of the first document on a keeper
+ * thread, and it stays up for the grace period after the last document
+ * closes, so closing one file and opening the next does not rebuild PDFium's
+ * font and codec state. The keeper thread also does the delayed teardown.
+ */
+class PdfiumLibrary {
+public:
+    static PdfiumLibrary& instance();
+
+    //Initialize if needed, blocks while a warm-up is initializing
+    void acquire();
+    //Drop a reference, the last one starts the grace period
+    void release();
+
+    /*
+     * Initialize on the keeper thread without waiting, then keep the library
+     * graceMs after the last release; graceMs < 0 keeps it for the process.
+     */
+    void warmUp(int graceMs);
+
+    //Install the font provider now if the library is up, the next init does otherwise
+    void installFontProvider();
+
+    //Tear down now if no document holds the library, for background trims
+    bool releaseIdle();
+
+private:
+    PdfiumLibrary();
+
+    static void* keeperMain(void *arg);
+    void keep();
+    void startKeeperLocked();
+    void initLocked();
+    void destroyLocked();
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mWake;
+    bool mInitialized;
+    bool mWarmUpPending;
+    bool mKeeperStarted;
+    bool mTrimRegistered;
+    int mReferences;
+    int mGraceMs;
+    int64_t mIdleSinceMs;       //when the last reference went, -1 while referenced
+
+    PdfiumLibrary(const PdfiumLibrary&);
+    PdfiumLibrary& operator=(const PdfiumLibrary&);
+};
+
+#endif
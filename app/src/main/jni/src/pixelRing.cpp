@@ -0,0 +1,163 @@
+#include "util.hpp"
+#include "pixelRing.hpp"
+#include "sharedMemory.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <sys/stat.h>
+}
+
+#define PIXEL_RING_MAGIC 0x50524E47 //PRNG
+#define PIXEL_RING_ALIGN 4096
+
+static size_t alignUp(size_t value, size_t alignment){
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//Header page holds the ring header followed by the slot table
+static size_t headerSize(int slotCount){
+    return alignUp(sizeof(PixelRingHeader) + sizeof(PixelSlot) * slotCount, PIXEL_RING_ALIGN);
+}
+
+PixelRing::PixelRing(int fd, void *base, size_t size)
+        : mFd(fd), mBase(base), mSize(size), mNextSlot(0) {
+    mHeader = (PixelRingHeader*) base;
+}
+
+PixelRing::~PixelRing(){
+    unmapSharedMemory(mBase, mSize);
+    close(mFd);
+}
+
+PixelRing* PixelRing::create(int slotCount, size_t slotSize){
+    slotSize = alignUp(slotSize, PIXEL_RING_ALIGN);
+    size_t size = headerSize(slotCount) + slotSize * slotCount;
+
+    int fd = createSharedMemory("pdfium-pixel-ring", size);
+    if(fd < 0) return NULL;
+    void *base = mapSharedMemory(fd, size);
+    if(base == NULL){
+        close(fd);
+        return NULL;
+    }
+
+    PixelRing *ring = new PixelRing(fd, base, size);
+    ring->mHeader->slotCount = (uint32_t) slotCount;
+    ring->mHeader->slotSize = slotSize;
+    ring->mHeader->mappedSize = size;
+    for(int i = 0; i < slotCount; i++){
+        PixelSlot *s = ring->slot(i);
+        s->state = PIXEL_SLOT_FREE;
+        s->generation = 0;
+    }
+    __atomic_store_n(&ring->mHeader->magic, PIXEL_RING_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+PixelRing* PixelRing::attach(int fd){
+    struct stat state;
+    if(fstat(fd, &state) != 0 || (size_t) state.st_size < sizeof(PixelRingHeader)){
+        close(fd);
+        return NULL;
+    }
+    void *base = mapSharedMemory(fd, (size_t) state.st_size);
+    if(base == NULL){
+        close(fd);
+        return NULL;
+    }
+
+    PixelRingHeader *header = (PixelRingHeader*) base;
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != PIXEL_RING_MAGIC
+       || header->mappedSize > (uint64_t) state.st_size){
+        LOGE("Invalid pixel ring");
+        unmapSharedMemory(base, (size_t) state.st_size);
+        close(fd);
+        return NULL;
+    }
+    return new PixelRing(fd, base, (size_t) state.st_size);
+}
+
+PixelSlot* PixelRing::slot(int index){
+    PixelSlot *slots = (PixelSlot*) ((char*) mBase + sizeof(PixelRingHeader));
+    return &slots[index];
+}
+
+void* PixelRing::pixels(int index){
+    return (char*) mBase + headerSize((int) mHeader->slotCount) + (size_t) mHeader->slotSize * index;
+}
+
+int PixelRing::acquireWrite(uint32_t *generation){
+    int count = (int) mHeader->slotCount;
+    uint32_t start = __atomic_load_n(&mNextSlot, __ATOMIC_RELAXED);
+
+    //Free slots first, then READY pages nobody mapped; their tickets go stale
+    const uint32_t reusable[] = { PIXEL_SLOT_FREE, PIXEL_SLOT_READY };
+    for(int pass = 0; pass < 2; pass++){
+        //Round robin so the page the consumer displayed last is reused last
+        for(int i = 0; i < count; i++){
+            int index = (int) ((start + i) % count);
+            PixelSlot *s = slot(index);
+            uint32_t expected = reusable[pass];
+            if(__atomic_compare_exchange_n(&s->state, &expected, (uint32_t) PIXEL_SLOT_WRITING, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+                //Odd generation marks pixels in flight
+                *generation = __atomic_add_fetch(&s->generation, 1, __ATOMIC_ACQ_REL);
+                __atomic_store_n(&mNextSlot, (uint32_t) (index + 1), __ATOMIC_RELAXED);
+                return index;
+            }
+        }
+    }
+    return -1;
+}
+
+void PixelRing::publish(int index, int documentId, int pageIndex, int format,
+                        int width, int height, int stride){
+    PixelSlot *s = slot(index);
+    s->documentId = documentId;
+    s->pageIndex = pageIndex;
+    s->format = format;
+    s->width = width;
+    s->height = height;
+    s->stride = stride;
+
+    //Pixels and metadata must be visible before the slot is seen as READY
+    __atomic_add_fetch(&s->generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&s->state, (uint32_t) PIXEL_SLOT_READY, __ATOMIC_RELEASE);
+}
+
+void PixelRing::abortWrite(int index){
+    PixelSlot *s = slot(index);
+    __atomic_add_fetch(&s->generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&s->state, (uint32_t) PIXEL_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+bool PixelRing::acquireRead(int index, uint32_t generation){
+    if(index < 0 || index >= (int) mHeader->slotCount) return false;
+
+    PixelSlot *s = slot(index);
+    uint32_t expected = PIXEL_SLOT_READY;
+    if(!__atomic_compare_exchange_n(&s->state, &expected, (uint32_t) PIXEL_SLOT_READING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return false;
+    }
+    //Ticket generation is the odd write generation, published one is the next even
+    if(__atomic_load_n(&s->generation, __ATOMIC_ACQUIRE) != generation + 1){
+        __atomic_store_n(&s->state, (uint32_t) PIXEL_SLOT_READY, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+void PixelRing::releaseRead(int index){
+    PixelSlot *s = slot(index);
+    __atomic_store_n(&s->state, (uint32_t) PIXEL_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+int PixelRing::busySlots(){
+    int busy = 0;
+    for(int i = 0; i < (int) mHeader->slotCount; i++){
+        uint32_t state = __atomic_load_n(&slot(i)->state, __ATOMIC_ACQUIRE);
+        if(state == PIXEL_SLOT_WRITING || state == PIXEL_SLOT_READING) busy++;
+    }
+    return busy;
+}
@@ -0,0 +1,89 @@
+#ifndef _PIXEL_RING_HPP_
+#define _PIXEL_RING_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+/*
+ * Ring of page sized pixel slots in one shared memory region, mapped by the
+ * render workers (producers) and by the app (consumer). A slot goes
+ * FREE -> WRITING -> READY -> READING -> FREE; every transition is a CAS on
+ * the slot state and the generation is odd while pixels are being written.
+ * A consumer holds a (slot, generation) ticket and can only map the slot when
+ * it is READY with exactly that generation, so it never sees a half written
+ * page nor a slot that was recycled for another page.
+ */
+
+enum PixelSlotState {
+    PIXEL_SLOT_FREE = 0,
+    PIXEL_SLOT_WRITING,
+    PIXEL_SLOT_READY,
+    PIXEL_SLOT_READING
+};
+
+struct PixelSlot {
+    uint32_t state;
+    uint32_t generation;
+    int32_t documentId;
+    int32_t pageIndex;
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t reserved[8];
+};
+
+struct PixelRingHeader {
+    uint32_t magic;
+    uint32_t slotCount;
+    uint64_t slotSize;
+    uint64_t mappedSize;
+};
+
+class PixelRing {
+public:
+    //Create a new region, fd is owned by the ring
+    static PixelRing* create(int slotCount, size_t slotSize);
+    //Map a region created by another process, takes ownership of fd
+    static PixelRing* attach(int fd);
+    ~PixelRing();
+
+    int fd() const { return mFd; }
+    int slotCount() const { return (int) mHeader->slotCount; }
+    size_t slotSize() const { return (size_t) mHeader->slotSize; }
+
+    PixelSlot* slot(int index);
+    void* pixels(int index);
+
+    //Producer side
+    int acquireWrite(uint32_t *generation);
+    void publish(int index, int documentId, int pageIndex, int format,
+                 int width, int height, int stride);
+    void abortWrite(int index);
+
+    //Consumer side
+    bool acquireRead(int index, uint32_t generation);
+    void releaseRead(int index);
+
+    //Slots currently owned by a writer or reader
+    int busySlots();
+
+    static uint64_t ticket(int index, uint32_t generation) {
+        return ((uint64_t) (uint32_t) index << 32) | generation;
+    }
+    static int ticketSlot(uint64_t ticket) { return (int) (ticket >> 32); }
+    static uint32_t ticketGeneration(uint64_t ticket) { return (uint32_t) ticket; }
+
+private:
+    PixelRing(int fd, void *base, size_t size);
+
+    int mFd;
+    void *mBase;
+    size_t mSize;
+    PixelRingHeader *mHeader;
+    uint32_t mNextSlot;
+};
+
+#endif
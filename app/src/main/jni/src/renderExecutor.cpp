@@ -0,0 +1,227 @@
+#include "util.hpp"
+#include "renderExecutor.hpp"
+
+extern "C" {
+    #include <errno.h>
+    #include <time.h>
+    #include <sys/time.h>
+}
+
+#define RENDER_EXECUTOR_HISTORY 256
+
+RenderExecutor::RenderExecutor(JavaVM *vm, int threads)
+        : mVm(vm), mThreadCount(threads), mStopping(false), mNextTicket(1) {
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mQueued, NULL);
+    pthread_cond_init(&mFinished, NULL);
+
+    pthread_mutex_lock(&mLock);
+    startLocked();
+    pthread_mutex_unlock(&mLock);
+}
+
+RenderExecutor::~RenderExecutor(){
+    shutdown();
+    pthread_cond_destroy(&mFinished);
+    pthread_cond_destroy(&mQueued);
+    pthread_mutex_destroy(&mLock);
+}
+
+void RenderExecutor::startLocked(){
+    for(int i = 0; i < mThreadCount; i++){
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, threadMain, this) != 0){
+            LOGE("Cannot start render thread %d", i);
+            break;
+        }
+        mThreads.push_back(thread);
+    }
+}
+
+void RenderExecutor::shutdown(){
+    pthread_mutex_lock(&mLock);
+    //One shutdown at a time, a second caller waits for the first
+    while(mStopping) pthread_cond_wait(&mFinished, &mLock);
+    std::vector<pthread_t> threads;
+    threads.swap(mThreads);
+    mStopping = true;
+    pthread_cond_broadcast(&mQueued);
+    pthread_mutex_unlock(&mLock);
+
+    //Threads leave once the queue is empty
+    for(size_t i = 0; i < threads.size(); i++){
+        pthread_join(threads[i], NULL);
+    }
+    LOGD("Render executor stopped %d threads", (int) threads.size());
+
+    pthread_mutex_lock(&mLock);
+    mStopping = false;
+    //Submitted after the last thread left
+    if(!mQueue.empty()) startLocked();
+    pthread_cond_broadcast(&mFinished);
+    pthread_mutex_unlock(&mLock);
+}
+
+void* RenderExecutor::threadMain(void *arg){
+    RenderExecutor *executor = (RenderExecutor*) arg;
+    JNIEnv *env;
+    if(executor->mVm->AttachCurrentThread(&env, NULL) != JNI_OK){
+        LOGE("Cannot attach render thread");
+        return NULL;
+    }
+    executor->loop(env);
+    executor->mVm->DetachCurrentThread();
+    return NULL;
+}
+
+void RenderExecutor::loop(JNIEnv *env){
+    for(;;){
+        pthread_mutex_lock(&mLock);
+        while(mQueue.empty() && !mStopping) pthread_cond_wait(&mQueued, &mLock);
+        if(mQueue.empty()){
+            pthread_mutex_unlock(&mLock);
+            return;
+        }
+        Entry *entry = mQueue.front();
+        mQueue.pop_front();
+        entry->state = RENDER_TASK_RUNNING;
+        pthread_mutex_unlock(&mLock);
+
+        bool ok = entry->task->run(env);
+        if(env->ExceptionCheck()){
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+            ok = false;
+        }
+        int state = ok ? RENDER_TASK_DONE : RENDER_TASK_FAILED;
+
+        //Callback before the ticket turns final, so awaiting callers see its side effects
+        entry->task->complete(env, entry->ticket, state);
+        if(env->ExceptionCheck()){
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+        finish(entry, state);
+    }
+}
+
+void RenderExecutor::finish(Entry *entry, int state){
+    pthread_mutex_lock(&mLock);
+    mActive.erase(entry->ticket);
+    mHistory[entry->ticket] = state;
+    mHistoryOrder.push_back(entry->ticket);
+    while(mHistoryOrder.size() > RENDER_EXECUTOR_HISTORY){
+        mHistory.erase(mHistoryOrder.front());
+        mHistoryOrder.pop_front();
+    }
+    pthread_cond_broadcast(&mFinished);
+    pthread_mutex_unlock(&mLock);
+
+    delete entry->task;
+    delete entry;
+}
+
+int64_t RenderExecutor::submit(RenderTask *task, intptr_t owner){
+    Entry *entry = new Entry();
+    entry->owner = owner;
+    entry->state = RENDER_TASK_PENDING;
+    entry->task = task;
+
+    pthread_mutex_lock(&mLock);
+    entry->ticket = mNextTicket++;
+    mActive[entry->ticket] = entry;
+    mQueue.push_back(entry);
+    //Restart after a shutdown, one in progress restarts on its own
+    if(mThreads.empty() && !mStopping) startLocked();
+    pthread_cond_signal(&mQueued);
+    pthread_mutex_unlock(&mLock);
+    return entry->ticket;
+}
+
+int RenderExecutor::status(int64_t ticket){
+    int state = RENDER_TASK_UNKNOWN;
+    pthread_mutex_lock(&mLock);
+    std::map<int64_t, Entry*>::iterator active = mActive.find(ticket);
+    if(active != mActive.end()){
+        state = active->second->state;
+    }else{
+        std::map<int64_t, int>::iterator done = mHistory.find(ticket);
+        if(done != mHistory.end()) state = done->second;
+    }
+    pthread_mutex_unlock(&mLock);
+    return state;
+}
+
+int RenderExecutor::await(int64_t ticket, int timeoutMs){
+    struct timespec deadline;
+    if(timeoutMs >= 0){
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        int64_t nsec = (int64_t) now.tv_usec * 1000 + (int64_t) (timeoutMs % 1000) * 1000000;
+        deadline.tv_sec = now.tv_sec + timeoutMs / 1000 + (time_t) (nsec / 1000000000);
+        deadline.tv_nsec = (long) (nsec % 1000000000);
+    }
+
+    pthread_mutex_lock(&mLock);
+    while(mActive.count(ticket)){
+        if(timeoutMs < 0){
+            pthread_cond_wait(&mFinished, &mLock);
+        }else if(pthread_cond_timedwait(&mFinished, &mLock, &deadline) == ETIMEDOUT){
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    return status(ticket);
+}
+
+bool RenderExecutor::cancel(JNIEnv *env, int64_t ticket){
+    Entry *entry = NULL;
+    pthread_mutex_lock(&mLock);
+    for(std::deque<Entry*>::iterator it = mQueue.begin(); it != mQueue.end(); ++it){
+        if((*it)->ticket == ticket){
+            entry = *it;
+            mQueue.erase(it);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    if(entry == NULL) return false;
+
+    entry->task->complete(env, entry->ticket, RENDER_TASK_CANCELLED);
+    finish(entry, RENDER_TASK_CANCELLED);
+    return true;
+}
+
+void RenderExecutor::cancelOwner(JNIEnv *env, intptr_t owner){
+    std::vector<Entry*> cancelled;
+    pthread_mutex_lock(&mLock);
+    for(std::deque<Entry*>::iterator it = mQueue.begin(); it != mQueue.end();){
+        if((*it)->owner == owner){
+            cancelled.push_back(*it);
+            it = mQueue.erase(it);
+        }else{
+            ++it;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    for(size_t i = 0; i < cancelled.size(); i++){
+        cancelled[i]->task->complete(env, cancelled[i]->ticket, RENDER_TASK_CANCELLED);
+        finish(cancelled[i], RENDER_TASK_CANCELLED);
+    }
+
+    //Running tasks still use the owner's pages
+    pthread_mutex_lock(&mLock);
+    for(;;){
+        bool running = false;
+        for(std::map<int64_t, Entry*>::iterator it = mActive.begin(); it != mActive.end(); ++it){
+            if(it->second->owner == owner){
+                running = true;
+                break;
+            }
+        }
+        if(!running) break;
+        pthread_cond_wait(&mFinished, &mLock);
+    }
+    pthread_mutex_unlock(&mLock);
+}
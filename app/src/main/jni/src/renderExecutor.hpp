@@ -0,0 +1,90 @@
+#ifndef _RENDER_EXECUTOR_HPP_
+#define _RENDER_EXECUTOR_HPP_
+
+#include <jni.h>
+
+extern "C" {
+    #include <stdint.h>
+    #include <pthread.h>
+}
+
+#include <deque>
+#include <map>
+#include <vector>
+
+/*
+ * Executor owning the PDFium render calls of async requests. Callers submit a
+ * RenderTask and get a ticket back right away; the task runs on one of the
+ * executor threads (attached to the VM) and its state can be polled, awaited
+ * or delivered through RenderTask::complete.
+ */
+
+enum RenderTaskState {
+    RENDER_TASK_UNKNOWN = -1,   //never submitted or dropped from the history
+    RENDER_TASK_PENDING = 0,
+    RENDER_TASK_RUNNING,
+    RENDER_TASK_DONE,
+    RENDER_TASK_FAILED,
+    RENDER_TASK_CANCELLED
+};
+
+class RenderTask {
+public:
+    virtual ~RenderTask() {}
+    //Runs on an executor thread, true if the page was rendered
+    virtual bool run(JNIEnv *env) = 0;
+    //Called exactly once with the final state, also for cancelled tasks; release JNI refs here
+    virtual void complete(JNIEnv *env, int64_t ticket, int state) = 0;
+};
+
+class RenderExecutor {
+public:
+    RenderExecutor(JavaVM *vm, int threads);
+    ~RenderExecutor();
+
+    int threadCount() const { return (int) mThreads.size(); }
+
+    //Queue task rendering a page of owner (document), executor takes ownership
+    int64_t submit(RenderTask *task, intptr_t owner);
+    int status(int64_t ticket);
+    //Wait up to timeoutMs (<0 forever) for the task to finish, returns its state
+    int await(int64_t ticket, int timeoutMs);
+    //Cancel a task not started yet
+    bool cancel(JNIEnv *env, int64_t ticket);
+    //Cancel pending tasks of owner and wait for the running ones, before the owner is closed
+    void cancelOwner(JNIEnv *env, intptr_t owner);
+    /*
+     * Let the threads run what is queued, then stop and join them. Tickets and
+     * their history stay valid; the next submit starts the threads again.
+     */
+    void shutdown();
+
+private:
+    struct Entry {
+        int64_t ticket;
+        intptr_t owner;
+        int state;
+        RenderTask *task;
+    };
+
+    JavaVM *mVm;
+    int mThreadCount;
+    std::vector<pthread_t> mThreads;
+    bool mStopping;
+    pthread_mutex_t mLock;
+    pthread_cond_t mQueued;
+    pthread_cond_t mFinished;
+    std::deque<Entry*> mQueue;
+    std::map<int64_t, Entry*> mActive;
+    //Final states of recent tickets, bounded so unpolled tickets do not pile up
+    std::map<int64_t, int> mHistory;
+    std::deque<int64_t> mHistoryOrder;
+    int64_t mNextTicket;
+
+    void startLocked();
+    static void* threadMain(void *arg);
+    void loop(JNIEnv *env);
+    void finish(Entry *entry, int state);
+};
+
+#endif
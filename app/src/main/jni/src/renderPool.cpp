@@ -0,0 +1,547 @@
+#include "util.hpp"
+#include "renderPool.hpp"
+#include "memoryGovernor.hpp"
+#include "sharedMemory.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <signal.h>
+    #include <string.h>
+    #include <stdio.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+}
+
+#include <fpdfview.h>
+
+using namespace android;
+
+static int bytesPerPixel(int format){
+    switch(format){
+        case FPDFBitmap_Gray: return 1;
+        case FPDFBitmap_BGR: return 3;
+        default: return 4;
+    }
+}
+
+static size_t trimRing(int level, void *arg){
+    return reinterpret_cast<RenderPool*>(arg)->releaseRing();
+}
+
+RenderPool::RenderPool(const char *workerPath, int workers)
+        : mWorkerPath(workerPath), mNextDocumentId(1), mRing(NULL), mRingEpoch(0) {
+    pthread_rwlock_init(&mRingLock, NULL);
+    for(int i = 0; i < workers; i++){
+        Worker *worker = new Worker();
+        worker->pid = -1;
+        worker->socket = -1;
+        if(!spawn(worker)){
+            delete worker;
+            break;
+        }
+        mWorkers.push_back(worker);
+    }
+    LOGD("Render pool started %d of %d workers", (int) mWorkers.size(), workers);
+    MemoryGovernor::instance().addTrimHandler(10, TRIM_RUNNING_CRITICAL, trimRing, this);
+}
+
+RenderPool::~RenderPool(){
+    MemoryGovernor::instance().removeTrimHandler(trimRing, this);
+    for(size_t i = 0; i < mWorkers.size(); i++){
+        Worker *worker = mWorkers[i];
+        {
+            Mutex::Autolock lock(worker->lock);
+            shutdown(worker);
+        }
+        delete worker;
+    }
+    for(size_t i = 0; i < mDocuments.size(); i++){
+        close(mDocuments[i].fd);
+    }
+    MemoryGovernor::instance().untrack(mRing);
+    delete mRing;
+    pthread_rwlock_destroy(&mRingLock);
+}
+
+//Slot ticket tagged with the ring epoch, so tickets of a replaced ring never match
+static uint64_t poolTicket(uint32_t epoch, int slot, uint32_t generation){
+    return ((uint64_t) (epoch & 0xFFFF) << 48) | PixelRing::ticket(slot & 0xFFFF, generation);
+}
+
+bool RenderPool::spawn(Worker *worker){
+    int sockets[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) != 0){
+        LOGE("Render pool socketpair failed: %s", strerror(errno));
+        return false;
+    }
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+
+    //The worker links against libmodpdfium and libc++_shared next to it in nativeLibraryDir
+    const char *path = mWorkerPath.c_str();
+    char *const argv[] = { const_cast<char*>(path), const_cast<char*>("3"), NULL };
+    std::vector<std::string> environment;
+    std::vector<char*> envp;
+    helperEnvironment(path, &environment, &envp);
+
+    pid_t pid = fork();
+    if(pid == 0){
+        //Child of a JVM process: only async-signal-safe calls until exec
+        if(sockets[1] != 3){
+            dup2(sockets[1], 3);
+        }
+        long maxFd = sysconf(_SC_OPEN_MAX);
+        for(int fd = 4; fd < maxFd; fd++) close(fd);
+
+        execve(path, argv, &envp[0]);
+        _exit(127);
+    }
+    close(sockets[1]);
+
+    if(pid < 0){
+        LOGE("Render pool fork failed: %s", strerror(errno));
+        close(sockets[0]);
+        return false;
+    }
+
+    //The worker reports ready once PDFium is up; a worker that fails to exec,
+    //link or init closes the socket first
+    RenderPoolReply ready;
+    if(receiveWithFd(sockets[0], &ready, sizeof(ready), NULL) != sizeof(ready) || ready.status != 0){
+        close(sockets[0]);
+        int status = 0;
+        while(waitpid(pid, &status, 0) < 0 && errno == EINTR){}
+        LOGE("Render worker %s did not start, exit status %d", path,
+             WIFEXITED(status)? WEXITSTATUS(status) : -1);
+        return false;
+    }
+
+    worker->pid = pid;
+    worker->socket = sockets[0];
+    return true;
+}
+
+void RenderPool::shutdown(Worker *worker){
+    if(worker->socket >= 0){
+        RenderPoolRequest request;
+        memset(&request, 0, sizeof(request));
+        request.command = RENDER_POOL_QUIT;
+        sendWithFd(worker->socket, &request, sizeof(request), -1);
+        close(worker->socket);
+        worker->socket = -1;
+    }
+    if(worker->pid > 0){
+        int status;
+        if(waitpid(worker->pid, &status, WNOHANG) == 0){
+            kill(worker->pid, SIGKILL);
+            waitpid(worker->pid, &status, 0);
+        }
+        worker->pid = -1;
+    }
+}
+
+bool RenderPool::call(Worker *worker, const RenderPoolRequest &request, int fd){
+    if(!sendWithFd(worker->socket, &request, sizeof(request), fd)) return false;
+
+    RenderPoolReply reply;
+    if(receiveWithFd(worker->socket, &reply, sizeof(reply), NULL) != sizeof(reply)) return false;
+    if(reply.status != 0){
+        LOGE("Render worker command %d failed: %d", request.command, reply.error);
+    }
+    return reply.status == 0;
+}
+
+bool RenderPool::sendRing(Worker *worker){
+    if(mRing == NULL) return true;
+
+    RenderPoolRequest request;
+    memset(&request, 0, sizeof(request));
+    request.command = RENDER_POOL_SET_RING;
+    return call(worker, request, mRing->fd());
+}
+
+bool RenderPool::ensureRing(size_t slotSize){
+    pthread_rwlock_rdlock(&mRingLock);
+    bool fits = mRing != NULL && mRing->slotSize() >= slotSize;
+    pthread_rwlock_unlock(&mRingLock);
+    if(fits) return true;
+
+    pthread_rwlock_wrlock(&mRingLock);
+    bool ok = true;
+    if(mRing == NULL || mRing->slotSize() < slotSize){
+        if(mRing != NULL && mRing->busySlots() > 0){
+            //Consumers still map pages of the current ring
+            LOGE("Render pool ring busy, release rendered pages before growing it");
+            ok = false;
+        }else{
+            //Round up so small size changes while zooming do not remap every frame
+            size_t rounded = (slotSize + (1 << 20) - 1) & ~((size_t) (1 << 20) - 1);
+            //Two slots per worker keep workers busy while the consumer holds the last page
+            PixelRing *ring = PixelRing::create((int) mWorkers.size() * 2 + 2, rounded);
+            if(ring == NULL){
+                ok = false;
+            }else{
+                MemoryGovernor::instance().untrack(mRing);
+                delete mRing;
+                mRing = ring;
+                mRingEpoch++;
+                MemoryGovernor::instance().track(mRing, MEMORY_TILE_CACHE,
+                                                 (size_t) mRing->slotCount() * mRing->slotSize());
+                for(size_t i = 0; i < mWorkers.size(); i++){
+                    Mutex::Autolock lock(mWorkers[i]->lock);
+                    sendRing(mWorkers[i]);
+                }
+            }
+        }
+    }
+    pthread_rwlock_unlock(&mRingLock);
+    return ok;
+}
+
+size_t RenderPool::releaseRing(){
+    size_t released = 0;
+    pthread_rwlock_wrlock(&mRingLock);
+    if(mRing != NULL && mRing->busySlots() == 0){
+        //Workers unmap too, the shared pages are only freed once nobody maps them
+        RenderPoolRequest request;
+        memset(&request, 0, sizeof(request));
+        request.command = RENDER_POOL_SET_RING;
+        for(size_t i = 0; i < mWorkers.size(); i++){
+            Mutex::Autolock lock(mWorkers[i]->lock);
+            call(mWorkers[i], request, -1);
+        }
+
+        released = (size_t) mRing->slotCount() * mRing->slotSize();
+        MemoryGovernor::instance().untrack(mRing);
+        delete mRing;
+        mRing = NULL;
+        mRingEpoch++;
+    }
+    pthread_rwlock_unlock(&mRingLock);
+    return released;
+}
+
+bool RenderPool::restart(Worker *worker, const std::vector<Document> &documents){
+    //Fresh process with the current ring and every pool document
+    shutdown(worker);
+    if(!spawn(worker) || !sendRing(worker)) return false;
+    for(size_t d = 0; d < documents.size(); d++){
+        if(!openInWorker(worker, documents[d])) return false;
+    }
+    return true;
+}
+
+bool RenderPool::openInWorker(Worker *worker, const Document &document){
+    RenderPoolRequest request;
+    memset(&request, 0, sizeof(request));
+    request.command = RENDER_POOL_OPEN_DOCUMENT;
+    request.documentId = document.id;
+    strncpy(request.password, document.password.c_str(), RENDER_POOL_MAX_PASSWORD - 1);
+    return call(worker, request, document.fd);
+}
+
+int RenderPool::openDocument(int fd, const char *password){
+    if(password != NULL && strlen(password) >= RENDER_POOL_MAX_PASSWORD) return -1;
+
+    Document document;
+    document.fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if(document.fd < 0) return -1;
+    document.password = (password != NULL)? password : "";
+
+    {
+        Mutex::Autolock lock(mDocumentsLock);
+        document.id = mNextDocumentId++;
+    }
+
+    bool opened = true;
+    for(size_t i = 0; opened && i < mWorkers.size(); i++){
+        Mutex::Autolock lock(mWorkers[i]->lock);
+        opened = openInWorker(mWorkers[i], document);
+    }
+
+    if(!opened){
+        closeDocument(document.id);
+        close(document.fd);
+        return -1;
+    }
+
+    Mutex::Autolock lock(mDocumentsLock);
+    mDocuments.push_back(document);
+    return document.id;
+}
+
+void RenderPool::closeDocument(int documentId){
+    RenderPoolRequest request;
+    memset(&request, 0, sizeof(request));
+    request.command = RENDER_POOL_CLOSE_DOCUMENT;
+    request.documentId = documentId;
+
+    for(size_t i = 0; i < mWorkers.size(); i++){
+        Mutex::Autolock lock(mWorkers[i]->lock);
+        call(mWorkers[i], request, -1);
+    }
+
+    Mutex::Autolock lock(mDocumentsLock);
+    for(size_t i = 0; i < mDocuments.size(); i++){
+        if(mDocuments[i].id == documentId){
+            close(mDocuments[i].fd);
+            mDocuments.erase(mDocuments.begin() + i);
+            break;
+        }
+    }
+}
+
+bool RenderPool::sendRender(Worker *worker, int documentId, Target *target, int *slot){
+    uint32_t generation;
+    *slot = mRing->acquireWrite(&generation);
+    if(*slot < 0){
+        LOGE("Render pool ring full");
+        return false;
+    }
+
+    RenderPoolRequest request;
+    memset(&request, 0, sizeof(request));
+    request.command = RENDER_POOL_RENDER;
+    request.documentId = documentId;
+    request.pageIndex = target->pageIndex;
+    request.format = target->format;
+    request.canvasHorSize = target->canvasHorSize;
+    request.canvasVerSize = target->canvasVerSize;
+    request.stride = target->canvasHorSize * bytesPerPixel(target->format);
+    request.startX = target->startX;
+    request.startY = target->startY;
+    request.drawSizeHor = target->drawSizeHor;
+    request.drawSizeVer = target->drawSizeVer;
+    request.flags = target->flags;
+    request.slot = *slot;
+    request.generation = generation;
+    target->ticket = poolTicket(mRingEpoch, *slot, generation);
+
+    if(!sendWithFd(worker->socket, &request, sizeof(request), -1)){
+        //Slot index stays set so the caller can tell a lost worker from a full ring
+        mRing->abortWrite(*slot);
+        return false;
+    }
+    return true;
+}
+
+int RenderPool::finishRender(Worker *worker, Target *target, int slot){
+    target->done = true;
+
+    RenderPoolReply reply;
+    if(receiveWithFd(worker->socket, &reply, sizeof(reply), NULL) != sizeof(reply)){
+        mRing->abortWrite(slot);
+        target->ticket = 0;
+        return -1;
+    }
+    if(reply.status != 0){
+        LOGE("Render worker failed page %d: %d", target->pageIndex, reply.error);
+        mRing->abortWrite(slot);
+        target->ticket = 0;
+        return 0;
+    }
+
+    //Read before the ticket leaves, a READY slot is fair game for the next acquireWrite or trim
+    if(!mRing->acquireRead(slot, PixelRing::ticketGeneration(target->ticket))){
+        target->ticket = 0;
+        return 0;
+    }
+    if(target->pixels == NULL) return 1;
+
+    //Caller wants its own buffer, copy out and give the slot back right away
+    const PixelSlot *info = mRing->slot(slot);
+    int rowSize = info->width * bytesPerPixel(info->format);
+    const char *src = (const char*) mRing->pixels(slot);
+    char *dst = (char*) target->pixels;
+    for(int y = 0; y < info->height; y++){
+        memcpy(dst, src, rowSize);
+        src += info->stride;
+        dst += target->stride;
+    }
+    mRing->releaseRead(slot);
+    target->ticket = 0;
+    return 1;
+}
+
+int RenderPool::render(int documentId, Target *targets, int count){
+    int workers = (int) mWorkers.size();
+    if(workers == 0) return 0;
+
+    size_t slotSize = 0;
+    for(int i = 0; i < count; i++){
+        targets[i].done = targets[i].pageIndex < 0;
+        targets[i].ticket = 0;
+        size_t size = (size_t) targets[i].canvasHorSize * bytesPerPixel(targets[i].format)
+                      * targets[i].canvasVerSize;
+        if(size > slotSize) slotSize = size;
+    }
+    if(!ensureRing(slotSize)) return 0;
+
+    std::vector<Document> documents;
+    {
+        Mutex::Autolock lock(mDocumentsLock);
+        documents = mDocuments;
+    }
+
+    pthread_rwlock_rdlock(&mRingLock);
+    if(mRing == NULL || mRing->slotSize() < slotSize){
+        pthread_rwlock_unlock(&mRingLock);
+        return 0;
+    }
+
+    int rendered = 0;
+    std::vector<int> inFlight(workers);
+    std::vector<int> slots(workers);
+    bool pending = true;
+    while(pending){
+        pending = false;
+
+        //One request per worker per round, locks taken in worker order
+        for(int w = 0; w < workers; w++){
+            inFlight[w] = -1;
+            for(int i = 0; i < count; i++){
+                if(!targets[i].done && targets[i].pageIndex % workers == w){
+                    inFlight[w] = i;
+                    break;
+                }
+            }
+            if(inFlight[w] < 0) continue;
+
+            Worker *worker = mWorkers[w];
+            Target *target = &targets[inFlight[w]];
+            worker->lock.lock();
+            if(!sendRender(worker, documentId, target, &slots[w])){
+                //A full ring means every slot is mapped or in flight, drop the page
+                bool retry = slots[w] >= 0;
+                if(retry){
+                    //Worker died, restart it and retry once
+                    retry = restart(worker, documents);
+                }
+                if(!retry || !sendRender(worker, documentId, target, &slots[w])){
+                    target->done = true;
+                    target->ticket = 0;
+                    inFlight[w] = -1;
+                    worker->lock.unlock();
+                }
+            }
+        }
+
+        for(int w = 0; w < workers; w++){
+            if(inFlight[w] < 0) continue;
+            Worker *worker = mWorkers[w];
+            int result = finishRender(worker, &targets[inFlight[w]], slots[w]);
+            if(result > 0){
+                rendered++;
+            }else if(result < 0){
+                restart(worker, documents);
+            }
+            worker->lock.unlock();
+        }
+
+        for(int i = 0; i < count; i++){
+            if(!targets[i].done) pending = true;
+        }
+    }
+    pthread_rwlock_unlock(&mRingLock);
+    return rendered;
+}
+
+bool RenderPool::extractText(int documentId, int pageCount,
+                             std::vector<unsigned short> *text, std::vector<int32_t> *offsets){
+    int workers = (int) mWorkers.size();
+    if(workers == 0) return false;
+    if(workers > pageCount) workers = pageCount > 0 ? pageCount : 1;
+
+    std::vector<Document> documents;
+    {
+        Mutex::Autolock lock(mDocumentsLock);
+        documents = mDocuments;
+    }
+
+    //Ring read lock for restart(), taken before worker locks like render()
+    pthread_rwlock_rdlock(&mRingLock);
+
+    //Ranges in worker order, sent to all workers before any reply is read
+    std::vector<bool> sent(workers, false);
+    for(int w = 0; w < workers; w++){
+        Worker *worker = mWorkers[w];
+        worker->lock.lock();
+
+        RenderPoolRequest request;
+        memset(&request, 0, sizeof(request));
+        request.command = RENDER_POOL_EXTRACT_TEXT;
+        request.documentId = documentId;
+        request.pageIndex = (int) ((int64_t) pageCount * w / workers);
+        request.pageEnd = (int) ((int64_t) pageCount * (w + 1) / workers);
+        sent[w] = sendWithFd(worker->socket, &request, sizeof(request), -1);
+    }
+
+    bool ok = true;
+    offsets->clear();
+    offsets->push_back((int32_t) text->size());
+    for(int w = 0; w < workers; w++){
+        Worker *worker = mWorkers[w];
+        int fd = -1;
+        RenderPoolReply reply;
+        bool received = sent[w] && receiveWithFd(worker->socket, &reply, sizeof(reply), &fd) == sizeof(reply);
+
+        int from = (int) ((int64_t) pageCount * w / workers);
+        int to = (int) ((int64_t) pageCount * (w + 1) / workers);
+        size_t offsetsSize = (size_t) (to - from + 1) * sizeof(int32_t);
+        void *addr = NULL;
+        if(received && reply.status == 0 && fd >= 0 && (size_t) reply.length >= offsetsSize){
+            addr = mapSharedMemory(fd, (size_t) reply.length);
+        }
+
+        if(ok && addr != NULL){
+            const int32_t *rangeOffsets = (const int32_t*) addr;
+            const unsigned short *rangeText = (const unsigned short*) ((char*) addr + offsetsSize);
+            size_t rangeLength = ((size_t) reply.length - offsetsSize) / sizeof(unsigned short);
+            int32_t base = (int32_t) text->size();
+            for(int i = 1; i <= to - from; i++){
+                offsets->push_back(base + rangeOffsets[i]);
+            }
+            text->insert(text->end(), rangeText, rangeText + rangeLength);
+        }else{
+            ok = false;
+        }
+        if(addr != NULL) unmapSharedMemory(addr, (size_t) reply.length);
+        if(fd >= 0) close(fd);
+
+        if(!received) restart(worker, documents);
+        worker->lock.unlock();
+    }
+    pthread_rwlock_unlock(&mRingLock);
+    return ok;
+}
+
+const PixelSlot* RenderPool::acquirePage(uint64_t ticket, void **pixels){
+    const PixelSlot *info = NULL;
+    pthread_rwlock_rdlock(&mRingLock);
+    int slot = PixelRing::ticketSlot(ticket) & 0xFFFF;
+    if(mRing != NULL && (ticket >> 48) == (mRingEpoch & 0xFFFF) && slot < mRing->slotCount()){
+        //render left the slot READING for this ticket, which also keeps the ring in place
+        const PixelSlot *held = mRing->slot(slot);
+        if(__atomic_load_n(&held->state, __ATOMIC_ACQUIRE) == PIXEL_SLOT_READING
+           && held->generation == PixelRing::ticketGeneration(ticket) + 1){
+            info = held;
+            *pixels = mRing->pixels(slot);
+        }
+    }
+    pthread_rwlock_unlock(&mRingLock);
+    return info;
+}
+
+void RenderPool::releasePage(uint64_t ticket){
+    pthread_rwlock_rdlock(&mRingLock);
+    int slot = PixelRing::ticketSlot(ticket) & 0xFFFF;
+    if(mRing != NULL && (ticket >> 48) == (mRingEpoch & 0xFFFF) && slot < mRing->slotCount()){
+        const PixelSlot *info = mRing->slot(slot);
+        if(__atomic_load_n(&info->state, __ATOMIC_ACQUIRE) == PIXEL_SLOT_READING
+           && info->generation == PixelRing::ticketGeneration(ticket) + 1){
+            mRing->releaseRead(slot);
+        }
+    }
+    pthread_rwlock_unlock(&mRingLock);
+}
@@ -0,0 +1,143 @@
+#ifndef _RENDER_POOL_HPP_
+#define _RENDER_POOL_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+    #include <sys/types.h>
+    #include <pthread.h>
+}
+
+#include <utils/Mutex.h>
+
+#include "pixelRing.hpp"
+
+#include <string>
+#include <vector>
+
+/*
+ * Render pool: N helper processes (pdfiumRenderWorker), each with its own
+ * FPDF_InitLibrary, so pages of one document rasterize in parallel instead of
+ * queueing on the process wide PDFium lock. Documents are opened in every
+ * worker from a dup of the same fd, pages are sharded by index and workers
+ * write pixels straight into a slot of the shared PixelRing.
+ */
+
+enum RenderPoolCommand {
+    RENDER_POOL_OPEN_DOCUMENT = 1,
+    RENDER_POOL_CLOSE_DOCUMENT,
+    RENDER_POOL_SET_RING,
+    RENDER_POOL_RENDER,
+    RENDER_POOL_QUIT,
+    RENDER_POOL_EXTRACT_TEXT
+};
+
+#define RENDER_POOL_MAX_PASSWORD 128
+
+struct RenderPoolRequest {
+    int32_t command;
+    int32_t documentId;
+    int32_t pageIndex;
+    int32_t format;         //FPDFBitmap_* of the shared buffer
+    int32_t canvasHorSize;
+    int32_t canvasVerSize;
+    int32_t stride;
+    int32_t startX;
+    int32_t startY;
+    int32_t drawSizeHor;
+    int32_t drawSizeVer;
+    int32_t flags;          //FPDF_RenderPageBitmap flags
+    int32_t slot;           //PixelRing slot claimed for the page
+    uint32_t generation;    //write generation of the claimed slot
+    int32_t pageEnd;        //EXTRACT_TEXT covers pageIndex..pageEnd-1
+    char password[RENDER_POOL_MAX_PASSWORD];
+};
+
+//Also sent once unprompted by a worker that started, status 0
+struct RenderPoolReply {
+    int32_t status;         //0 on success
+    int32_t error;          //FPDF_GetLastError or errno
+    int32_t length;         //bytes of the shared memory attached to the reply, if any
+};
+
+class RenderPool {
+public:
+    struct Target {
+        int pageIndex;
+        void *pixels;       //caller owned destination, NULL to keep page in the ring
+        int format;
+        int canvasHorSize;
+        int canvasVerSize;
+        int stride;
+        int startX;
+        int startY;
+        int drawSizeHor;
+        int drawSizeVer;
+        int flags;
+        bool done;
+        uint64_t ticket;    //ring ticket holding the slot when pixels is NULL, 0 if not rendered
+    };
+
+    RenderPool(const char *workerPath, int workers);
+    ~RenderPool();
+
+    int workerCount() const { return (int) mWorkers.size(); }
+
+    //Open document from fd in every worker, returns pool document id or -1
+    int openDocument(int fd, const char *password);
+    void closeDocument(int documentId);
+
+    //Render targets in parallel, one worker per page shard; returns rendered count
+    int render(int documentId, Target *targets, int count);
+
+    /*
+     * Text of pages [0, pageCount) as by appendDocumentText, each worker
+     * extracting one contiguous range. False if any worker failed.
+     */
+    bool extractText(int documentId, int pageCount,
+                     std::vector<unsigned short> *text, std::vector<int32_t> *offsets);
+
+    //Drop the pixel ring when no page is mapped, the next render creates a new one
+    size_t releaseRing();
+
+    //Map the slot a ticket holds; valid until releasePage, which every ticket needs, mapped or not
+    const PixelSlot* acquirePage(uint64_t ticket, void **pixels);
+    void releasePage(uint64_t ticket);
+
+private:
+    struct Worker {
+        pid_t pid;
+        int socket;
+        android::Mutex lock;
+    };
+
+    struct Document {
+        int id;
+        int fd;             //dup kept to reopen documents in respawned workers
+        std::string password;
+    };
+
+    std::string mWorkerPath;
+    std::vector<Worker*> mWorkers;
+    std::vector<Document> mDocuments;
+    android::Mutex mDocumentsLock;
+    int mNextDocumentId;
+
+    //Readers render or map pages, the writer replaces the ring with a larger one
+    PixelRing *mRing;
+    uint32_t mRingEpoch;
+    pthread_rwlock_t mRingLock;
+
+    bool spawn(Worker *worker);
+    void shutdown(Worker *worker);
+    bool ensureRing(size_t slotSize);
+    bool sendRing(Worker *worker);
+    bool call(Worker *worker, const RenderPoolRequest &request, int fd);
+    bool openInWorker(Worker *worker, const Document &document);
+    bool restart(Worker *worker, const std::vector<Document> &documents);
+    bool sendRender(Worker *worker, int documentId, Target *target, int *slot);
+    //1 rendered, 0 page failed, -1 worker lost
+    int finishRender(Worker *worker, Target *target, int slot);
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "util.hpp"
+#include "pdfCore.hpp"
+#include "renderPool.hpp"
+#include "sharedMemory.hpp"
+#include "pixelRing.hpp"
+#include "documentAssembler.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <string.h>
+    #include <stdlib.h>
+}
+
+#include <fpdfview.h>
+
+#include <map>
+
+/*
+ * pdfiumRenderWorker - helper process of RenderPool. Owns one PDFium instance
+ * and serves requests from the socket given as the only argument. Exits when
+ * the socket is closed or on RENDER_POOL_QUIT. Started with "assemble" it
+ * builds one merge/split output instead, see documentAssembler.hpp.
+ */
+
+//Pages of the current shard stay loaded, a few are enough for page flipping
+#define WORKER_PAGE_CACHE 8
+
+struct WorkerDocument {
+    int fd;
+    FPDF_DOCUMENT document;
+    std::map<int, FPDF_PAGE> pages;
+    std::vector<int> pageOrder;
+};
+
+static std::map<int, WorkerDocument*> sDocuments;
+static PixelRing *sRing = NULL;
+
+static void closeWorkerDocument(WorkerDocument *doc){
+    for(std::map<int, FPDF_PAGE>::iterator it = doc->pages.begin(); it != doc->pages.end(); ++it){
+        FPDF_ClosePage(it->second);
+    }
+    FPDF_CloseDocument(doc->document);
+    close(doc->fd);
+    delete doc;
+}
+
+static FPDF_PAGE getWorkerPage(WorkerDocument *doc, int pageIndex){
+    std::map<int, FPDF_PAGE>::iterator it = doc->pages.find(pageIndex);
+    if(it != doc->pages.end()) return it->second;
+
+    FPDF_PAGE page = FPDF_LoadPage(doc->document, pageIndex);
+    if(page == NULL) return NULL;
+
+    if(doc->pageOrder.size() >= WORKER_PAGE_CACHE){
+        int evicted = doc->pageOrder.front();
+        doc->pageOrder.erase(doc->pageOrder.begin());
+        FPDF_ClosePage(doc->pages[evicted]);
+        doc->pages.erase(evicted);
+    }
+    doc->pages[pageIndex] = page;
+    doc->pageOrder.push_back(pageIndex);
+    return page;
+}
+
+/*
+ * Text of a page range in shared memory: pageEnd - pageIndex + 1 int32
+ * offsets followed by the UTF-16 text.
+ */
+static int extractText(WorkerDocument *doc, int fromIndex, int toIndex, int32_t *length){
+    std::vector<unsigned short> scratch;
+    std::vector<unsigned short> text;
+    std::vector<int32_t> offsets;
+    appendDocumentText(doc->document, fromIndex, toIndex, &scratch, &text, &offsets);
+
+    size_t offsetsSize = offsets.size() * sizeof(int32_t);
+    size_t size = offsetsSize + text.size() * sizeof(unsigned short);
+    int fd = createSharedMemory("pdfium-text", size);
+    if(fd < 0) return -1;
+    void *addr = mapSharedMemory(fd, size);
+    if(addr == NULL){
+        close(fd);
+        return -1;
+    }
+    memcpy(addr, &offsets[0], offsetsSize);
+    if(!text.empty()) memcpy((char*) addr + offsetsSize, &text[0], size - offsetsSize);
+    unmapSharedMemory(addr, size);
+
+    *length = (int32_t) size;
+    return fd;
+}
+
+static RenderPoolReply handleRequest(const RenderPoolRequest &request, int fd, int *replyFd){
+    RenderPoolReply reply;
+    reply.status = 0;
+    reply.error = 0;
+    reply.length = 0;
+
+    switch(request.command){
+        case RENDER_POOL_OPEN_DOCUMENT: {
+            if(fd < 0){
+                reply.status = -1;
+                reply.error = EBADF;
+                break;
+            }
+            char password[RENDER_POOL_MAX_PASSWORD];
+            memcpy(password, request.password, sizeof(password));
+            password[sizeof(password) - 1] = '\0';
+
+            FPDF_DOCUMENT document = loadDocumentFromFd(fd, (size_t) getFileSize(fd),
+                                                        password[0] ? password : NULL);
+            if(document == NULL){
+                close(fd);
+                reply.status = -1;
+                reply.error = (int32_t) FPDF_GetLastError();
+                break;
+            }
+            WorkerDocument *doc = new WorkerDocument();
+            doc->fd = fd;
+            doc->document = document;
+            if(sDocuments.count(request.documentId)){
+                closeWorkerDocument(sDocuments[request.documentId]);
+            }
+            sDocuments[request.documentId] = doc;
+            break;
+        }
+        case RENDER_POOL_CLOSE_DOCUMENT: {
+            std::map<int, WorkerDocument*>::iterator it = sDocuments.find(request.documentId);
+            if(it != sDocuments.end()){
+                closeWorkerDocument(it->second);
+                sDocuments.erase(it);
+            }
+            break;
+        }
+        case RENDER_POOL_SET_RING: {
+            if(fd < 0){
+                //Ring released by the app under memory pressure
+                delete sRing;
+                sRing = NULL;
+                break;
+            }
+            PixelRing *ring = PixelRing::attach(fd);
+            if(ring == NULL){
+                reply.status = -1;
+                reply.error = ENOMEM;
+                break;
+            }
+            delete sRing;
+            sRing = ring;
+            break;
+        }
+        case RENDER_POOL_RENDER: {
+            std::map<int, WorkerDocument*>::iterator it = sDocuments.find(request.documentId);
+            if(it == sDocuments.end()){
+                reply.status = -1;
+                reply.error = EBADF;
+                break;
+            }
+            if(sRing == NULL || request.slot < 0 || request.slot >= sRing->slotCount()
+               || (uint64_t) request.stride * request.canvasVerSize > sRing->slotSize()){
+                reply.status = -1;
+                reply.error = ENOSPC;
+                break;
+            }
+            //The app claimed the slot for this request, anything else is a stale request
+            PixelSlot *slot = sRing->slot(request.slot);
+            if(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != PIXEL_SLOT_WRITING
+               || __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE) != request.generation){
+                reply.status = -1;
+                reply.error = ESTALE;
+                break;
+            }
+            FPDF_PAGE page = getWorkerPage(it->second, request.pageIndex);
+            if(page == NULL){
+                reply.status = -1;
+                reply.error = (int32_t) FPDF_GetLastError();
+                break;
+            }
+            renderPageToBuffer(page, sRing->pixels(request.slot), request.format, request.stride,
+                               request.canvasHorSize, request.canvasVerSize,
+                               request.startX, request.startY,
+                               request.drawSizeHor, request.drawSizeVer,
+                               request.flags, NULL);
+            sRing->publish(request.slot, request.documentId, request.pageIndex, request.format,
+                           request.canvasHorSize, request.canvasVerSize, request.stride);
+            break;
+        }
+        case RENDER_POOL_EXTRACT_TEXT: {
+            std::map<int, WorkerDocument*>::iterator it = sDocuments.find(request.documentId);
+            if(it == sDocuments.end() || request.pageIndex < 0 || request.pageEnd < request.pageIndex){
+                reply.status = -1;
+                reply.error = EBADF;
+                break;
+            }
+            *replyFd = extractText(it->second, request.pageIndex, request.pageEnd, &reply.length);
+            if(*replyFd < 0){
+                reply.status = -1;
+                reply.error = ENOMEM;
+            }
+            break;
+        }
+        default:
+            reply.status = -1;
+            reply.error = EINVAL;
+    }
+    return reply;
+}
+
+int main(int argc, char **argv){
+    if(argc < 2) return 2;
+    if(strcmp(argv[1], "assemble") == 0) return assembleMain(argc, argv);
+    int socket = atoi(argv[1]);
+
+    FPDF_InitLibrary();
+
+    //Handshake, RenderPool::spawn waits for it before sending requests
+    RenderPoolReply ready;
+    memset(&ready, 0, sizeof(ready));
+    if(!sendWithFd(socket, &ready, sizeof(ready), -1)){
+        FPDF_DestroyLibrary();
+        return 1;
+    }
+
+    for(;;){
+        RenderPoolRequest request;
+        int fd = -1;
+        int received = receiveWithFd(socket, &request, sizeof(request), &fd);
+        if(received != (int) sizeof(request)){
+            if(fd >= 0) close(fd);
+            break;
+        }
+        if(request.command == RENDER_POOL_QUIT) break;
+
+        int replyFd = -1;
+        RenderPoolReply reply = handleRequest(request, fd, &replyFd);
+        bool sent = sendWithFd(socket, &reply, sizeof(reply), replyFd);
+        if(replyFd >= 0) close(replyFd);
+        if(!sent) break;
+    }
+
+    for(std::map<int, WorkerDocument*>::iterator it = sDocuments.begin(); it != sDocuments.end(); ++it){
+        closeWorkerDocument(it->second);
+    }
+    delete sRing;
+    FPDF_DestroyLibrary();
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "util.hpp"
+#include "scratchArena.hpp"
+#include "memoryGovernor.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <pthread.h>
+}
+
+#define SCRATCH_CHUNK_SIZE (64 * 1024)
+#define SCRATCH_RETAINED_SIZE (256 * 1024)     //kept between calls, the rest goes back
+
+static pthread_key_t sArenaKey;
+static pthread_once_t sArenaKeyOnce = PTHREAD_ONCE_INIT;
+
+void ScratchArena::createKey(){
+    pthread_key_create(&sArenaKey, destroy);
+}
+
+ScratchArena& ScratchArena::current(){
+    pthread_once(&sArenaKeyOnce, createKey);
+    ScratchArena *arena = static_cast<ScratchArena*>(pthread_getspecific(sArenaKey));
+    if(arena == NULL){
+        arena = new ScratchArena();
+        pthread_setspecific(sArenaKey, arena);
+    }
+    return *arena;
+}
+
+ScratchArena::ScratchArena() : mChunk(0), mUsed(0), mCapacity(0), mDepth(0) {
+}
+
+ScratchArena::~ScratchArena(){
+    for(size_t i = 0; i < mChunks.size(); i++) free(mChunks[i].base);
+    MemoryGovernor::instance().untrack(this);
+}
+
+void ScratchArena::destroy(void *arena){
+    delete static_cast<ScratchArena*>(arena);
+}
+
+void* ScratchArena::alloc(size_t bytes, size_t align){
+    for(;;){
+        if(mChunk < mChunks.size()){
+            Chunk &chunk = mChunks[mChunk];
+            size_t offset = (mUsed + align - 1) & ~(align - 1);
+            if(offset + bytes <= chunk.size){
+                mUsed = offset + bytes;
+                return chunk.base + offset;
+            }
+            //Later chunks were kept from an earlier, larger call
+            if(mChunk + 1 < mChunks.size()){
+                mChunk++;
+                mUsed = 0;
+                continue;
+            }
+        }
+
+        //Double with each chunk so large ranges need few of them
+        size_t size = mChunks.empty() ? SCRATCH_CHUNK_SIZE : mChunks.back().size * 2;
+        while(size < bytes + align) size *= 2;
+        Chunk chunk;
+        chunk.base = static_cast<char*>(malloc(size));
+        if(chunk.base == NULL){
+            LOGE("Scratch arena cannot grow to %zu bytes", mCapacity + size);
+            return NULL;
+        }
+        chunk.size = size;
+        mChunks.push_back(chunk);
+        mCapacity += size;
+        MemoryGovernor::instance().track(this, MEMORY_SCRATCH, mCapacity);
+        mChunk = mChunks.size() - 1;
+        mUsed = 0;
+    }
+}
+
+void ScratchArena::rewind(const Mark &mark){
+    mChunk = mark.chunk;
+    mUsed = mark.used;
+}
+
+void ScratchArena::shrink(){
+    if(mCapacity <= SCRATCH_RETAINED_SIZE) return;
+    //Keep the first chunks within the retained size, the arena is empty here
+    size_t kept = 0;
+    size_t keep = 0;
+    while(keep < mChunks.size() && kept + mChunks[keep].size <= SCRATCH_RETAINED_SIZE){
+        kept += mChunks[keep].size;
+        keep++;
+    }
+    for(size_t i = keep; i < mChunks.size(); i++) free(mChunks[i].base);
+    mChunks.resize(keep);
+    mCapacity = kept;
+    mChunk = 0;
+    mUsed = 0;
+    MemoryGovernor::instance().track(this, MEMORY_SCRATCH, mCapacity);
+}
+
+ScratchScope::ScratchScope() : mArena(ScratchArena::current()) {
+    mMark.chunk = mArena.mChunk;
+    mMark.used = mArena.mUsed;
+    mArena.mDepth++;
+}
+
+ScratchScope::~ScratchScope(){
+    mArena.rewind(mMark);
+    if(--mArena.mDepth == 0) mArena.shrink();
+}
@@ -0,0 +1,75 @@
+#ifndef _SCRATCH_ARENA_HPP_
+#define _SCRATCH_ARENA_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <vector>
+
+/*
+ * Per-thread bump allocator for temporaries of one native call: page handle
+ * arrays, titles, URIs, text runs. A ScratchScope at the top of the call
+ * marks the arena and rewinds it on return, so buffers are never freed one
+ * by one and nothing large lands on the stack. Chunks are kept between calls
+ * up to a retained size, above that the outermost scope gives them back.
+ */
+
+class ScratchArena {
+public:
+    //Arena of the calling thread, created on first use and freed when the thread exits
+    static ScratchArena& current();
+
+    void* alloc(size_t bytes, size_t align = sizeof(void*));
+
+    template <class T>
+    T* alloc(size_t count) { return static_cast<T*>(alloc(count * sizeof(T), __alignof__(T))); }
+
+    size_t capacity() const { return mCapacity; }
+
+private:
+    friend class ScratchScope;
+
+    struct Chunk {
+        char *base;
+        size_t size;
+    };
+
+    struct Mark {
+        size_t chunk;
+        size_t used;
+    };
+
+    std::vector<Chunk> mChunks;
+    size_t mChunk;          //chunk being filled
+    size_t mUsed;           //bytes used in it
+    size_t mCapacity;
+    int mDepth;
+
+    ScratchArena();
+    ~ScratchArena();
+
+    static void createKey();
+    static void destroy(void *arena);
+    void rewind(const Mark &mark);
+    void shrink();
+};
+
+//Rewinds the current thread's arena to where it was at construction
+class ScratchScope {
+public:
+    ScratchScope();
+    ~ScratchScope();
+
+    ScratchArena& arena() { return mArena; }
+
+private:
+    ScratchArena &mArena;
+    ScratchArena::Mark mMark;
+
+    ScratchScope(const ScratchScope&);
+    ScratchScope& operator=(const ScratchScope&);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "util.hpp"
+#include "searchSession.hpp"
+
+SearchSession::SearchSession(FPDF_DOCUMENT doc, int pageIndex, const unsigned short *query,
+                             unsigned long flags)
+        : mPage(NULL), mTextPage(NULL), mHandle(NULL), mComplete(false), mCurrent(-1) {
+    mPage = FPDF_LoadPage(doc, pageIndex);
+    if(mPage == NULL){
+        LOGE("Search cannot load page %d", pageIndex);
+        return;
+    }
+    mTextPage = FPDFText_LoadPage(mPage);
+    if(mTextPage == NULL){
+        LOGE("Search cannot load text page %d", pageIndex);
+        return;
+    }
+    mHandle = FPDFText_FindStart(mTextPage, query, flags, 0);
+}
+
+SearchSession::~SearchSession(){
+    if(mHandle != NULL) FPDFText_FindClose(mHandle);
+    if(mTextPage != NULL) FPDFText_ClosePage(mTextPage);
+    if(mPage != NULL) FPDF_ClosePage(mPage);
+}
+
+bool SearchSession::findMore(){
+    if(mComplete || mHandle == NULL) return false;
+
+    //Handle always sits on the last remembered match, FindNext moves past it
+    if(!FPDFText_FindNext(mHandle)){
+        mComplete = true;
+        return false;
+    }
+    Match match;
+    match.index = FPDFText_GetSchResultIndex(mHandle);
+    match.count = FPDFText_GetSchCount(mHandle);
+    mMatches.push_back(match);
+    return true;
+}
+
+bool SearchSession::next(){
+    if(mCurrent + 1 >= (int) mMatches.size() && !findMore()) return false;
+    mCurrent++;
+    return true;
+}
+
+bool SearchSession::prev(){
+    if(mCurrent <= 0) return false;
+    mCurrent--;
+    return true;
+}
+
+bool SearchSession::jump(int n){
+    if(n < 0) return false;
+    while(n >= (int) mMatches.size()){
+        if(!findMore()) return false;
+    }
+    mCurrent = n;
+    return true;
+}
+
+int SearchSession::count(){
+    while(findMore()){}
+    return (int) mMatches.size();
+}
+
+int SearchSession::charIndex() const {
+    return mCurrent >= 0 ? mMatches[mCurrent].index : -1;
+}
+
+int SearchSession::charCount() const {
+    return mCurrent >= 0 ? mMatches[mCurrent].count : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _SEARCH_SESSION_HPP_
+#define _SEARCH_SESSION_HPP_
+
+#include <fpdfview.h>
+#include <fpdf_text.h>
+
+#include <vector>
+
+/*
+ * Find session on one page. Owns its page, text page and FPDFText search
+ * handle for its whole life, so stepping does not restart the search. Matches
+ * are remembered as the handle finds them: next only asks PDFium for a match
+ * not seen yet, prev and jump to a seen match are lookups.
+ */
+
+class SearchSession {
+public:
+    //query is UTF-16 with terminator, flags are FPDF_MATCHCASE / FPDF_MATCHWHOLEWORD
+    SearchSession(FPDF_DOCUMENT doc, int pageIndex, const unsigned short *query, unsigned long flags);
+    ~SearchSession();
+
+    bool valid() const { return mHandle != NULL; }
+
+    bool next();
+    bool prev();
+    //Move to match n (0 based), false if the page has fewer matches
+    bool jump(int n);
+    //Total matches on the page, finds the remaining ones once
+    int count();
+
+    //Current match, -1 before the first next()
+    int current() const { return mCurrent; }
+    int charIndex() const;
+    int charCount() const;
+
+private:
+    struct Match {
+        int index;
+        int count;
+    };
+
+    FPDF_PAGE mPage;
+    FPDF_TEXTPAGE mTextPage;
+    FPDF_SCHHANDLE mHandle;
+    std::vector<Match> mMatches;
+    bool mComplete;
+    int mCurrent;
+
+    bool findMore();
+};
+
+#endif
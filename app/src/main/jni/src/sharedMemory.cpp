@@ -0,0 +1,148 @@
+#include "util.hpp"
+#include "sharedMemory.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <string.h>
+    #include <sys/mman.h>
+    #include <sys/ioctl.h>
+    #include <sys/socket.h>
+    #include <sys/syscall.h>
+}
+
+extern char **environ;
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+//From linux/ashmem.h, not exported by every NDK platform level
+#define ASHMEM_NAME_LEN 256
+#define __ASHMEMIOC 0x77
+#define ASHMEM_SET_NAME _IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
+#define ASHMEM_SET_SIZE _IOW(__ASHMEMIOC, 3, size_t)
+
+static int createMemfd(const char *name){
+#if defined(__NR_memfd_create)
+    return (int) syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int createSharedMemory(const char *name, size_t size){
+    int fd = createMemfd(name);
+    if(fd >= 0){
+        if(ftruncate(fd, (off_t) size) != 0){
+            LOGE("Cannot size memfd %s: %s", name, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+    if(fd < 0){
+        LOGE("No shared memory available: %s", strerror(errno));
+        return -1;
+    }
+    char ashmemName[ASHMEM_NAME_LEN];
+    strncpy(ashmemName, name, sizeof(ashmemName) - 1);
+    ashmemName[sizeof(ashmemName) - 1] = '\0';
+    ioctl(fd, ASHMEM_SET_NAME, ashmemName);
+    if(ioctl(fd, ASHMEM_SET_SIZE, size) < 0){
+        LOGE("Cannot size ashmem %s: %s", name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void* mapSharedMemory(int fd, size_t size){
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(addr == MAP_FAILED){
+        LOGE("Cannot map shared memory: %s", strerror(errno));
+        return NULL;
+    }
+    return addr;
+}
+
+void unmapSharedMemory(void *addr, size_t size){
+    if(addr != NULL) munmap(addr, size);
+}
+
+bool sendWithFd(int socket, const void *data, size_t size, int fd){
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = size;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if(fd >= 0){
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+    } while(sent < 0 && errno == EINTR);
+    return sent == (ssize_t) size;
+}
+
+int receiveWithFd(int socket, void *data, size_t size, int *fd){
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    } while(received < 0 && errno == EINTR);
+
+    if(fd != NULL){
+        *fd = -1;
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+                memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+    }
+    return (int) received;
+}
+
+void helperEnvironment(const char *path, std::vector<std::string> *storage, std::vector<char*> *envp){
+    storage->clear();
+    for(char **var = environ; *var != NULL; var++){
+        if(strncmp(*var, "LD_LIBRARY_PATH=", 16) != 0) storage->push_back(*var);
+    }
+    const char *slash = strrchr(path, '/');
+    std::string directory = (slash != NULL)? std::string(path, slash - path) : ".";
+    storage->push_back("LD_LIBRARY_PATH=" + directory);
+
+    envp->clear();
+    for(size_t i = 0; i < storage->size(); i++) envp->push_back(const_cast<char*>((*storage)[i].c_str()));
+    envp->push_back(NULL);
+}
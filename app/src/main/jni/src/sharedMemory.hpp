@@ -0,0 +1,30 @@
+#ifndef _SHARED_MEMORY_HPP_
+#define _SHARED_MEMORY_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+#include <string>
+#include <vector>
+
+//Anonymous shared memory fd (memfd, ashmem on kernels without memfd), -1 on failure
+int createSharedMemory(const char *name, size_t size);
+
+//Map whole region read/write, NULL on failure
+void* mapSharedMemory(int fd, size_t size);
+
+void unmapSharedMemory(void *addr, size_t size);
+
+//Send/receive one packet with an optional fd attached (SCM_RIGHTS)
+bool sendWithFd(int socket, const void *data, size_t size, int fd);
+int receiveWithFd(int socket, void *data, size_t size, int *fd);
+
+/*
+ * Environment to exec a helper executable with: ours, with LD_LIBRARY_PATH
+ * set to the directory of path so it links against the libraries installed
+ * next to it. Built before fork, envp points into storage.
+ */
+void helperEnvironment(const char *path, std::vector<std::string> *storage, std::vector<char*> *envp);
+
+#endif
@@ -0,0 +1,677 @@
+#include "util.hpp"
+#include "textRegex.hpp"
+
+#include <utils/Mutex.h>
+
+#include <algorithm>
+#include <map>
+
+using namespace android;
+
+//Keep compile time and table size bounded for hostile patterns
+#define REGEX_MAX_NFA_STATES 8192
+#define REGEX_MAX_DFA_STATES 2048
+#define REGEX_MAX_REPEAT 256
+#define REGEX_CACHE_SIZE 8
+
+typedef std::pair<uint32_t, uint32_t> CharRange;   //inclusive
+
+struct RegexNode {
+    enum Type { SET, CONCAT, ALT, REPEAT, EMPTY };
+    Type type;
+    std::vector<CharRange> ranges;
+    std::vector<int> children;
+    int min;
+    int max;    //-1 unbounded
+};
+
+static bool isWordChar(unsigned short c){
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'
+           || (c >= 0xC0 && c <= 0x24F && c != 0xD7 && c != 0xF7);
+}
+
+static void addWordRanges(std::vector<CharRange> *ranges){
+    ranges->push_back(CharRange('0', '9'));
+    ranges->push_back(CharRange('A', 'Z'));
+    ranges->push_back(CharRange('_', '_'));
+    ranges->push_back(CharRange('a', 'z'));
+    ranges->push_back(CharRange(0xC0, 0xD6));
+    ranges->push_back(CharRange(0xD8, 0xF6));
+    ranges->push_back(CharRange(0xF8, 0x24F));
+}
+
+static void addSpaceRanges(std::vector<CharRange> *ranges){
+    ranges->push_back(CharRange('\t', '\r'));
+    ranges->push_back(CharRange(' ', ' '));
+    ranges->push_back(CharRange(0xA0, 0xA0));
+}
+
+static void normalizeRanges(std::vector<CharRange> *ranges){
+    std::sort(ranges->begin(), ranges->end());
+    std::vector<CharRange> merged;
+    for(size_t i = 0; i < ranges->size(); i++){
+        if(!merged.empty() && (*ranges)[i].first <= merged.back().second + 1){
+            merged.back().second = std::max(merged.back().second, (*ranges)[i].second);
+        }else{
+            merged.push_back((*ranges)[i]);
+        }
+    }
+    ranges->swap(merged);
+}
+
+static void negateRanges(std::vector<CharRange> *ranges){
+    normalizeRanges(ranges);
+    std::vector<CharRange> negated;
+    uint32_t next = 0;
+    for(size_t i = 0; i < ranges->size(); i++){
+        if((*ranges)[i].first > next) negated.push_back(CharRange(next, (*ranges)[i].first - 1));
+        next = (*ranges)[i].second + 1;
+    }
+    if(next <= 0xFFFF) negated.push_back(CharRange(next, 0xFFFF));
+    ranges->swap(negated);
+}
+
+class RegexParser {
+public:
+    RegexParser(const unsigned short *pattern, size_t length, std::vector<RegexNode> *nodes)
+            : mPattern(pattern), mLength(length), mPos(0), mNodes(nodes) {}
+
+    int parse(std::string *error){
+        int root = parseAlt();
+        if(mError.empty() && mPos < mLength) mError = "unmatched )";
+        if(!mError.empty()){
+            *error = mError;
+            return -1;
+        }
+        return root;
+    }
+
+private:
+    const unsigned short *mPattern;
+    size_t mLength;
+    size_t mPos;
+    std::vector<RegexNode> *mNodes;
+    std::string mError;
+
+    int node(RegexNode::Type type){
+        RegexNode n;
+        n.type = type;
+        n.min = n.max = 0;
+        mNodes->push_back(n);
+        return (int) mNodes->size() - 1;
+    }
+
+    bool more() const { return mPos < mLength && mError.empty(); }
+    unsigned short peek() const { return mPattern[mPos]; }
+
+    int parseAlt(){
+        int first = parseConcat();
+        if(!more() || peek() != '|') return first;
+
+        int alt = node(RegexNode::ALT);
+        (*mNodes)[alt].children.push_back(first);
+        while(more() && peek() == '|'){
+            mPos++;
+            int next = parseConcat();
+            (*mNodes)[alt].children.push_back(next);
+        }
+        return alt;
+    }
+
+    int parseConcat(){
+        int concat = node(RegexNode::CONCAT);
+        while(more() && peek() != '|' && peek() != ')'){
+            int item = parseRepeat();
+            if(item < 0) break;
+            (*mNodes)[concat].children.push_back(item);
+        }
+        if((*mNodes)[concat].children.empty()) (*mNodes)[concat].type = RegexNode::EMPTY;
+        return concat;
+    }
+
+    bool parseNumber(int *out){
+        if(!more() || peek() < '0' || peek() > '9') return false;
+        int value = 0;
+        while(more() && peek() >= '0' && peek() <= '9'){
+            value = value * 10 + (peek() - '0');
+            if(value > REGEX_MAX_REPEAT) value = REGEX_MAX_REPEAT + 1;
+            mPos++;
+        }
+        *out = value;
+        return true;
+    }
+
+    int parseRepeat(){
+        int atom = parseAtom();
+        while(atom >= 0 && more()){
+            int min, max;
+            unsigned short c = peek();
+            if(c == '*'){
+                min = 0; max = -1; mPos++;
+            }else if(c == '+'){
+                min = 1; max = -1; mPos++;
+            }else if(c == '?'){
+                min = 0; max = 1; mPos++;
+            }else if(c == '{'){
+                mPos++;
+                if(!parseNumber(&min)){
+                    mError = "bad repeat count";
+                    return -1;
+                }
+                max = min;
+                if(more() && peek() == ','){
+                    mPos++;
+                    if(!parseNumber(&max)) max = -1;
+                }
+                if(!more() || peek() != '}' || (max >= 0 && max < min)){
+                    mError = "bad repeat count";
+                    return -1;
+                }
+                mPos++;
+                if(min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT){
+                    mError = "repeat count too large";
+                    return -1;
+                }
+            }else{
+                break;
+            }
+            //Lazy quantifiers make no difference for longest matches
+            if(more() && peek() == '?') mPos++;
+
+            int repeat = node(RegexNode::REPEAT);
+            (*mNodes)[repeat].children.push_back(atom);
+            (*mNodes)[repeat].min = min;
+            (*mNodes)[repeat].max = max;
+            atom = repeat;
+        }
+        return atom;
+    }
+
+    //Escape after '\', adds its chars to ranges
+    bool parseEscape(std::vector<CharRange> *ranges){
+        if(mPos >= mLength){
+            mError = "trailing \\\\";
+            return false;
+        }
+        unsigned short c = mPattern[mPos++];
+        std::vector<CharRange> set;
+        switch(c){
+            case 'd': case 'D': set.push_back(CharRange('0', '9')); break;
+            case 'w': case 'W': addWordRanges(&set); break;
+            case 's': case 'S': addSpaceRanges(&set); break;
+            case 't': ranges->push_back(CharRange('\t', '\t')); return true;
+            case 'n': ranges->push_back(CharRange('\n', '\n')); return true;
+            case 'r': ranges->push_back(CharRange('\r', '\r')); return true;
+            case 'u': {
+                uint32_t value = 0;
+                for(int i = 0; i < 4; i++){
+                    if(mPos >= mLength){
+                        mError = "bad \\\\u escape";
+                        return false;
+                    }
+                    unsigned short h = mPattern[mPos++];
+                    int digit = (h >= '0' && h <= '9') ? h - '0'
+                              : (h >= 'a' && h <= 'f') ? h - 'a' + 10
+                              : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                    if(digit < 0){
+                        mError = "bad \\\\u escape";
+                        return false;
+                    }
+                    value = value * 16 + digit;
+                }
+                ranges->push_back(CharRange(value, value));
+                return true;
+            }
+            case 'b': case 'B':
+                mError = "\\\\b is only supported at the start or end";
+                return false;
+            default:
+                if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')){
+                    mError = "unknown escape";
+                    return false;
+                }
+                ranges->push_back(CharRange(c, c));
+                return true;
+        }
+        if(c == 'D' || c == 'W' || c == 'S') negateRanges(&set);
+        ranges->insert(ranges->end(), set.begin(), set.end());
+        return true;
+    }
+
+    int parseClass(){
+        bool negate = false;
+        if(more() && peek() == '^'){
+            negate = true;
+            mPos++;
+        }
+        std::vector<CharRange> ranges;
+        bool first = true;
+        for(;;){
+            if(!more()){
+                if(mError.empty()) mError = "unterminated [";
+                return -1;
+            }
+            unsigned short c = mPattern[mPos++];
+            if(c == ']' && !first) break;
+            first = false;
+
+            uint32_t low;
+            if(c == '\\'){
+                std::vector<CharRange> escaped;
+                if(!parseEscape(&escaped)) return -1;
+                if(escaped.size() != 1 || escaped[0].first != escaped[0].second){
+                    ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+                    continue;
+                }
+                low = escaped[0].first;
+            }else{
+                low = c;
+            }
+
+            uint32_t high = low;
+            if(mPos + 1 < mLength && mPattern[mPos] == '-' && mPattern[mPos + 1] != ']'){
+                mPos++;
+                unsigned short h = mPattern[mPos++];
+                if(h == '\\'){
+                    std::vector<CharRange> escaped;
+                    if(!parseEscape(&escaped)) return -1;
+                    if(escaped.size() != 1 || escaped[0].first != escaped[0].second){
+                        mError = "bad class range";
+                        return -1;
+                    }
+                    high = escaped[0].first;
+                }else{
+                    high = h;
+                }
+                if(high < low){
+                    mError = "bad class range";
+                    return -1;
+                }
+            }
+            ranges.push_back(CharRange(low, high));
+        }
+        if(negate) negateRanges(&ranges);
+
+        int set = node(RegexNode::SET);
+        (*mNodes)[set].ranges = ranges;
+        return set;
+    }
+
+    int parseAtom(){
+        unsigned short c = mPattern[mPos++];
+        switch(c){
+            case '(': {
+                if(mPos + 1 < mLength && mPattern[mPos] == '?' && mPattern[mPos + 1] == ':') mPos += 2;
+                int inner = parseAlt();
+                if(!mError.empty()) return -1;
+                if(mPos >= mLength || mPattern[mPos] != ')'){
+                    mError = "unmatched (";
+                    return -1;
+                }
+                mPos++;
+                return inner;
+            }
+            case '[':
+                return parseClass();
+            case '.': {
+                //Any char but line breaks, PDFium ends lines with \r\n
+                int set = node(RegexNode::SET);
+                (*mNodes)[set].ranges.push_back(CharRange('\n', '\n'));
+                (*mNodes)[set].ranges.push_back(CharRange('\r', '\r'));
+                negateRanges(&(*mNodes)[set].ranges);
+                return set;
+            }
+            case '\\': {
+                int set = node(RegexNode::SET);
+                std::vector<CharRange> ranges;
+                if(!parseEscape(&ranges)) return -1;
+                (*mNodes)[set].ranges = ranges;
+                return set;
+            }
+            case '*': case '+': case '?': case '{':
+                mError = "nothing to repeat";
+                return -1;
+            case '^': case '$':
+                mError = "anchors are not supported";
+                return -1;
+            default: {
+                int set = node(RegexNode::SET);
+                (*mNodes)[set].ranges.push_back(CharRange(c, c));
+                return set;
+            }
+        }
+    }
+};
+
+struct NfaState {
+    std::vector<int> epsilon;
+    int set;        //node index of the SET this state consumes, -1 for none
+    int next;
+};
+
+class NfaBuilder {
+public:
+    std::vector<NfaState> states;
+    bool overflow;
+
+    NfaBuilder(const std::vector<RegexNode> &nodes) : overflow(false), mNodes(nodes) {}
+
+    //Fragment of node, returns start and sets end
+    int build(int index, int *end){
+        if(overflow) {
+            *end = state();
+            return *end;
+        }
+        const RegexNode &n = mNodes[index];
+        switch(n.type){
+            case RegexNode::SET: {
+                int s = state();
+                *end = state();
+                states[s].set = index;
+                states[s].next = *end;
+                return s;
+            }
+            case RegexNode::CONCAT: {
+                int start = -1, last = -1;
+                for(size_t i = 0; i < n.children.size(); i++){
+                    int childEnd;
+                    int childStart = build(n.children[i], &childEnd);
+                    if(last >= 0) states[last].epsilon.push_back(childStart);
+                    else start = childStart;
+                    last = childEnd;
+                }
+                *end = last;
+                return start;
+            }
+            case RegexNode::ALT: {
+                int s = state();
+                *end = state();
+                for(size_t i = 0; i < n.children.size(); i++){
+                    int childEnd;
+                    int childStart = build(n.children[i], &childEnd);
+                    states[s].epsilon.push_back(childStart);
+                    states[childEnd].epsilon.push_back(*end);
+                }
+                return s;
+            }
+            case RegexNode::REPEAT: {
+                int s = state();
+                int last = s;
+                for(int i = 0; i < n.min; i++){
+                    int childEnd;
+                    int childStart = build(n.children[0], &childEnd);
+                    states[last].epsilon.push_back(childStart);
+                    last = childEnd;
+                }
+                if(n.max < 0){
+                    //Loop: last -> child -> last, last can leave any time
+                    int loop = state();
+                    states[last].epsilon.push_back(loop);
+                    int childEnd;
+                    int childStart = build(n.children[0], &childEnd);
+                    states[loop].epsilon.push_back(childStart);
+                    states[childEnd].epsilon.push_back(loop);
+                    *end = state();
+                    states[loop].epsilon.push_back(*end);
+                }else{
+                    *end = state();
+                    for(int i = n.min; i < n.max; i++){
+                        int childEnd;
+                        int childStart = build(n.children[0], &childEnd);
+                        states[last].epsilon.push_back(childStart);
+                        states[last].epsilon.push_back(*end);
+                        last = childEnd;
+                    }
+                    states[last].epsilon.push_back(*end);
+                }
+                return s;
+            }
+            default: {
+                int s = state();
+                *end = state();
+                states[s].epsilon.push_back(*end);
+                return s;
+            }
+        }
+    }
+
+private:
+    const std::vector<RegexNode> &mNodes;
+
+    int state(){
+        if(states.size() >= REGEX_MAX_NFA_STATES) overflow = true;
+        NfaState s;
+        s.set = -1;
+        s.next = -1;
+        states.push_back(s);
+        return (int) states.size() - 1;
+    }
+};
+
+static void closure(const std::vector<NfaState> &states, std::vector<int> *set){
+    std::vector<bool> seen(states.size(), false);
+    std::vector<int> stack(set->begin(), set->end());
+    set->clear();
+    while(!stack.empty()){
+        int s = stack.back();
+        stack.pop_back();
+        if(seen[s]) continue;
+        seen[s] = true;
+        set->push_back(s);
+        for(size_t i = 0; i < states[s].epsilon.size(); i++) stack.push_back(states[s].epsilon[i]);
+    }
+    std::sort(set->begin(), set->end());
+}
+
+TextRegex::TextRegex() : mRefs(1), mClassCount(0), mWordStart(false), mWordEnd(false) {
+}
+
+TextRegex* TextRegex::compile(const unsigned short *pattern, size_t length, std::string *error){
+    TextRegex *regex = new TextRegex();
+    regex->mPattern.assign(pattern, pattern + length);
+
+    //\b is an anchor check, only at the edges of the pattern
+    if(length >= 2 && pattern[0] == '\\' && pattern[1] == 'b'){
+        regex->mWordStart = true;
+        pattern += 2;
+        length -= 2;
+    }
+    if(length >= 2 && pattern[length - 2] == '\\' && pattern[length - 1] == 'b'
+       && (length < 3 || pattern[length - 3] != '\\')){
+        regex->mWordEnd = true;
+        length -= 2;
+    }
+
+    std::vector<RegexNode> nodes;
+    RegexParser parser(pattern, length, &nodes);
+    int root = parser.parse(error);
+    if(root < 0){
+        delete regex;
+        return NULL;
+    }
+
+    NfaBuilder nfa(nodes);
+    int accept;
+    int start = nfa.build(root, &accept);
+    if(nfa.overflow){
+        *error = "pattern too large";
+        delete regex;
+        return NULL;
+    }
+
+    //Char classes: intervals between all range edges of the pattern
+    std::vector<uint32_t> edges;
+    edges.push_back(0);
+    for(size_t i = 0; i < nodes.size(); i++){
+        if(nodes[i].type != RegexNode::SET) continue;
+        for(size_t r = 0; r < nodes[i].ranges.size(); r++){
+            edges.push_back(nodes[i].ranges[r].first);
+            if(nodes[i].ranges[r].second < 0xFFFF) edges.push_back(nodes[i].ranges[r].second + 1);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    regex->mClassStarts = edges;
+    regex->mClassCount = (int) edges.size();
+    for(int c = 0; c < 256; c++){
+        regex->mLatinClass[c] = (uint16_t) (std::upper_bound(edges.begin(), edges.end(), (uint32_t) c)
+                                            - edges.begin() - 1);
+    }
+
+    //Classes each SET node consumes
+    const int classCount = regex->mClassCount;
+    std::map<int, std::vector<bool> > setClasses;
+    for(size_t i = 0; i < nodes.size(); i++){
+        if(nodes[i].type != RegexNode::SET) continue;
+        std::vector<bool> &classes = setClasses[(int) i];
+        classes.assign(classCount, false);
+        for(size_t r = 0; r < nodes[i].ranges.size(); r++){
+            int from = (int) (std::upper_bound(edges.begin(), edges.end(), nodes[i].ranges[r].first)
+                              - edges.begin() - 1);
+            int to = (int) (std::upper_bound(edges.begin(), edges.end(), nodes[i].ranges[r].second)
+                            - edges.begin() - 1);
+            for(int c = from; c <= to; c++) classes[c] = true;
+        }
+    }
+
+    //Subset construction
+    std::map<std::vector<int>, int> dfaIds;
+    std::vector<std::vector<int> > dfaSets;
+    std::vector<int> initial(1, start);
+    closure(nfa.states, &initial);
+    dfaIds[initial] = 0;
+    dfaSets.push_back(initial);
+
+    for(size_t d = 0; d < dfaSets.size(); d++){
+        if(dfaSets.size() > REGEX_MAX_DFA_STATES){
+            *error = "pattern too complex";
+            delete regex;
+            return NULL;
+        }
+        std::vector<int> current = dfaSets[d];
+        regex->mAccepting.push_back(std::binary_search(current.begin(), current.end(), accept));
+        for(int c = 0; c < classCount; c++){
+            std::vector<int> next;
+            for(size_t i = 0; i < current.size(); i++){
+                const NfaState &s = nfa.states[current[i]];
+                if(s.set >= 0 && setClasses[s.set][c]) next.push_back(s.next);
+            }
+            if(next.empty()){
+                regex->mTransitions.push_back(-1);
+                continue;
+            }
+            closure(nfa.states, &next);
+            std::map<std::vector<int>, int>::iterator it = dfaIds.find(next);
+            if(it != dfaIds.end()){
+                regex->mTransitions.push_back(it->second);
+            }else{
+                int id = (int) dfaSets.size();
+                dfaIds[next] = id;
+                dfaSets.push_back(next);
+                regex->mTransitions.push_back(id);
+            }
+        }
+    }
+
+    regex->mStartClasses.assign(classCount, false);
+    for(int c = 0; c < classCount; c++) regex->mStartClasses[c] = regex->mTransitions[c] >= 0;
+    return regex;
+}
+
+int TextRegex::classOf(unsigned short c) const {
+    if(c < 256) return mLatinClass[c];
+    return (int) (std::upper_bound(mClassStarts.begin(), mClassStarts.end(), (uint32_t) c)
+                  - mClassStarts.begin() - 1);
+}
+
+static bool wordBoundary(const unsigned short *text, int length, int pos){
+    bool before = pos > 0 && isWordChar(text[pos - 1]);
+    bool after = pos < length && isWordChar(text[pos]);
+    return before != after;
+}
+
+int TextRegex::matchAt(const unsigned short *text, int length, int start) const {
+    if(mWordStart && !wordBoundary(text, length, start)) return -1;
+
+    int state = 0;
+    int end = -1;
+    for(int i = start; i < length; i++){
+        state = mTransitions[state * mClassCount + classOf(text[i])];
+        if(state < 0) break;
+        if(mAccepting[state] && (!mWordEnd || wordBoundary(text, length, i + 1))) end = i + 1;
+    }
+    return end;
+}
+
+void TextRegex::findAll(const unsigned short *text, int length, std::vector<int32_t> *out) const {
+    int i = 0;
+    while(i < length){
+        if(!mStartClasses[classOf(text[i])]){
+            i++;
+            continue;
+        }
+        int end = matchAt(text, length, i);
+        if(end > i){
+            out->push_back(i);
+            out->push_back(end - i);
+            i = end;
+        }else{
+            i++;
+        }
+    }
+}
+
+static Mutex sCacheLock;
+static std::vector<TextRegex*> sCache;     //most recently used last
+
+TextRegex* TextRegex::acquire(const unsigned short *pattern, size_t length, std::string *error){
+    Mutex::Autolock lock(sCacheLock);
+    for(size_t i = 0; i < sCache.size(); i++){
+        TextRegex *regex = sCache[i];
+        if(regex->mPattern.size() == length
+           && std::equal(regex->mPattern.begin(), regex->mPattern.end(), pattern)){
+            sCache.erase(sCache.begin() + i);
+            sCache.push_back(regex);
+            regex->mRefs++;
+            return regex;
+        }
+    }
+
+    TextRegex *regex = compile(pattern, length, error);
+    if(regex == NULL) return NULL;
+    if(sCache.size() >= REGEX_CACHE_SIZE){
+        TextRegex *evicted = sCache.front();
+        sCache.erase(sCache.begin());
+        if(--evicted->mRefs == 0) delete evicted;
+    }
+    regex->mRefs++;     //one for the cache, one for the caller
+    sCache.push_back(regex);
+    return regex;
+}
+
+void TextRegex::release(){
+    Mutex::Autolock lock(sCacheLock);
+    if(--mRefs == 0) delete this;
+}
+
+size_t TextRegex::footprint() const {
+    return sizeof(TextRegex) + mPattern.capacity() * sizeof(unsigned short)
+           + mClassStarts.capacity() * sizeof(uint32_t)
+           + mTransitions.capacity() * sizeof(int32_t)
+           + (mAccepting.size() + mStartClasses.size()) / 8;
+}
+
+size_t TextRegex::trimCache(){
+    Mutex::Autolock lock(sCacheLock);
+    size_t released = 0;
+    for(size_t i = 0; i < sCache.size(); i++){
+        TextRegex *regex = sCache[i];
+        //Searches still running keep their regex, it goes with their release()
+        if(--regex->mRefs == 0){
+            released += regex->footprint();
+            delete regex;
+        }
+    }
+    sCache.clear();
+    return released;
+}
@@ -0,0 +1,55 @@
+#ifndef _TEXT_REGEX_HPP_
+#define _TEXT_REGEX_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <string>
+#include <vector>
+
+/*
+ * Regular expressions over UTF-16 text, compiled to a DFA over char classes
+ * so matching is one table lookup per char. Supported: literals, ., [...]
+ * classes with ranges and negation, \d \w \s and their negations, groups,
+ * (?:...), |, * + ? {n} {n,} {n,m}, and \b at the start or end of the pattern.
+ * Matches are leftmost-longest and never overlap. A compiled regex is
+ * immutable and shared between threads.
+ */
+
+class TextRegex {
+public:
+    static TextRegex* compile(const unsigned short *pattern, size_t length, std::string *error);
+
+    //Compiled regex of pattern from a small cache, release() when done
+    static TextRegex* acquire(const unsigned short *pattern, size_t length, std::string *error);
+    void release();
+    //Drop every cached regex not in use, returns the approximate bytes freed
+    static size_t trimCache();
+
+    //End (exclusive) of the longest match starting at start, -1 if none
+    int matchAt(const unsigned short *text, int length, int start) const;
+    //Non-empty, non-overlapping matches as start, count pairs
+    void findAll(const unsigned short *text, int length, std::vector<int32_t> *out) const;
+
+private:
+    TextRegex();
+
+    std::vector<unsigned short> mPattern;
+    int mRefs;
+
+    std::vector<uint32_t> mClassStarts;     //sorted first char of every class
+    uint16_t mLatinClass[256];
+    int mClassCount;
+    std::vector<int32_t> mTransitions;      //state * classCount + class, -1 is dead
+    std::vector<bool> mAccepting;
+    std::vector<bool> mStartClasses;        //classes that can begin a match
+    bool mWordStart;
+    bool mWordEnd;
+
+    int classOf(unsigned short c) const;
+    size_t footprint() const;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "textSearch.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+//Base letters of U+0100..U+017F, '*' marks the two-letter ligatures
+static const char LATIN_EXTENDED_A[] =
+        "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii**jjkkklllllllll"
+        "lnnnnnnnnnoooooo**rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+//Base letters of U+00C0..U+00FF, '*' marks chars expanding to two letters, '=' unchanged
+static const char LATIN_1[] =
+        "aaaaaa*ceeeeiiiidnooooo=ouuuuy**aaaaaa*ceeeeiiiidnooooo=ouuuuy*y";
+
+static bool isSpace(unsigned short c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0xA0 || c == 0x3000
+           || (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029;
+}
+
+static bool isWordChar(unsigned short c){
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0xC0;
+}
+
+//Folded form of c, returns number of chars written to out (0 drops the char)
+static int foldChar(unsigned short c, unsigned short *out){
+    if(c < 0x80){
+        out[0] = (c >= 'A' && c <= 'Z') ? (unsigned short) (c + 0x20) : c;
+        return 1;
+    }
+    if(c >= 0xC0 && c <= 0xFF){
+        char base = LATIN_1[c - 0xC0];
+        if(base == '=') {
+            out[0] = c;
+            return 1;
+        }
+        if(base != '*'){
+            out[0] = (unsigned short) base;
+            return 1;
+        }
+        switch(c){
+            case 0xC6: case 0xE6: out[0] = 'a'; out[1] = 'e'; return 2;
+            case 0xDE: case 0xFE: out[0] = 't'; out[1] = 'h'; return 2;
+            default: out[0] = 's'; out[1] = 's'; return 2;   //U+00DF
+        }
+    }
+    if(c >= 0x100 && c <= 0x17F){
+        char base = LATIN_EXTENDED_A[c - 0x100];
+        if(base != '*'){
+            out[0] = (unsigned short) base;
+            return 1;
+        }
+        if(c <= 0x133){
+            out[0] = 'i'; out[1] = 'j';
+        }else{
+            out[0] = 'o'; out[1] = 'e';
+        }
+        return 2;
+    }
+    //Combining diacritical marks and soft hyphen carry no letters
+    if((c >= 0x300 && c <= 0x36F) || c == 0xAD) return 0;
+
+    //Greek and Cyrillic capitals
+    if(c >= 0x391 && c <= 0x3A9 && c != 0x3A2){
+        out[0] = (unsigned short) (c + 0x20);
+        return 1;
+    }
+    if(c >= 0x410 && c <= 0x42F){
+        out[0] = (unsigned short) (c + 0x20);
+        return 1;
+    }
+    if(c >= 0x400 && c <= 0x40F){
+        out[0] = (unsigned short) (c + 0x50);
+        return 1;
+    }
+
+    switch(c){
+        case 0xFB00: out[0] = 'f'; out[1] = 'f'; return 2;
+        case 0xFB01: out[0] = 'f'; out[1] = 'i'; return 2;
+        case 0xFB02: out[0] = 'f'; out[1] = 'l'; return 2;
+        case 0xFB03: out[0] = 'f'; out[1] = 'f'; out[2] = 'i'; return 3;
+        case 0xFB04: out[0] = 'f'; out[1] = 'f'; out[2] = 'l'; return 3;
+        case 0xFB05: case 0xFB06: out[0] = 's'; out[1] = 't'; return 2;
+        case 0x2018: case 0x2019: case 0x201B: case 0x2032: out[0] = '\''; return 1;
+        case 0x201C: case 0x201D: case 0x201F: case 0x2033: out[0] = '"'; return 1;
+        case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014: case 0x2015:
+        case 0x2212: out[0] = '-'; return 1;
+    }
+    out[0] = c;
+    return 1;
+}
+
+void foldText(const unsigned short *text, size_t length, FoldedText *out){
+    out->text.clear();
+    out->sourceIndex.clear();
+    out->text.reserve(length);
+    out->sourceIndex.reserve(length);
+
+    bool lastSpace = false;
+    for(size_t i = 0; i < length; i++){
+        if(isSpace(text[i])){
+            //Line breaks in PDFium text become plain spaces, runs collapse
+            if(!lastSpace){
+                out->text.push_back(' ');
+                out->sourceIndex.push_back((int32_t) i);
+            }
+            lastSpace = true;
+            continue;
+        }
+        unsigned short folded[3];
+        int n = foldChar(text[i], folded);
+        for(int k = 0; k < n; k++){
+            out->text.push_back(folded[k]);
+            out->sourceIndex.push_back((int32_t) i);
+        }
+        if(n > 0) lastSpace = false;
+    }
+}
+
+//8 UTF-16 lanes; GCC/Clang lower these to NEON or SSE2 compares
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+typedef uint64_t u64x2 __attribute__((vector_size(16)));
+
+static inline u16x8 load8(const unsigned short *p){
+    u16x8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void findFolded(const unsigned short *text, size_t textLength,
+                const unsigned short *query, size_t queryLength,
+                std::vector<int32_t> *positions){
+    if(queryLength == 0 || queryLength > textLength) return;
+
+    const unsigned short first = query[0];
+    const unsigned short last = query[queryLength - 1];
+    const size_t end = textLength - queryLength + 1;   //candidate starts [0, end)
+    //Chars between first and last, those two are checked by the filter
+    const size_t middleBytes = queryLength > 2 ? (queryLength - 2) * sizeof(unsigned short) : 0;
+
+    size_t i = 0;
+    if(end >= 8){
+        u16x8 firstV = { first, first, first, first, first, first, first, first };
+        u16x8 lastV = { last, last, last, last, last, last, last, last };
+        //Blocks of 8 candidates, only those matching first and last char are compared
+        for(; i + 8 <= end; i += 8){
+            u16x8 hits = (u16x8) ((load8(text + i) == firstV)
+                                  & (load8(text + i + queryLength - 1) == lastV));
+            u64x2 any = (u64x2) hits;
+            if((any[0] | any[1]) == 0) continue;
+
+            for(int lane = 0; lane < 8; lane++){
+                if(hits[lane] == 0) continue;
+                if(memcmp(text + i + lane + 1, query + 1, middleBytes) == 0){
+                    positions->push_back((int32_t) (i + lane));
+                }
+            }
+        }
+    }
+    for(; i < end; i++){
+        if(text[i] == first && text[i + queryLength - 1] == last
+           && memcmp(text + i, query, queryLength * sizeof(unsigned short)) == 0){
+            positions->push_back((int32_t) i);
+        }
+    }
+}
+
+void searchFoldedText(const FoldedText &folded, const unsigned short *query, size_t queryLength,
+                      int flags, std::vector<int32_t> *out){
+    FoldedText foldedQuery;
+    foldText(query, queryLength, &foldedQuery);
+
+    //Spaces around the query would only match at line edges
+    const unsigned short *q = foldedQuery.text.empty() ? NULL : &foldedQuery.text[0];
+    size_t qLength = foldedQuery.text.size();
+    while(qLength > 0 && q[0] == ' '){
+        q++;
+        qLength--;
+    }
+    while(qLength > 0 && q[qLength - 1] == ' ') qLength--;
+    if(qLength == 0 || folded.text.empty()) return;
+
+    const unsigned short *text = &folded.text[0];
+    size_t textLength = folded.text.size();
+    std::vector<int32_t> positions;
+    findFolded(text, textLength, q, qLength, &positions);
+
+    int32_t lastEnd = -1;
+    for(size_t i = 0; i < positions.size(); i++){
+        size_t p = positions[i];
+        if(flags & TEXT_SEARCH_WHOLE_WORD){
+            if(p > 0 && isWordChar(text[p - 1])) continue;
+            if(p + qLength < textLength && isWordChar(text[p + qLength])) continue;
+        }
+        int32_t start = folded.sourceIndex[p];
+        int32_t end = folded.sourceIndex[p + qLength - 1];
+        //A ligature folds to several chars, do not report overlapping source ranges
+        if(start <= lastEnd) continue;
+        out->push_back(start);
+        out->push_back(end - start + 1);
+        lastEnd = end;
+    }
+}
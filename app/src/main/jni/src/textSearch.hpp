@@ -0,0 +1,42 @@
+#ifndef _TEXT_SEARCH_HPP_
+#define _TEXT_SEARCH_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <vector>
+
+/*
+ * Accent and case insensitive search over extracted UTF-16 text. The text is
+ * folded once into a side buffer (lower case, diacritics and combining marks
+ * dropped, ligatures expanded, whitespace runs collapsed, typographic quotes
+ * and dashes unified) together with a map from every folded char back to the
+ * source char index. Queries are folded the same way and scanned with a
+ * vector first/last char filter, then mapped back to source ranges.
+ */
+
+//Same bit as FPDF_MATCHWHOLEWORD, so Java passes one set of search flags
+#define TEXT_SEARCH_WHOLE_WORD 0x2
+
+struct FoldedText {
+    std::vector<unsigned short> text;
+    std::vector<int32_t> sourceIndex;   //source char of each folded char
+};
+
+void foldText(const unsigned short *text, size_t length, FoldedText *out);
+
+//Start positions of query in text, both already folded
+void findFolded(const unsigned short *text, size_t textLength,
+                const unsigned short *query, size_t queryLength,
+                std::vector<int32_t> *positions);
+
+/*
+ * Matches of query in the folded text as source ranges: start, count pairs
+ * appended to out. query is the raw (unfolded) UTF-16 query.
+ */
+void searchFoldedText(const FoldedText &folded, const unsigned short *query, size_t queryLength,
+                      int flags, std::vector<int32_t> *out);
+
+#endif
@@ -0,0 +1,175 @@
+#include "util.hpp"
+#include "textSelection.hpp"
+#include "pdfCore.hpp"
+
+#include <math.h>
+
+static bool emptyBox(const float *box){
+    return box[2] <= box[0] || box[1] <= box[3];
+}
+
+TextSelection::TextSelection(FPDF_TEXTPAGE textPage) : mStart(0), mCount(0) {
+    std::vector<float> geometry;
+    getCharGeometry(textPage, &geometry);
+
+    int count = (int) (geometry.size() / CHAR_GEOMETRY_STRIDE);
+    mText.resize(count);
+    mCodePoints.resize(count);
+    mBoxes.resize((size_t) count * 4);
+    for(int i = 0; i < count; i++){
+        const float *entry = &geometry[(size_t) i * CHAR_GEOMETRY_STRIDE];
+        for(int k = 0; k < 4; k++) mBoxes[(size_t) i * 4 + k] = entry[k];
+        //Floats hold every code point exactly
+        uint32_t codePoint = (uint32_t) entry[4];
+        mCodePoints[i] = codePoint;
+        mText[i] = codePoint > 0xFFFF ? 0xFFFD : (unsigned short) codePoint;
+    }
+    buildLines();
+}
+
+void TextSelection::buildLines(){
+    int count = (int) mText.size();
+    mCharLine.resize(count);
+
+    Line line;
+    bool open = false;
+    for(int i = 0; i < count; i++){
+        const float *box = &mBoxes[(size_t) i * 4];
+        bool breakChar = mText[i] == '\n' || mText[i] == '\r';
+
+        //New line when the char does not overlap the current one vertically
+        if(open && !emptyBox(box)){
+            float center = (box[1] + box[3]) / 2;
+            if(center > line.top || center < line.bottom){
+                mLines.push_back(line);
+                open = false;
+            }
+        }
+        if(!open){
+            line.first = i;
+            line.left = line.bottom = INFINITY;
+            line.right = line.top = -INFINITY;
+            open = true;
+        }
+        line.last = i;
+        mCharLine[i] = (int) mLines.size();
+        if(!emptyBox(box)){
+            if(box[0] < line.left) line.left = box[0];
+            if(box[1] > line.top) line.top = box[1];
+            if(box[2] > line.right) line.right = box[2];
+            if(box[3] < line.bottom) line.bottom = box[3];
+        }
+        if(breakChar){
+            mLines.push_back(line);
+            open = false;
+        }
+    }
+    if(open) mLines.push_back(line);
+}
+
+int TextSelection::charAt(float x, float y) const {
+    if(mLines.empty()) return -1;
+
+    //Closest line vertically, then closest char horizontally within it
+    int bestLine = -1;
+    float bestDistance = INFINITY;
+    for(size_t l = 0; l < mLines.size(); l++){
+        const Line &line = mLines[l];
+        if(line.left > line.right) continue;    //only generated chars
+        float distance = y > line.top ? y - line.top : (y < line.bottom ? line.bottom - y : 0);
+        if(distance < bestDistance){
+            bestDistance = distance;
+            bestLine = (int) l;
+            if(distance == 0) break;
+        }
+    }
+    if(bestLine < 0) return -1;
+
+    const Line &line = mLines[bestLine];
+    int best = line.first;
+    bestDistance = INFINITY;
+    for(int i = line.first; i <= line.last; i++){
+        const float *box = &mBoxes[(size_t) i * 4];
+        if(emptyBox(box)) continue;
+        float distance = x < box[0] ? box[0] - x : (x > box[2] ? x - box[2] : 0);
+        if(distance < bestDistance){
+            bestDistance = distance;
+            best = i;
+            if(distance == 0) break;
+        }
+    }
+    return best;
+}
+
+void TextSelection::selectedText(std::vector<unsigned short> *out) const {
+    for(int i = mStart; i < mStart + mCount; i++){
+        uint32_t codePoint = mCodePoints[i];
+        if(codePoint > 0xFFFF && codePoint <= 0x10FFFF){
+            codePoint -= 0x10000;
+            out->push_back((unsigned short) (0xD800 | (codePoint >> 10)));
+            out->push_back((unsigned short) (0xDC00 | (codePoint & 0x3FF)));
+        }else{
+            out->push_back(mText[i]);
+        }
+    }
+}
+
+bool TextSelection::update(float startX, float startY, float endX, float endY){
+    int start = charAt(startX, startY);
+    int end = charAt(endX, endY);
+    if(start < 0 || end < 0) return select(0, -1);
+    return select(start, end);
+}
+
+void TextSelection::addRect(int first, int last){
+    float left = INFINITY, top = -INFINITY, right = -INFINITY, bottom = INFINITY;
+    for(int i = first; i <= last; i++){
+        const float *box = &mBoxes[(size_t) i * 4];
+        if(emptyBox(box)) continue;
+        if(box[0] < left) left = box[0];
+        if(box[1] > top) top = box[1];
+        if(box[2] > right) right = box[2];
+        if(box[3] < bottom) bottom = box[3];
+    }
+    if(left > right) return;
+    mRects.push_back(left);
+    mRects.push_back(top);
+    mRects.push_back(right);
+    mRects.push_back(bottom);
+}
+
+bool TextSelection::select(int start, int end){
+    if(start > end){
+        int tmp = start;
+        start = end;
+        end = tmp;
+    }
+    if(start < 0) start = 0;
+    if(end >= (int) mText.size()) end = (int) mText.size() - 1;
+    int count = end >= start ? end - start + 1 : 0;
+    if(count == 0) start = 0;
+    if(start == mStart && count == mCount) return false;
+
+    mStart = start;
+    mCount = count;
+    mRects.clear();
+    if(count == 0) return true;
+
+    //One rect per line, partial lines at both ends
+    int firstLine = mCharLine[start];
+    int lastLine = mCharLine[end];
+    for(int l = firstLine; l <= lastLine; l++){
+        const Line &line = mLines[l];
+        if(line.first >= start && line.last <= end){
+            if(line.left <= line.right){
+                mRects.push_back(line.left);
+                mRects.push_back(line.top);
+                mRects.push_back(line.right);
+                mRects.push_back(line.bottom);
+            }
+        }else{
+            addRect(line.first > start ? line.first : start, line.last < end ? line.last : end);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef _TEXT_SELECTION_HPP_
+#define _TEXT_SELECTION_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdf_text.h>
+
+#include <vector>
+
+/*
+ * Selection over one text page. Text and char boxes are copied out of PDFium
+ * once, so updates while dragging never call into the library and can run
+ * outside the PdfiumCore lock. Characters are grouped into lines up front; an
+ * update only walks the lines between the two ends and scans characters of
+ * the first and last line, full lines use their precomputed box.
+ */
+
+class TextSelection {
+public:
+    explicit TextSelection(FPDF_TEXTPAGE textPage);
+
+    //Char nearest to the point (page coordinates), -1 on a page without text
+    int charAt(float x, float y) const;
+
+    //Select from start to end point; false if the selected range did not change
+    bool update(float startX, float startY, float endX, float endY);
+    //Select char range [start, end] inclusive, either order
+    bool select(int start, int end);
+
+    int start() const { return mStart; }
+    int count() const { return mCount; }
+    //Merged highlight rects, 4 floats each: left, top, right, bottom
+    const std::vector<float>& rects() const { return mRects; }
+    //Append the selected text as UTF-16, chars beyond the BMP as surrogate pairs
+    void selectedText(std::vector<unsigned short> *out) const;
+    /*
+     * Whole page text, one unit per char so indexes are PDFium char indexes;
+     * chars beyond the BMP read as U+FFFD here.
+     */
+    const std::vector<unsigned short>& pageText() const { return mText; }
+
+private:
+    struct Line {
+        int first;          //char range [first, last]
+        int last;
+        float left, top, right, bottom;
+    };
+
+    std::vector<unsigned short> mText;
+    std::vector<uint32_t> mCodePoints;
+    std::vector<float> mBoxes;      //left, top, right, bottom per char
+    std::vector<int> mCharLine;
+    std::vector<Line> mLines;
+
+    int mStart;
+    int mCount;
+    std::vector<float> mRects;
+
+    void buildLines();
+    void addRect(int first, int last);
+};
+
+#endif
@@ -1,19 +1,41 @@
 #ifndef _UTIL_HPP_
 #define _UTIL_HPP_
 
-#include <jni.h>
 extern "C" {
     #include <stdlib.h>
 }
 
-#include <android/log.h>
-
 #define JNI_FUNC(retType, bindClass, name)  JNIEXPORT retType JNICALL Java_com_shockwave_pdfium_##bindClass##_##name
 #define JNI_ARGS    JNIEnv *env, jobject thiz
 
 #define LOG_TAG "jniPdfium"
+
+#ifdef __ANDROID__
+#include <jni.h>
+#include <android/log.h>
+
 #define LOGI(...)   __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...)   __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGD(...)   __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#else
+//Host builds of the shared sources (pdfiumBatch on a server, unit tests) log to stderr
+extern "C" {
+    #include <stdio.h>
+    #include <stdarg.h>
+}
+
+static inline void hostLog(char level, const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c/%s: ", level, LOG_TAG);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+#define LOGI(...)   hostLog('I', __VA_ARGS__)
+#define LOGE(...)   hostLog('E', __VA_ARGS__)
+#define LOGD(...)   hostLog('D', __VA_ARGS__)
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,128 @@
+#include "util.hpp"
+#include "webLinks.hpp"
+
+#include <algorithm>
+
+using namespace android;
+
+WebLinkCache::WebLinkCache() : mRefs(1) {
+}
+
+WebLinkCache::~WebLinkCache(){
+    for(std::map<int, Page*>::iterator it = mPages.begin(); it != mPages.end(); ++it){
+        delete it->second;
+    }
+}
+
+void WebLinkCache::acquire(){
+    __atomic_add_fetch(&mRefs, 1, __ATOMIC_RELAXED);
+}
+
+void WebLinkCache::release(){
+    if(__atomic_sub_fetch(&mRefs, 1, __ATOMIC_ACQ_REL) == 0) delete this;
+}
+
+bool WebLinkCache::hasPage(int pageIndex){
+    Mutex::Autolock lock(mLock);
+    return mPages.find(pageIndex) != mPages.end();
+}
+
+WebLinkCache::Page* WebLinkCache::load(FPDF_TEXTPAGE textPage){
+    Page *page = new Page();
+    page->urlStarts.push_back(0);
+    page->rectStarts.push_back(0);
+
+    FPDF_PAGELINK links = FPDFLink_LoadWebLinks(textPage);
+    int count = (links != NULL)? FPDFLink_CountWebLinks(links) : 0;
+    for(int i = 0; i < count; i++){
+        //Length includes the terminator, which is dropped again
+        int length = FPDFLink_GetURL(links, i, NULL, 0);
+        if(length > 1){
+            size_t start = page->urls.size();
+            page->urls.resize(start + length);
+            FPDFLink_GetURL(links, i, &page->urls[start], length);
+            page->urls.resize(start + length - 1);
+        }
+        page->urlStarts.push_back((int32_t) page->urls.size());
+
+        int rectCount = FPDFLink_CountRects(links, i);
+        for(int r = 0; r < rectCount; r++){
+            double left, top, right, bottom;
+            FPDFLink_GetRect(links, i, r, &left, &top, &right, &bottom);
+            page->rects.push_back((float) left);
+            page->rects.push_back((float) top);
+            page->rects.push_back((float) right);
+            page->rects.push_back((float) bottom);
+        }
+        page->rectStarts.push_back((int32_t) page->rects.size());
+    }
+    if(links != NULL) FPDFLink_CloseWebLinks(links);
+    return page;
+}
+
+void WebLinkCache::store(int pageIndex, Page *page){
+    page->left = page->bottom = 1e30f;
+    page->right = page->top = -1e30f;
+    for(size_t r = 0; r < page->rects.size(); r += 4){
+        page->left = std::min(page->left, page->rects[r]);
+        page->top = std::max(page->top, page->rects[r + 1]);
+        page->right = std::max(page->right, page->rects[r + 2]);
+        page->bottom = std::min(page->bottom, page->rects[r + 3]);
+    }
+
+    Mutex::Autolock lock(mLock);
+    if(!mPages.insert(std::make_pair(pageIndex, page)).second){
+        delete page;
+    }
+}
+
+void WebLinkCache::detect(int pageIndex, FPDF_TEXTPAGE textPage){
+    if(hasPage(pageIndex)) return;
+    store(pageIndex, load(textPage));
+}
+
+bool WebLinkCache::getPage(int pageIndex, std::vector<unsigned short> *urls,
+                           std::vector<int32_t> *urlStarts,
+                           std::vector<float> *rects, std::vector<int32_t> *rectStarts){
+    Mutex::Autolock lock(mLock);
+    std::map<int, Page*>::iterator it = mPages.find(pageIndex);
+    if(it == mPages.end()) return false;
+
+    *urls = it->second->urls;
+    *urlStarts = it->second->urlStarts;
+    *rects = it->second->rects;
+    *rectStarts = it->second->rectStarts;
+    return true;
+}
+
+int WebLinkCache::linkAt(int pageIndex, float x, float y, std::vector<unsigned short> *url){
+    Mutex::Autolock lock(mLock);
+    std::map<int, Page*>::iterator it = mPages.find(pageIndex);
+    if(it == mPages.end()) return -1;
+
+    //PDF space, top is greater than bottom
+    const Page *page = it->second;
+    if(x < page->left || x > page->right || y < page->bottom || y > page->top) return 0;
+
+    int count = (int) page->urlStarts.size() - 1;
+    for(int i = 0; i < count; i++){
+        for(int r = page->rectStarts[i]; r < page->rectStarts[i + 1]; r += 4){
+            const float *rect = &page->rects[r];
+            if(x >= rect[0] && x <= rect[2] && y <= rect[1] && y >= rect[3]){
+                url->assign(page->urls.begin() + page->urlStarts[i],
+                            page->urls.begin() + page->urlStarts[i + 1]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void WebLinkCache::invalidate(int fromIndex, int toIndex){
+    Mutex::Autolock lock(mLock);
+    std::map<int, Page*>::iterator it = mPages.lower_bound(fromIndex);
+    while(it != mPages.end() && it->first <= toIndex){
+        delete it->second;
+        mPages.erase(it++);
+    }
+}
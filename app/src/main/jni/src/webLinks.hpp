@@ -0,0 +1,73 @@
+#ifndef _WEB_LINKS_HPP_
+#define _WEB_LINKS_HPP_
+
+extern "C" {
+    #include <stdint.h>
+}
+
+#include <fpdf_text.h>
+#include <utils/Mutex.h>
+
+#include <map>
+#include <vector>
+
+/*
+ * URLs written as plain text, detected by FPDFLink_LoadWebLinks once per page
+ * and kept per document until the page content is rewritten. Each page is a
+ * flat table: all URLs in one UTF-16 buffer and all rects in one float array,
+ * indexed by offset arrays with one extra end entry. A page is stored once
+ * complete and never changes after, so lookups never call into PDFium and
+ * only take the table lock. The cache is reference counted: the DocumentFile
+ * holds one reference, the Java document one for its lookups and every
+ * queued detection one, so none of them waits for the document close.
+ */
+
+class WebLinkCache {
+public:
+    struct Page;
+
+    //Starts with one reference
+    WebLinkCache();
+
+    void acquire();
+    void release();
+
+    bool hasPage(int pageIndex);
+    //Links FPDFLink_LoadWebLinks finds on textPage, caller holds the PDFium lock
+    static Page* load(FPDF_TEXTPAGE textPage);
+    //Keep a loaded page, the PDFium lock is not needed
+    void store(int pageIndex, Page *page);
+    //load and store in one, caller holds the PDFium lock
+    void detect(int pageIndex, FPDF_TEXTPAGE textPage);
+
+    /*
+     * Links of a detected page: urls back to back with urlStarts[n+1],
+     * rects as left, top, right, bottom with rectStarts[n+1] in rects.
+     * False while the page is not detected yet.
+     */
+    bool getPage(int pageIndex, std::vector<unsigned short> *urls, std::vector<int32_t> *urlStarts,
+                 std::vector<float> *rects, std::vector<int32_t> *rectStarts);
+
+    //URL of the link under the point (page coordinates); -1 not detected yet, 0 none, 1 found
+    int linkAt(int pageIndex, float x, float y, std::vector<unsigned short> *url);
+
+    //Forget pages fromIndex..toIndex whose content changed, they are detected again
+    void invalidate(int fromIndex, int toIndex);
+
+    struct Page {
+        std::vector<unsigned short> urls;
+        std::vector<int32_t> urlStarts;
+        std::vector<float> rects;
+        std::vector<int32_t> rectStarts;
+        float left, top, right, bottom;     //union of all rects, rejects most taps early
+    };
+
+private:
+    ~WebLinkCache();
+
+    int mRefs;
+    android::Mutex mLock;
+    std::map<int, Page*> mPages;
+};
+
+#endif
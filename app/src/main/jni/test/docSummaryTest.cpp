@@ -0,0 +1,115 @@
+#include "jniTest.hpp"
+#include "docSummary.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+//Offset of payloadSize in the file header: magic, version, key
+#define SUMMARY_PAYLOAD_SIZE_OFFSET (8 + sizeof(DocumentKey))
+
+static DocumentKey sampleKey(){
+    DocumentKey key;
+    key.size = 123456;
+    key.mtimeNs = 1700000000123456789ll;
+    key.contentHash = 0x0123456789abcdefull;
+    return key;
+}
+
+static DocumentSummary sampleSummary(){
+    DocumentSummary summary;
+    summary.pageCount = 2;
+    summary.pageSizes.push_back(612);
+    summary.pageSizes.push_back(792);
+    summary.pageSizes.push_back(842);
+    summary.pageSizes.push_back(595);
+    summary.meta[0] = utf16("Annual report");
+    summary.meta[1] = utf16("Finance");
+    summary.outlineTitles = utf16("IntroductionScope");
+    OutlineEntry intro = { 0, 0, 0, 12 };
+    OutlineEntry scope = { 1, 1, 12, 5 };
+    summary.outline.push_back(intro);
+    summary.outline.push_back(scope);
+    summary.thumbnailWidth = 3;
+    summary.thumbnailHeight = 2;
+    for(uint32_t i = 0; i < 6; i++) summary.thumbnail.push_back(0xff000000u | i);
+    return summary;
+}
+
+static std::string writeSample(const char *name){
+    std::string path = documentSummaryPath(testDirectory(name).c_str(), sampleKey());
+    EXPECT(writeDocumentSummary(path, sampleKey(), sampleSummary()));
+    return path;
+}
+
+TEST(docSummaryRoundTrip){
+    std::string path = writeSample("summaryRoundTrip");
+    DocumentSummary expected = sampleSummary();
+    DocumentSummary read;
+    EXPECT(readDocumentSummary(path, sampleKey(), &read));
+
+    EXPECT_EQ(expected.pageCount, read.pageCount);
+    EXPECT(expected.pageSizes == read.pageSizes);
+    for(int i = 0; i < DOC_SUMMARY_META_COUNT; i++) EXPECT(expected.meta[i] == read.meta[i]);
+    EXPECT(expected.outlineTitles == read.outlineTitles);
+    EXPECT_EQ(expected.outline.size(), read.outline.size());
+    for(size_t i = 0; i < expected.outline.size() && i < read.outline.size(); i++){
+        EXPECT(memcmp(&expected.outline[i], &read.outline[i], sizeof(OutlineEntry)) == 0);
+    }
+    EXPECT_EQ(expected.thumbnailWidth, read.thumbnailWidth);
+    EXPECT_EQ(expected.thumbnailHeight, read.thumbnailHeight);
+    EXPECT(expected.thumbnail == read.thumbnail);
+}
+
+TEST(docSummaryStaleKey){
+    std::string path = writeSample("summaryStaleKey");
+    DocumentSummary read;
+    DocumentKey key = sampleKey();
+    key.mtimeNs++;
+    EXPECT(!readDocumentSummary(path, key, &read));
+    key = sampleKey();
+    key.contentHash ^= 1;
+    EXPECT(!readDocumentSummary(path, key, &read));
+    EXPECT(!readDocumentSummary(path + ".missing", sampleKey(), &read));
+}
+
+TEST(docSummaryTruncatedOrExtended){
+    std::string path = writeSample("summaryTruncated");
+    std::vector<uint8_t> data = readTestFile(path);
+    DocumentSummary read;
+
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 1);
+    writeTestFile(path, truncated);
+    EXPECT(!readDocumentSummary(path, sampleKey(), &read));
+
+    std::vector<uint8_t> headerOnly(data.begin(), data.begin() + SUMMARY_PAYLOAD_SIZE_OFFSET + 8);
+    writeTestFile(path, headerOnly);
+    EXPECT(!readDocumentSummary(path, sampleKey(), &read));
+
+    std::vector<uint8_t> extended(data);
+    extended.push_back(0);
+    writeTestFile(path, extended);
+    EXPECT(!readDocumentSummary(path, sampleKey(), &read));
+}
+
+TEST(docSummaryCorruptHeaderSize){
+    std::string path = writeSample("summaryHeaderSize");
+    std::vector<uint8_t> data = readTestFile(path);
+    DocumentSummary read;
+
+    //A size beyond the file must be refused before anything is allocated for it
+    uint32_t huge = 0xfffffff0u;
+    memcpy(&data[SUMMARY_PAYLOAD_SIZE_OFFSET], &huge, sizeof(huge));
+    writeTestFile(path, data);
+    EXPECT(!readDocumentSummary(path, sampleKey(), &read));
+}
+
+TEST(docSummaryCorruptPayload){
+    std::string path = writeSample("summaryPayload");
+    std::vector<uint8_t> data = readTestFile(path);
+    DocumentSummary read;
+
+    data[data.size() - 3] ^= 0x40;
+    writeTestFile(path, data);
+    EXPECT(!readDocumentSummary(path, sampleKey(), &read));
+}
@@ -0,0 +1,109 @@
+#include "jniTest.hpp"
+#include "fakePdfium.hpp"
+#include "documentSave.hpp"
+
+extern "C" {
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+}
+
+#define DOCUMENT reinterpret_cast<FPDF_DOCUMENT>(1)
+
+//Deterministic bytes, different for every seed
+static std::string sampleBytes(size_t size, int seed){
+    std::string bytes(size, '\0');
+    for(size_t i = 0; i < size; i++) bytes[i] = (char) ((i * 31 + seed * 7) & 0xFF);
+    return bytes;
+}
+
+static std::vector<uint8_t> toVector(const std::string &bytes){
+    return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+static std::vector<int64_t> sProgress;
+
+static void recordProgress(int64_t written, void * /*arg*/){
+    sProgress.push_back(written);
+}
+
+static SaveOptions saveOptions(int flags, int64_t skipBytes){
+    SaveOptions options;
+    options.flags = flags;
+    options.skipBytes = skipBytes;
+    options.progress = recordProgress;
+    options.progressArg = NULL;
+    return options;
+}
+
+TEST(saveDocumentRewrite){
+    std::string path = testDirectory("save") + "/rewrite.pdf";
+    //Longer old content is cut off
+    writeTestFile(path, toVector(sampleBytes(3 * 1024 * 1024, 9)));
+    std::string output = sampleBytes(2500 * 1000, 1);
+    fakeSetSaveOutput(output, 7000, true);
+
+    int fd = open(path.c_str(), O_RDWR);
+    EXPECT(fd >= 0);
+    int64_t written = -1;
+    sProgress.clear();
+    EXPECT_EQ(0, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_NO_INCREMENTAL, 0), &written));
+    close(fd);
+
+    EXPECT_EQ(FPDF_NO_INCREMENTAL, fakeLastSaveFlags());
+    EXPECT_EQ((int64_t) output.size(), written);
+    EXPECT(readTestFile(path) == toVector(output));
+    //One report per 1 MB chunk and the rest
+    EXPECT_EQ((size_t) 3, sProgress.size());
+    if(!sProgress.empty()) EXPECT_EQ((int64_t) output.size(), sProgress.back());
+}
+
+TEST(saveDocumentIncrementalSkipsOriginal){
+    std::string path = testDirectory("save") + "/incremental.pdf";
+    std::string original = sampleBytes(5000, 2);
+    //Past the verified first kilobyte the file is left as it is
+    std::string onDisk = original.substr(0, 1024) + sampleBytes(5000 - 1024, 3);
+    writeTestFile(path, toVector(onDisk + "old revision"));
+    fakeSetSaveOutput(original + "new revision", 100, true);
+
+    int fd = open(path.c_str(), O_RDWR);
+    int64_t written = -1;
+    EXPECT_EQ(0, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_INCREMENTAL, 5000), &written));
+    close(fd);
+
+    EXPECT_EQ((int64_t) 5012, written);
+    EXPECT(readTestFile(path) == toVector(onDisk + "new revision"));
+}
+
+TEST(saveDocumentIncrementalRejectsOtherFile){
+    std::string path = testDirectory("save") + "/other.pdf";
+    std::vector<uint8_t> other = toVector(sampleBytes(5000, 4));
+    writeTestFile(path, other);
+    fakeSetSaveOutput(sampleBytes(5000, 2) + "new revision", 100, true);
+
+    int fd = open(path.c_str(), O_RDWR);
+    int64_t written = -1;
+    EXPECT_EQ(EINVAL, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_INCREMENTAL, 5000), &written));
+    //Shorter than the bytes to skip
+    EXPECT_EQ(EINVAL, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_INCREMENTAL, 6000), &written));
+    close(fd);
+    EXPECT_EQ((int64_t) 0, written);
+    EXPECT(readTestFile(path) == other);
+}
+
+TEST(saveDocumentFailures){
+    std::string path = testDirectory("save") + "/failed.pdf";
+    std::vector<uint8_t> existing = toVector(sampleBytes(2000, 5));
+    writeTestFile(path, existing);
+    int fd = open(path.c_str(), O_RDWR);
+    int64_t written = -1;
+
+    //PDFium fails, nothing below the chunk size reached the file
+    fakeSetSaveOutput(sampleBytes(1000, 6), 100, false);
+    EXPECT_EQ(EIO, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_NO_INCREMENTAL, 0), &written));
+    //Output ends before the bytes to skip, not an incremental copy of the file
+    fakeSetSaveOutput(sampleBytes(1500, 5), 100, true);
+    EXPECT_EQ(EINVAL, saveDocumentToFd(DOCUMENT, fd, saveOptions(FPDF_INCREMENTAL, 2000), &written));
+    close(fd);
+    EXPECT(readTestFile(path) == existing);
+}
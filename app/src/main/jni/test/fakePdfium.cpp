@@ -0,0 +1,198 @@
+#include "fakePdfium.hpp"
+
+extern "C" {
+    #include <stdint.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_doc.h>
+#include <fpdf_edit.h>
+#include <fpdf_flatten.h>
+#include <fpdf_formfill.h>
+#include <fpdf_save.h>
+#include <fpdf_searchex.h>
+#include <fpdf_sysfontinfo.h>
+#include <fpdf_text.h>
+#include <fpdf_transformpage.h>
+
+static std::vector<FakeNamedDest> sNamedDests;
+
+void fakeSetNamedDests(const std::vector<FakeNamedDest> &dests){
+    sNamedDests = dests;
+}
+
+//Destinations are their index + 1, so none is NULL
+FPDF_DWORD FPDF_CountNamedDests(FPDF_DOCUMENT /*document*/){
+    return (FPDF_DWORD) sNamedDests.size();
+}
+
+FPDF_DEST FPDF_GetNamedDest(FPDF_DOCUMENT /*document*/, int index, void *buffer, long *buflen){
+    if(index < 0 || (size_t) index >= sNamedDests.size()){
+        *buflen = 0;
+        return NULL;
+    }
+    const std::string &name = sNamedDests[index].name;
+    long bytes = (long) (name.size() + 1) * 2;
+    if(buffer != NULL){
+        if(*buflen < bytes){
+            *buflen = -1;
+            return NULL;
+        }
+        unsigned short *out = static_cast<unsigned short*>(buffer);
+        for(size_t i = 0; i < name.size(); i++) out[i] = (unsigned char) name[i];
+        out[name.size()] = 0;
+    }
+    *buflen = bytes;
+    return reinterpret_cast<FPDF_DEST>((intptr_t) index + 1);
+}
+
+unsigned long FPDFDest_GetPageIndex(FPDF_DOCUMENT /*document*/, FPDF_DEST dest){
+    size_t index = (size_t) reinterpret_cast<intptr_t>(dest) - 1;
+    return (index < sNamedDests.size())? (unsigned long) sNamedDests[index].pageIndex : 0;
+}
+
+static std::vector<FakeChar> sChars;
+
+void fakeSetChars(const std::vector<FakeChar> &chars){
+    sChars = chars;
+}
+
+int FPDFText_CountChars(FPDF_TEXTPAGE /*text_page*/){
+    return (int) sChars.size();
+}
+
+unsigned int FPDFText_GetUnicode(FPDF_TEXTPAGE /*text_page*/, int index){
+    return (index >= 0 && (size_t) index < sChars.size())? sChars[index].unicode : 0;
+}
+
+void FPDFText_GetCharBox(FPDF_TEXTPAGE /*text_page*/, int index, double *left, double *right, double *bottom, double *top){
+    if(index < 0 || (size_t) index >= sChars.size()) return;
+    const FakeChar &c = sChars[index];
+    *left = c.left;
+    *right = c.right;
+    *bottom = c.bottom;
+    *top = c.top;
+}
+
+static std::vector<FakeWebLink> sWebLinks;
+static int sOpenWebLinks;
+
+void fakeSetWebLinks(const std::vector<FakeWebLink> &links){
+    sWebLinks = links;
+}
+
+int fakeOpenWebLinks(){
+    return sOpenWebLinks;
+}
+
+FPDF_PAGELINK FPDFLink_LoadWebLinks(FPDF_TEXTPAGE /*text_page*/){
+    sOpenWebLinks++;
+    return reinterpret_cast<FPDF_PAGELINK>(&sWebLinks);
+}
+
+int FPDFLink_CountWebLinks(FPDF_PAGELINK /*link_page*/){
+    return (int) sWebLinks.size();
+}
+
+int FPDFLink_GetURL(FPDF_PAGELINK /*link_page*/, int link_index, unsigned short *buffer, int buflen){
+    if(link_index < 0 || (size_t) link_index >= sWebLinks.size()) return 0;
+    const std::string &url = sWebLinks[link_index].url;
+    int length = (int) url.size() + 1;
+    if(buffer == NULL) return length;
+    if(buflen < length) return 0;
+    for(size_t i = 0; i < url.size(); i++) buffer[i] = (unsigned char) url[i];
+    buffer[url.size()] = 0;
+    return length;
+}
+
+int FPDFLink_CountRects(FPDF_PAGELINK /*link_page*/, int link_index){
+    if(link_index < 0 || (size_t) link_index >= sWebLinks.size()) return 0;
+    return (int) (sWebLinks[link_index].rects.size() / 4);
+}
+
+void FPDFLink_GetRect(FPDF_PAGELINK /*link_page*/, int link_index, int rect_index,
+                      double *left, double *top, double *right, double *bottom){
+    const double *rect = &sWebLinks[link_index].rects[(size_t) rect_index * 4];
+    *left = rect[0];
+    *top = rect[1];
+    *right = rect[2];
+    *bottom = rect[3];
+}
+
+void FPDFLink_CloseWebLinks(FPDF_PAGELINK /*link_page*/){
+    sOpenWebLinks--;
+}
+
+static std::string sSaveOutput;
+static size_t sSaveBlockSize = 1;
+static bool sSaveSucceeds = true;
+static int sSaveFlags;
+
+void fakeSetSaveOutput(const std::string &output, size_t blockSize, bool succeed){
+    sSaveOutput = output;
+    sSaveBlockSize = blockSize > 0 ? blockSize : 1;
+    sSaveSucceeds = succeed;
+}
+
+int fakeLastSaveFlags(){
+    return sSaveFlags;
+}
+
+//Stops at the first block the writer refuses, like PDFium
+FPDF_BOOL FPDF_SaveAsCopy(FPDF_DOCUMENT /*document*/, FPDF_FILEWRITE *pFileWrite, FPDF_DWORD flags){
+    sSaveFlags = (int) flags;
+    for(size_t done = 0; done < sSaveOutput.size(); done += sSaveBlockSize){
+        size_t size = sSaveOutput.size() - done;
+        if(size > sSaveBlockSize) size = sSaveBlockSize;
+        if(!pFileWrite->WriteBlock(pFileWrite, sSaveOutput.data() + done, (unsigned long) size)) return 0;
+    }
+    return sSaveSucceeds;
+}
+
+//Nothing below is reached by the tests
+
+FPDF_DOCUMENT FPDF_LoadCustomDocument(FPDF_FILEACCESS * /*pFileAccess*/, FPDF_BYTESTRING /*password*/){ return NULL; }
+int FPDF_GetPageCount(FPDF_DOCUMENT /*document*/){ return 0; }
+int FPDF_GetPageSizeByIndex(FPDF_DOCUMENT /*document*/, int /*page_index*/, double * /*width*/, double * /*height*/){ return 0; }
+FPDF_PAGE FPDF_LoadPage(FPDF_DOCUMENT /*document*/, int /*page_index*/){ return NULL; }
+void FPDF_ClosePage(FPDF_PAGE /*page*/){}
+double FPDF_GetPageWidth(FPDF_PAGE /*page*/){ return 0; }
+double FPDF_GetPageHeight(FPDF_PAGE /*page*/){ return 0; }
+unsigned long FPDF_GetMetaText(FPDF_DOCUMENT /*doc*/, FPDF_BYTESTRING /*tag*/, void * /*buffer*/, unsigned long /*buflen*/){ return 0; }
+
+FPDF_BOOKMARK FPDFBookmark_GetFirstChild(FPDF_DOCUMENT /*document*/, FPDF_BOOKMARK /*bookmark*/){ return NULL; }
+FPDF_BOOKMARK FPDFBookmark_GetNextSibling(FPDF_DOCUMENT /*document*/, FPDF_BOOKMARK /*bookmark*/){ return NULL; }
+unsigned long FPDFBookmark_GetTitle(FPDF_BOOKMARK /*bookmark*/, void * /*buffer*/, unsigned long /*buflen*/){ return 0; }
+FPDF_DEST FPDFBookmark_GetDest(FPDF_DOCUMENT /*document*/, FPDF_BOOKMARK /*bookmark*/){ return NULL; }
+
+FPDF_BOOL FPDFLink_Enumerate(FPDF_PAGE /*page*/, int * /*startPos*/, FPDF_LINK * /*linkAnnot*/){ return 0; }
+FPDF_BOOL FPDFLink_GetAnnotRect(FPDF_LINK /*linkAnnot*/, FS_RECTF * /*rect*/){ return 0; }
+FPDF_DEST FPDFLink_GetDest(FPDF_DOCUMENT /*document*/, FPDF_LINK /*link*/){ return NULL; }
+FPDF_ACTION FPDFLink_GetAction(FPDF_LINK /*link*/){ return NULL; }
+unsigned long FPDFAction_GetURIPath(FPDF_DOCUMENT /*document*/, FPDF_ACTION /*action*/, void * /*buffer*/, unsigned long /*buflen*/){ return 0; }
+
+FPDF_TEXTPAGE FPDFText_LoadPage(FPDF_PAGE /*page*/){ return NULL; }
+void FPDFText_ClosePage(FPDF_TEXTPAGE /*text_page*/){}
+int FPDFText_GetText(FPDF_TEXTPAGE /*text_page*/, int /*start_index*/, int /*count*/, unsigned short * /*result*/){ return 0; }
+int FPDFText_GetCharIndexFromTextIndex(FPDF_TEXTPAGE /*text_page*/, int /*nTextIndex*/){ return -1; }
+
+FPDF_BITMAP FPDFBitmap_CreateEx(int /*width*/, int /*height*/, int /*format*/, void * /*first_scan*/, int /*stride*/){ return NULL; }
+void FPDFBitmap_Destroy(FPDF_BITMAP /*bitmap*/){}
+void FPDFBitmap_FillRect(FPDF_BITMAP /*bitmap*/, int /*left*/, int /*top*/, int /*width*/, int /*height*/, FPDF_DWORD /*color*/){}
+void FPDF_RenderPageBitmap(FPDF_BITMAP /*bitmap*/, FPDF_PAGE /*page*/, int /*start_x*/, int /*start_y*/,
+                           int /*size_x*/, int /*size_y*/, int /*rotate*/, int /*flags*/){}
+void FPDF_FFLDraw(FPDF_FORMHANDLE /*hHandle*/, FPDF_BITMAP /*bitmap*/, FPDF_PAGE /*page*/, int /*start_x*/, int /*start_y*/,
+                  int /*size_x*/, int /*size_y*/, int /*rotate*/, int /*flags*/){}
+int FPDFPage_Flatten(FPDF_PAGE /*page*/, int /*nFlag*/){ return FLATTEN_NOTHINGTODO; }
+
+int FPDFPage_GetRotation(FPDF_PAGE /*page*/){ return 0; }
+void FPDFPage_SetRotation(FPDF_PAGE /*page*/, int /*rotate*/){}
+FPDF_BOOL FPDFPage_GetCropBox(FPDF_PAGE /*page*/, float * /*left*/, float * /*bottom*/, float * /*right*/, float * /*top*/){ return 0; }
+FPDF_BOOL FPDFPage_GetMediaBox(FPDF_PAGE /*page*/, float * /*left*/, float * /*bottom*/, float * /*right*/, float * /*top*/){ return 0; }
+void FPDFPage_SetCropBox(FPDF_PAGE /*page*/, float /*left*/, float /*bottom*/, float /*right*/, float /*top*/){}
+void FPDFPage_SetMediaBox(FPDF_PAGE /*page*/, float /*left*/, float /*bottom*/, float /*right*/, float /*top*/){}
+FPDF_BOOL FPDFPage_TransFormWithClip(FPDF_PAGE /*page*/, FS_MATRIX * /*matrix*/, FS_RECTF * /*clipRect*/){ return 0; }
+void FPDFPage_TransformAnnots(FPDF_PAGE /*page*/, double /*a*/, double /*b*/, double /*c*/, double /*d*/, double /*e*/, double /*f*/){}
+
+void FPDF_SetSystemFontInfo(FPDF_SYSFONTINFO * /*pFontInfo*/){}
+void FPDF_AddInstalledFont(void * /*mapper*/, const char * /*face*/, int /*charset*/){}
@@ -0,0 +1,45 @@
+#ifndef _FAKE_PDFIUM_HPP_
+#define _FAKE_PDFIUM_HPP_
+
+#include <string>
+#include <vector>
+
+/*
+ * The PDFium entry points the tested sources link against. Tests do not
+ * load documents; the behaviour is a named destination table, the chars
+ * and web links of a text page and the bytes a save streams out, every
+ * other call reports nothing found.
+ */
+
+struct FakeNamedDest {
+    std::string name;           //ASCII, returned as UTF-16
+    int pageIndex;
+};
+
+//Destinations FPDF_CountNamedDests and FPDF_GetNamedDest report for any document
+void fakeSetNamedDests(const std::vector<FakeNamedDest> &dests);
+
+struct FakeChar {
+    unsigned int unicode;
+    double left, top, right, bottom;
+};
+
+//Chars every text page reports, tests pass any non-NULL FPDF_TEXTPAGE
+void fakeSetChars(const std::vector<FakeChar> &chars);
+
+struct FakeWebLink {
+    std::string url;            //ASCII, returned as UTF-16
+    std::vector<double> rects;  //left, top, right, bottom per rect
+};
+
+//Links FPDFLink_LoadWebLinks finds on every text page
+void fakeSetWebLinks(const std::vector<FakeWebLink> &links);
+//Link pages loaded and not closed yet
+int fakeOpenWebLinks();
+
+//Bytes FPDF_SaveAsCopy hands the writer, blockSize at a time; false fails the save after them
+void fakeSetSaveOutput(const std::string &output, size_t blockSize, bool succeed);
+//Flags of the last FPDF_SaveAsCopy
+int fakeLastSaveFlags();
+
+#endif
@@ -0,0 +1,91 @@
+#include "jniTest.hpp"
+#include "fontProvider.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+//Offset of payloadSize in the file header: magic, version, stamp
+#define FONT_INDEX_PAYLOAD_SIZE_OFFSET 16
+
+static std::vector<FontFace> sampleFaces(){
+    std::vector<FontFace> faces;
+    FontFace face;
+    face.family = "Noto Sans";
+    face.familyKey = foldFontName(face.family.c_str(), face.family.size());
+    face.postScriptKey = "notosansregular";
+    face.path = "/system/fonts/NotoSans-Regular.ttf";
+    face.faceOffset = 0;
+    face.weight = 400;
+    face.flags = 0;
+    face.charsets = fontCharsetBit(FXFONT_ANSI_CHARSET);
+    faces.push_back(face);
+
+    face.family = "Noto Sans CJK JP";
+    face.familyKey = foldFontName(face.family.c_str(), face.family.size());
+    face.postScriptKey = "notosanscjkjpbold";
+    face.path = "/system/fonts/NotoSansCJK-Regular.ttc";
+    face.faceOffset = 0x1c4;
+    face.weight = 700;
+    face.flags = FONT_FACE_FIXED;
+    face.charsets = fontCharsetBit(FXFONT_SHIFTJIS_CHARSET) | fontCharsetBit(FXFONT_ANSI_CHARSET);
+    faces.push_back(face);
+    return faces;
+}
+
+static bool sameFace(const FontFace &a, const FontFace &b){
+    return a.family == b.family && a.familyKey == b.familyKey && a.postScriptKey == b.postScriptKey
+           && a.path == b.path && a.faceOffset == b.faceOffset && a.weight == b.weight
+           && a.flags == b.flags && a.charsets == b.charsets;
+}
+
+TEST(foldFontNameKeys){
+    const char *spaced = "Noto Sans CJK JP";
+    const char *packed = "NotoSansCJKjp";
+    EXPECT_EQ(std::string("notosanscjkjp"), foldFontName(spaced, strlen(spaced)));
+    EXPECT(foldFontName(spaced, strlen(spaced)) == foldFontName(packed, strlen(packed)));
+    EXPECT_EQ(std::string("arial"), foldFontName("Arial,Bold", 5));
+}
+
+TEST(fontIndexRoundTrip){
+    std::string path = testDirectory("fontIndexRoundTrip") + "/fonts.index";
+    std::vector<FontFace> faces = sampleFaces();
+    EXPECT(writeFontIndex(path, 42, faces));
+
+    std::vector<FontFace> read;
+    EXPECT(readFontIndex(path, 42, &read));
+    EXPECT_EQ(faces.size(), read.size());
+    for(size_t i = 0; i < faces.size() && i < read.size(); i++) EXPECT(sameFace(faces[i], read[i]));
+}
+
+TEST(fontIndexStaleStamp){
+    std::string path = testDirectory("fontIndexStale") + "/fonts.index";
+    EXPECT(writeFontIndex(path, 42, sampleFaces()));
+    std::vector<FontFace> read;
+    EXPECT(!readFontIndex(path, 43, &read));
+    EXPECT(!readFontIndex(path + ".missing", 42, &read));
+}
+
+TEST(fontIndexCorrupt){
+    std::string path = testDirectory("fontIndexCorrupt") + "/fonts.index";
+    EXPECT(writeFontIndex(path, 42, sampleFaces()));
+    std::vector<uint8_t> data = readTestFile(path);
+    std::vector<FontFace> read;
+
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 1);
+    writeTestFile(path, truncated);
+    EXPECT(!readFontIndex(path, 42, &read));
+    EXPECT(read.empty());
+
+    std::vector<uint8_t> flipped(data);
+    flipped[flipped.size() / 2] ^= 0x01;
+    writeTestFile(path, flipped);
+    EXPECT(!readFontIndex(path, 42, &read));
+
+    //A size beyond the file must be refused before anything is allocated for it
+    std::vector<uint8_t> huge(data);
+    uint32_t size = 0xfffffff0u;
+    memcpy(&huge[FONT_INDEX_PAYLOAD_SIZE_OFFSET], &size, sizeof(size));
+    writeTestFile(path, huge);
+    EXPECT(!readFontIndex(path, 42, &read));
+}
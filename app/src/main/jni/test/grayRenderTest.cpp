@@ -0,0 +1,113 @@
+#include "jniTest.hpp"
+#include "grayRender.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+#define GRAY_STRIDE 32
+#define CANARY 0xAA
+
+typedef void (*Ditherer)(const uint8_t *gray, int width, int height, uint8_t *out, int outStride);
+
+static void ordered(const uint8_t *gray, int width, int height, uint8_t *out, int outStride){
+    ditherOrdered(gray, GRAY_STRIDE, width, height, out, outStride);
+}
+
+static void diffusion(const uint8_t *gray, int width, int height, uint8_t *out, int outStride){
+    EXPECT(ditherDiffusion(gray, GRAY_STRIDE, width, height, out, outStride));
+}
+
+static bool pixel(const uint8_t *out, int outStride, int x, int y){
+    return (out[(size_t) y * outStride + x / 8] & (0x80 >> (x & 7))) != 0;
+}
+
+//Black is 0 and white 255 in every column, both ditherers must keep them exact
+static std::vector<uint8_t> pattern(int width, int height){
+    //Padding columns black, so stray bits past the width would show
+    std::vector<uint8_t> gray((size_t) GRAY_STRIDE * height, 0);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++) gray[(size_t) y * GRAY_STRIDE + x] = ((x + y) % 3 == 0)? 0 : 255;
+    }
+    return gray;
+}
+
+static void checkPacking(Ditherer dither){
+    int width = 13, height = 4;
+    size_t rowBytes = grayOutputRowBytes(GRAY_OUTPUT_MONO_ORDERED, width);
+    EXPECT_EQ((size_t) 2, rowBytes);
+
+    std::vector<uint8_t> gray = pattern(width, height);
+    std::vector<uint8_t> out(rowBytes * height, CANARY);
+    dither(&gray[0], width, height, &out[0], (int) rowBytes);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++) EXPECT_EQ((x + y) % 3 == 0, pixel(&out[0], (int) rowBytes, x, y));
+        //Bits past the width are clear
+        EXPECT_EQ(0, out[y * rowBytes + 1] & 0x07);
+    }
+}
+
+static void checkStride(Ditherer dither){
+    int width = 13, height = 3, stride = 5;
+    size_t rowBytes = grayOutputRowBytes(GRAY_OUTPUT_MONO_DIFFUSION, width);
+    //The JNI accepts buffers ending right after the last row
+    size_t used = (size_t) stride * (height - 1) + rowBytes;
+
+    std::vector<uint8_t> gray = pattern(width, height);
+    std::vector<uint8_t> out(used + 8, CANARY);
+    dither(&gray[0], width, height, &out[0], stride);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++) EXPECT_EQ((x + y) % 3 == 0, pixel(&out[0], stride, x, y));
+        if(y < height - 1){
+            for(int b = (int) rowBytes; b < stride; b++) EXPECT_EQ(0, out[y * stride + b]);
+        }
+    }
+    for(size_t b = used; b < out.size(); b++) EXPECT_EQ(CANARY, out[b]);
+}
+
+TEST(grayRowBytes){
+    EXPECT_EQ((size_t) 13, grayOutputRowBytes(GRAY_OUTPUT_8BIT, 13));
+    EXPECT_EQ((size_t) 1, grayOutputRowBytes(GRAY_OUTPUT_MONO_ORDERED, 8));
+    EXPECT_EQ((size_t) 2, grayOutputRowBytes(GRAY_OUTPUT_MONO_ORDERED, 9));
+    EXPECT_EQ((size_t) 2, grayOutputRowBytes(GRAY_OUTPUT_MONO_DIFFUSION, 16));
+}
+
+TEST(ditherOrderedPacking){
+    checkPacking(ordered);
+}
+
+TEST(ditherOrderedStride){
+    checkStride(ordered);
+}
+
+TEST(ditherDiffusionPacking){
+    checkPacking(diffusion);
+}
+
+TEST(ditherDiffusionStride){
+    checkStride(diffusion);
+}
+
+TEST(ditherMidGray){
+    //Both keep the average: about half of a 50% gray field is black
+    int width = 24, height = 24;
+    std::vector<uint8_t> gray((size_t) GRAY_STRIDE * height, 128);
+    size_t rowBytes = grayOutputRowBytes(GRAY_OUTPUT_MONO_ORDERED, width);
+    std::vector<uint8_t> out(rowBytes * height);
+    Ditherer ditherers[] = { ordered, diffusion };
+    for(int d = 0; d < 2; d++){
+        ditherers[d](&gray[0], width, height, &out[0], (int) rowBytes);
+        int black = 0;
+        for(int y = 0; y < height; y++){
+            for(int x = 0; x < width; x++) black += pixel(&out[0], (int) rowBytes, x, y)? 1 : 0;
+        }
+        EXPECT(black > width * height * 2 / 5 && black < width * height * 3 / 5);
+    }
+}
+
+TEST(renderPageGrayRejectsShortStride){
+    uint8_t buffer[64];
+    EXPECT(!renderPageGray(NULL, NULL, GRAY_OUTPUT_8BIT, buffer, 12, 13, 2, 0, 0, 13, 2, 0));
+    EXPECT(!renderPageGray(NULL, NULL, GRAY_OUTPUT_MONO_ORDERED, buffer, 1, 13, 2, 0, 0, 13, 2, 0));
+    EXPECT(!renderPageGray(NULL, NULL, GRAY_OUTPUT_COUNT, buffer, 16, 13, 2, 0, 0, 13, 2, 0));
+}
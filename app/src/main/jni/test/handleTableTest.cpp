@@ -0,0 +1,72 @@
+#include "jniTest.hpp"
+#include "handleTable.hpp"
+
+#include <algorithm>
+
+//Objects in the order the closer got them
+static std::vector<void*> sClosed;
+
+static void recordClose(int /*kind*/, void *object){
+    sClosed.push_back(object);
+}
+
+static int closedAt(void *object){
+    std::vector<void*>::iterator it = std::find(sClosed.begin(), sClosed.end(), object);
+    return (it != sClosed.end())? (int) (it - sClosed.begin()) : -1;
+}
+
+TEST(handleTableGenerations){
+    HandleTable &table = HandleTable::instance();
+    int document, page, otherPage;
+    int64_t handle = table.add(HANDLE_PAGE, &page, &document);
+    EXPECT(handle != 0 && handle != -1);
+    EXPECT(table.get(handle, HANDLE_PAGE) == &page);
+    EXPECT(table.get(handle, HANDLE_TEXT_PAGE) == NULL);
+
+    sClosed.clear();
+    EXPECT(table.close(handle, HANDLE_PAGE, recordClose));
+    EXPECT_EQ(0, closedAt(&page));
+    EXPECT(table.get(handle, HANDLE_PAGE) == NULL);
+
+    //The slot is reused, the old handle stays stale
+    int64_t reused = table.add(HANDLE_PAGE, &otherPage, &document);
+    EXPECT(reused != handle);
+    EXPECT(table.get(handle, HANDLE_PAGE) == NULL);
+    EXPECT(table.get(reused, HANDLE_PAGE) == &otherPage);
+    EXPECT(!table.close(handle, HANDLE_PAGE, recordClose));
+    EXPECT_EQ((size_t) 1, sClosed.size());
+    EXPECT(table.close(reused, HANDLE_PAGE, recordClose));
+}
+
+TEST(handleTableOwnerRelease){
+    HandleTable &table = HandleTable::instance();
+    int document, page, otherPage, textPage, search, link;
+    int64_t pageHandle = table.add(HANDLE_PAGE, &page, &document);
+    int64_t otherHandle = table.add(HANDLE_PAGE, &otherPage, &document);
+    int64_t textHandle = table.add(HANDLE_TEXT_PAGE, &textPage, &page);
+    int64_t searchHandle = table.add(HANDLE_SEARCH, &search, &textPage);
+    int64_t linkHandle = table.add(HANDLE_LINK, &link, &otherPage);
+
+    //Closing a page takes its text page and search, children first
+    sClosed.clear();
+    EXPECT(table.close(pageHandle, HANDLE_PAGE, recordClose));
+    EXPECT_EQ((size_t) 3, sClosed.size());
+    EXPECT(closedAt(&search) < closedAt(&textPage));
+    EXPECT(closedAt(&textPage) < closedAt(&page));
+    EXPECT(table.get(textHandle, HANDLE_TEXT_PAGE) == NULL);
+    EXPECT(table.get(searchHandle, HANDLE_SEARCH) == NULL);
+    EXPECT(table.get(linkHandle, HANDLE_LINK) == &link);
+
+    //The document releases the rest in one pass
+    sClosed.clear();
+    table.closeOwned(&document, recordClose);
+    EXPECT_EQ((size_t) 2, sClosed.size());
+    EXPECT_EQ(0, closedAt(&link));
+    EXPECT_EQ(1, closedAt(&otherPage));
+    EXPECT(table.get(otherHandle, HANDLE_PAGE) == NULL);
+    EXPECT(table.get(linkHandle, HANDLE_LINK) == NULL);
+
+    sClosed.clear();
+    table.closeOwned(&document, recordClose);
+    EXPECT(sClosed.empty());
+}
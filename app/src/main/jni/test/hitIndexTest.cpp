@@ -0,0 +1,114 @@
+#include "jniTest.hpp"
+#include "hitIndex.hpp"
+
+#define LINE_CHARS 50
+
+//One line of 8 point wide chars every 10 points, at x = 10 + 10 * i
+static std::vector<float> lineGeometry(){
+    std::vector<float> geometry;
+    for(int i = 0; i < LINE_CHARS; i++){
+        float left = 10 + 10 * i;
+        float box[CHAR_GEOMETRY_STRIDE] = { left, 712, left + 8, 700, (float) 'a' };
+        geometry.insert(geometry.end(), box, box + CHAR_GEOMETRY_STRIDE);
+    }
+    return geometry;
+}
+
+static HitIndex* sampleIndex(){
+    //Annotation link over chars 0..4
+    std::vector<PageLink> links(1);
+    links[0].left = 10;
+    links[0].top = 715;
+    links[0].right = 58;
+    links[0].bottom = 698;
+    links[0].destPageIndex = 4;
+
+    //Web link over chars 20..24 on this line and 0..1 on a line below
+    std::vector<unsigned short> urls = utf16("http://x.org");
+    std::vector<int32_t> urlStarts;
+    urlStarts.push_back(0);
+    urlStarts.push_back((int32_t) urls.size());
+    const float rects[] = { 210, 712, 258, 700, 10, 690, 28, 678 };
+    std::vector<float> webRects(rects, rects + 8);
+    std::vector<int32_t> rectStarts;
+    rectStarts.push_back(0);
+    rectStarts.push_back(8);
+
+    return new HitIndex(600, 800, links, urls, urlStarts, webRects, rectStarts, lineGeometry());
+}
+
+TEST(hitIndexKinds){
+    HitIndex *index = sampleIndex();
+    int id = -1;
+    //Links win over the chars under them
+    EXPECT_EQ(HIT_LINK, index->hitTest(34, 706, 0, &id));
+    EXPECT_EQ(0, id);
+    EXPECT_EQ(4, index->links()[0].destPageIndex);
+
+    EXPECT_EQ(HIT_WEB_LINK, index->hitTest(224, 706, 0, &id));
+    EXPECT_EQ(0, id);
+    EXPECT_EQ(HIT_WEB_LINK, index->hitTest(15, 680, 0, &id));
+    EXPECT_EQ(1, index->webLinkCount());
+    std::vector<unsigned short> url;
+    index->webLinkUrl(0, &url);
+    EXPECT(url == utf16("http://x.org"));
+    const float *bounds = index->webLinkBounds(0);
+    EXPECT_EQ(10.0f, bounds[0]);
+    EXPECT_EQ(712.0f, bounds[1]);
+    EXPECT_EQ(258.0f, bounds[2]);
+    EXPECT_EQ(678.0f, bounds[3]);
+
+    EXPECT_EQ(HIT_CHAR, index->hitTest(305, 706, 0, &id));
+    EXPECT_EQ(29, id);
+    delete index;
+}
+
+TEST(hitIndexTolerance){
+    HitIndex *index = sampleIndex();
+    int id = -1;
+    //Between chars 29 and 30, nearer to 29
+    EXPECT_EQ(HIT_NONE, index->hitTest(308.5f, 706, 0, &id));
+    EXPECT_EQ(HIT_CHAR, index->hitTest(308.5f, 706, 2, &id));
+    EXPECT_EQ(29, id);
+    //A direct hit beats a nearer kind within tolerance
+    EXPECT_EQ(HIT_CHAR, index->hitTest(61, 706, 5, &id));
+    EXPECT_EQ(5, id);
+    EXPECT_EQ(HIT_NONE, index->hitTest(300, 100, 5, &id));
+    delete index;
+}
+
+TEST(hitIndexEveryChar){
+    //Each char centre finds its own char through the grid, whatever cell it falls in
+    std::vector<PageLink> links;
+    std::vector<unsigned short> urls;
+    std::vector<int32_t> starts;
+    std::vector<float> rects;
+    HitIndex index(600, 800, links, urls, starts, rects, starts, lineGeometry());
+    for(int i = 0; i < LINE_CHARS; i++){
+        int id = -1;
+        EXPECT_EQ(HIT_CHAR, index.hitTest(14 + 10 * i, 706, 0, &id));
+        EXPECT_EQ(i, id);
+    }
+    EXPECT_EQ(0, index.webLinkCount());
+}
+
+TEST(hitIndexEmptyAndOffPage){
+    std::vector<PageLink> links;
+    std::vector<unsigned short> urls;
+    std::vector<int32_t> starts;
+    std::vector<float> rects, geometry;
+    int id = -1;
+    HitIndex empty(600, 800, links, urls, starts, rects, starts, geometry);
+    EXPECT_EQ(HIT_NONE, empty.hitTest(300, 400, 50, &id));
+
+    //Content drawn outside the page box is still indexed
+    links.resize(1);
+    links[0].left = -40;
+    links[0].top = 900;
+    links[0].right = -10;
+    links[0].bottom = 850;
+    links[0].destPageIndex = -1;
+    HitIndex outside(600, 800, links, urls, starts, rects, starts, geometry);
+    EXPECT_EQ(HIT_LINK, outside.hitTest(-20, 870, 0, &id));
+    EXPECT_EQ(HIT_NONE, outside.hitTest(20, 870, 0, &id));
+}
@@ -0,0 +1,66 @@
+#include "jniTest.hpp"
+#include "imposition.hpp"
+
+#define A4_WIDTH 595.0f
+#define A4_HEIGHT 842.0f
+
+TEST(sheetLayoutTwoUp){
+    //Two portrait pages side by side on a landscape sheet
+    SheetLayout layout = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 2, A4_WIDTH, A4_HEIGHT, 0, 0);
+    EXPECT_EQ(A4_HEIGHT, layout.width);
+    EXPECT_EQ(A4_WIDTH, layout.height);
+    EXPECT_EQ(1, layout.rows);
+    EXPECT_EQ(2, layout.cols);
+
+    CellPlacement left = placePage(layout, 0, A4_WIDTH, A4_HEIGHT);
+    CellPlacement right = placePage(layout, 1, A4_WIDTH, A4_HEIGHT);
+    EXPECT_EQ(0, left.rotate);
+    EXPECT_NEAR(A4_WIDTH, left.height, 0.01);
+    EXPECT(left.width <= A4_HEIGHT / 2);
+    EXPECT(left.left >= 0);
+    EXPECT(right.left >= A4_HEIGHT / 2);
+    EXPECT_NEAR(left.bottom, right.bottom, 0.01);
+}
+
+TEST(sheetLayoutFourUp){
+    SheetLayout layout = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 4, A4_WIDTH, A4_HEIGHT, 20, 10);
+    EXPECT_EQ(A4_WIDTH, layout.width);
+    EXPECT_EQ(2, layout.rows);
+    EXPECT_EQ(2, layout.cols);
+
+    //Cells count from the top left, PDF y grows upwards
+    CellPlacement first = placePage(layout, 0, A4_WIDTH, A4_HEIGHT);
+    CellPlacement last = placePage(layout, 3, A4_WIDTH, A4_HEIGHT);
+    EXPECT(first.bottom > last.bottom);
+    EXPECT(first.left < last.left);
+    EXPECT(first.left >= 20);
+    EXPECT(last.left + last.width <= A4_WIDTH - 20 + 0.01f);
+    EXPECT(last.bottom >= 20 - 0.01f);
+}
+
+TEST(sheetLayoutTurnsLandscapePages){
+    //Landscape pages stacked on a portrait sheet, no quarter turn needed
+    SheetLayout layout = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 2, A4_HEIGHT, A4_WIDTH, 0, 0);
+    EXPECT_EQ(A4_WIDTH, layout.width);
+    EXPECT_EQ(2, layout.rows);
+    EXPECT_EQ(1, layout.cols);
+    EXPECT_EQ(0, placePage(layout, 0, A4_HEIGHT, A4_WIDTH).rotate);
+
+    //Forced into a tall cell, a landscape page turns
+    SheetLayout single = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 1, A4_WIDTH, A4_HEIGHT, 0, 0);
+    CellPlacement turned = placePage(single, 0, A4_HEIGHT, A4_WIDTH);
+    EXPECT_EQ(1, turned.rotate);
+    EXPECT_NEAR(A4_WIDTH, turned.width, 0.01);
+    EXPECT_NEAR(A4_HEIGHT, turned.height, 0.01);
+}
+
+TEST(sheetLayoutMarginsTooLarge){
+    SheetLayout layout = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 3, A4_WIDTH, A4_HEIGHT, 400, 0);
+    EXPECT_EQ(0.0f, layout.margin);
+    EXPECT_EQ(0.0f, layout.gap);
+    EXPECT_EQ(1, layout.rows);
+    EXPECT_EQ(3, layout.cols);
+
+    layout = chooseSheetLayout(A4_WIDTH, A4_HEIGHT, 0, A4_WIDTH, A4_HEIGHT, 0, 0);
+    EXPECT_EQ(1, layout.rows * layout.cols);
+}
@@ -0,0 +1,100 @@
+#include "jniTest.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <dirent.h>
+    #include <sys/stat.h>
+}
+
+struct RegisteredTest {
+    const char *name;
+    TestFunction function;
+};
+
+static std::vector<RegisteredTest>& registeredTests(){
+    static std::vector<RegisteredTest> tests;
+    return tests;
+}
+
+static std::vector<std::string> sDirectories;
+static int sCaseFailures;
+
+TestCase::TestCase(const char *name, TestFunction function){
+    RegisteredTest test;
+    test.name = name;
+    test.function = function;
+    registeredTests().push_back(test);
+}
+
+void testFailed(const char *file, int line, const char *expression){
+    fprintf(stderr, "  %s:%d: %s\n", file, line, expression);
+    sCaseFailures++;
+}
+
+std::vector<unsigned short> utf16(const char *text){
+    std::vector<unsigned short> out;
+    for(const char *c = text; *c != '\0'; c++) out.push_back((unsigned char) *c);
+    return out;
+}
+
+std::string testDirectory(const char *name){
+    const char *tmp = getenv("TMPDIR");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/jniTest-%d-%s", (tmp != NULL)? tmp : "/tmp", (int) getpid(), name);
+    mkdir(path, 0700);
+    sDirectories.push_back(path);
+    return path;
+}
+
+std::vector<uint8_t> readTestFile(const std::string &path){
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if(file == NULL) return data;
+    uint8_t buffer[4096];
+    size_t count;
+    while((count = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + count);
+    fclose(file);
+    return data;
+}
+
+void writeTestFile(const std::string &path, const std::vector<uint8_t> &data){
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == NULL) return;
+    if(!data.empty()) fwrite(&data[0], 1, data.size(), file);
+    fclose(file);
+}
+
+static void removeDirectory(const std::string &path){
+    DIR *dir = opendir(path.c_str());
+    if(dir == NULL) return;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        if(entry->d_name[0] == '.') continue;
+        unlink((path + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+//Runs every case, or those whose name contains argv[1]
+int main(int argc, char **argv){
+    const char *filter = (argc > 1)? argv[1] : NULL;
+    int run = 0, failed = 0;
+    std::vector<RegisteredTest> &tests = registeredTests();
+    for(size_t i = 0; i < tests.size(); i++){
+        if(filter != NULL && strstr(tests[i].name, filter) == NULL) continue;
+        sCaseFailures = 0;
+        tests[i].function();
+        run++;
+        if(sCaseFailures > 0){
+            failed++;
+            fprintf(stderr, "FAIL %s\n", tests[i].name);
+        }
+    }
+    for(size_t i = 0; i < sDirectories.size(); i++) removeDirectory(sDirectories[i]);
+
+    printf("%d of %d tests passed\n", run - failed, run);
+    return (failed == 0)? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#ifndef _JNI_TEST_HPP_
+#define _JNI_TEST_HPP_
+
+extern "C" {
+    #include <stdio.h>
+    #include <stdint.h>
+    #include <math.h>
+}
+
+#include <string>
+#include <vector>
+
+/*
+ * Host unit tests of the JNI sources that work without PDFium: caches,
+ * indexes, handles, text matching and selection, saving and pixel packing.
+ * Every *Test.cpp registers its cases with TEST and links against
+ * fakePdfium.cpp, see the README for the build line. A failed check reports
+ * and lets the case go on.
+ */
+
+typedef void (*TestFunction)();
+
+struct TestCase {
+    TestCase(const char *name, TestFunction function);
+};
+
+//Set by a failed check of the running case
+void testFailed(const char *file, int line, const char *expression);
+
+#define TEST(name) \
+    static void test_##name(); \
+    static TestCase testCase_##name(#name, test_##name); \
+    static void test_##name()
+
+#define EXPECT(condition) \
+    do{ if(!(condition)) testFailed(__FILE__, __LINE__, #condition); }while(0)
+
+#define EXPECT_EQ(expected, actual) EXPECT((expected) == (actual))
+
+#define EXPECT_NEAR(expected, actual, tolerance) EXPECT(fabs((double) (expected) - (double) (actual)) <= (tolerance))
+
+//ASCII to UTF-16, as the JNI layer hands text over
+std::vector<unsigned short> utf16(const char *text);
+
+//Fresh path under the temporary directory, removed with its files at exit
+std::string testDirectory(const char *name);
+
+//Whole files, for tests that corrupt what a writer produced
+std::vector<uint8_t> readTestFile(const std::string &path);
+void writeTestFile(const std::string &path, const std::vector<uint8_t> &data);
+
+#endif
@@ -0,0 +1,80 @@
+#include "jniTest.hpp"
+#include "fakePdfium.hpp"
+#include "namedDests.hpp"
+
+extern "C" {
+    #include <stdio.h>
+}
+
+static int findName(const NamedDestIndex &index, const char *name){
+    std::vector<unsigned short> text = utf16(name);
+    return index.find(text.empty() ? NULL : &text[0], text.size());
+}
+
+static void addDest(std::vector<FakeNamedDest> *dests, const std::string &name, int pageIndex){
+    FakeNamedDest dest;
+    dest.name = name;
+    dest.pageIndex = pageIndex;
+    dests->push_back(dest);
+}
+
+TEST(namedDestLookup){
+    std::vector<FakeNamedDest> dests;
+    addDest(&dests, "chapter1", 2);
+    addDest(&dests, "chapter2", 17);
+    addDest(&dests, "", 5);                 //no name, skipped
+    addDest(&dests, "chapter1", 9);         //duplicate, the first wins
+    fakeSetNamedDests(dests);
+
+    NamedDestIndex index;
+    EXPECT(!index.built());
+    EXPECT_EQ(-1, findName(index, "chapter1"));
+    index.build(NULL);
+    EXPECT(index.built());
+    EXPECT_EQ(3, index.count());
+    EXPECT_EQ(2, findName(index, "chapter1"));
+    EXPECT_EQ(17, findName(index, "chapter2"));
+    EXPECT_EQ(-1, findName(index, "chapter"));
+    EXPECT_EQ(-1, findName(index, "chapter10"));
+    EXPECT_EQ(-1, findName(index, ""));
+}
+
+TEST(namedDestManyNames){
+    //Enough names to grow the table and make probe chains
+    std::vector<FakeNamedDest> dests;
+    char name[32];
+    for(int i = 0; i < 1000; i++){
+        snprintf(name, sizeof(name), "dest.%d", i);
+        addDest(&dests, name, i % 97);
+    }
+    fakeSetNamedDests(dests);
+
+    NamedDestIndex index;
+    index.build(NULL);
+    EXPECT_EQ(1000, index.count());
+    for(int i = 0; i < 1000; i++){
+        snprintf(name, sizeof(name), "dest.%d", i);
+        EXPECT_EQ(i % 97, findName(index, name));
+    }
+    EXPECT_EQ(-1, findName(index, "dest.1000"));
+}
+
+TEST(namedDestInvalidate){
+    std::vector<FakeNamedDest> dests;
+    addDest(&dests, "intro", 1);
+    fakeSetNamedDests(dests);
+    NamedDestIndex index;
+    index.build(NULL);
+    EXPECT_EQ(1, findName(index, "intro"));
+
+    //Built once: later document changes show only after an invalidate
+    dests[0].pageIndex = 3;
+    fakeSetNamedDests(dests);
+    index.build(NULL);
+    EXPECT_EQ(1, findName(index, "intro"));
+    index.invalidate();
+    EXPECT(!index.built());
+    EXPECT_EQ(-1, findName(index, "intro"));
+    index.build(NULL);
+    EXPECT_EQ(3, findName(index, "intro"));
+}
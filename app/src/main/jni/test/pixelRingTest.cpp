@@ -0,0 +1,95 @@
+#include "jniTest.hpp"
+#include "pixelRing.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <string.h>
+}
+
+TEST(pixelRingTicketLifecycle){
+    PixelRing *ring = PixelRing::create(2, 4096);
+    EXPECT(ring != NULL);
+    if(ring == NULL) return;
+
+    uint32_t generation;
+    int slot = ring->acquireWrite(&generation);
+    EXPECT(slot >= 0);
+    EXPECT_EQ(1u, generation & 1);
+    //Not readable while the pixels are in flight
+    EXPECT(!ring->acquireRead(slot, generation));
+    memset(ring->pixels(slot), 0x5a, 4096);
+    ring->publish(slot, 7, 3, 1, 32, 32, 128);
+
+    uint64_t ticket = PixelRing::ticket(slot, generation);
+    EXPECT_EQ(slot, PixelRing::ticketSlot(ticket));
+    EXPECT_EQ(generation, PixelRing::ticketGeneration(ticket));
+    EXPECT(ring->acquireRead(slot, generation));
+    EXPECT_EQ(7, ring->slot(slot)->documentId);
+    EXPECT_EQ(3, ring->slot(slot)->pageIndex);
+    EXPECT_EQ(1, ring->busySlots());
+    //One reader at a time
+    EXPECT(!ring->acquireRead(slot, generation));
+    ring->releaseRead(slot);
+    EXPECT_EQ(0, ring->busySlots());
+    //Released tickets do not map again
+    EXPECT(!ring->acquireRead(slot, generation));
+    EXPECT(!ring->acquireRead(-1, generation));
+    EXPECT(!ring->acquireRead(2, generation));
+    delete ring;
+}
+
+TEST(pixelRingRecyclesUnreadPages){
+    PixelRing *ring = PixelRing::create(2, 1024);
+    EXPECT(ring != NULL);
+    if(ring == NULL) return;
+
+    uint32_t generations[3];
+    int slots[3];
+    for(int i = 0; i < 2; i++){
+        slots[i] = ring->acquireWrite(&generations[i]);
+        ring->publish(slots[i], 1, i, 1, 8, 8, 32);
+    }
+    //The reader holds the first page, the writer takes the unread second one
+    EXPECT(ring->acquireRead(slots[0], generations[0]));
+    slots[2] = ring->acquireWrite(&generations[2]);
+    EXPECT_EQ(slots[1], slots[2]);
+    EXPECT(!ring->acquireRead(slots[1], generations[1]));
+
+    //Every slot busy: no slot for a writer
+    uint32_t generation;
+    EXPECT_EQ(-1, ring->acquireWrite(&generation));
+    ring->abortWrite(slots[2]);
+    EXPECT(!ring->acquireRead(slots[2], generations[2]));
+    EXPECT(ring->acquireWrite(&generation) >= 0);
+    delete ring;
+}
+
+TEST(pixelRingAttach){
+    PixelRing *ring = PixelRing::create(3, 1000);
+    EXPECT(ring != NULL);
+    if(ring == NULL) return;
+
+    PixelRing *worker = PixelRing::attach(dup(ring->fd()));
+    EXPECT(worker != NULL);
+    if(worker != NULL){
+        EXPECT_EQ(3, worker->slotCount());
+        EXPECT(worker->slotSize() >= 1000);
+
+        //Written in one mapping, read in the other
+        uint32_t generation;
+        int slot = worker->acquireWrite(&generation);
+        memset(worker->pixels(slot), 0x33, 1000);
+        worker->publish(slot, 2, 9, 1, 10, 10, 100);
+        EXPECT(ring->acquireRead(slot, generation));
+        EXPECT_EQ(0x33, static_cast<uint8_t*>(ring->pixels(slot))[999]);
+        ring->releaseRead(slot);
+        delete worker;
+    }
+    delete ring;
+
+    //A region that is not a ring
+    int pipes[2];
+    EXPECT_EQ(0, pipe(pipes));
+    EXPECT(PixelRing::attach(pipes[0]) == NULL);
+    close(pipes[1]);
+}
@@ -0,0 +1,70 @@
+#include "jniTest.hpp"
+#include "scratchArena.hpp"
+
+extern "C" {
+    #include <pthread.h>
+    #include <string.h>
+}
+
+TEST(scratchScopeRewinds){
+    void *first;
+    {
+        ScratchScope scope;
+        first = scope.arena().alloc(100);
+        EXPECT(first != NULL);
+        {
+            ScratchScope inner;
+            void *nested = inner.arena().alloc(100);
+            EXPECT(nested != first);
+        }
+        //The inner scope gave its bytes back
+        void *next = scope.arena().alloc(100);
+        EXPECT(next != first);
+        ScratchScope again;
+        EXPECT(again.arena().alloc(100) == static_cast<void*>(static_cast<char*>(next) + 104));
+    }
+    ScratchScope scope;
+    EXPECT(scope.arena().alloc(100) == first);
+}
+
+TEST(scratchArenaAlignsAndGrows){
+    ScratchScope scope;
+    ScratchArena &arena = scope.arena();
+    arena.alloc(1, 1);
+    double *values = arena.alloc<double>(3);
+    EXPECT(((uintptr_t) values % __alignof__(double)) == 0);
+
+    //Larger than a chunk, the arena grows and the memory is usable
+    size_t before = arena.capacity();
+    char *large = static_cast<char*>(arena.alloc(300 * 1024));
+    EXPECT(large != NULL);
+    EXPECT(arena.capacity() > before);
+    memset(large, 0x5A, 300 * 1024);
+    values[2] = 1.5;
+    EXPECT_EQ(1.5, values[2]);
+}
+
+TEST(scratchArenaShrinksAfterLargeCall){
+    {
+        ScratchScope scope;
+        EXPECT(scope.arena().alloc(1024 * 1024) != NULL);
+        EXPECT(scope.arena().capacity() > 1024 * 1024);
+    }
+    //The outermost scope keeps only the retained size
+    EXPECT(ScratchArena::current().capacity() <= 256 * 1024);
+}
+
+static void* otherThreadArena(void *arg){
+    *static_cast<ScratchArena**>(arg) = &ScratchArena::current();
+    return NULL;
+}
+
+TEST(scratchArenaPerThread){
+    ScratchArena *mine = &ScratchArena::current();
+    ScratchArena *other = NULL;
+    pthread_t thread;
+    EXPECT_EQ(0, pthread_create(&thread, NULL, otherThreadArena, &other));
+    pthread_join(thread, NULL);
+    EXPECT(other != NULL);
+    EXPECT(other != mine);
+}
@@ -0,0 +1,89 @@
+#include "jniTest.hpp"
+#include "textRegex.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+static std::vector<int32_t> regexMatches(const char *pattern, const char *text){
+    std::vector<unsigned short> p = utf16(pattern), t = utf16(text);
+    std::string error;
+    TextRegex *regex = TextRegex::compile(&p[0], p.size(), &error);
+    std::vector<int32_t> matches;
+    EXPECT(regex != NULL);
+    if(regex == NULL) return matches;
+    regex->findAll(&t[0], (int) t.size(), &matches);
+    delete regex;
+    return matches;
+}
+
+//Start and length of every occurrence of part in text, as findAll reports them
+static std::vector<int32_t> ranges(const char *text, const char *part){
+    std::vector<int32_t> out;
+    out.push_back((int32_t) (strstr(text, part) - text));
+    out.push_back((int32_t) strlen(part));
+    return out;
+}
+
+TEST(textRegexPartNumbers){
+    const char *text = "Parts ABC-1234, XYZ-98765 and ab-1234";
+    std::vector<int32_t> matches = regexMatches("[A-Z]{3}-\\d{4}", text);
+    std::vector<int32_t> expected = ranges(text, "ABC-1234");
+    std::vector<int32_t> second = ranges(text, "XYZ-9876");
+    expected.insert(expected.end(), second.begin(), second.end());
+    EXPECT(matches == expected);
+}
+
+TEST(textRegexLeftmostLongest){
+    std::vector<int32_t> matches = regexMatches("a|ab|abc?", "xabcab");
+    EXPECT_EQ((size_t) 4, matches.size());
+    if(matches.size() == 4){
+        EXPECT_EQ(1, matches[0]);
+        EXPECT_EQ(3, matches[1]);
+        EXPECT_EQ(4, matches[2]);
+        EXPECT_EQ(2, matches[3]);
+    }
+}
+
+TEST(textRegexWordBoundary){
+    const char *text = "cat concat cats cat.";
+    std::vector<int32_t> matches = regexMatches("\\bcat\\b", text);
+    EXPECT_EQ((size_t) 4, matches.size());
+    if(matches.size() == 4){
+        EXPECT_EQ(0, matches[0]);
+        EXPECT_EQ(16, matches[2]);
+    }
+}
+
+TEST(textRegexInvalid){
+    const char *patterns[] = { "(ab", "[a-", "a{3,1}", "*a" };
+    for(size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++){
+        std::vector<unsigned short> p = utf16(patterns[i]);
+        std::string error;
+        TextRegex *regex = TextRegex::compile(&p[0], p.size(), &error);
+        EXPECT(regex == NULL);
+        EXPECT(!error.empty());
+        delete regex;
+    }
+}
+
+TEST(textRegexCache){
+    std::vector<unsigned short> p = utf16("\\w+@\\w+");
+    std::vector<unsigned short> text = utf16("mail me@host now");
+    std::string error;
+    TextRegex *first = TextRegex::acquire(&p[0], p.size(), &error);
+    TextRegex *second = TextRegex::acquire(&p[0], p.size(), &error);
+    EXPECT(first != NULL);
+    EXPECT(first == second);
+    if(first == NULL) return;
+    second->release();
+    first->release();
+    //Still cached after the last release, a trim frees it
+    EXPECT(TextRegex::trimCache() > 0);
+
+    //A trim during a search leaves the regex to the searcher
+    TextRegex *held = TextRegex::acquire(&p[0], p.size(), &error);
+    EXPECT_EQ((size_t) 0, TextRegex::trimCache());
+    EXPECT_EQ(12, held->matchAt(&text[0], (int) text.size(), 5));
+    held->release();
+}
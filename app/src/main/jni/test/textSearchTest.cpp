@@ -0,0 +1,57 @@
+#include "jniTest.hpp"
+#include "textSearch.hpp"
+
+TEST(foldTextMapsBack){
+    //"Été  — ﬁn’s"
+    const unsigned short text[] = { 0xC9, 't', 0xE9, ' ', '\n', 0x2014, ' ', 0xFB01, 'n', 0x2019, 's' };
+    FoldedText folded;
+    foldText(text, sizeof(text) / sizeof(text[0]), &folded);
+
+    std::vector<unsigned short> expected = utf16("ete - fin's");
+    EXPECT(folded.text == expected);
+    const int32_t sources[] = { 0, 1, 2, 3, 5, 6, 7, 7, 8, 9, 10 };
+    EXPECT_EQ(sizeof(sources) / sizeof(sources[0]), folded.sourceIndex.size());
+    for(size_t i = 0; i < folded.sourceIndex.size() && i < sizeof(sources) / sizeof(sources[0]); i++){
+        EXPECT_EQ(sources[i], folded.sourceIndex[i]);
+    }
+}
+
+TEST(foldTextDropsCombiningMarks){
+    const unsigned short text[] = { 'e', 0x301, 'x', 0xAD, 'y' };
+    FoldedText folded;
+    foldText(text, 5, &folded);
+    EXPECT(folded.text == utf16("exy"));
+    EXPECT_EQ(4, folded.sourceIndex[2]);
+}
+
+TEST(searchFoldedTextWholeWord){
+    std::vector<unsigned short> text = utf16("Cafe CAFE cafeteria caf");
+    FoldedText folded;
+    foldText(&text[0], text.size(), &folded);
+    std::vector<unsigned short> query = utf16(" cafe ");
+
+    std::vector<int32_t> any, whole;
+    searchFoldedText(folded, &query[0], query.size(), 0, &any);
+    searchFoldedText(folded, &query[0], query.size(), TEXT_SEARCH_WHOLE_WORD, &whole);
+    EXPECT_EQ((size_t) 6, any.size());
+    EXPECT_EQ((size_t) 4, whole.size());
+    if(whole.size() == 4){
+        EXPECT_EQ(0, whole[0]);
+        EXPECT_EQ(4, whole[1]);
+        EXPECT_EQ(5, whole[2]);
+    }
+}
+
+TEST(findFoldedLongText){
+    //Past the vector filter width, matches at both ends and across a vector boundary
+    std::vector<unsigned short> text = utf16("abcxxxxxxxxxxxxxxabcxxxxxxxxxxxabc");
+    std::vector<unsigned short> query = utf16("abc");
+    std::vector<int32_t> positions;
+    findFolded(&text[0], text.size(), &query[0], query.size(), &positions);
+    EXPECT_EQ((size_t) 3, positions.size());
+    if(positions.size() == 3){
+        EXPECT_EQ(0, positions[0]);
+        EXPECT_EQ(17, positions[1]);
+        EXPECT_EQ((int32_t) text.size() - 3, positions[2]);
+    }
+}
@@ -0,0 +1,74 @@
+#include "jniTest.hpp"
+#include "fakePdfium.hpp"
+#include "textSelection.hpp"
+
+//Any non-NULL text page, the fake reports the same chars for all
+#define TEXT_PAGE reinterpret_cast<FPDF_TEXTPAGE>(1)
+
+//"ab\n" on a line at 700..712, "c", U+1F600 and "e" on a line at 678..690
+static void setTwoLines(){
+    const FakeChar chars[] = {
+        { 'a', 10, 712, 18, 700 },
+        { 'b', 20, 712, 28, 700 },
+        { '\n', 0, 0, 0, 0 },
+        { 'c', 10, 690, 18, 678 },
+        { 0x1F600, 20, 690, 28, 678 },
+        { 'e', 30, 690, 38, 678 },
+    };
+    fakeSetChars(std::vector<FakeChar>(chars, chars + 6));
+}
+
+TEST(textSelectionCharAt){
+    setTwoLines();
+    TextSelection selection(TEXT_PAGE);
+    EXPECT_EQ(1, selection.charAt(22, 705));
+    EXPECT_EQ(5, selection.charAt(35, 685));
+    //Past the end of a line and below the page snap to the nearest char
+    EXPECT_EQ(1, selection.charAt(100, 705));
+    EXPECT_EQ(3, selection.charAt(12, 0));
+    EXPECT_EQ(0xFFFD, selection.pageText()[4]);
+    fakeSetChars(std::vector<FakeChar>());
+}
+
+TEST(textSelectionRectsPerLine){
+    setTwoLines();
+    TextSelection selection(TEXT_PAGE);
+    EXPECT(selection.update(12, 706, 25, 684));
+    EXPECT_EQ(0, selection.start());
+    EXPECT_EQ(5, selection.count());
+    //First line whole, second up to the end char
+    const float expected[] = { 10, 712, 28, 700, 10, 690, 28, 678 };
+    EXPECT(selection.rects() == std::vector<float>(expected, expected + 8));
+    //Same range again is no change
+    EXPECT(!selection.update(11, 707, 27, 680));
+
+    std::vector<unsigned short> text;
+    selection.selectedText(&text);
+    const unsigned short units[] = { 'a', 'b', '\n', 'c', 0xD83D, 0xDE00 };
+    EXPECT(text == std::vector<unsigned short>(units, units + 6));
+    fakeSetChars(std::vector<FakeChar>());
+}
+
+TEST(textSelectionSelectRange){
+    setTwoLines();
+    TextSelection selection(TEXT_PAGE);
+    //Either order, clamped to the page
+    EXPECT(selection.select(4, 1));
+    EXPECT_EQ(1, selection.start());
+    EXPECT_EQ(4, selection.count());
+    EXPECT(selection.select(3, 99));
+    EXPECT_EQ(3, selection.start());
+    EXPECT_EQ(3, selection.count());
+    const float expected[] = { 10, 690, 38, 678 };
+    EXPECT(selection.rects() == std::vector<float>(expected, expected + 4));
+    fakeSetChars(std::vector<FakeChar>());
+}
+
+TEST(textSelectionEmptyPage){
+    fakeSetChars(std::vector<FakeChar>());
+    TextSelection selection(TEXT_PAGE);
+    EXPECT_EQ(-1, selection.charAt(10, 10));
+    EXPECT(!selection.update(0, 0, 100, 100));
+    EXPECT_EQ(0, selection.count());
+    EXPECT(selection.rects().empty());
+}
@@ -0,0 +1,87 @@
+#include "jniTest.hpp"
+#include "fakePdfium.hpp"
+#include "webLinks.hpp"
+
+#define TEXT_PAGE reinterpret_cast<FPDF_TEXTPAGE>(1)
+
+//A link wrapped over two lines and one short link further down
+static void setTwoLinks(){
+    std::vector<FakeWebLink> links(2);
+    links[0].url = "http://a.org";
+    const double wrapped[] = { 10, 712, 58, 700, 10, 690, 28, 678 };
+    links[0].rects.assign(wrapped, wrapped + 8);
+    links[1].url = "b.com";
+    const double single[] = { 100, 500, 140, 490 };
+    links[1].rects.assign(single, single + 4);
+    fakeSetWebLinks(links);
+}
+
+TEST(webLinkCacheDetect){
+    setTwoLinks();
+    WebLinkCache *cache = new WebLinkCache();
+    EXPECT(!cache->hasPage(2));
+    cache->detect(2, TEXT_PAGE);
+    EXPECT(cache->hasPage(2));
+    EXPECT_EQ(0, fakeOpenWebLinks());
+
+    std::vector<unsigned short> urls;
+    std::vector<int32_t> urlStarts, rectStarts;
+    std::vector<float> rects;
+    EXPECT(cache->getPage(2, &urls, &urlStarts, &rects, &rectStarts));
+    EXPECT(urls == utf16("http://a.orgb.com"));
+    const int32_t expectedUrlStarts[] = { 0, 12, 17 };
+    EXPECT(urlStarts == std::vector<int32_t>(expectedUrlStarts, expectedUrlStarts + 3));
+    const int32_t expectedRectStarts[] = { 0, 8, 12 };
+    EXPECT(rectStarts == std::vector<int32_t>(expectedRectStarts, expectedRectStarts + 3));
+    EXPECT_EQ((size_t) 12, rects.size());
+    EXPECT(!cache->getPage(3, &urls, &urlStarts, &rects, &rectStarts));
+
+    //A detected page is not loaded again
+    fakeSetWebLinks(std::vector<FakeWebLink>());
+    cache->detect(2, TEXT_PAGE);
+    EXPECT(cache->getPage(2, &urls, &urlStarts, &rects, &rectStarts));
+    EXPECT_EQ((size_t) 3, urlStarts.size());
+    cache->release();
+}
+
+TEST(webLinkCacheLinkAt){
+    setTwoLinks();
+    WebLinkCache *cache = new WebLinkCache();
+    cache->detect(0, TEXT_PAGE);
+    fakeSetWebLinks(std::vector<FakeWebLink>());
+
+    std::vector<unsigned short> url;
+    EXPECT_EQ(1, cache->linkAt(0, 20, 705, &url));
+    EXPECT(url == utf16("http://a.org"));
+    EXPECT_EQ(1, cache->linkAt(0, 15, 680, &url));
+    EXPECT(url == utf16("http://a.org"));
+    EXPECT_EQ(1, cache->linkAt(0, 120, 495, &url));
+    EXPECT(url == utf16("b.com"));
+    //Inside the page bounds but on no rect, outside the bounds, page not detected
+    EXPECT_EQ(0, cache->linkAt(0, 50, 685, &url));
+    EXPECT_EQ(0, cache->linkAt(0, 300, 300, &url));
+    EXPECT_EQ(-1, cache->linkAt(1, 20, 705, &url));
+    cache->release();
+}
+
+TEST(webLinkCacheInvalidate){
+    setTwoLinks();
+    WebLinkCache *cache = new WebLinkCache();
+    cache->detect(1, TEXT_PAGE);
+    cache->detect(4, TEXT_PAGE);
+    cache->invalidate(0, 2);
+    EXPECT(!cache->hasPage(1));
+    EXPECT(cache->hasPage(4));
+
+    //Detected again from the rewritten content
+    fakeSetWebLinks(std::vector<FakeWebLink>());
+    cache->detect(1, TEXT_PAGE);
+    std::vector<unsigned short> url;
+    EXPECT_EQ(0, cache->linkAt(1, 20, 705, &url));
+
+    //Lives until the last reference goes
+    cache->acquire();
+    cache->release();
+    EXPECT(cache->hasPage(4));
+    cache->release();
+}